@@ -0,0 +1,417 @@
+#include "aot/cell_runtime.h"
+#include "sim/runtime.h"
+
+#include <vector>
+#include <set>
+#include <map>
+#include <tuple>
+#include <list>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+
+namespace {
+
+  typedef void (*Process_fn)(char*, char*, char*, char*);
+  typedef int64_t (*Recurrent_fn)(char*, char*, char*, char*, int64_t);
+
+  struct Driver {
+    cell_driver_fn fn;
+    void* user;
+  };
+
+  /** Runtime data of a module instance, see sim::Runset::Module */
+  struct Instance {
+    cell_instance_desc const* desc;
+    std::vector<char> this_in;
+    std::vector<char> this_out;
+    std::vector<char> this_prev;
+    std::vector<char> read_mask;
+    std::vector<std::set<std::size_t>> sensitivity;
+    std::set<std::size_t> run_list;
+    std::multimap<int64_t, std::tuple<int64_t,std::size_t>> schedule;
+    std::multimap<int64_t, std::size_t> recurrent_schedule;
+    std::vector<Driver> drivers;
+    bool port_event = false;
+
+    std::size_t element_containing_offset(std::size_t ofs) const {
+      auto begin = desc->element_offsets;
+      auto end = desc->element_offsets + desc->num_elements;
+      auto it = std::upper_bound(begin, end, static_cast<int64_t>(ofs));
+      return (it - begin) - 1;
+    }
+  };
+
+}
+
+
+struct cell_sim {
+  static unsigned const max_cycles = 20;
+
+  cell_design_desc const* design;
+  std::vector<Instance> instances;
+  std::vector<std::tuple<cell_step_fn,void*>> step_callbacks;
+  int64_t time = 0;
+
+  explicit cell_sim(cell_design_desc const* d);
+  void seed(uint64_t s);
+  void simulate(int64_t duration);
+  int64_t simulate_step(int64_t t, int64_t start, int64_t end);
+  bool simulate_cycle(int64_t t);
+};
+
+
+cell_sim::cell_sim(cell_design_desc const* d)
+  : design(d) {
+  if( design->version != CELL_DESIGN_VERSION )
+    throw std::runtime_error("design descriptor version mismatch");
+
+  instances.resize(design->num_instances);
+
+  for(int64_t i=0; i<design->num_instances; ++i) {
+    auto& inst = instances[i];
+    auto desc = &design->instances[i];
+
+    inst.desc = desc;
+    inst.this_in.resize(desc->frame_size, 0);
+    inst.this_out.resize(desc->frame_size, 0);
+    inst.this_prev.resize(desc->frame_size, 0);
+    inst.read_mask.resize(desc->read_mask_size, 0);
+    inst.sensitivity.resize(desc->num_elements);
+
+    for(int64_t j=0; j<desc->num_processes; ++j) {
+      auto const& proc = desc->processes[j];
+      switch( proc.kind ) {
+        case CELL_PROCESS:
+          inst.run_list.insert(j);
+          break;
+
+        case CELL_PERIODIC:
+          inst.run_list.insert(j);
+          inst.schedule.insert(std::make_pair(proc.time,
+                std::make_tuple(proc.time, static_cast<std::size_t>(j))));
+          break;
+
+        case CELL_ONCE:
+          inst.schedule.insert(std::make_pair(proc.time,
+                std::make_tuple(int64_t(0), static_cast<std::size_t>(j))));
+          break;
+
+        case CELL_RECURRENT:
+          inst.recurrent_schedule.insert(std::make_pair(int64_t(0),
+                static_cast<std::size_t>(j)));
+          break;
+
+        default:
+          throw std::runtime_error("unknown process kind in design descriptor");
+      }
+    }
+  }
+
+  // set pointers to the frames of instantiated modules
+  for(auto& inst : instances) {
+    for(int64_t k=0; k<inst.desc->num_children; ++k) {
+      auto ofs = inst.desc->child_offsets[k];
+      auto& child = instances.at(inst.desc->child_instances[k]);
+      char* ptr_in = child.this_in.data();
+      char* ptr_out = child.this_out.data();
+
+      std::copy_n(reinterpret_cast<char*>(&ptr_in), sizeof(ptr_in),
+          inst.this_in.data() + ofs);
+      std::copy_n(reinterpret_cast<char*>(&ptr_out), sizeof(ptr_out),
+          inst.this_out.data() + ofs);
+      std::copy_n(reinterpret_cast<char*>(&ptr_in), sizeof(ptr_in),
+          inst.this_prev.data() + ofs);
+    }
+  }
+
+  seed(initial_rand_state);
+
+  // call __init__
+  for(auto& inst : instances) {
+    if( !inst.desc->init )
+      continue;
+
+    auto init = reinterpret_cast<Process_fn>(inst.desc->init);
+    init(inst.this_out.data(),
+        inst.this_in.data(),
+        inst.this_prev.data(),
+        inst.read_mask.data());
+    inst.this_in = inst.this_out;
+    inst.this_prev = inst.this_out;
+  }
+}
+
+
+void
+cell_sim::seed(uint64_t s) {
+  rand_state(s);
+
+  for(auto& inst : instances) {
+    auto ofs = inst.desc->rand_state_offset;
+    if( ofs == 0 )
+      continue;
+
+    auto state = cell_rand_stream(s, inst.desc->path);
+    auto data = reinterpret_cast<char const*>(&state);
+    std::copy_n(data, sizeof(state), inst.this_in.data() + ofs);
+    std::copy_n(data, sizeof(state), inst.this_out.data() + ofs);
+    std::copy_n(data, sizeof(state), inst.this_prev.data() + ofs);
+  }
+}
+
+
+void
+cell_sim::simulate(int64_t duration) {
+  int64_t const start = time;
+  int64_t const end = time + duration;
+
+  for(int64_t t=start; t<end; ) {
+    int64_t next_t = simulate_step(t, start, end);
+
+    for(auto const& cb : step_callbacks)
+      std::get<0>(cb)(t, std::get<1>(cb));
+
+    t = next_t;
+  }
+
+  time = end;
+}
+
+
+int64_t
+cell_sim::simulate_step(int64_t t, int64_t start, int64_t end) {
+  int64_t next_t = end;
+
+  for(auto& inst : instances) {
+    std::list<std::pair<int64_t, std::tuple<int64_t,std::size_t>>> new_schedules;
+    std::list<std::pair<int64_t, std::size_t>> new_schedules_recurrent;
+
+    // add timed processes to the run list
+    auto timed_range = inst.schedule.equal_range(t);
+    for(auto it=timed_range.first; it != timed_range.second; ++it) {
+      auto period = std::get<0>(it->second);
+      auto proc = std::get<1>(it->second);
+      inst.run_list.insert(proc);
+
+      if( period > 0 )
+        new_schedules.push_back(std::make_pair(t + period, it->second));
+    }
+
+    // execute recurrent processes
+    auto recurrent_range = inst.recurrent_schedule.equal_range(t);
+    for(auto it=recurrent_range.first; it != recurrent_range.second; ++it) {
+      auto fn = reinterpret_cast<Recurrent_fn>(
+          inst.desc->processes[it->second].code);
+      auto next = fn(inst.this_out.data(),
+          inst.this_in.data(),
+          inst.this_prev.data(),
+          inst.read_mask.data(),
+          t);
+      new_schedules_recurrent.push_back(std::make_pair(next, it->second));
+    }
+
+    inst.schedule.erase(timed_range.first, timed_range.second);
+    inst.schedule.insert(new_schedules.begin(), new_schedules.end());
+    inst.recurrent_schedule.erase(recurrent_range.first, recurrent_range.second);
+    inst.recurrent_schedule.insert(new_schedules_recurrent.begin(),
+        new_schedules_recurrent.end());
+
+    // select next point in time for simulation
+    auto nextit = inst.schedule.upper_bound(start);
+    if( nextit != inst.schedule.end() )
+      next_t = std::min(next_t, nextit->first);
+
+    auto nextit_rec = inst.recurrent_schedule.upper_bound(start);
+    if( nextit_rec != inst.recurrent_schedule.end() )
+      next_t = std::min(next_t, nextit_rec->first);
+  }
+
+  // simulate cycles until all signals are stable
+  unsigned cycle = 0;
+  bool rerun;
+
+  do {
+    rerun = simulate_cycle(t);
+  } while( (cycle++ < max_cycles) && rerun );
+
+  return next_t;
+}
+
+
+bool
+cell_sim::simulate_cycle(int64_t t) {
+  for(auto& inst : instances) {
+    for(auto const& drv : inst.drivers)
+      drv.fn(t,
+          inst.this_in.data(),
+          inst.this_out.data(),
+          inst.this_prev.data(),
+          drv.user);
+
+    for(auto const& j : inst.run_list) {
+      auto const& proc = inst.desc->processes[j];
+      bool sensitive = (proc.kind == CELL_PROCESS);
+
+      if( sensitive )
+        std::fill(inst.read_mask.begin(), inst.read_mask.end(), 0);
+
+      auto fn = reinterpret_cast<Process_fn>(proc.code);
+      fn(inst.this_out.data(),
+          inst.this_in.data(),
+          inst.this_prev.data(),
+          inst.read_mask.data());
+
+      if( sensitive ) {
+        for(std::size_t k=0; k<inst.read_mask.size(); ++k) {
+          if( inst.read_mask[k] )
+            inst.sensitivity[k].insert(j);
+          else
+            inst.sensitivity[k].erase(j);
+        }
+      }
+    }
+  }
+
+  // find modified signals
+  bool rerun = false;
+
+  for(auto& inst : instances) {
+    auto size = inst.this_in.size();
+    char const* ptr_in = inst.this_in.data();
+    char const* ptr_out = inst.this_out.data();
+    bool modified = false;
+
+    inst.run_list.clear();
+    inst.port_event = false;
+
+    for(std::size_t i=0; i<size; ++i) {
+      if( ptr_out[i] != ptr_in[i] ) {
+        auto elem = inst.element_containing_offset(i);
+        modified = true;
+
+        if( elem == 0 )
+          inst.port_event = true;
+
+        auto const& deps = inst.sensitivity[elem];
+        inst.run_list.insert(deps.begin(), deps.end());
+      }
+    }
+
+    inst.this_prev = inst.this_in;
+    if( modified )
+      inst.this_in = inst.this_out;
+
+    if( !inst.run_list.empty() )
+      rerun = true;
+  }
+
+  // port events trigger processes of the instantiating module
+  for(auto& inst : instances) {
+    for(int64_t k=0; k<inst.desc->num_children; ++k) {
+      auto const& child = instances[inst.desc->child_instances[k]];
+      if( !child.port_event )
+        continue;
+
+      auto elem = inst.element_containing_offset(inst.desc->child_offsets[k]);
+      auto const& deps = inst.sensitivity[elem];
+      inst.run_list.insert(deps.begin(), deps.end());
+    }
+
+    if( !inst.run_list.empty() )
+      rerun = true;
+  }
+
+  return rerun;
+}
+
+
+
+//--------------------------------------------------------------------------
+// C API
+//--------------------------------------------------------------------------
+
+extern "C" {
+
+  cell_sim* cell_sim_create(cell_design_desc const* design) {
+    try {
+      return new cell_sim(design);
+    } catch( std::exception const& ) {
+      return nullptr;
+    }
+  }
+
+
+  void cell_sim_destroy(cell_sim* sim) {
+    delete sim;
+  }
+
+
+  void cell_sim_seed(cell_sim* sim, uint64_t seed) {
+    sim->seed(seed);
+  }
+
+
+  int cell_sim_simulate(cell_sim* sim, int64_t duration) {
+    try {
+      sim->simulate(duration);
+    } catch( std::exception const& ) {
+      return 1;
+    }
+
+    return 0;
+  }
+
+
+  int64_t cell_sim_time(cell_sim const* sim) {
+    return sim->time;
+  }
+
+
+  int cell_sim_find_instance(cell_sim const* sim, char const* path) {
+    std::string const p(path);
+
+    for(std::size_t i=0; i<sim->instances.size(); ++i) {
+      if( p == sim->instances[i].desc->path )
+        return static_cast<int>(i);
+    }
+
+    return -1;
+  }
+
+
+  char* cell_sim_frame(cell_sim* sim, int instance) {
+    return sim->instances.at(instance).this_in.data();
+  }
+
+
+  char* cell_sim_frame_out(cell_sim* sim, int instance) {
+    return sim->instances.at(instance).this_out.data();
+  }
+
+
+  int cell_sim_add_driver(cell_sim* sim,
+      int instance,
+      cell_driver_fn fn,
+      void* user) {
+    if( (instance < 0)
+        || (static_cast<std::size_t>(instance) >= sim->instances.size()) )
+      return 1;
+
+    Driver drv;
+    drv.fn = fn;
+    drv.user = user;
+    sim->instances[instance].drivers.push_back(drv);
+    return 0;
+  }
+
+
+  void cell_sim_on_step(cell_sim* sim, cell_step_fn fn, void* user) {
+    sim->step_callbacks.push_back(std::make_tuple(fn, user));
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,123 @@
+#pragma once
+
+/** @file
+ * Runtime for ahead-of-time compiled designs.
+ *
+ * Designs written with cellsim --emit-object contain a descriptor of type
+ * cell_design_desc. This runtime implements the scheduler of
+ * sim::Simulation_engine on top of it, without any dependency on LLVM. All
+ * times are given in picoseconds.
+ * */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version of the descriptor layout */
+#define CELL_DESIGN_VERSION 2
+
+/** Kinds of processes */
+enum {
+  CELL_PROCESS = 0,    /**< sensitive process */
+  CELL_PERIODIC = 1,   /**< periodic process, time is the period */
+  CELL_ONCE = 2,       /**< process run once, time is the point in time */
+  CELL_RECURRENT = 3   /**< recurrent process */
+};
+
+struct cell_process_desc {
+  int64_t kind;
+  int64_t time;
+  void* code;
+};
+
+struct cell_instance_desc {
+  char const* path;                /**< hierarchical path, "" for top */
+  int64_t frame_size;
+  int64_t read_mask_size;
+  int64_t num_elements;
+  int64_t const* element_offsets;
+  int64_t num_processes;
+  struct cell_process_desc const* processes;
+  void* init;                      /**< __init__ function or NULL */
+  int64_t num_children;
+  int64_t const* child_offsets;    /**< offset of the child pointer in frame */
+  int64_t const* child_instances;  /**< instance index of the child */
+  int64_t rand_state_offset;       /**< offset of the random number
+                                        generator state in frame, 0 if the
+                                        module does not use it */
+};
+
+struct cell_design_desc {
+  int64_t version;
+  int64_t num_instances;
+  struct cell_instance_desc const* instances;
+};
+
+
+typedef struct cell_sim cell_sim;
+
+/** Driver/observer callback, see sim::Simulation_engine::add_driver() */
+typedef void (*cell_driver_fn)(int64_t t,
+    char* this_in,
+    char* this_out,
+    char* this_prev,
+    void* user);
+
+/** Called after every simulation step */
+typedef void (*cell_step_fn)(int64_t t, void* user);
+
+
+/** Create a simulation and run __init__ of all instances
+ *
+ * Random number streams are seeded as by cell_sim_seed() with the default
+ * seed of sim::Simulation_engine.
+ *
+ * @return NULL on error */
+cell_sim* cell_sim_create(struct cell_design_desc const* design);
+void cell_sim_destroy(cell_sim* sim);
+
+/** Reset the random number streams of all instances
+ *
+ * Every instance gets the stream cell_rand_stream(seed, path), the calling
+ * thread's stream used outside of modules starts at seed, see
+ * sim::Simulation_engine::seed().
+ * */
+void cell_sim_seed(cell_sim* sim, uint64_t seed);
+
+/** Simulate for duration picoseconds
+ *
+ * @return 0 on success */
+int cell_sim_simulate(cell_sim* sim, int64_t duration);
+
+/** Current simulation time */
+int64_t cell_sim_time(cell_sim const* sim);
+
+/** Find an instance by hierarchical path
+ *
+ * @return Instance index or -1 if not found */
+int cell_sim_find_instance(cell_sim const* sim, char const* path);
+
+/** Current values (this_in frame) of an instance */
+char* cell_sim_frame(cell_sim* sim, int instance);
+
+/** Frame written by processes (this_out) of an instance */
+char* cell_sim_frame_out(cell_sim* sim, int instance);
+
+/** Register a driver/observer callback for an instance
+ *
+ * @return 0 on success */
+int cell_sim_add_driver(cell_sim* sim,
+    int instance,
+    cell_driver_fn fn,
+    void* user);
+
+/** Register a callback after every simulation step */
+void cell_sim_on_step(cell_sim* sim, cell_step_fn fn, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -4,28 +4,77 @@
 
 namespace ir {
 
+  /** Builtin types, functions and operators
+   *
+   * The tables are owned by the compilation context using them, e.g. one per
+   * sim::Simulation_engine, so independent compilations do not share any
+   * mutable state. The static accessors refer to the tables made current for
+   * the calling thread by a Builtins::Scope, or to tables private to the
+   * thread if there is none.
+   * */
   template<typename Impl = No_impl>
   struct Builtins {
-    static std::map<Label, std::shared_ptr<Type<Impl>>> types;
-    static std::map<Label, std::shared_ptr<Object<Impl>>> objects;
-    static std::multimap<Label, std::shared_ptr<Function<Impl>>> functions;
-    static std::multimap<Label, std::shared_ptr<Operator<Impl>>> operators;
+    typedef std::map<Label, std::shared_ptr<Type<Impl>>> Type_map;
+    typedef std::map<Label, std::shared_ptr<Object<Impl>>> Object_map;
+    typedef std::multimap<Label, std::shared_ptr<Function<Impl>>> Function_map;
+    typedef std::multimap<Label, std::shared_ptr<Operator<Impl>>> Operator_map;
+
+    /** Builtins of one compilation context */
+    struct Tables {
+      Type_map types;
+      Object_map objects;
+      Function_map functions;
+      Operator_map operators;
+    };
+
+    /** Make tables current for the calling thread during its lifetime */
+    class Scope {
+      public:
+        explicit Scope(Tables& tables)
+          : m_prev(current) {
+          current = &tables;
+        }
+
+        ~Scope() {
+          current = m_prev;
+        }
+
+        Scope(Scope const&) = delete;
+        Scope& operator = (Scope const&) = delete;
+
+      private:
+        Tables* m_prev;
+    };
+
+
+    static Tables& tables() {
+      static thread_local Tables thread_tables;
+      return current ? *current : thread_tables;
+    }
 
-    static std::shared_ptr<Socket<Impl>> null_socket;
+    static Type_map& types() { return tables().types; }
+    static Object_map& objects() { return tables().objects; }
+    static Function_map& functions() { return tables().functions; }
+    static Operator_map& operators() { return tables().operators; }
 
+
+    /** Fill the current tables with the builtins */
     static void init() {
+      auto& types = Builtins::types();
+      auto& functions = Builtins::functions();
+
       types.clear();
-      objects.clear();
+      objects().clear();
       functions.clear();
-      operators.clear();
+      operators().clear();
 
       // types
       types["unit"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"unit"});
-		  types["void"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"void"});
-		  types["bool"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"bool"});
-		  types["int"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"int"});
-		  types["logic"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"logic"});
-		  types["string"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"string"});
+      types["void"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"void"});
+      types["bool"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"bool"});
+      types["int"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"int"});
+      types["logic"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"logic"});
+      types["string"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"string"});
       types["float"] = std::shared_ptr<Type<Impl>>(new Type<Impl>{"float"});
 
       // functions
@@ -36,32 +85,67 @@ namespace ir {
           "msg"});
       functions.insert(std::make_pair("print", printf));
 
-      auto randf = std::make_shared<Function<Impl>>();
-      randf->name = "print";
-      randf->return_type = types.at("int");
-      functions.insert(std::make_pair("rand", randf));
+      // print(msg, value), the value is formatted when the log is written
+      for(auto type : {"int", "float"}) {
+        auto f = std::make_shared<Function<Impl>>();
+        f->name = std::string("cell_print_") + type;
+        f->return_type = types.at("int");
+        f->parameters.emplace_back(new Object<Impl>{types.at("string"),
+            "msg"});
+        f->parameters.emplace_back(new Object<Impl>{types.at(type), "value"});
+        functions.insert(std::make_pair("print", f));
+      }
+
+      // random number generators, named after their runtime functions
+      auto add_rand = [&](Label const& name,
+          Label const& return_type,
+          std::vector<std::pair<Label, Label>> const& params) {
+        auto f = std::make_shared<Function<Impl>>();
+        f->name = "cell_" + name;
+        f->return_type = types.at(return_type);
+        for(auto const& p : params)
+          f->parameters.emplace_back(new Object<Impl>{types.at(p.second),
+              p.first});
+        functions.insert(std::make_pair(name, f));
+      };
+
+      add_rand("rand", "int", {});
+      add_rand("rand_int", "int", {{"lo", "int"}, {"hi", "int"}});
+      add_rand("rand_float", "float", {});
+      add_rand("rand_normal", "float", {{"mean", "float"}, {"sd", "float"}});
+      add_rand("rand_poisson", "int", {{"lambda", "float"}});
+
+      // math functions, overloads are told apart by the type in their name
+      auto add_math = [&](Label const& name,
+          Label const& type,
+          std::vector<Label> const& params) {
+        auto f = std::make_shared<Function<Impl>>();
+        f->name = "cell_" + name + "_" + type;
+        f->return_type = types.at(type);
+        for(auto const& p : params)
+          f->parameters.emplace_back(new Object<Impl>{types.at(type), p});
+        functions.insert(std::make_pair(name, f));
+      };
+
+      for(auto name : {"exp", "log", "sqrt", "sin", "cos", "floor", "ceil"})
+        add_math(name, "float", {"x"});
+      add_math("pow", "float", {"x", "y"});
+      add_math("fma", "float", {"a", "b", "c"});
+      for(auto type : {"int", "float"}) {
+        add_math("abs", type, {"x"});
+        add_math("min", type, {"a", "b"});
+        add_math("max", type, {"a", "b"});
+        add_math("clamp", type, {"x", "lo", "hi"});
+      }
     };
-  };
-
 
-  template<typename Impl>
-	std::map<Label, std::shared_ptr<Type<Impl>>> Builtins<Impl>::types {
-	};
-
-  template<typename Impl>
-	std::map<Label, std::shared_ptr<Object<Impl>>> Builtins<Impl>::objects {
-	};
 
-  template<typename Impl>
-	std::multimap<Label, std::shared_ptr<Function<Impl>>> Builtins<Impl>::functions {
-	};
-
-  template<typename Impl>
-  std::multimap<Label, std::shared_ptr<Operator<Impl>>> Builtins<Impl>::operators {
+    private:
+      static thread_local Tables* current;
   };
 
 
-  //template<typename Impl>
-	//std::shared_ptr<Type<Impl>> Builtins<Impl>::null_socket(new Type<Impl>("null_socket"));
+  template<typename Impl>
+  thread_local typename Builtins<Impl>::Tables* Builtins<Impl>::current = nullptr;
 
 }
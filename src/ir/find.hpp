@@ -67,7 +67,7 @@ namespace ir {
     auto rv = find_in_namespace<Type<Impl>>(ns, &Namespace<Impl>::sockets, sock_name);
     if( !rv ) {
       if( sock_name == "unit" ) {
-        return Builtins<Impl>::types.at("unit");
+        return Builtins<Impl>::types().at("unit");
       }
     }
     return rv;
@@ -79,8 +79,8 @@ namespace ir {
       Label const& type_name) {
     auto rv = find_in_namespace<Type<Impl>>(ns, &Namespace<Impl>::types, type_name);
     if( !rv ) {
-      auto it = Builtins<Impl>::types.find(type_name);
-      if( it != Builtins<Impl>::types.end() )
+      auto it = Builtins<Impl>::types().find(type_name);
+      if( it != Builtins<Impl>::types().end() )
         return it->second;
       else
         return std::shared_ptr<Type<Impl>>(nullptr);
@@ -114,7 +114,7 @@ namespace ir {
         param_type_b);
     if( !func ) {
       // check builtins
-      auto const range2 = Builtins<Impl>::functions.equal_range(func_name);
+      auto const range2 = Builtins<Impl>::functions().equal_range(func_name);
       func = resolve_function_overload<Impl>(range2.first,
           range2.second,
           param_type_a,
@@ -226,7 +226,7 @@ namespace ir {
 
     // not found yet, check built-in operators
     {
-      auto& m = Builtins<Impl>::operators;
+      auto& m = Builtins<Impl>::operators();
 
       auto range = m.equal_range(name);
       if( range.first != m.end() ) {
@@ -271,7 +271,7 @@ namespace ir {
 
     // not found yet, check built-in operators
     {
-      auto& m = Builtins<Impl>::operators;
+      auto& m = Builtins<Impl>::operators();
 
       auto range = m.equal_range(name);
       if( range.first != m.end() ) {
@@ -9,6 +9,8 @@
 #include "ast/module_def.h"
 #include "time.h"
 
+class Parse_driver;
+
 /** Internal represenation namespace */
 namespace ir {
 
@@ -252,6 +254,11 @@ namespace ir {
     Label name;
     std::shared_ptr<Namespace<Impl>> ns;
     std::vector<std::string> lookup_path;
+    /** Files parsed ahead of scanning (by filename)
+     *
+     * The drivers are kept, locations of the AST nodes refer to their
+     * filenames. */
+    std::map<std::string, std::shared_ptr<Parse_driver>> parsed_files;
 
     typename Impl::Library impl;
   };
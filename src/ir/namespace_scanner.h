@@ -127,7 +127,7 @@ namespace ir {
               insert_socket(sock);
             }
           } else {
-            m_mod.socket = Builtins<Impl>::types.at("unit");
+            m_mod.socket = Builtins<Impl>::types().at("unit");
           }
 
           auto port_obj = std::make_shared<Object<Impl>>();
@@ -8,8 +8,7 @@
 
 namespace ir {
 
-  template<typename Impl>
-  std::string path_lookup(std::shared_ptr<Library<Impl>> lib,
+  inline std::string path_lookup(std::vector<std::string> const& lookup_path,
       Label const& name) {
     namespace bf = boost::filesystem;
 
@@ -18,7 +17,7 @@ namespace ir {
     log4cxx::LoggerPtr logger = log4cxx::Logger::getLogger("cell.path");
     std::string const needle(name + ext);
 
-    for(auto const& p : lib->lookup_path) {
+    for(auto const& p : lookup_path) {
       auto path = bf::path(p) /= needle;
       LOG4CXX_DEBUG(logger, "searching for " << path);
       if( bf::exists(path) && bf::is_regular_file(path) )
@@ -28,6 +27,13 @@ namespace ir {
     return std::string("");
   }
 
+
+  template<typename Impl>
+  std::string path_lookup(std::shared_ptr<Library<Impl>> lib,
+      Label const& name) {
+    return path_lookup(lib->lookup_path, name);
+  }
+
 }
 
 
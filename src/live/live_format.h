@@ -0,0 +1,64 @@
+#pragma once
+
+/** @file
+ * Layout of the shared memory segment written by sim::Live_instrumenter.
+ *
+ * The segment starts with a Header, followed by the signal table, the
+ * string table holding the signal names and the data area holding copies
+ * of all module frames. Signal offsets are relative to the data area.
+ *
+ * The data area and the time stamp are protected by a sequence lock: the
+ * writer increments sequence before and after updating them, so readers
+ * retry while sequence is odd or changed during their read.
+ * */
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace live {
+
+  static char const magic[8] = {'C','E','L','L','L','I','V','E'};
+  static uint32_t const format_version = 1;
+
+  enum Kind {
+    integer = 0,
+    real = 1
+  };
+
+  enum State {
+    running = 0,
+    finished = 1
+  };
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t segment_size;
+    uint64_t num_signals;
+    uint64_t signals_offset;
+    uint64_t names_offset;
+    uint64_t data_offset;
+    uint64_t data_size;
+
+    // protected by sequence
+    std::atomic<uint64_t> sequence;
+    int64_t time_ps;
+    uint64_t num_updates;
+    uint32_t state;
+    uint32_t reserved;
+  };
+
+  struct Signal_entry {
+    uint64_t name_offset;   /**< relative to the string table */
+    uint32_t name_size;
+    uint32_t width;         /**< in bits */
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;        /**< relative to the data area */
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
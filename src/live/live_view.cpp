@@ -0,0 +1,116 @@
+#include "live/live_view.h"
+
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace live {
+
+  Live_view::Live_view(std::string const& name)
+    : m_name(name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if( fd < 0 ) {
+      std::stringstream strm;
+      strm << "Could not open shared memory segment '" << name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    struct stat st;
+    if( (fstat(fd, &st) != 0) || (st.st_size < static_cast<off_t>(sizeof(Header))) ) {
+      close(fd);
+      std::stringstream strm;
+      strm << "Shared memory segment '" << name << "' is too small";
+      throw std::runtime_error(strm.str());
+    }
+
+    m_size = st.st_size;
+    m_addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( m_addr == MAP_FAILED ) {
+      m_addr = nullptr;
+      std::stringstream strm;
+      strm << "Could not map shared memory segment '" << name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    auto base = static_cast<char const*>(m_addr);
+    m_header = reinterpret_cast<Header const*>(base);
+
+    if( (std::memcmp(m_header->magic, magic, sizeof(magic)) != 0)
+        || (m_header->version != format_version)
+        || (m_header->header_size != sizeof(Header))
+        || (m_header->segment_size != m_size)
+        || (m_header->signals_offset
+          + m_header->num_signals * sizeof(Signal_entry) > m_size)
+        || (m_header->data_offset + m_header->data_size > m_size) ) {
+      munmap(m_addr, m_size);
+      m_addr = nullptr;
+      std::stringstream strm;
+      strm << "'" << name << "' is not a live view segment of version "
+        << format_version;
+      throw std::runtime_error(strm.str());
+    }
+
+    m_data = base + m_header->data_offset;
+
+    auto entries = reinterpret_cast<Signal_entry const*>(base
+        + m_header->signals_offset);
+    auto names = base + m_header->names_offset;
+    for(uint64_t i=0; i<m_header->num_signals; ++i) {
+      Signal sig;
+      sig.name.assign(names + entries[i].name_offset, entries[i].name_size);
+      sig.width = entries[i].width;
+      sig.kind = static_cast<Kind>(entries[i].kind);
+      sig.offset = entries[i].offset;
+      m_signals.push_back(sig);
+    }
+  }
+
+
+  Live_view::~Live_view() {
+    if( m_addr )
+      munmap(m_addr, m_size);
+  }
+
+
+  int64_t
+  Live_view::find(std::string const& name) const {
+    for(std::size_t i=0; i<m_signals.size(); ++i) {
+      if( m_signals[i].name == name )
+        return i;
+    }
+
+    return -1;
+  }
+
+
+  int64_t
+  Live_view::snapshot(std::vector<char>& dst) const {
+    dst.resize(m_header->data_size);
+    return read([&]() {
+          std::memcpy(dst.data(), m_data, dst.size());
+        });
+  }
+
+
+  uint64_t
+  Live_view::num_updates() const {
+    uint64_t rv;
+    read([&]() { rv = m_header->num_updates; });
+    return rv;
+  }
+
+
+  bool
+  Live_view::finished() const {
+    uint32_t rv;
+    read([&]() { rv = m_header->state; });
+    return rv == live::finished;
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
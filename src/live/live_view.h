@@ -0,0 +1,101 @@
+#pragma once
+
+#include "live/live_format.h"
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace live {
+
+  /** Read only view of a segment written by sim::Live_instrumenter
+   *
+   * Values are read directly from shared memory. Use read() to access
+   * several values from the same simulation step.
+   * */
+  class Live_view {
+    public:
+      struct Signal {
+        std::string name;     /**< hierarchical name, e.g. top.cpu.pc */
+        uint32_t width;
+        Kind kind;
+        uint64_t offset;
+      };
+
+
+      /** Open the segment name, see shm_open() */
+      explicit Live_view(std::string const& name);
+      ~Live_view();
+
+      Live_view(Live_view const&) = delete;
+      Live_view& operator = (Live_view const&) = delete;
+
+      std::vector<Signal> const& signals() const { return m_signals; }
+
+      /** @return Index of the signal or -1 if not found */
+      int64_t find(std::string const& name) const;
+
+      /** Address of a signal's value, only consistent within read() */
+      char const* data(std::size_t signal) const {
+        return m_data + m_signals.at(signal).offset;
+      }
+
+      /** Call fn until it ran on the state of a single simulation step
+       *
+       * fn may be called several times and must not have side effects
+       * other than copying values.
+       *
+       * @return Simulation time in picoseconds of the state fn saw
+       * */
+      template<typename Fn>
+      int64_t read(Fn fn) const {
+        while( true ) {
+          auto seq = m_header->sequence.load(std::memory_order_acquire);
+          if( seq & 1 )
+            continue;
+
+          fn();
+          auto t = m_header->time_ps;
+
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if( m_header->sequence.load(std::memory_order_relaxed) == seq )
+            return t;
+        }
+      }
+
+      /** Read a single value */
+      template<typename T>
+      T get(std::size_t signal) const {
+        T rv;
+        auto ptr = data(signal);
+        read([&]() { std::memcpy(&rv, ptr, sizeof(rv)); });
+        return rv;
+      }
+
+      /** Copy the complete data area */
+      int64_t snapshot(std::vector<char>& dst) const;
+
+      /** Simulation time of the last update in picoseconds */
+      int64_t time() const { return read([](){}); }
+
+      /** Number of updates written so far */
+      uint64_t num_updates() const;
+
+      /** true once the simulation finished */
+      bool finished() const;
+
+
+    private:
+      std::string m_name;
+      void* m_addr = nullptr;
+      std::size_t m_size = 0;
+      Header const* m_header = nullptr;
+      char const* m_data = nullptr;
+      std::vector<Signal> m_signals;
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <ucontext.h>
+
+
+namespace method {
+
+  /** Stackful coroutine on top of ucontext
+   *
+   * The function passed to the constructor runs on its own stack. It starts
+   * with the first call to resume() and runs until it calls yield() or
+   * returns, then resume() returns to the caller. Exceptions leaving the
+   * function are rethrown by resume().
+   *
+   * Destroying a suspended coroutine unwinds its stack: yield() throws
+   * Coroutine::Cancel, which must not be caught by the function.
+   * */
+  class Coroutine {
+    public:
+      typedef std::function<void()> Function;
+
+      /** Thrown by yield() if a suspended coroutine is destroyed */
+      struct Cancel {};
+
+      static std::size_t const default_stack_size = 64 * 1024;
+
+
+      explicit Coroutine(Function f,
+          std::size_t stack_size = default_stack_size)
+        : m_function(std::move(f)),
+          m_stack(new char[stack_size]) {
+        if( getcontext(&m_context) != 0 )
+          throw std::runtime_error("getcontext failed");
+
+        m_context.uc_stack.ss_sp = m_stack.get();
+        m_context.uc_stack.ss_size = stack_size;
+        m_context.uc_link = &m_caller;
+
+        // makecontext only passes int arguments
+        auto self = reinterpret_cast<uintptr_t>(this);
+        makecontext(&m_context,
+            reinterpret_cast<void(*)()>(&Coroutine::trampoline),
+            2,
+            static_cast<unsigned>(self >> 32),
+            static_cast<unsigned>(self & 0xffffffff));
+      }
+
+      Coroutine(Coroutine const&) = delete;
+      Coroutine& operator = (Coroutine const&) = delete;
+
+      ~Coroutine() {
+        if( m_started && !m_done ) {
+          m_cancel = true;
+          try {
+            resume();
+          } catch(...) {
+          }
+        }
+      }
+
+
+      /** Run the coroutine until it yields or returns */
+      void resume() {
+        if( m_done )
+          throw std::runtime_error("Coroutine::resume() called on finished "
+              "coroutine");
+
+        auto prev = current();
+        current() = this;
+        m_started = true;
+        swapcontext(&m_caller, &m_context);
+        current() = prev;
+
+        if( m_exception ) {
+          auto e = m_exception;
+          m_exception = nullptr;
+          std::rethrow_exception(e);
+        }
+      }
+
+      /** Return to the caller of resume(), call from within the coroutine */
+      void yield() {
+        swapcontext(&m_context, &m_caller);
+        if( m_cancel )
+          throw Cancel();
+      }
+
+      bool done() const { return m_done; }
+
+      /** The coroutine running on this thread, nullptr outside of any */
+      static Coroutine*& current() {
+        static thread_local Coroutine* rv = nullptr;
+        return rv;
+      }
+
+
+    private:
+      Function m_function;
+      std::unique_ptr<char[]> m_stack;
+      ucontext_t m_context;
+      ucontext_t m_caller;
+      bool m_started = false;
+      bool m_done = false;
+      bool m_cancel = false;
+      std::exception_ptr m_exception;
+
+
+      static void trampoline(unsigned hi, unsigned lo) {
+        auto self = reinterpret_cast<Coroutine*>(
+            (static_cast<uintptr_t>(hi) << 32) | static_cast<uintptr_t>(lo));
+
+        try {
+          self->m_function();
+        } catch(Cancel const&) {
+        } catch(...) {
+          self->m_exception = std::current_exception();
+        }
+
+        // returns to m_caller through uc_link
+        self->m_done = true;
+      }
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
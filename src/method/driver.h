@@ -2,6 +2,9 @@
 
 #include "logging/logger.h"
 #include "sim/simulation_engine.h"
+#include "method/frame_view.h"
+
+#include <type_traits>
 
 /** Verification methodology */
 namespace method {
@@ -24,6 +27,16 @@ namespace method {
    * In both cases port will be loaded with the contents of the this_in module
    * frame.  For drive the return value will overwrite this_out at the beginnig
    * of the cycle.
+   *
+   * If Socket is a view type generated by cellwrap --views (derived from
+   * Frame_view) the socket is not copied. Instead a view referencing the
+   * module frames is passed and the expected function signatures are
+   *
+   * - void Derived::observe(ir::Time const& t, Socket const& port)
+   * - void Derived::drive(ir::Time const& t, Socket& port)
+   *
+   * Getters of the view read this_in, setters write only the assigned
+   * element to this_out.
    * */
   template<typename Derived, typename Socket>
   class Driver {
@@ -34,12 +47,23 @@ namespace method {
 
       /** Call back from sim::Simulation_engine.
        *
-       * Converts raw sim::Runset::Module_frame to type Socket. */
+       * Converts raw sim::Runset::Module_frame to type Socket or wraps it
+       * in a view. */
       void operator () (ir::Time const& t,
           sim::Runset::Module_frame this_in,
           sim::Runset::Module_frame this_out,
           sim::Runset::Module_frame this_prev) {
+        call(t, this_in, this_out,
+            std::integral_constant<bool,
+              std::is_base_of<Frame_view, Socket>::value>());
+      }
 
+    protected:
+      /** Copy the socket to and from the frames */
+      void call(ir::Time const& t,
+          sim::Runset::Module_frame this_in,
+          sim::Runset::Module_frame this_out,
+          std::false_type) {
         Socket s = from_frame(this_in);
         LOG4CXX_TRACE(m_logger, "@" << t << " in : " << s);
 
@@ -50,7 +74,20 @@ namespace method {
         to_frame(s, this_out);
       }
 
-    protected:
+      /** Pass a view of the frames */
+      void call(ir::Time const& t,
+          sim::Runset::Module_frame this_in,
+          sim::Runset::Module_frame this_out,
+          std::true_type) {
+        Socket s(this_in->data(), this_out->data());
+
+        static_cast<Derived*>(this)->observe(t, static_cast<Socket const&>(s));
+        static_cast<Derived*>(this)->drive(t, s);
+
+        LOG4CXX_TRACE(m_logger, "@" << t << " written: 0x"
+            << std::hex << s.written_mask() << std::dec);
+      }
+
       /** Convert from sim::Runset::Module_frame to type Socket.
        *
        * @param frame Module frame to convert. */
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <thread>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+namespace method {
+
+  /** Spin-then-sleep wait for a condition published by another thread
+   *
+   * wait() polls a condition for a configurable number of iterations and
+   * then sleeps on a futex until notify() is called. notify() costs a fence
+   * and a load while no thread sleeps, so the publishing side can call it
+   * after every change. The publisher must make its change visible before
+   * calling notify().
+   * */
+  class Event_count {
+    public:
+      /** @param spin Number of polls before sleeping */
+      explicit Event_count(unsigned spin = 1000)
+        : m_spin(spin) {
+      }
+
+      /** Wait until cond() returns true
+       *
+       * @return true if the thread slept
+       * */
+      template<typename Cond>
+      bool wait(Cond cond) {
+        for(unsigned i=0; i<m_spin; ++i) {
+          if( cond() )
+            return false;
+          if( i >= m_spin / 2 )
+            std::this_thread::yield();
+        }
+
+        bool slept = false;
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        for(;;) {
+          auto key = m_seq.load(std::memory_order_seq_cst);
+          if( cond() )
+            break;
+          syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_seq),
+              FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+          slept = true;
+        }
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        return slept;
+      }
+
+      /** Wake all sleeping waiters */
+      void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if( m_waiters.load(std::memory_order_relaxed) == 0 )
+          return;
+
+        m_seq.fetch_add(1, std::memory_order_seq_cst);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_seq),
+            FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+      }
+
+
+    private:
+      static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+          "futex requires a plain 32 bit word");
+
+      std::atomic<uint32_t> m_seq{0};
+      std::atomic<uint32_t> m_waiters{0};
+      unsigned m_spin;
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+
+namespace method {
+
+  /** Base class of socket views generated by cellwrap --views
+   *
+   * A view references the socket at the beginning of the module frames
+   * directly. Getters read the current value from this_in, setters write
+   * the next value to this_out and mark the field as written, like
+   * sim::Module_inspector::get() and sim::Module_inspector::set().
+   *
+   * The generated view types check the field offsets against the layout
+   * of the simulator with static_assert, so a mismatch between the C++
+   * compiler and the simulator fails at compile time.
+   * */
+  class Frame_view {
+    public:
+      Frame_view(char const* in, char* out)
+        : m_in(in),
+          m_out(out) {
+      }
+
+      /** Reference other frames and clear the written fields */
+      void reset(char const* in, char* out) {
+        m_in = in;
+        m_out = out;
+        m_written = 0;
+      }
+
+      /** true if any setter was called */
+      bool written() const { return m_written != 0; }
+
+      /** Bit i is set if field i was written, fields beyond 63 share bit 63 */
+      uint64_t written_mask() const { return m_written; }
+
+
+    protected:
+      template<typename T>
+      T load(std::size_t offset) const {
+        T rv;
+        std::memcpy(&rv, m_in + offset, sizeof(rv));
+        return rv;
+      }
+
+      template<typename T>
+      void store(std::size_t offset, std::size_t field, T val) {
+        std::memcpy(m_out + offset, &val, sizeof(val));
+        m_written |= uint64_t(1) << (field < 63 ? field : 63);
+      }
+
+
+    private:
+      char const* m_in;
+      char* m_out;
+      uint64_t m_written = 0;
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
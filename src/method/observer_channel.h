@@ -1,14 +1,45 @@
 #pragma once
 
 #include "driver.h"
+#include "event_count.h"
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <algorithm>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <vector>
 
 
 namespace method {
 
+  /** Configuration of Observer_channel */
+  struct Observer_options {
+    /** Number of items buffered per observer thread, rounded up to a power
+     * of two */
+    std::size_t capacity = 1024;
+
+    /** Maximum number of items passed to one cycle_batch() call */
+    std::size_t batch = 64;
+
+    /** Number of observer threads */
+    unsigned threads = 1;
+
+    /** Number of polls before a waiting thread sleeps */
+    unsigned spin = 1000;
+  };
+
+
+  /** Counters of Observer_channel */
+  struct Observer_stats {
+    std::size_t items = 0;              /**< items pushed */
+    std::size_t batches = 0;            /**< cycle_batch() calls */
+    std::size_t producer_stalls = 0;    /**< pushes that found a full queue */
+    std::size_t consumer_sleeps = 0;    /**< observer thread went to sleep */
+    std::size_t max_occupancy = 0;      /**< max. items queued after a push */
+    double mean_occupancy = 0.0;        /**< mean items queued after a push */
+  };
+
+
   /** Clocked channel to observe a module during simulation.
    *
    * @tparam Derived Derived class for CRTP.
@@ -21,29 +52,61 @@ namespace method {
    * - bool clocked(Socket in, Socket prev)
    * - void cycle(Socket port)
    *
-   * Observer_channel launches a thread and passes data from the simulation
-   * thread through a boost::lockfree::spsc_queue. For each data item the
-   * cycle() function is called individually in the observer's thread.
+   * Observer_channel launches observer threads and passes data from the
+   * simulation thread through one single producer/single consumer ring per
+   * thread. An observer thread takes all items available up to
+   * Observer_options::batch at once and passes them to cycle_batch(), which
+   * calls cycle() for each item by default. The derived class can
+   * implement
+   *
+   * - void cycle_batch(Socket const* items, std::size_t n)
+   *
+   * to process a batch as a whole. Both sides poll for a while if the ring
+   * is full or empty and then sleep until the other side made progress.
+   *
+   * With several threads the items are distributed by
+   *
+   * - std::size_t partition(Socket const& port)
+   *
+   * modulo the number of threads. Items of the same partition are processed
+   * in the order they were pushed, items of different partitions may be
+   * processed concurrently. The default partition is 0, which keeps all
+   * items on the first thread.
    * */
   template<typename Derived, typename Socket>
   class Observer_channel : public Driver<Observer_channel<Derived, Socket>, Socket> {
     public:
       /** Constructor.
        *
-       * Start a new thread for observation using the run() member. */
-      Observer_channel()
+       * Start the observer threads using the run() member. */
+      Observer_channel(Observer_options const& options = Observer_options())
         : Driver<Observer_channel<Derived, Socket>, Socket>(),
-          m_stop(false),
-          m_thread(&Observer_channel<Derived,Socket>::run,
-              static_cast<Derived*>(this)) {
+          m_options(options),
+          m_stop(false) {
+        m_options.threads = std::max(m_options.threads, 1u);
+        m_options.batch = std::max<std::size_t>(m_options.batch, 1);
+
+        std::size_t capacity = 1;
+        while( capacity < m_options.capacity )
+          capacity <<= 1;
+
+        for(unsigned i=0; i<m_options.threads; ++i)
+          m_queues.emplace_back(new Queue(capacity, m_options.spin));
+        for(unsigned i=0; i<m_options.threads; ++i)
+          m_threads.emplace_back([this, i]() { this->run(i); });
       }
 
       /** Destructor.
        *
-       * Signal a stop request to the thread and wait for it to finish. */
+       * Signal a stop request to the threads and wait for them to finish.
+       * Items not processed yet are discarded, call flush() to process
+       * them. */
       ~Observer_channel() {
         m_stop = true;
-        m_thread.join();
+        for(auto& q : m_queues)
+          q->not_empty.notify();
+        for(auto& th : m_threads)
+          th.join();
       }
 
       /** Call back for sim::Simulation_engine. */
@@ -56,39 +119,153 @@ namespace method {
 
         if( static_cast<Derived*>(this)->clocked(in, prev) ) {
           LOG4CXX_TRACE(this->m_logger, "in : " << in << " -> push");
-          while( !m_queue.push(in) )
-            ;
+          push(in);
         }
       }
 
-      /** Entry point for the observer's thread.
+      /** Wait until all pushed items were processed */
+      void flush() {
+        for(auto& q : m_queues) {
+          Queue& qr = *q;
+          qr.not_full.wait([&qr]() {
+            return qr.head.load(std::memory_order_acquire)
+              == qr.tail.load(std::memory_order_relaxed);
+          });
+        }
+      }
+
+      /** Counters of all queues */
+      Observer_stats stats() const {
+        Observer_stats rv;
+        std::size_t occupancy_sum = 0;
+
+        for(auto const& q : m_queues) {
+          rv.items += q->pushed;
+          rv.batches += q->batches.load(std::memory_order_relaxed);
+          rv.producer_stalls += q->stalls;
+          rv.consumer_sleeps += q->sleeps.load(std::memory_order_relaxed);
+          rv.max_occupancy = std::max(rv.max_occupancy, q->max_occupancy);
+          occupancy_sum += q->occupancy_sum;
+        }
+
+        if( rv.items > 0 )
+          rv.mean_occupancy = static_cast<double>(occupancy_sum) / rv.items;
+        return rv;
+      }
+
+      /** Default partition, all items go to the first thread */
+      std::size_t partition(Socket const& port) const {
+        return 0;
+      }
+
+      /** Default batch processing, calls Derived::cycle() for each item */
+      void cycle_batch(Socket const* items, std::size_t n) {
+        for(std::size_t i=0; i<n; ++i)
+          static_cast<Derived*>(this)->cycle(items[i]);
+      }
+
+      /** Entry point for an observer thread.
        *
-       * Polls the queue and calls Derived::cycle() for each data item.  Also
-       * monitors m_stop to exit the thread on request.
+       * Waits for items in the queue of thread idx and passes them to
+       * Derived::cycle_batch(). Also monitors m_stop to exit the thread on
+       * request.
        * */
-      void run() {
-        LOG4CXX_DEBUG(this->m_logger, "Starting observer thread");
+      void run(std::size_t idx) {
+        LOG4CXX_DEBUG(this->m_logger, "Starting observer thread " << idx);
 
-        Socket sock;
+        Queue& q = *m_queues[idx];
+        auto head = q.head.load(std::memory_order_relaxed);
 
         while( !m_stop ) {
-          while( !m_stop && !m_queue.pop(sock) )
-            ;
+          std::size_t tail;
+          auto slept = q.not_empty.wait([&]() {
+            tail = q.tail.load(std::memory_order_acquire);
+            return (tail != head) || m_stop;
+          });
+          if( slept )
+            q.sleeps.fetch_add(1, std::memory_order_relaxed);
+          if( m_stop )
+            break;
 
-          LOG4CXX_TRACE(this->m_logger, "observing: " << sock);
-          static_cast<Derived*>(this)->cycle(sock);
+          // process in place up to the end of the ring
+          auto begin = head & q.mask;
+          auto n = std::min(std::min(tail - head, m_options.batch),
+              q.items.size() - begin);
+
+          LOG4CXX_TRACE(this->m_logger, "observing " << n << " items");
+          static_cast<Derived*>(this)->cycle_batch(&q.items[begin], n);
+
+          head += n;
+          q.head.store(head, std::memory_order_release);
+          q.batches.fetch_add(1, std::memory_order_relaxed);
+          q.not_full.notify();
         }
       }
 
     private:
-      /** Queue for inter-thread communication. */
-      boost::lockfree::spsc_queue<Socket, boost::lockfree::capacity<64>> m_queue;
+      /** Ring of items for one observer thread */
+      struct Queue {
+        Queue(std::size_t capacity, unsigned spin)
+          : items(capacity),
+            mask(capacity - 1),
+            not_empty(spin),
+            not_full(spin) {
+        }
+
+        std::vector<Socket> items;
+        std::size_t mask;
+        std::atomic<std::size_t> head{0};   /**< next item to process */
+        char pad0[64];
+        std::atomic<std::size_t> tail{0};   /**< next item to fill */
+        char pad1[64];
+        Event_count not_empty;
+        Event_count not_full;
+
+        // written by the observer thread
+        std::atomic<std::size_t> batches{0};
+        std::atomic<std::size_t> sleeps{0};
 
-      /** Flag for requesting the thread to stop. */
+        // written by the simulation thread
+        std::size_t pushed = 0;
+        std::size_t stalls = 0;
+        std::size_t max_occupancy = 0;
+        std::size_t occupancy_sum = 0;
+      };
+
+
+      Observer_options m_options;
+      std::vector<std::unique_ptr<Queue>> m_queues;
+
+      /** Flag for requesting the threads to stop. */
       std::atomic_bool m_stop;
 
-      /** Thread object. */
-      std::thread m_thread;
+      /** Observer threads, one per queue. */
+      std::vector<std::thread> m_threads;
+
+
+      void push(Socket const& in) {
+        auto part = static_cast<Derived*>(this)->partition(in);
+        Queue& q = *m_queues[part % m_queues.size()];
+
+        auto tail = q.tail.load(std::memory_order_relaxed);
+        auto head = q.head.load(std::memory_order_acquire);
+        if( tail - head > q.mask ) {
+          ++q.stalls;
+          q.not_full.wait([&]() {
+            head = q.head.load(std::memory_order_acquire);
+            return tail - head <= q.mask;
+          });
+        }
+
+        q.items[tail & q.mask] = in;
+        q.tail.store(tail + 1, std::memory_order_release);
+        q.not_empty.notify();
+
+        auto occupancy = tail + 1 - head;
+        ++q.pushed;
+        q.occupancy_sum += occupancy;
+        q.max_occupancy = std::max(q.max_occupancy, occupancy);
+      }
   };
 
 }
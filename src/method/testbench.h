@@ -0,0 +1,242 @@
+#pragma once
+
+#include "logging/logger.h"
+#include "sim/simulation_engine.h"
+#include "method/coroutine.h"
+#include "method/frame_view.h"
+
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+namespace method {
+
+  /** Testbench of resumable tasks
+   *
+   * @tparam Socket Type for the socket of the targetted module. Generate with
+   * cellwrap, either the plain structure or the view type (--views).
+   *
+   * Instead of a callback invoked in every cycle, stimulus is written as
+   * sequential tasks:
+   *
+   *     method::Testbench<cell::s> tb(engine);
+   *     engine.add_driver(tb, "");
+   *
+   *     tb.spawn([&]() {
+   *       tb.port().a = 1;
+   *       tb.wait_edge(&cell::s::clk);
+   *       tb.delay(ir::Time(10, ir::Time::ns));
+   *       tb.until([](cell::s const& p) { return p.y == 3; });
+   *     });
+   *
+   * Every task runs as Coroutine and is resumed at the beginning of a cycle
+   * only when the event it waits for happened. Delays are scheduled with
+   * Simulation_engine::schedule_wakeup(), so a step is simulated at the
+   * wake-up time even if no process of the design runs then. The conditions
+   * of wait_edge() and until() are evaluated every cycle without resuming
+   * the task.
+   *
+   * port() reads this_in and writes this_out like the socket passed to
+   * Driver::drive(). Writes of a plain socket structure are copied to
+   * this_out after all tasks of the cycle ran, views write directly.
+   * */
+  template<typename Socket>
+  class Testbench {
+    public:
+      typedef std::function<void()> Task_function;
+      typedef std::function<bool(Socket const&)> Condition;
+
+
+      Testbench(sim::Simulation_engine& engine,
+          std::size_t stack_size = Coroutine::default_stack_size)
+        : m_engine(engine),
+          m_stack_size(stack_size),
+          m_port(make_port(is_view())),
+          m_loaded(make_port(is_view())),
+          m_logger(log4cxx::Logger::getLogger("tb.Testbench")) {
+      }
+
+      Testbench(Testbench const&) = delete;
+      Testbench& operator = (Testbench const&) = delete;
+
+
+      /** Start a task in the next cycle */
+      void spawn(Task_function f) {
+        m_tasks.emplace_back();
+        auto& task = m_tasks.back();
+        task.co.reset(new Coroutine(std::move(f), m_stack_size));
+        m_ready.push_back(&task);
+      }
+
+      /** Socket of the module, use within a task */
+      Socket& port() { return m_port; }
+
+      /** Current simulation time */
+      ir::Time const& now() const { return m_time; }
+
+      /** Number of tasks not yet finished */
+      std::size_t num_tasks() const { return m_tasks.size(); }
+
+      /** Number of times a task was resumed */
+      std::size_t num_resumes() const { return m_num_resumes; }
+
+
+      /** Suspend the calling task for d */
+      void delay(ir::Time const& d) {
+        auto task = running("delay");
+        auto wake = m_time + d;
+
+        m_timers.insert(std::make_pair(wake, task));
+        m_engine.schedule_wakeup(wake);
+        task->co->yield();
+      }
+
+      /** Suspend the calling task until cond(port()) holds
+       *
+       * Returns immediately if the condition already holds.
+       * */
+      template<typename Cond>
+      void until(Cond cond) {
+        auto task = running("until");
+        if( cond(static_cast<Socket const&>(m_port)) )
+          return;
+
+        task->cond = std::move(cond);
+        m_waiting.push_back(task);
+        task->co->yield();
+      }
+
+      /** Suspend the calling task until signal changes from false to true
+       *
+       * @param signal Pointer to a bool member of a socket structure or to
+       *   a getter of a view.
+       * */
+      template<typename M>
+      void wait_edge(M Socket::* signal) {
+        auto get = std::mem_fn(signal);
+        bool last = get(static_cast<Socket const&>(m_port));
+
+        until([get, last](Socket const& p) mutable -> bool {
+          bool v = get(p);
+          bool rv = v && !last;
+          last = v;
+          return rv;
+        });
+      }
+
+
+      /** Call back from sim::Simulation_engine, see add_driver() */
+      void operator () (ir::Time const& t,
+          sim::Runset::Module_frame this_in,
+          sim::Runset::Module_frame this_out,
+          sim::Runset::Module_frame this_prev) {
+        if( m_tasks.empty() )
+          return;
+
+        m_time = t;
+        load(this_in->data(), this_out->data(), is_view());
+
+        // collect tasks to resume in this cycle
+        std::vector<Task*> resume;
+        resume.swap(m_ready);
+
+        auto timers_end = m_timers.upper_bound(t);
+        for(auto it=m_timers.begin(); it != timers_end; ++it)
+          resume.push_back(it->second);
+        m_timers.erase(m_timers.begin(), timers_end);
+
+        for(auto it=m_waiting.begin(); it != m_waiting.end(); ) {
+          if( (*it)->cond(static_cast<Socket const&>(m_port)) ) {
+            (*it)->cond = Condition();
+            resume.push_back(*it);
+            it = m_waiting.erase(it);
+          } else
+            ++it;
+        }
+
+        for(auto task : resume) {
+          LOG4CXX_TRACE(m_logger, "@" << t << " resuming task");
+          ++m_num_resumes;
+          m_running = task;
+          try {
+            task->co->resume();
+          } catch(...) {
+            m_running = nullptr;
+            throw;
+          }
+          m_running = nullptr;
+        }
+
+        if( !resume.empty() ) {
+          store(this_out->data(), is_view());
+          m_tasks.remove_if([](Task const& task) { return task.co->done(); });
+        }
+      }
+
+
+    private:
+      struct Task {
+        std::unique_ptr<Coroutine> co;
+        Condition cond;
+      };
+
+      typedef std::integral_constant<bool,
+              std::is_base_of<Frame_view, Socket>::value> is_view;
+
+
+      sim::Simulation_engine& m_engine;
+      std::size_t m_stack_size;
+      Socket m_port;
+      Socket m_loaded;
+      ir::Time m_time;
+      std::list<Task> m_tasks;
+      std::vector<Task*> m_ready;
+      std::multimap<ir::Time, Task*> m_timers;
+      std::list<Task*> m_waiting;
+      Task* m_running = nullptr;
+      std::size_t m_num_resumes = 0;
+      log4cxx::LoggerPtr m_logger;
+
+
+      Task* running(char const* func) const {
+        if( !m_running ) {
+          std::stringstream strm;
+          strm << "Testbench::" << func << "() called outside of a task";
+          throw std::runtime_error(strm.str());
+        }
+
+        return m_running;
+      }
+
+      static Socket make_port(std::false_type) { return Socket(); }
+      static Socket make_port(std::true_type) { return Socket(nullptr, nullptr); }
+
+      /** Copy the socket from this_in */
+      void load(char const* in, char* out, std::false_type) {
+        std::memcpy(&m_port, in, sizeof(Socket));
+        std::memcpy(&m_loaded, in, sizeof(Socket));
+      }
+
+      /** Point the view to the frames */
+      void load(char const* in, char* out, std::true_type) {
+        m_port.reset(in, out);
+      }
+
+      /** Copy the socket to this_out if a task modified it */
+      void store(char* out, std::false_type) {
+        if( std::memcmp(&m_port, &m_loaded, sizeof(Socket)) != 0 )
+          std::memcpy(out, &m_port, sizeof(Socket));
+      }
+
+      void store(char* out, std::true_type) {
+      }
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,117 @@
+#include "parallel_parse.h"
+
+#include "ast/ast_find.h"
+#include "ast/namespace_def.h"
+#include "ast/identifier.h"
+#include "ir/path.h"
+
+#include <deque>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+
+
+static std::shared_ptr<Parse_driver> parse_file(std::string const& filename) {
+  auto driver = std::make_shared<Parse_driver>();
+  if( driver->parse(filename) )
+    throw std::runtime_error("parse of '" + filename + "' failed");
+
+  return driver;
+}
+
+
+static std::vector<std::string> referenced_files(ast::Node_if const& root,
+    std::vector<std::string> const& lookup_path) {
+  std::vector<std::string> rv;
+
+  for(auto ns : ast::find_by_type<ast::Namespace_def>(root)) {
+    if( !ns->empty() )
+      continue;
+
+    auto name = dynamic_cast<ast::Identifier const&>(ns->identifier()).identifier();
+    auto filename = ir::path_lookup(lookup_path, name);
+    if( !filename.empty() )
+      rv.push_back(filename);
+  }
+
+  return rv;
+}
+
+
+Parsed_files parse_files(std::string const& filename,
+    std::vector<std::string> const& lookup_path,
+    unsigned jobs) {
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::string> todo;
+  std::set<std::string> seen;
+  unsigned busy = 0;
+  std::exception_ptr error;
+  Parsed_files rv;
+
+  todo.push_back(filename);
+  seen.insert(filename);
+
+  // each worker takes a file from the queue, parses it and queues the files
+  // it references
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while( true ) {
+      cond.wait(lock, [&]() {
+          return error || !todo.empty() || (busy == 0);
+        });
+
+      if( error || todo.empty() )
+        break;
+
+      auto fn = todo.front();
+      todo.pop_front();
+      ++busy;
+      lock.unlock();
+
+      std::shared_ptr<Parse_driver> driver;
+      std::vector<std::string> refs;
+      std::exception_ptr err;
+      try {
+        driver = parse_file(fn);
+        refs = referenced_files(driver->ast_root(), lookup_path);
+      } catch(...) {
+        err = std::current_exception();
+      }
+
+      lock.lock();
+      --busy;
+      if( err ) {
+        if( !error )
+          error = err;
+      } else {
+        rv[fn] = driver;
+        for(auto const& r : refs) {
+          if( seen.insert(r).second )
+            todo.push_back(r);
+        }
+      }
+      cond.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(unsigned i=1; i<jobs; ++i)
+    threads.emplace_back(worker);
+  worker();
+
+  for(auto& t : threads)
+    t.join();
+
+  if( error )
+    std::rethrow_exception(error);
+
+  return rv;
+}
+
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "parse_driver.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/** Drivers of parsed source files indexed by filename
+ *
+ * The drivers hold the AST roots and the filenames the locations of the
+ * AST nodes point to, keep them as long as the ASTs are used.
+ * */
+typedef std::map<std::string, std::shared_ptr<Parse_driver>> Parsed_files;
+
+
+/** Parse a source file and all namespace files referenced from it
+ *
+ * @param filename Source file to start with.
+ * @param lookup_path Directories searched for referenced namespaces.
+ * @param jobs Maximum number of files parsed concurrently.
+ * @return Drivers of all parsed files.
+ *
+ * Namespace references (namespace declarations without a body) are resolved
+ * using ir::path_lookup(). Each referenced file is parsed once, independent
+ * files are parsed on up to jobs threads. References that can not be
+ * resolved are skipped here and reported during scanning.
+ *
+ * Only parsing is concurrent. Namespaces resolve types and functions of
+ * each other through the shared IR of the library while they are lowered,
+ * so lowering to LLVM IR stays serial and uses a single LLVMContext.
+ * */
+Parsed_files parse_files(std::string const& filename,
+    std::vector<std::string> const& lookup_path,
+    unsigned jobs = 1);
+
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
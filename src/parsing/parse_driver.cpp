@@ -3,6 +3,7 @@
 Parse_driver::Parse_driver()
 	:	m_trace_parsing(false),
 		m_trace_scanning(false),
+		m_scanner(nullptr),
 		m_ast_root(nullptr)
     //m_default_namespace("default")
     {
@@ -5,12 +5,18 @@
 #include "ir/namespace.h"
 #include <string>
 
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
 // Tell Flex the lexer's prototype ...
 # define YY_DECL                                        \
   yy::Parser::token_type                         \
-  yylex (yy::Parser::semantic_type* yylval,      \
+  yylex_r (yy::Parser::semantic_type* yylval,    \
          yy::Parser::location_type* yylloc,      \
-         Parse_driver& driver)
+         Parse_driver& driver,                   \
+         yyscan_t yyscanner)
 
 // ... and declare it for the parser's sake.
 YY_DECL;
@@ -32,13 +38,28 @@ class Parse_driver {
 
     void ast_root(ast::Node_if& root_node) { m_ast_root = &root_node; }
     ast::Node_if& ast_root() { return *m_ast_root; }
+    ast::Node_if const& ast_root() const { return *m_ast_root; }
 
     //ir::Namespace& cur_ns() { return m_default_namespace; }
 
+    /** State of the reentrant scanner while parsing. */
+    yyscan_t scanner() { return m_scanner; }
+
   private:
     bool m_trace_parsing;
     bool m_trace_scanning;
+    yyscan_t m_scanner;
     std::string m_filename;
     ast::Node_if* m_ast_root;
     //ir::Namespace m_default_namespace;
 };
+
+
+// The parser calls yylex() with the driver only; the scanner state is kept in
+// the driver, so that several files can be parsed concurrently.
+inline yy::Parser::token_type
+yylex(yy::Parser::semantic_type* yylval,
+    yy::Parser::location_type* yylloc,
+    Parse_driver& driver) {
+  return yylex_r(yylval, yylloc, driver, driver.scanner());
+}
@@ -0,0 +1,287 @@
+#include "async_instrumenter.h"
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+
+namespace sim {
+
+  // local helper functions
+  static void backoff(unsigned& spins);
+
+
+
+  Async_instrumenter::Async_instrumenter(Instrumenter_if& target,
+      Async_options const& options)
+    : m_target(target),
+      m_options(options),
+      m_logger(log4cxx::Logger::getLogger("cell.async")) {
+    if( m_options.num_chunks < 2 )
+      throw std::runtime_error("Async_instrumenter requires at least two chunks");
+  }
+
+
+  Async_instrumenter::~Async_instrumenter() {
+    try {
+      stop();
+    } catch( std::exception const& ) {
+    }
+  }
+
+
+  void
+  Async_instrumenter::push_hierarchy() {
+    m_target.push_hierarchy();
+  }
+
+
+  void
+  Async_instrumenter::pop_hierarchy() {
+    m_target.pop_hierarchy();
+  }
+
+
+  void
+  Async_instrumenter::register_module(std::shared_ptr<Module_inspector> insp) {
+    if( m_thread.joinable() )
+      throw std::runtime_error("Modules must be registered before "
+          "Async_instrumenter::initial()");
+
+    Frame frame;
+    frame.live = insp->frame();
+    frame.shadow = std::make_shared<std::vector<char>>(*frame.live);
+    frame.last = *frame.live;
+    m_frames.push_back(frame);
+
+    m_target.register_module(
+        std::make_shared<Module_inspector>(insp->with_frame(frame.shadow)));
+  }
+
+
+  void
+  Async_instrumenter::initial(ir::Time const& t) {
+    m_step_size = sizeof(Step_header);
+    for(auto& frame : m_frames) {
+      *frame.shadow = *frame.live;
+      frame.last = *frame.live;
+      m_step_size += sizeof(uint32_t) + frame.live->size();
+    }
+
+    m_target.initial(t);
+
+    auto chunk_size = std::max(m_options.chunk_size, m_step_size);
+    m_chunks.resize(m_options.num_chunks);
+    for(auto& chunk : m_chunks)
+      chunk.data.resize(chunk_size);
+
+    LOG4CXX_DEBUG(m_logger, "starting writer thread with "
+        << m_chunks.size()
+        << " chunks of "
+        << chunk_size
+        << " bytes");
+    m_thread = std::thread(&Async_instrumenter::writer_loop, this);
+  }
+
+
+  void
+  Async_instrumenter::step(ir::Time const& t) {
+    rethrow();
+
+    auto& chunk = acquire_chunk();
+    auto begin = chunk.data.data() + chunk.used;
+    auto p = begin + sizeof(Step_header);
+
+    Step_header header;
+    header.time = t.v;
+    header.magnitude = t.magnitude;
+    header.num_frames = 0;
+
+    for(std::size_t i=0; i<m_frames.size(); ++i) {
+      auto& frame = m_frames[i];
+      auto size = frame.live->size();
+
+      if( std::memcmp(frame.live->data(), frame.last.data(), size) == 0 )
+        continue;
+
+      std::memcpy(frame.last.data(), frame.live->data(), size);
+
+      uint32_t index = i;
+      std::memcpy(p, &index, sizeof(index));
+      p += sizeof(index);
+      std::memcpy(p, frame.live->data(), size);
+      p += size;
+      ++header.num_frames;
+    }
+
+    std::memcpy(begin, &header, sizeof(header));
+    chunk.used = p - chunk.data.data();
+
+    ++m_stats.steps;
+    m_stats.frames_copied += header.num_frames;
+
+    // do not keep steps from the writer until the chunk is full
+    if( (++chunk.steps >= m_options.max_steps)
+        || (std::chrono::steady_clock::now() - chunk.start >= m_options.max_delay) )
+      publish_chunk();
+  }
+
+
+  void
+  Async_instrumenter::teardown() {
+    stop();
+    rethrow();
+
+    LOG4CXX_INFO(m_logger, "async instrumentation: "
+        << m_stats.steps << " steps, "
+        << m_stats.frames_copied << " frames copied, "
+        << m_stats.chunks << " chunks, "
+        << m_stats.max_queued << " max. queued, "
+        << m_stats.stalls << " stalls ("
+        << m_stats.stall_seconds << " s)");
+
+    m_target.teardown();
+  }
+
+
+  Async_instrumenter::Chunk&
+  Async_instrumenter::acquire_chunk() {
+    auto n = m_chunks.size();
+
+    if( m_filling ) {
+      auto& chunk = m_chunks[m_tail.load(std::memory_order_relaxed) % n];
+      if( chunk.used + m_step_size <= chunk.data.size() )
+        return chunk;
+
+      publish_chunk();
+    }
+
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if( tail - m_head.load(std::memory_order_acquire) >= n ) {
+      auto start = std::chrono::steady_clock::now();
+      unsigned spins = 0;
+
+      while( tail - m_head.load(std::memory_order_acquire) >= n ) {
+        rethrow();
+        backoff(spins);
+      }
+
+      ++m_stats.stalls;
+      m_stats.stall_seconds += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+    }
+
+    auto& chunk = m_chunks[tail % n];
+    chunk.used = 0;
+    chunk.steps = 0;
+    chunk.start = std::chrono::steady_clock::now();
+    m_filling = true;
+    return chunk;
+  }
+
+
+  void
+  Async_instrumenter::publish_chunk() {
+    if( !m_filling )
+      return;
+
+    auto tail = m_tail.load(std::memory_order_relaxed) + 1;
+    m_tail.store(tail, std::memory_order_release);
+    m_filling = false;
+
+    ++m_stats.chunks;
+    m_stats.max_queued = std::max<std::size_t>(m_stats.max_queued,
+        tail - m_head.load(std::memory_order_acquire));
+  }
+
+
+  void
+  Async_instrumenter::writer_loop() {
+    try {
+      unsigned spins = 0;
+
+      while( true ) {
+        auto head = m_head.load(std::memory_order_relaxed);
+
+        if( head == m_tail.load(std::memory_order_acquire) ) {
+          // the last chunk is published before m_stop is set
+          if( m_stop.load(std::memory_order_acquire)
+              && (head == m_tail.load(std::memory_order_acquire)) )
+            break;
+
+          backoff(spins);
+          continue;
+        }
+
+        spins = 0;
+        consume(m_chunks[head % m_chunks.size()]);
+        m_head.store(head + 1, std::memory_order_release);
+      }
+    } catch( ... ) {
+      m_error = std::current_exception();
+      m_failed.store(true, std::memory_order_release);
+    }
+  }
+
+
+  void
+  Async_instrumenter::consume(Chunk const& chunk) {
+    auto p = chunk.data.data();
+    auto end = p + chunk.used;
+
+    while( p < end ) {
+      Step_header header;
+      std::memcpy(&header, p, sizeof(header));
+      p += sizeof(header);
+
+      for(uint32_t i=0; i<header.num_frames; ++i) {
+        uint32_t index;
+        std::memcpy(&index, p, sizeof(index));
+        p += sizeof(index);
+
+        auto& shadow = *m_frames[index].shadow;
+        std::memcpy(shadow.data(), p, shadow.size());
+        p += shadow.size();
+      }
+
+      ir::Time t;
+      t.v = header.time;
+      t.magnitude = header.magnitude;
+      m_target.step(t);
+    }
+  }
+
+
+  void
+  Async_instrumenter::stop() {
+    if( !m_thread.joinable() )
+      return;
+
+    publish_chunk();
+    m_stop.store(true, std::memory_order_release);
+    m_thread.join();
+  }
+
+
+  void
+  Async_instrumenter::rethrow() {
+    if( m_failed.load(std::memory_order_acquire) )
+      std::rethrow_exception(m_error);
+  }
+
+
+
+  static void backoff(unsigned& spins) {
+    if( spins < 64 ) {
+      ++spins;
+    } else if( spins < 128 ) {
+      ++spins;
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
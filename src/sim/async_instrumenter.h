@@ -0,0 +1,127 @@
+#pragma once
+
+#include "sim/instrumenter_if.h"
+
+#include "logging/logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <exception>
+
+
+namespace sim {
+
+  /** Buffer configuration of Async_instrumenter */
+  struct Async_options {
+    /** Number of chunks in the ring */
+    std::size_t num_chunks = 16;
+
+    /** Minimum size of a chunk in bytes, a chunk always holds at least one
+     * step with all frames */
+    std::size_t chunk_size = 1 << 20;
+
+    /** Maximum number of steps in a chunk before it is handed to the
+     * writer, 1 publishes every step */
+    std::size_t max_steps = 1024;
+
+    /** Maximum time a filled step waits in a chunk before the chunk is
+     * handed to the writer, so that slow simulations are written promptly */
+    std::chrono::milliseconds max_delay{10};
+  };
+
+
+  /** Back-pressure statistics of Async_instrumenter */
+  struct Async_stats {
+    std::size_t steps = 0;
+    std::size_t frames_copied = 0;
+    std::size_t chunks = 0;
+    std::size_t max_queued = 0;   /**< max. number of filled chunks */
+    std::size_t stalls = 0;       /**< steps that waited for a chunk */
+    double stall_seconds = 0.0;
+  };
+
+
+  /** Run another instrumenter on a background thread
+   *
+   * Module frames registered with this instrumenter are shadowed by private
+   * copies which are handed to the wrapped instrumenter. After every
+   * simulation step the frames that changed since the last step are copied
+   * into preallocated chunks of a lock-free single producer/single consumer
+   * ring. A chunk is handed to the writer when it is full, holds
+   * Async_options::max_steps steps or its first step is older than
+   * Async_options::max_delay. The background thread copies them into the shadow frames and calls
+   * the wrapped instrumenter's step(), so formatting and file output overlap
+   * with the simulation.
+   *
+   * If all chunks are in use the simulation waits for the writer; see
+   * stats() for the time lost this way. teardown() waits until all steps
+   * were passed to the wrapped instrumenter and calls its teardown().
+   * */
+  class Async_instrumenter : public Instrumenter_if {
+    public:
+      explicit Async_instrumenter(Instrumenter_if& target,
+          Async_options const& options = Async_options());
+      virtual ~Async_instrumenter();
+
+      virtual void push_hierarchy();
+      virtual void pop_hierarchy();
+      virtual void register_module(std::shared_ptr<Module_inspector> insp);
+      virtual void initial(ir::Time const& t);
+      virtual void step(ir::Time const& t);
+      virtual void teardown();
+
+      /** Statistics of the simulation side, complete after teardown() */
+      Async_stats const& stats() const { return m_stats; }
+
+
+    private:
+      /** Record header of a step in a chunk, followed by the changed frames
+       * as frame index (uint32_t) and frame contents */
+      struct Step_header {
+        long long time;
+        int magnitude;
+        uint32_t num_frames;
+      };
+
+      struct Chunk {
+        std::vector<char> data;
+        std::size_t used = 0;
+        std::size_t steps = 0;
+        std::chrono::steady_clock::time_point start;  /**< first step */
+      };
+
+      struct Frame {
+        Runset::Module_frame live;
+        Runset::Module_frame shadow;
+        std::vector<char> last;       /**< last copied contents */
+      };
+
+      Instrumenter_if& m_target;
+      Async_options m_options;
+      Async_stats m_stats;
+      std::vector<Frame> m_frames;
+      std::size_t m_step_size = 0;
+
+      std::vector<Chunk> m_chunks;
+      std::atomic<std::size_t> m_head{0};   /**< next chunk to consume */
+      std::atomic<std::size_t> m_tail{0};   /**< next chunk to fill */
+      std::atomic<bool> m_stop{false};
+      std::atomic<bool> m_failed{false};
+      bool m_filling = false;
+      std::thread m_thread;
+      std::exception_ptr m_error;
+      log4cxx::LoggerPtr m_logger;
+
+      Chunk& acquire_chunk();
+      void publish_chunk();
+      void writer_loop();
+      void consume(Chunk const& chunk);
+      void stop();
+      void rethrow();
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -1,5 +1,11 @@
 #include "sim/simulation_engine.h"
 #include "sim/vcd_instrumenter.h"
+#include "sim/wave_instrumenter.h"
+#include "sim/async_instrumenter.h"
+#include "sim/live_instrumenter.h"
+#include "sim/stimulus_replay.h"
+#include "sim/fork_fanout.h"
+#include "sim/sweep.h"
 #include "sim/cpp_gen.h"
 #include "logging/logger.h"
 #include "ir/time.h"
@@ -15,6 +21,17 @@
 namespace po = boost::program_options;
 
 
+/** Experiments forked from a common prefix of the simulation, see --fork */
+struct Fork_options {
+  std::size_t num = 0;
+  bool at_set = false;
+  ir::Time at;
+  uint64_t seed = 1;
+  std::vector<std::string> stimuli;
+  std::vector<std::string> report;
+};
+
+
 void wrap_cpp(std::string const& cpp_header, sim::Simulation_engine& engine) {
   std::ofstream ofs(cpp_header);
   if( !ofs )
@@ -27,41 +44,257 @@ void wrap_cpp(std::string const& cpp_header, sim::Simulation_engine& engine) {
 }
 
 
+std::unique_ptr<sim::Stimulus_replay> replay_stimulus(
+    std::string const& stimulus,
+    std::string const& prefix,
+    sim::Simulation_engine& engine) {
+  std::unique_ptr<sim::Stimulus_replay> rv;
+  if( !stimulus.empty() ) {
+    rv.reset(new sim::Stimulus_replay(engine, stimulus, "", prefix));
+    engine.add_driver(*rv, "");
+  }
+
+  return rv;
+}
+
+
+/** Simulate for duration, optionally continuing from a checkpoint and
+ * writing one at save_at.first to the file save_at.second */
+template<typename Engine>
+void run(Engine& engine,
+    ir::Time const& duration,
+    std::pair<ir::Time,std::string> const& save_at,
+    std::string const& restore) {
+  if( !restore.empty() )
+    engine.restore(restore);
+
+  auto begin = engine.time().value(ir::Time::ps);
+  auto end = begin + duration.value(ir::Time::ps);
+
+  if( !save_at.second.empty() ) {
+    auto save = save_at.first.value(ir::Time::ps);
+    if( (save < begin) || (save > end) )
+      throw std::runtime_error("Checkpoint time is outside of the simulated time");
+
+    if( save > begin )
+      engine.simulate(ir::Time(save - begin, ir::Time::ps));
+    engine.checkpoint(save_at.second);
+    begin = save;
+  }
+
+  if( end > begin )
+    engine.simulate(ir::Time(end - begin, ir::Time::ps));
+}
+
+
+/** Simulate the common prefix up to fork.at, then continue in forked
+ * experiments with their own seed and stimulus until duration is reached */
+void run_forked(sim::Simulation_engine& engine,
+    ir::Time const& duration,
+    std::string const& restore,
+    std::string const& stimulus_prefix,
+    Fork_options const& fork) {
+  if( !restore.empty() )
+    engine.restore(restore);
+
+  auto begin = engine.time().value(ir::Time::ps);
+  auto end = begin + duration.value(ir::Time::ps);
+  auto at = fork.at_set ? fork.at.value(ir::Time::ps) : begin;
+  if( (at < begin) || (at > end) )
+    throw std::runtime_error("Fork time is outside of the simulated time");
+
+  if( at > begin )
+    engine.simulate(ir::Time(at - begin, ir::Time::ps));
+
+  auto experiment = [&](std::size_t i, std::ostream& os) {
+    engine.seed(sim::run_seed(fork.seed, i));
+    auto replay = replay_stimulus(fork.stimuli.empty() ? "" : fork.stimuli[i],
+        stimulus_prefix,
+        engine);
+
+    if( end > at )
+      engine.simulate(ir::Time(end - at, ir::Time::ps));
+
+    auto insp = engine.inspect_module("");
+    for(auto const& name : fork.report) {
+      auto bits = insp.get_bits(name);
+      os << ' ' << name << '=';
+      if( bits.size() == 64 )
+        os << static_cast<int64_t>(bits.to_ulong());
+      else if( bits.size() < 64 )
+        os << bits.to_ulong();
+      else
+        os << bits;
+    }
+  };
+
+  std::size_t num_failed = 0;
+  for(auto const& r : sim::fork_experiments(fork.num, experiment)) {
+    std::cout << "experiment " << r.index << ':';
+    if( r.ok ) {
+      std::cout << r.data << '\n';
+    } else {
+      std::cout << " failed: " << r.error << '\n';
+      ++num_failed;
+    }
+  }
+  std::cout.flush();
+
+  if( num_failed > 0 ) {
+    std::stringstream strm;
+    strm << num_failed << " of " << fork.num << " experiments failed";
+    throw std::runtime_error(strm.str());
+  }
+}
+
+
+/** Simulate every point of a parameter sweep, see sim::run_sweep() */
+void sweep(std::string const& sourcefile,
+    std::string const& top_module,
+    std::string const& spec,
+    sim::Sweep_options const& options,
+    std::string const& out_file,
+    std::string const& format,
+    std::vector<std::string> const& lookup_path,
+    unsigned jobs,
+    sim::Frame_layout_options const& frame_layout) {
+  auto params = sim::parse_sweep(spec);
+
+  std::ofstream ofs;
+  std::ostream* os = &std::cout;
+  if( !out_file.empty() ) {
+    ofs.open(out_file, std::ios::binary);
+    if( !ofs )
+      throw std::runtime_error("Failed to open file '" + out_file + "'");
+    os = &ofs;
+  }
+
+  std::unique_ptr<sim::Sweep_writer> writer;
+  if( format == "csv" )
+    writer.reset(new sim::Csv_sweep_writer(*os));
+  else if( (format == "binary") && !out_file.empty() )
+    writer.reset(new sim::Binary_sweep_writer(*os));
+  else
+    throw std::runtime_error("Invalid sweep format '" + format + "', binary "
+        "results require --sweep-out");
+
+  sim::Simulation_engine design(sourcefile,
+      top_module,
+      lookup_path,
+      jobs,
+      frame_layout);
+  auto n = sim::run_sweep(design, "", params, options, *writer);
+
+  os->flush();
+  if( !*os )
+    throw std::runtime_error("Failed to write sweep results");
+
+  LOG4CXX_INFO(log4cxx::Logger::getLogger("cell.sim"), "simulated " << n
+      << " sweep points");
+}
+
+
+void emit_object(std::string const& sourcefile,
+    std::string const& top_module,
+    std::string const& object_file,
+    std::vector<std::string> const& lookup_path,
+    unsigned jobs) {
+  sim::Simulation_engine engine(sourcefile, top_module, lookup_path, jobs);
+  engine.emit_object(object_file);
+}
+
+
 void simulate(std::string const& sourcefile,
     std::string const& top_module,
     std::string const& vcd_dump,
+    std::string const& wave_dump,
+    std::string const& live_name,
+    unsigned live_interval,
+    bool async,
+    sim::Dump_selection const& dump_scope,
+    std::vector<std::pair<ir::Time,ir::Time>> const& dump_windows,
+    std::string const& dump_when,
+    std::string const& dump_until,
     std::string const& cpp_header,
+    std::string const& stimulus,
+    std::string const& stimulus_prefix,
+    std::pair<ir::Time,std::string> const& save_at,
+    std::string const& restore,
+    Fork_options const& fork,
     std::string const& time,
-    std::vector<std::string> const& lookup_path) {
+    std::vector<std::string> const& lookup_path,
+    unsigned jobs,
+    bool watch,
+    bool specialize,
+    sim::Frame_layout_options const& frame_layout) {
   ir::Time t;
   if( !time.empty() ) {
     std::stringstream strm(time);
     strm >> t;
   }
 
-  if( !vcd_dump.empty() ) {
+  if( (fork.num > 0) && (!vcd_dump.empty() || !wave_dump.empty()
+        || !live_name.empty() || !save_at.second.empty() || watch) )
+    throw std::runtime_error("--fork can not be combined with waveform "
+        "output, --live, --save-at or --watch");
+
+  if( !vcd_dump.empty() || !wave_dump.empty() || !live_name.empty() ) {
     sim::Instrumented_simulation_engine engine(sourcefile,
         top_module,
-        lookup_path);
-    sim::Vcd_instrumenter instr(vcd_dump);
-    engine.instrument(instr);
+        lookup_path,
+        jobs,
+        frame_layout);
+    std::unique_ptr<sim::Instrumenter_if> instr;
+    if( !live_name.empty() )
+      instr.reset(new sim::Live_instrumenter(live_name,
+            std::chrono::milliseconds(live_interval)));
+    else if( !wave_dump.empty() )
+      instr.reset(new sim::Wave_instrumenter(wave_dump));
+    else
+      instr.reset(new sim::Vcd_instrumenter(vcd_dump));
+
+    std::unique_ptr<sim::Instrumenter_if> async_instr;
+    if( async ) {
+      async_instr.reset(new sim::Async_instrumenter(*instr));
+      engine.instrument(*async_instr);
+    } else {
+      engine.instrument(*instr);
+    }
+    engine.dump_scope(dump_scope);
+    for(auto const& w : dump_windows)
+      engine.dump_window(w.first, w.second);
+    engine.dump_when(dump_when);
+    engine.dump_until(dump_until);
+    engine.watch(watch);
+    engine.specialize_ports(specialize);
+    engine.seed(fork.seed);
     engine.setup();
+    auto replay = replay_stimulus(stimulus, stimulus_prefix, engine);
 
     if( !cpp_header.empty() )
       wrap_cpp(cpp_header, engine);
 
-    if( t != ir::Time(0, ir::Time::ns) )
-      engine.simulate(t);
+    run(engine, t, save_at, restore);
     engine.teardown();
   } else {
-    sim::Simulation_engine engine(sourcefile, top_module, lookup_path);
+    sim::Simulation_engine engine(sourcefile,
+        top_module,
+        lookup_path,
+        jobs,
+        frame_layout);
+    engine.watch(watch);
+    engine.specialize_ports(specialize);
+    engine.seed(fork.seed);
     engine.setup();
+    auto replay = replay_stimulus(stimulus, stimulus_prefix, engine);
 
     if( !cpp_header.empty() )
       wrap_cpp(cpp_header, engine);
 
-    if( t != ir::Time(0, ir::Time::ns) )
-      engine.simulate(t);
+    if( fork.num > 0 )
+      run_forked(engine, t, restore, stimulus_prefix, fork);
+    else
+      run(engine, t, save_at, restore);
     engine.teardown();
   }
 }
@@ -79,8 +312,66 @@ int main(int argc, char* argv[]) {
       ("veryverbose,V", "even more output")
       ("vcd", po::value<std::string>()->default_value(""),
        "write VCD output to file")
+      ("wave", po::value<std::string>()->default_value(""),
+       "write compressed binary waveform to file (convert with wave2vcd)")
+      ("live", po::value<std::string>()->default_value(""),
+       "publish module frames in a shared memory segment for live monitors")
+      ("live-interval", po::value<unsigned>()->default_value(10),
+       "minimum time between updates of the live view in ms")
+      ("async", "write VCD or waveform output on a background thread")
+      ("dump-scope", po::value<std::vector<std::string>>(),
+       "dump only signals matching a glob like top.cpu.*.pc, or a regular "
+       "expression prefixed by 're:' (can be given multiple times)")
+      ("dump-depth", po::value<int>()->default_value(-1),
+       "dump only modules up to this depth below the top level module")
+      ("dump-window", po::value<std::vector<std::string>>(),
+       "dump only within a time window '<begin>:<end>', e.g. '10 us:20 us' "
+       "(can be given multiple times)")
+      ("dump-when", po::value<std::string>()->default_value(""),
+       "start dumping once a condition holds, e.g. 'top.state == 3'")
+      ("dump-until", po::value<std::string>()->default_value(""),
+       "stop dumping once a condition holds")
       ("wrap-cpp", po::value<std::string>()->default_value(""),
        "write C++ header to file")
+      ("stimulus", po::value<std::string>()->default_value(""),
+       "drive the ports of the top level module from a stimulus file "
+       "(convert VCD or CSV with stimconv)")
+      ("stimulus-prefix", po::value<std::string>()->default_value(""),
+       "prefix removed from the signal names of the stimulus file")
+      ("save-at", po::value<std::string>()->default_value(""),
+       "write a checkpoint at an absolute simulation time '<time>:<file>', "
+       "e.g. '1 s:warm.ckpt'")
+      ("restore", po::value<std::string>()->default_value(""),
+       "continue the simulation from a checkpoint of the same design")
+      ("fork", po::value<std::size_t>()->default_value(0),
+       "continue the simulation in this number of parallel experiments "
+       "forked from a common prefix")
+      ("fork-at", po::value<std::string>()->default_value(""),
+       "absolute simulation time at which the experiments are forked")
+      ("seed", po::value<uint64_t>()->default_value(1),
+       "seed of the builtin random number generators, forked experiments "
+       "and sweep points derive their own seeds from it")
+      ("fork-stimulus", po::value<std::vector<std::string>>(),
+       "stimulus file of one experiment, implies --fork (can be given "
+       "multiple times)")
+      ("fork-report", po::value<std::vector<std::string>>(),
+       "print the value of a member of the top level module at the end of "
+       "every experiment (can be given multiple times)")
+      ("sweep", po::value<std::string>()->default_value(""),
+       "simulate every point of a parameter sweep '<var>=<values>;...' "
+       "overriding values set by __init__, values as 'v1,v2,...' or "
+       "'<begin>:<end>:<step>'")
+      ("sweep-record", po::value<std::vector<std::string>>(),
+       "variable written to the sweep results, as member or "
+       "instance.member (can be given multiple times)")
+      ("sweep-sample", po::value<std::string>()->default_value(""),
+       "write the recorded variables with this period, not only at the end")
+      ("sweep-out", po::value<std::string>()->default_value(""),
+       "file for the sweep results, written to stdout if empty")
+      ("sweep-format", po::value<std::string>()->default_value("csv"),
+       "format of the sweep results, csv or binary")
+      ("sweep-threads", po::value<unsigned>()->default_value(0),
+       "number of threads simulating sweep points, 0 for all cores")
       ("file,f", po::value<std::string>(),
        "input source file")
       ("top_module,m", po::value<std::string>(),
@@ -89,6 +380,21 @@ int main(int argc, char* argv[]) {
        "simulated duration of simulation")
       ("lookup_path,L", po::value<std::vector<std::string>>(),
        "add a lookup path for namespace resolution (can be given multiple times)")
+      ("jobs,j", po::value<unsigned>()->default_value(1),
+       "number of source files parsed in parallel (lowering is serial)")
+      ("watch", "reload modified source files during simulation")
+      ("specialize", "specialize process code for ports only set in __init__")
+      ("optimize-layout", "remove unreferenced members and order module "
+       "frames by write frequency")
+      ("keep-member", po::value<std::vector<std::string>>(),
+       "keep member with --optimize-layout, as member or module.member "
+       "(can be given multiple times)")
+      ("fast-math", po::value<std::vector<std::string>>(),
+       "approximate exp(), log() and pow() and allow reassociating floating "
+       "point operations in the given module (can be given multiple times)")
+      ("emit-object", po::value<std::string>()->default_value(""),
+       "compile the design to an object file instead of simulating it "
+       "(link with libcellrt)")
     ;
     po::positional_options_description pos_opts;
     pos_opts.add("file", 1);
@@ -131,12 +437,136 @@ int main(int argc, char* argv[]) {
     if( vm.count("lookup_path") )
       lookup_path = vm["lookup_path"].as<std::vector<std::string>>();
 
+    if( !vm["emit-object"].as<std::string>().empty() ) {
+      emit_object(vm["file"].as<std::string>(),
+          vm["top_module"].as<std::string>(),
+          vm["emit-object"].as<std::string>(),
+          lookup_path,
+          vm["jobs"].as<unsigned>());
+      return 0;
+    }
+
+    sim::Frame_layout_options frame_layout;
+    if( vm.count("optimize-layout") ) {
+      frame_layout.eliminate_unused = true;
+      frame_layout.reorder = true;
+    }
+    if( vm.count("keep-member") ) {
+      auto keep = vm["keep-member"].as<std::vector<std::string>>();
+      frame_layout.keep.insert(keep.begin(), keep.end());
+    }
+    if( vm.count("fast-math") ) {
+      auto fast = vm["fast-math"].as<std::vector<std::string>>();
+      frame_layout.fast_math.insert(fast.begin(), fast.end());
+    }
+
+    if( !vm["sweep"].as<std::string>().empty() ) {
+      sim::Sweep_options options;
+      std::stringstream strm_time(vm["time"].as<std::string>());
+      strm_time >> options.duration;
+      if( !vm["sweep-sample"].as<std::string>().empty() ) {
+        std::stringstream strm(vm["sweep-sample"].as<std::string>());
+        strm >> options.sample_period;
+      }
+      if( vm.count("sweep-record") )
+        options.record = vm["sweep-record"].as<std::vector<std::string>>();
+      options.threads = vm["sweep-threads"].as<unsigned>();
+      options.seed = vm["seed"].as<uint64_t>();
+
+      sweep(vm["file"].as<std::string>(),
+          vm["top_module"].as<std::string>(),
+          vm["sweep"].as<std::string>(),
+          options,
+          vm["sweep-out"].as<std::string>(),
+          vm["sweep-format"].as<std::string>(),
+          lookup_path,
+          vm["jobs"].as<unsigned>(),
+          frame_layout);
+      return 0;
+    }
+
+    sim::Dump_selection dump_scope;
+    if( vm.count("dump-scope") ) {
+      for(auto const& pattern : vm["dump-scope"].as<std::vector<std::string>>()) {
+        if( pattern.compare(0, 3, "re:") == 0 )
+          dump_scope.add_regex(pattern.substr(3));
+        else
+          dump_scope.add_glob(pattern);
+      }
+    }
+    dump_scope.max_depth(vm["dump-depth"].as<int>());
+
+    std::vector<std::pair<ir::Time,ir::Time>> dump_windows;
+    if( vm.count("dump-window") ) {
+      for(auto const& w : vm["dump-window"].as<std::vector<std::string>>()) {
+        auto sep = w.find(':');
+        if( sep == std::string::npos )
+          throw std::runtime_error("Invalid dump window '" + w + "'");
+
+        ir::Time begin, end;
+        std::stringstream strm_begin(w.substr(0, sep));
+        std::stringstream strm_end(w.substr(sep + 1));
+        strm_begin >> begin;
+        strm_end >> end;
+        dump_windows.push_back(std::make_pair(begin, end));
+      }
+    }
+
+    std::pair<ir::Time,std::string> save_at;
+    auto save_at_arg = vm["save-at"].as<std::string>();
+    if( !save_at_arg.empty() ) {
+      auto sep = save_at_arg.find(':');
+      if( (sep == std::string::npos) || (sep + 1 == save_at_arg.size()) )
+        throw std::runtime_error("Invalid checkpoint '" + save_at_arg + "'");
+
+      std::stringstream strm(save_at_arg.substr(0, sep));
+      strm >> save_at.first;
+      save_at.second = save_at_arg.substr(sep + 1);
+    }
+
+    Fork_options fork;
+    fork.num = vm["fork"].as<std::size_t>();
+    fork.seed = vm["seed"].as<uint64_t>();
+    if( vm.count("fork-stimulus") ) {
+      fork.stimuli = vm["fork-stimulus"].as<std::vector<std::string>>();
+      if( fork.num == 0 )
+        fork.num = fork.stimuli.size();
+      if( (fork.num != fork.stimuli.size())
+          || !vm["stimulus"].as<std::string>().empty() )
+        throw std::runtime_error("--fork-stimulus must be given once per "
+            "experiment and can not be combined with --stimulus");
+    }
+    if( vm.count("fork-report") )
+      fork.report = vm["fork-report"].as<std::vector<std::string>>();
+    if( !vm["fork-at"].as<std::string>().empty() ) {
+      std::stringstream strm(vm["fork-at"].as<std::string>());
+      strm >> fork.at;
+      fork.at_set = true;
+    }
+
     simulate(vm["file"].as<std::string>(),
         vm["top_module"].as<std::string>(),
         vm["vcd"].as<std::string>(),
+        vm["wave"].as<std::string>(),
+        vm["live"].as<std::string>(),
+        vm["live-interval"].as<unsigned>(),
+        vm.count("async") > 0,
+        dump_scope,
+        dump_windows,
+        vm["dump-when"].as<std::string>(),
+        vm["dump-until"].as<std::string>(),
         vm["wrap-cpp"].as<std::string>(),
+        vm["stimulus"].as<std::string>(),
+        vm["stimulus-prefix"].as<std::string>(),
+        save_at,
+        vm["restore"].as<std::string>(),
+        fork,
         vm["time"].as<std::string>(),
-        lookup_path);
+        lookup_path,
+        vm["jobs"].as<unsigned>(),
+        vm.count("watch") > 0,
+        vm.count("specialize") > 0,
+        frame_layout);
 
   } catch( std::runtime_error const& err ) {
     cerr << "Encountered runtime error: " << err.what() << endl;
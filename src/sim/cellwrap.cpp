@@ -1,44 +1,182 @@
-#include "sim/simulation_engine.h"
-#include "sim/cpp_gen.h"
+#include "sim/compile.h"
+#include "sim/cpp_header.h"
+#include "sim/object_emitter.h"
 #include "logging/logger.h"
-#include "ir/time.h"
 
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <set>
 
 namespace po = boost::program_options;
+namespace bf = boost::filesystem;
+
+
+static std::string const options_tag = "// cellwrap options: ";
+static std::string const source_tag = "// cellwrap source: ";
+static std::string const include_tag = "// cellwrap include: ";
+
+
+/** true if the header records the same options and modification times of
+ * all source files as the current ones and all generated headers it
+ * includes are up to date as well */
+bool up_to_date(std::string const& cpp_header, std::string const& options) {
+  std::ifstream ifs(cpp_header);
+  if( !ifs )
+    return false;
+
+  bool options_match = false;
+  bool have_sources = false;
+  std::string line;
+  while( std::getline(ifs, line) ) {
+    if( line.compare(0, options_tag.size(), options_tag) == 0 ) {
+      options_match = (line.substr(options_tag.size()) == options);
+    } else if( line.compare(0, source_tag.size(), source_tag) == 0 ) {
+      std::stringstream strm(line.substr(source_tag.size()));
+      std::time_t recorded;
+      std::string filename;
+      strm >> recorded;
+      std::getline(strm >> std::ws, filename);
+
+      boost::system::error_code ec;
+      auto t = bf::last_write_time(filename, ec);
+      if( ec || (t != recorded) )
+        return false;
+      have_sources = true;
+    } else if( line.compare(0, include_tag.size(), include_tag) == 0 ) {
+      if( !up_to_date(line.substr(include_tag.size()), options) )
+        return false;
+    } else if( !line.empty() && (line[0] != '#') ) {
+      break;
+    }
+  }
+
+  return options_match && have_sources;
+}
 
 
-void wrap(std::string const& sourcefile,
-    std::string const& cpp_header,
-    std::vector<std::string> const& lookup_path) {
+/** Header of a namespace read from another file, next to the main header */
+bf::path import_header(std::string const& cpp_header,
+    sim::Cpp_header_writer::Import const& import) {
+  std::string name;
+  for(auto const& n : import.scope)
+    name += (name.empty() ? "" : "_") + n;
+
+  return bf::absolute(cpp_header).parent_path() / (name + ".h");
+}
+
+
+/** Source files of ns and of all namespaces read by it */
+void source_files(sim::Llvm_namespace const& ns, std::set<std::string>& files) {
+  if( !ns.impl.source_file.empty() )
+    files.insert(ns.impl.source_file);
+
+  for(auto const& n : ns.namespaces)
+    source_files(*n.second, files);
+}
+
+
+void write_header(std::string const& cpp_header,
+    std::string const& options,
+    std::set<std::string> const& sources,
+    std::vector<sim::Cpp_header_writer::Import> const& imports,
+    std::string const& body,
+    bool views) {
   std::ofstream ofs(cpp_header);
   if( !ofs )
     throw std::runtime_error("Failed to open file '" + cpp_header + "'");
 
   ofs << "#pragma once\n\n";
-  ofs << "namespace cell {\n";
+  ofs << options_tag << options << "\n";
+  for(auto const& f : sources) {
+    auto path = bf::absolute(f);
+    ofs << source_tag << bf::last_write_time(path) << ' '
+      << path.string() << "\n";
+  }
+  for(auto const& imp : imports)
+    ofs << include_tag << import_header(cpp_header, imp).string() << "\n";
+
+  ofs << "\n#include <cstddef>\n"
+    << "#include <cstdint>\n";
+  if( views )
+    ofs << "#include \"method/frame_view.h\"\n";
+  for(auto const& imp : imports)
+    ofs << "#include \"" << import_header(cpp_header, imp).filename().string()
+      << "\"\n";
+  ofs << "\nnamespace cell {\n";
+  ofs << body;
+  ofs << "\n}\n";  // end namespace
+}
 
-  sim::Simulation_engine engine(sourcefile, lookup_path);
-  auto lib = engine.library();
 
-  for(auto m : lib->ns->modules) {
-    engine.setup(m.first);
-    auto insp = engine.inspect_module("");
-    sim::write_cpp(ofs, insp.module()->socket);
-    engine.teardown();
+/** Writes cpp_header and one header per namespace read from another file,
+ * each of them only if it is not up to date */
+void wrap(std::string const& sourcefile,
+    std::string const& cpp_header,
+    std::vector<std::string> const& lookup_path,
+    unsigned jobs,
+    bool views,
+    bool force) {
+  auto logger = log4cxx::Logger::getLogger("cell.wrap");
+  std::string options = views ? "views" : "types";
+
+  if( !force && up_to_date(cpp_header, options) ) {
+    LOG4CXX_INFO(logger, "'" << cpp_header << "' is up to date");
+    return;
   }
 
-  ofs << "\n}\n";  // end namespace
+  // types and layouts only, no module is elaborated
+  auto lib = sim::compile_file(sourcefile, lookup_path, jobs);
+  auto machine = sim::create_host_target_machine();
+  auto const& layout = *machine->getDataLayout();
+
+  std::set<std::string> sources;
+  for(auto const& f : lib->parsed_files)
+    sources.insert(f.first);
+
+  std::stringstream body;
+  sim::Cpp_header_writer writer(layout, views);
+  writer.write(body, *lib->ns);
+  write_header(cpp_header, options, sources, writer.imports(), body.str(), views);
+
+  auto todo = writer.imports();
+  std::set<std::string> done;
+  while( !todo.empty() ) {
+    auto imp = todo.back();
+    todo.pop_back();
+
+    auto header = import_header(cpp_header, imp).string();
+    if( !done.insert(header).second )
+      continue;
+
+    std::stringstream imp_body;
+    sim::Cpp_header_writer imp_writer(layout, views);
+    imp_writer.write(imp_body, imp);
+    todo.insert(todo.end(),
+        imp_writer.imports().begin(),
+        imp_writer.imports().end());
+
+    if( !force && up_to_date(header, options) ) {
+      LOG4CXX_INFO(logger, "'" << header << "' is up to date");
+      continue;
+    }
+
+    std::set<std::string> imp_sources;
+    source_files(*imp.ns, imp_sources);
+    write_header(header,
+        options,
+        imp_sources,
+        imp_writer.imports(),
+        imp_body.str(),
+        views);
+  }
 }
 
 
 int main(int argc, char* argv[]) {
   using namespace std;
-  namespace bf = boost::filesystem;
 
   try {
     po::options_description desc("Options");
@@ -47,11 +185,17 @@ int main(int argc, char* argv[]) {
       ("verbose,v", "more output")
       ("veryverbose,V", "even more output")
       ("output,o", po::value<std::string>(),
-       "output C++ header file")
+       "output C++ header file, headers of namespaces read from other "
+       "files are written next to it")
       ("file,f", po::value<std::string>(),
        "input source file")
       ("lookup_path,L", po::value<std::vector<std::string>>(),
        "add a lookup path for namespace resolution (can be given multiple times)")
+      ("jobs,j", po::value<unsigned>()->default_value(1),
+       "number of source files parsed in parallel (lowering is serial)")
+      ("views", "also write <socket>_view types referencing module frames "
+       "directly (see method::Frame_view)")
+      ("force", "write the header even if it is newer than all sources")
     ;
     po::positional_options_description pos_opts;
     pos_opts.add("file", 1);
@@ -90,7 +234,10 @@ int main(int argc, char* argv[]) {
 
     wrap(vm["file"].as<std::string>(),
         vm["output"].as<std::string>(),
-        lookup_path);
+        lookup_path,
+        vm["jobs"].as<unsigned>(),
+        vm.count("views") > 0,
+        vm.count("force") > 0);
 
   } catch( std::runtime_error const& err ) {
     cerr << "Encountered runtime error: " << err.what() << endl;
@@ -0,0 +1,365 @@
+#include "sim/checkpoint.h"
+#include "sim/runtime.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace sim {
+
+  namespace {
+
+    typedef std::map<llvm::Function*, uint32_t> Process_ids;
+
+    /** State of a module read from a checkpoint */
+    struct Module_state {
+      std::vector<char> this_in;
+      std::vector<char> this_out;
+      std::vector<char> this_prev;
+      std::vector<char> read_mask;
+      Runset::Process_set run_list;
+      std::vector<Runset::Process_set> sensitivity;
+      Runset::Process_schedule schedule;
+      Runset::Time_process_map recurrent_schedule;
+    };
+
+  }
+
+
+  // local helper functions
+  template<typename T>
+  static void put(std::ostream& os, T v);
+  template<typename T>
+  static T get(std::istream& is);
+  static void put_bytes(std::ostream& os, std::vector<char> const& v);
+  static void get_bytes(std::istream& is, std::vector<char>& v);
+  static void put_time(std::ostream& os, ir::Time const& t);
+  static ir::Time get_time(std::istream& is);
+  static std::vector<llvm::Function*> process_functions(Llvm_module const& mod);
+  static Process_ids process_ids(Runset::Module const& m);
+  static uint32_t process_id(Process_ids const& ids,
+      Runset::Module const& m,
+      Runset::Process const& p);
+  static Runset::Process process(Runset::Module const& m,
+      std::vector<llvm::Function*> const& funcs,
+      uint32_t id);
+  static Runset::Process_set get_process_set(std::istream& is,
+      Runset::Module const& m,
+      std::vector<llvm::Function*> const& funcs);
+  static void put_process_set(std::ostream& os,
+      Process_ids const& ids,
+      Runset::Module const& m,
+      Runset::Process_set const& set);
+
+
+
+  uint64_t design_fingerprint(Runset const& runset) {
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto add = [&h](void const* data, std::size_t size) {
+      auto p = static_cast<unsigned char const*>(data);
+      for(std::size_t i=0; i<size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+      }
+    };
+    auto add_int = [&add](uint64_t v) { add(&v, sizeof(v)); };
+    auto add_str = [&add, &add_int](std::string const& s) {
+      add_int(s.size());
+      add(s.data(), s.size());
+    };
+
+    add_int(runset.modules.size());
+    for(auto const& m : runset.modules) {
+      add_str(m.mod->name);
+      add_int(m.this_in->size());
+      add_int(m.read_mask->size());
+
+      auto num_elements = m.mod->impl.mod_type->getNumElements();
+      add_int(num_elements);
+      for(unsigned i=0; i<num_elements; ++i)
+        add_int(m.layout->getElementOffset(i));
+
+      auto funcs = process_functions(*m.code);
+      add_int(funcs.size());
+      for(auto f : funcs)
+        add_str(f->getName().str());
+    }
+
+    return h;
+  }
+
+
+  void save_checkpoint(std::ostream& os,
+      Runset const& runset,
+      ir::Time const& t) {
+    os.write(checkpoint_magic, sizeof(checkpoint_magic));
+    put<uint32_t>(os, checkpoint_version);
+    put<uint32_t>(os, 0);
+    put<uint64_t>(os, design_fingerprint(runset));
+    put_time(os, t);
+    put<uint64_t>(os, rand_state());
+    put<uint64_t>(os, runset.modules.size());
+
+    for(auto const& m : runset.modules) {
+      auto ids = process_ids(m);
+
+      put<uint64_t>(os, m.this_in->size());
+      put<uint64_t>(os, m.read_mask->size());
+      put_bytes(os, *m.this_in);
+      put_bytes(os, *m.this_out);
+      put_bytes(os, *m.this_prev);
+      put_bytes(os, *m.read_mask);
+
+      put_process_set(os, ids, m, m.run_list);
+
+      put<uint64_t>(os, m.sensitivity.size());
+      for(auto const& s : m.sensitivity)
+        put_process_set(os, ids, m, s);
+
+      put<uint64_t>(os, m.schedule.size());
+      for(auto const& s : m.schedule) {
+        put_time(os, s.first);
+        put_time(os, std::get<0>(s.second));
+        put<uint32_t>(os, process_id(ids, m, std::get<1>(s.second)));
+      }
+
+      put<uint64_t>(os, m.recurrent_schedule.size());
+      for(auto const& s : m.recurrent_schedule) {
+        put_time(os, s.first);
+        put<uint32_t>(os, process_id(ids, m, s.second));
+      }
+    }
+
+    if( !os )
+      throw std::runtime_error("Failed to write checkpoint");
+  }
+
+
+  ir::Time load_checkpoint(std::istream& is,
+      Runset& runset) {
+    char magic[sizeof(checkpoint_magic)];
+    is.read(magic, sizeof(magic));
+    if( !is || (std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0) )
+      throw std::runtime_error("Not a checkpoint file");
+
+    auto version = get<uint32_t>(is);
+    if( version != checkpoint_version ) {
+      std::stringstream strm;
+      strm << "Checkpoint version " << version << " is not supported, "
+        "expected version " << checkpoint_version;
+      throw std::runtime_error(strm.str());
+    }
+    get<uint32_t>(is);
+
+    if( get<uint64_t>(is) != design_fingerprint(runset) )
+      throw std::runtime_error("Checkpoint was written by a different design");
+
+    auto t = get_time(is);
+    auto rand = get<uint64_t>(is);
+    if( get<uint64_t>(is) != runset.modules.size() )
+      throw std::runtime_error("Number of modules in checkpoint differs");
+
+    // read everything before modifying the runset
+    std::vector<Module_state> states(runset.modules.size());
+    for(std::size_t i=0; i<runset.modules.size(); ++i) {
+      auto const& m = runset.modules[i];
+      auto& s = states[i];
+      auto funcs = process_functions(*m.code);
+
+      s.this_in.resize(get<uint64_t>(is));
+      s.read_mask.resize(get<uint64_t>(is));
+      if( (s.this_in.size() != m.this_in->size())
+          || (s.read_mask.size() != m.read_mask->size()) )
+        throw std::runtime_error("Frame size in checkpoint differs");
+      s.this_out.resize(s.this_in.size());
+      s.this_prev.resize(s.this_in.size());
+
+      get_bytes(is, s.this_in);
+      get_bytes(is, s.this_out);
+      get_bytes(is, s.this_prev);
+      get_bytes(is, s.read_mask);
+
+      s.run_list = get_process_set(is, m, funcs);
+
+      s.sensitivity.resize(get<uint64_t>(is));
+      if( s.sensitivity.size() != m.sensitivity.size() )
+        throw std::runtime_error("Number of elements in checkpoint differs");
+      for(auto& sens : s.sensitivity)
+        sens = get_process_set(is, m, funcs);
+
+      auto num_scheduled = get<uint64_t>(is);
+      for(uint64_t j=0; j<num_scheduled; ++j) {
+        auto time = get_time(is);
+        auto period = get_time(is);
+        auto proc = process(m, funcs, get<uint32_t>(is));
+        s.schedule.insert(std::make_pair(time, std::make_tuple(period, proc)));
+      }
+
+      auto num_recurrent = get<uint64_t>(is);
+      for(uint64_t j=0; j<num_recurrent; ++j) {
+        auto time = get_time(is);
+        auto proc = process(m, funcs, get<uint32_t>(is));
+        s.recurrent_schedule.insert(std::make_pair(time, proc));
+      }
+    }
+
+    // frames are referenced by drivers and inspectors, copy into them
+    for(std::size_t i=0; i<runset.modules.size(); ++i) {
+      auto& m = runset.modules[i];
+      auto& s = states[i];
+
+      std::copy(s.this_in.begin(), s.this_in.end(), m.this_in->begin());
+      std::copy(s.this_out.begin(), s.this_out.end(), m.this_out->begin());
+      std::copy(s.this_prev.begin(), s.this_prev.end(), m.this_prev->begin());
+      std::copy(s.read_mask.begin(), s.read_mask.end(), m.read_mask->begin());
+      m.run_list = std::move(s.run_list);
+      m.sensitivity = std::move(s.sensitivity);
+      m.schedule = std::move(s.schedule);
+      m.recurrent_schedule = std::move(s.recurrent_schedule);
+    }
+
+    rand_state(rand);
+    return t;
+  }
+
+
+  template<typename T>
+  static void put(std::ostream& os, T v) {
+    os.write(reinterpret_cast<char const*>(&v), sizeof(v));
+  }
+
+
+  template<typename T>
+  static T get(std::istream& is) {
+    T rv;
+    is.read(reinterpret_cast<char*>(&rv), sizeof(rv));
+    if( !is )
+      throw std::runtime_error("Unexpected end of checkpoint");
+    return rv;
+  }
+
+
+  static void put_bytes(std::ostream& os, std::vector<char> const& v) {
+    os.write(v.data(), v.size());
+  }
+
+
+  static void get_bytes(std::istream& is, std::vector<char>& v) {
+    is.read(v.data(), v.size());
+    if( !is )
+      throw std::runtime_error("Unexpected end of checkpoint");
+  }
+
+
+  static void put_time(std::ostream& os, ir::Time const& t) {
+    put<int64_t>(os, t.v);
+    put<int32_t>(os, t.magnitude);
+  }
+
+
+  static ir::Time get_time(std::istream& is) {
+    ir::Time rv;
+    rv.v = get<int64_t>(is);
+    rv.magnitude = get<int32_t>(is);
+    return rv;
+  }
+
+
+  /** Functions of the processes in the order of the module definition */
+  static std::vector<llvm::Function*> process_functions(Llvm_module const& mod) {
+    std::vector<llvm::Function*> rv;
+    for(auto proc : mod.processes)
+      rv.push_back(proc->function->impl.code);
+    for(auto proc : mod.periodicals)
+      rv.push_back(proc->function->impl.code);
+    for(auto proc : mod.onces)
+      rv.push_back(proc->function->impl.code);
+    for(auto proc : mod.recurrents)
+      rv.push_back(proc->function->impl.code);
+
+    return rv;
+  }
+
+
+  /** Number processes, specialized variants share the number */
+  static Process_ids process_ids(Runset::Module const& m) {
+    Process_ids rv;
+    auto funcs = process_functions(*m.code);
+    for(uint32_t i=0; i<funcs.size(); ++i) {
+      rv[funcs[i]] = i;
+
+      auto v = m.variants.find(funcs[i]);
+      if( v != m.variants.end() )
+        rv[v->second] = i;
+    }
+
+    return rv;
+  }
+
+
+  static uint32_t process_id(Process_ids const& ids,
+      Runset::Module const& m,
+      Runset::Process const& p) {
+    auto it = ids.find(p.function);
+    if( it == ids.end() ) {
+      std::stringstream strm;
+      strm << "Process of module '" << m.mod->name
+        << "' not found in its definition";
+      throw std::runtime_error(strm.str());
+    }
+
+    return it->second;
+  }
+
+
+  /** Process with number id as created by Runset::add_module() */
+  static Runset::Process process(Runset::Module const& m,
+      std::vector<llvm::Function*> const& funcs,
+      uint32_t id) {
+    if( id >= funcs.size() ) {
+      std::stringstream strm;
+      strm << "Invalid process " << id << " of module '" << m.mod->name
+        << "' in checkpoint";
+      throw std::runtime_error(strm.str());
+    }
+
+    Runset::Process rv;
+    rv.function = funcs[id];
+    auto v = m.variants.find(rv.function);
+    if( v != m.variants.end() )
+      rv.function = v->second;
+    rv.exe_ptr = m.exe->getPointerToFunction(rv.function);
+    rv.sensitive = id < m.mod->processes.size();
+
+    return rv;
+  }
+
+
+  static Runset::Process_set get_process_set(std::istream& is,
+      Runset::Module const& m,
+      std::vector<llvm::Function*> const& funcs) {
+    Runset::Process_set rv;
+    auto n = get<uint64_t>(is);
+    for(uint64_t i=0; i<n; ++i)
+      rv.insert(process(m, funcs, get<uint32_t>(is)));
+
+    return rv;
+  }
+
+
+  static void put_process_set(std::ostream& os,
+      Process_ids const& ids,
+      Runset::Module const& m,
+      Runset::Process_set const& set) {
+    put<uint64_t>(os, set.size());
+    for(auto const& p : set)
+      put<uint32_t>(os, process_id(ids, m, p));
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
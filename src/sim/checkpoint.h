@@ -0,0 +1,62 @@
+#pragma once
+
+/** @file
+ * Checkpoints of the simulation state written by
+ * Simulation_engine::checkpoint().
+ *
+ * All integers are stored little endian. Times are stored as i64 value and
+ * i32 magnitude, see ir::Time.
+ *
+ *   header        "CELLCKPT", u32 version, u32 reserved, u64 fingerprint,
+ *                 time, u64 rand state, u64 number of modules
+ *   modules       per module in runset order:
+ *                 u64 frame size, u64 read mask size,
+ *                 this_in, this_out, this_prev, read mask,
+ *                 u64 n, n * u32 process of the run list,
+ *                 u64 number of elements, per element: u64 n, n * u32
+ *                 process sensitive to the element,
+ *                 u64 n, n * (time, period, u32 process) of the schedule,
+ *                 u64 n, n * (time, u32 process) of the recurrent schedule
+ *
+ * Processes are numbered by their position in the module definition:
+ * processes, periodicals, onces and recurrents. The fingerprint covers
+ * module names, frame layouts and process functions, a checkpoint can only
+ * be restored into a simulation of the same design.
+ * */
+
+#include "sim/runset.h"
+#include "ir/time.h"
+
+#include <istream>
+#include <ostream>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+
+namespace sim {
+
+  static char const checkpoint_magic[8] = {'C','E','L','L','C','K','P','T'};
+  static uint32_t const checkpoint_version = 1;
+
+
+  /** Hash of the structure of the modules in a runset */
+  uint64_t design_fingerprint(Runset const& runset);
+
+  /** Write the state of runset at time t and of the builtin rand() */
+  void save_checkpoint(std::ostream& os,
+      Runset const& runset,
+      ir::Time const& t);
+
+  /** Replace the state of runset by a checkpoint
+   *
+   * @return Simulation time of the checkpoint
+   *
+   * The runset must belong to the same design. Pointers to the frames of
+   * instantiated modules are not part of the checkpoint, call
+   * Runset::setup_hierarchy() afterwards.
+   * */
+  ir::Time load_checkpoint(std::istream& is,
+      Runset& runset);
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
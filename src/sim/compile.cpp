@@ -2,9 +2,15 @@
 
 #include "sim/scan_ast.h"
 #include "sim/llvm_namespace_scanner.h"
+#include "sim/llvm_builtins.h"
 #include "ast/ast_printer.h"
+#include "parallel_parse.h"
 
+#include <chrono>
 #include <memory>
+#include <sstream>
+#include <log4cxx/logger.h>
+#include <boost/filesystem.hpp>
 
 namespace sim {
 
@@ -24,5 +30,61 @@ namespace sim {
     return rv;
   }
 
+
+  std::shared_ptr<sim::Llvm_library> compile_file(std::string const& filename,
+      std::vector<std::string> const& lookup_path,
+      unsigned jobs,
+      Frame_layout_options const& frame_layout,
+      bool init_builtin_types) {
+    namespace bf = boost::filesystem;
+
+    auto logger = log4cxx::Logger::getLogger("cell.sim");
+    auto lib = std::make_shared<ir::Library<sim::Llvm_impl>>();
+
+    lib->name = "main";
+    lib->ns = std::make_shared<sim::Llvm_namespace>();
+    lib->ns->enclosing_library = lib;
+    lib->impl = sim::create_library_impl(lib->name);
+    lib->impl.frame_layout = frame_layout;
+
+    // set-up lookup path
+    bf::path file_path(filename);
+    lib->lookup_path.push_back(file_path.parent_path().string());
+    std::copy(lookup_path.begin(),
+        lookup_path.end(),
+        std::back_inserter(lib->lookup_path));
+
+    // parse the source file and all referenced namespace files, lowering
+    // to LLVM IR below stays serial
+    auto parse_start = std::chrono::steady_clock::now();
+    lib->parsed_files = parse_files(filename, lib->lookup_path, jobs);
+    auto const& ast_root = lib->parsed_files.at(filename)->ast_root();
+    auto parse_time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - parse_start);
+    LOG4CXX_DEBUG(logger, "parsed " << lib->parsed_files.size()
+        << " files using " << jobs << " jobs in "
+        << parse_time.count() << " us");
+
+    // init builtins
+    if( init_builtin_types )
+      init_builtins(lib);
+    else
+      declare_builtin_functions(lib);
+
+    // print AST
+    std::stringstream strm_ast;
+    ast::Ast_printer printer(strm_ast);
+    ast_root.accept(printer);
+    LOG4CXX_DEBUG(logger, strm_ast.str());
+
+    // generate code
+    sim::Llvm_namespace_scanner scanner(*(lib->ns));
+    ast_root.accept(scanner);
+
+    //verifyModule(*(lib->impl.module));
+
+    return lib;
+  }
+
 }
 
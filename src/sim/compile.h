@@ -3,6 +3,7 @@
 #include <string>
 #include <memory>
 #include <tuple>
+#include <vector>
 #include <llvm/IR/Module.h>
 
 #include "sim/llvm_namespace.h"
@@ -13,5 +14,22 @@ namespace sim {
   extern sim::Llvm_library compile(ast::Node_if const& ast_root,
       std::string const& defaultname = "default");
 
+  /** Parse and compile a source file and all referenced namespace files
+   *
+   * Generates the IR of the library without creating an execution engine
+   * or elaborating any module. Use this if only types and layouts are of
+   * interest.
+   *
+   * @param jobs Number of files parsed concurrently, see parse_files().
+   * @param init_builtin_types Create builtin types, only declare builtin
+   *   functions if false (they already exist from an earlier call).
+   * */
+  extern std::shared_ptr<sim::Llvm_library> compile_file(
+      std::string const& filename,
+      std::vector<std::string> const& lookup_path,
+      unsigned jobs = 1,
+      Frame_layout_options const& frame_layout = Frame_layout_options(),
+      bool init_builtin_types = true);
+
 }
 
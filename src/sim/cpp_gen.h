@@ -31,7 +31,7 @@ namespace sim {
   }
 
 
-  std::ostream& write_cpp(std::ostream& os, std::shared_ptr<Llvm_port> port) {
+  std::string cpp_type_name(std::shared_ptr<Llvm_type> ty) {
     std::map<std::string,std::string> predef;
 
     predef["unit"] = "void";
@@ -40,12 +40,15 @@ namespace sim {
     predef["bool"] = "bool";
     predef["float"] = "double";
 
-    os << "\t";
-    if( predef.count(port->type->name) )
-      os << predef[port->type->name];
+    if( predef.count(ty->name) )
+      return predef[ty->name];
     else
-      os << port->type->name;
-    os << " " << port->name << ";\n";
+      return ty->name;
+  }
+
+
+  std::ostream& write_cpp(std::ostream& os, std::shared_ptr<Llvm_port> port) {
+    os << "\t" << cpp_type_name(port->type) << " " << port->name << ";\n";
     return os;
   }
 
@@ -0,0 +1,317 @@
+#include "cpp_header.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cctype>
+#include <llvm/IR/DerivedTypes.h>
+
+
+namespace sim {
+
+  // local helper functions
+  static bool is_identifier(std::string const& name);
+  static llvm::Type* innermost_type(llvm::Type* ty, std::size_t& num_elements);
+
+
+
+  Cpp_header_writer::Cpp_header_writer(llvm::DataLayout const& layout,
+      bool views)
+    : m_layout(layout),
+      m_views(views) {
+  }
+
+
+  void
+  Cpp_header_writer::write(std::ostream& os, Llvm_namespace const& ns) {
+    write_namespace(os, ns);
+  }
+
+
+  void
+  Cpp_header_writer::write(std::ostream& os, Import const& import) {
+    for(auto const& n : import.scope)
+      os << "namespace " << n << " {\n";
+
+    m_scope = import.scope;
+    write_namespace(os, *import.ns);
+    m_scope.clear();
+
+    for(std::size_t i=0; i<import.scope.size(); ++i)
+      os << "}\n";
+  }
+
+
+  void
+  Cpp_header_writer::write_namespace(std::ostream& os,
+      Llvm_namespace const& ns) {
+    // nested namespaces first, types of the enclosing namespace may use them
+    for(auto const& n : ns.namespaces) {
+      // namespaces of table values are not types
+      if( ns.types.count(n.first) )
+        continue;
+
+      // declared in the header of its file, only its names are needed
+      if( !n.second->impl.source_file.empty() ) {
+        m_scope.push_back(n.first);
+        declare_namespace(*n.second);
+        m_imports.push_back(Import{m_scope, n.second.get()});
+        m_scope.pop_back();
+        continue;
+      }
+
+      os << "namespace " << n.first << " {\n";
+      m_scope.push_back(n.first);
+      write_namespace(os, *n.second);
+      m_scope.pop_back();
+      os << "}\n";
+    }
+
+    for(auto const& t : ns.types) {
+      auto ty = t.second;
+      if( !is_identifier(t.first) || !ty->impl.type )
+        continue;
+
+      if( !ty->elements.empty() ) {
+        write_struct(os, ty, ns.sockets.count(t.first) > 0);
+      } else if( !m_names.count(ty->impl.type) ) {
+        // tables and aliases of builtin types
+        os << "typedef " << declaration(ty->impl.type, t.first) << ";\n";
+      }
+    }
+
+    for(auto const& m : ns.modules) {
+      auto sock = m.second->socket;
+      if( sock && !sock->elements.empty() )
+        write_struct(os, sock, true);
+    }
+  }
+
+
+  void
+  Cpp_header_writer::declare_namespace(Llvm_namespace const& ns) {
+    for(auto const& n : ns.namespaces) {
+      if( ns.types.count(n.first) )
+        continue;
+
+      m_scope.push_back(n.first);
+      declare_namespace(*n.second);
+      m_scope.pop_back();
+    }
+
+    for(auto const& t : ns.types) {
+      if( is_identifier(t.first) && t.second->impl.type )
+        declare_struct(t.second);
+    }
+
+    for(auto const& m : ns.modules) {
+      if( m.second->socket )
+        declare_struct(m.second->socket);
+    }
+  }
+
+
+  void
+  Cpp_header_writer::declare_struct(std::shared_ptr<Llvm_type> ty) {
+    auto str_ty = llvm::dyn_cast<llvm::StructType>(ty->impl.type);
+    if( !str_ty || ty->elements.empty() || m_names.count(str_ty) )
+      return;
+
+    m_names[str_ty] = qualified(ty->name);
+  }
+
+
+  void
+  Cpp_header_writer::write_struct(std::ostream& os,
+      std::shared_ptr<Llvm_type> ty,
+      bool socket) {
+    auto str_ty = llvm::dyn_cast<llvm::StructType>(ty->impl.type);
+    if( !str_ty || m_names.count(str_ty) )
+      return;
+
+    auto mem = members(*ty);
+
+    // structures used by members first
+    for(auto const& m : mem) {
+      if( !m->type->elements.empty() )
+        write_struct(os, m->type, false);
+    }
+
+    os << "struct " << ty->name << " {\n";
+    for(std::size_t i=0; i<mem.size(); ++i) {
+      os << "\t" << declaration(str_ty->getElementType(i), mem[i]->name)
+        << ";\n";
+    }
+    os << "};\n";
+    m_names[str_ty] = qualified(ty->name);
+
+    write_layout_check(os, ty->name, mem, str_ty);
+    if( m_views && socket )
+      write_view(os, ty->name, mem, str_ty);
+  }
+
+
+  void
+  Cpp_header_writer::write_layout_check(std::ostream& os,
+      std::string const& name,
+      std::vector<std::shared_ptr<Llvm_port>> const& members,
+      llvm::StructType* str_ty) {
+    auto str_lay = m_layout.getStructLayout(str_ty);
+
+    os << "static_assert(sizeof(" << name << ") == "
+      << m_layout.getTypeAllocSize(str_ty) << ", "
+      << "\"size of " << name << " differs from the simulator\");\n";
+    for(std::size_t i=0; i<members.size(); ++i) {
+      os << "static_assert(offsetof(" << name << ", " << members[i]->name << ") == "
+        << str_lay->getElementOffset(i) << ", "
+        << "\"offset of " << name << "::" << members[i]->name
+        << " differs from the simulator\");\n";
+    }
+  }
+
+
+  void
+  Cpp_header_writer::write_view(std::ostream& os,
+      std::string const& name,
+      std::vector<std::shared_ptr<Llvm_port>> const& members,
+      llvm::StructType* str_ty) {
+    auto str_lay = m_layout.getStructLayout(str_ty);
+
+    os << "class " << name << "_view : public method::Frame_view {\n"
+      << "\tpublic:\n"
+      << "\t\t" << name << "_view(char const* in, char* out)"
+      << " : method::Frame_view(in, out) {}\n";
+
+    for(std::size_t i=0; i<members.size(); ++i) {
+      auto const& elem = members[i]->name;
+      auto ofs = str_lay->getElementOffset(i);
+      std::size_t num = 1;
+      auto inner = innermost_type(str_ty->getElementType(i), num);
+      auto type = type_name(inner);
+
+      if( inner->isStructTy() && !m_names.count(inner) ) {
+        os << "\t\t// no accessor for '" << elem << "' of unnamed structure type\n";
+        continue;
+      }
+
+      if( inner == str_ty->getElementType(i) ) {
+        os << "\t\t" << type << " " << elem << "() const"
+          << " { return load<" << type << ">(" << ofs << "); }\n"
+          << "\t\tvoid " << elem << "(" << type << " v)"
+          << " { store<" << type << ">(" << ofs << ", " << i << ", v); }\n";
+      } else {
+        auto stride = m_layout.getTypeAllocSize(inner);
+        os << "\t\t" << type << " " << elem << "(std::size_t i) const"
+          << " { return load<" << type << ">(" << ofs << " + i * " << stride << "); }\n"
+          << "\t\tvoid " << elem << "(std::size_t i, " << type << " v)"
+          << " { store<" << type << ">(" << ofs << " + i * " << stride
+          << ", " << i << ", v); }\n";
+      }
+    }
+
+    os << "};\n";
+  }
+
+
+  std::string
+  Cpp_header_writer::declaration(llvm::Type* ty, std::string const& name) {
+    std::stringstream dims;
+    while( auto ar_ty = llvm::dyn_cast<llvm::ArrayType>(ty) ) {
+      dims << '[' << ar_ty->getNumElements() << ']';
+      ty = ar_ty->getElementType();
+    }
+
+    return type_name(ty) + " " + name + dims.str();
+  }
+
+
+  std::string
+  Cpp_header_writer::type_name(llvm::Type* ty) {
+    auto it = m_names.find(ty);
+    if( it != m_names.end() )
+      return it->second;
+
+    if( ty->isIntegerTy(1) )
+      return "bool";
+    if( ty->isIntegerTy() ) {
+      switch( m_layout.getTypeStoreSize(ty) ) {
+        case 1: return "int8_t";
+        case 2: return "int16_t";
+        case 4: return "int32_t";
+        default: return "int64_t";
+      }
+    }
+    if( ty->isDoubleTy() )
+      return "double";
+    if( ty->isFloatTy() )
+      return "float";
+
+    if( auto str_ty = llvm::dyn_cast<llvm::StructType>(ty) ) {
+      // tuples have no name
+      std::stringstream strm;
+      strm << "struct { ";
+      for(std::size_t i=0; i<str_ty->getNumElements(); ++i) {
+        std::stringstream elem;
+        elem << 'e' << i;
+        strm << declaration(str_ty->getElementType(i), elem.str()) << "; ";
+      }
+      strm << "}";
+      return strm.str();
+    }
+
+    std::stringstream strm;
+    strm << "no C++ representation for LLVM type of size "
+      << m_layout.getTypeAllocSize(ty);
+    throw std::runtime_error(strm.str());
+  }
+
+
+  std::string
+  Cpp_header_writer::qualified(std::string const& name) const {
+    std::string rv;
+    for(auto const& s : m_scope)
+      rv += s + "::";
+    return rv + name;
+  }
+
+
+  std::vector<std::shared_ptr<Llvm_port>>
+  Cpp_header_writer::members(Llvm_type const& ty) const {
+    std::vector<std::shared_ptr<Llvm_port>> rv(ty.elements.size());
+    for(auto const& elem : ty.elements) {
+      auto idx = elem.second->impl.struct_index;
+      if( idx >= rv.size() ) {
+        std::stringstream strm;
+        strm << "invalid index of element '" << elem.first
+          << "' in type '" << ty.name << "'";
+        throw std::runtime_error(strm.str());
+      }
+      rv[idx] = elem.second;
+    }
+
+    return rv;
+  }
+
+
+  static bool is_identifier(std::string const& name) {
+    if( name.empty() || std::isdigit(name[0]) )
+      return false;
+
+    return std::all_of(name.begin(), name.end(), [](char c) {
+      return std::isalnum(c) || (c == '_');
+    });
+  }
+
+
+  static llvm::Type* innermost_type(llvm::Type* ty, std::size_t& num_elements) {
+    num_elements = 1;
+    while( auto ar_ty = llvm::dyn_cast<llvm::ArrayType>(ty) ) {
+      num_elements *= ar_ty->getNumElements();
+      ty = ar_ty->getElementType();
+    }
+
+    return ty;
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "sim/llvm_namespace.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <llvm/IR/DataLayout.h>
+
+
+namespace sim {
+
+  /** Write C++ declarations of the types in a namespace
+   *
+   * Works on the IR of a compiled library and a DataLayout only, no module
+   * is elaborated. Writes sockets, structures, table types (as typedef of
+   * their base type) and type aliases of the namespace and of all
+   * namespaces defined in the same file as C++ namespaces. Member types
+   * are derived from the LLVM types, so arrays and tuples are supported.
+   * Every structure is followed by static_asserts comparing its size and
+   * member offsets with the DataLayout.
+   *
+   * Namespaces read from other files are not written. Their structures are
+   * referenced by qualified name and the namespaces are listed in
+   * imports(), write each of them to its own header with write(os, import)
+   * and include it before the declarations.
+   *
+   * With views enabled, a method::Frame_view class <socket>_view is written
+   * for every socket, see method/frame_view.h. Array members are accessed
+   * by flat element index.
+   * */
+  class Cpp_header_writer {
+    public:
+      /** Namespace read from another file */
+      struct Import {
+        /** Names of the enclosing namespaces and of the namespace itself */
+        std::vector<std::string> scope;
+        Llvm_namespace const* ns;
+      };
+
+
+      Cpp_header_writer(llvm::DataLayout const& layout, bool views = false);
+
+      /** Write the declarations of ns, without enclosing C++ namespace */
+      void write(std::ostream& os, Llvm_namespace const& ns);
+
+      /** Write the declarations of an imported namespace within the C++
+       * namespaces of its scope */
+      void write(std::ostream& os, Import const& import);
+
+      /** Namespaces from other files referenced by the written ones */
+      std::vector<Import> const& imports() const { return m_imports; }
+
+
+    private:
+      llvm::DataLayout const& m_layout;
+      bool m_views;
+      std::vector<std::string> m_scope;
+      std::map<llvm::Type*,std::string> m_names;
+      std::vector<Import> m_imports;
+
+      void write_namespace(std::ostream& os, Llvm_namespace const& ns);
+      void declare_namespace(Llvm_namespace const& ns);
+      void declare_struct(std::shared_ptr<Llvm_type> ty);
+      void write_struct(std::ostream& os,
+          std::shared_ptr<Llvm_type> ty,
+          bool socket);
+      void write_layout_check(std::ostream& os,
+          std::string const& name,
+          std::vector<std::shared_ptr<Llvm_port>> const& members,
+          llvm::StructType* str_ty);
+      void write_view(std::ostream& os,
+          std::string const& name,
+          std::vector<std::shared_ptr<Llvm_port>> const& members,
+          llvm::StructType* str_ty);
+      std::string declaration(llvm::Type* ty, std::string const& name);
+      std::string type_name(llvm::Type* ty);
+      std::string qualified(std::string const& name) const;
+      std::vector<std::shared_ptr<Llvm_port>> members(Llvm_type const& ty) const;
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
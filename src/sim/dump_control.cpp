@@ -0,0 +1,425 @@
+#include "dump_control.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <cctype>
+#include <cstring>
+#include <tuple>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Verifier.h>
+
+
+namespace sim {
+
+  namespace {
+
+    /** Recursive descent parser generating code for a Dump_condition */
+    class Condition_compiler {
+      public:
+        Condition_compiler(std::string const& expr,
+            Dump_condition::Resolver const& resolve,
+            llvm::IRBuilder<>& builder)
+          : m_expr(expr),
+            m_resolve(resolve),
+            m_builder(builder) {
+          tokenize();
+        }
+
+        /** @return i1 value of the condition */
+        llvm::Value* compile() {
+          auto rv = parse_or();
+          if( m_pos != m_tokens.size() )
+            error("unexpected '" + m_tokens[m_pos] + "'");
+          return rv;
+        }
+
+
+      private:
+        /** Signal value or literal not yet converted to a type */
+        struct Operand {
+          llvm::Value* value = nullptr;
+          std::string literal;
+        };
+
+        std::string const& m_expr;
+        Dump_condition::Resolver const& m_resolve;
+        llvm::IRBuilder<>& m_builder;
+        std::vector<std::string> m_tokens;
+        std::size_t m_pos = 0;
+
+
+        void tokenize() {
+          static char const* const ops[] = {
+            "==", "!=", "<=", ">=", "&&", "||", "<", ">", "!", "(", ")"
+          };
+
+          std::size_t i = 0;
+          while( i < m_expr.size() ) {
+            auto c = m_expr[i];
+
+            if( std::isspace(uc(c)) ) {
+              ++i;
+            } else if( std::isalpha(uc(c)) || (c == '_') ) {
+              auto begin = i;
+              while( (i < m_expr.size())
+                  && (std::isalnum(uc(m_expr[i])) || (m_expr[i] == '_') || (m_expr[i] == '.')) )
+                ++i;
+              m_tokens.push_back(m_expr.substr(begin, i - begin));
+            } else if( std::isdigit(uc(c))
+                || ((c == '-') && (i + 1 < m_expr.size()) && std::isdigit(uc(m_expr[i+1]))) ) {
+              m_tokens.push_back(number(i));
+            } else {
+              bool found = false;
+              for(auto op : ops) {
+                if( m_expr.compare(i, std::strlen(op), op) == 0 ) {
+                  m_tokens.push_back(op);
+                  i += std::strlen(op);
+                  found = true;
+                  break;
+                }
+              }
+
+              if( !found )
+                error(std::string("invalid character '") + c + "'");
+            }
+          }
+        }
+
+
+        /** Decimal number with optional fraction or hexadecimal integer
+         * starting at i, a letter directly following it is an error */
+        std::string number(std::size_t& i) {
+          auto begin = i;
+          if( m_expr[i] == '-' )
+            ++i;
+
+          auto digits = [&](int (*is_digit)(int)) {
+            auto first = i;
+            while( (i < m_expr.size()) && is_digit(uc(m_expr[i])) )
+              ++i;
+            return i > first;
+          };
+
+          if( (m_expr.compare(i, 2, "0x") == 0) || (m_expr.compare(i, 2, "0X") == 0) ) {
+            i += 2;
+            if( !digits(std::isxdigit) )
+              error("missing digits of hexadecimal constant");
+          } else {
+            digits(std::isdigit);
+            if( (i < m_expr.size()) && (m_expr[i] == '.') ) {
+              ++i;
+              if( !digits(std::isdigit) )
+                error("missing digits after '.'");
+            }
+          }
+
+          if( (i < m_expr.size())
+              && (std::isalnum(uc(m_expr[i])) || (m_expr[i] == '_') || (m_expr[i] == '.')) )
+            error("invalid constant '" + m_expr.substr(begin, i + 1 - begin) + "'");
+
+          return m_expr.substr(begin, i - begin);
+        }
+
+
+        /** <cctype> functions require values of unsigned char */
+        static int uc(char c) { return static_cast<unsigned char>(c); }
+
+
+        bool accept(std::string const& tok) {
+          if( (m_pos < m_tokens.size()) && (m_tokens[m_pos] == tok) ) {
+            ++m_pos;
+            return true;
+          }
+          return false;
+        }
+
+
+        llvm::Value* parse_or() {
+          auto rv = parse_and();
+          while( accept("||") )
+            rv = m_builder.CreateOr(rv, parse_and());
+          return rv;
+        }
+
+
+        llvm::Value* parse_and() {
+          auto rv = parse_unary();
+          while( accept("&&") )
+            rv = m_builder.CreateAnd(rv, parse_unary());
+          return rv;
+        }
+
+
+        llvm::Value* parse_unary() {
+          if( accept("!") )
+            return m_builder.CreateNot(parse_unary());
+
+          if( accept("(") ) {
+            auto rv = parse_or();
+            if( !accept(")") )
+              error("missing ')'");
+            return rv;
+          }
+
+          auto a = parse_operand();
+          static char const* const rel_ops[] = {
+            "==", "!=", "<=", ">=", "<", ">"
+          };
+          for(auto op : rel_ops) {
+            if( accept(op) )
+              return compare(op, a, parse_operand());
+          }
+
+          return to_bool(a);
+        }
+
+
+        Operand parse_operand() {
+          if( m_pos >= m_tokens.size() )
+            error("unexpected end of condition");
+
+          auto const& tok = m_tokens[m_pos++];
+          Operand rv;
+
+          if( tok == "true" ) {
+            rv.literal = "1";
+          } else if( tok == "false" ) {
+            rv.literal = "0";
+          } else if( std::isalpha(uc(tok[0])) || (tok[0] == '_') ) {
+            char* addr;
+            llvm::Type* type;
+            std::tie(addr, type) = m_resolve(tok);
+
+            auto& ctx = m_builder.getContext();
+            auto ptr = m_builder.CreateIntToPtr(
+                llvm::ConstantInt::get(llvm::Type::getInt64Ty(ctx),
+                  reinterpret_cast<uint64_t>(addr)),
+                llvm::PointerType::getUnqual(type));
+            rv.value = m_builder.CreateLoad(ptr, tok);
+          } else {
+            rv.literal = tok;
+          }
+
+          return rv;
+        }
+
+
+        llvm::Value* literal(std::string const& text, llvm::Type* type) {
+          std::size_t end = 0;
+
+          try {
+            if( type->isIntegerTy() ) {
+              auto v = std::stoll(text, &end, 0);
+              if( end == text.size() )
+                return llvm::ConstantInt::get(type, v, true);
+            } else if( type->isFloatingPointTy() ) {
+              auto v = std::stod(text, &end);
+              if( end == text.size() )
+                return llvm::ConstantFP::get(type, v);
+            }
+          } catch( std::exception const& ) {
+          }
+
+          error("invalid constant '" + text + "'");
+          return nullptr;
+        }
+
+
+        llvm::Value* to_bool(Operand const& a) {
+          if( !a.value )
+            error("constant '" + a.literal + "' used as condition");
+
+          auto type = a.value->getType();
+          if( type->isIntegerTy() )
+            return m_builder.CreateICmpNE(a.value, llvm::ConstantInt::get(type, 0));
+          if( type->isFloatingPointTy() )
+            return m_builder.CreateFCmpONE(a.value, llvm::ConstantFP::get(type, 0.0));
+
+          error("signal can not be used as condition");
+          return nullptr;
+        }
+
+
+        llvm::Value* compare(std::string const& op, Operand a, Operand b) {
+          if( !a.value && !b.value )
+            error("comparison of two constants");
+
+          if( !a.value )
+            a.value = literal(a.literal, b.value->getType());
+          if( !b.value )
+            b.value = literal(b.literal, a.value->getType());
+
+          auto ta = a.value->getType();
+          auto tb = b.value->getType();
+
+          if( ta->isFloatingPointTy() || tb->isFloatingPointTy() ) {
+            auto& ctx = m_builder.getContext();
+            auto dbl = llvm::Type::getDoubleTy(ctx);
+            auto to_double = [&](llvm::Value* v) -> llvm::Value* {
+              if( v->getType()->isIntegerTy() )
+                return m_builder.CreateSIToFP(v, dbl);
+              if( !v->getType()->isFloatingPointTy() )
+                error("signal can not be compared");
+              if( v->getType() == dbl )
+                return v;
+              return m_builder.CreateFPExt(v, dbl);
+            };
+            auto x = to_double(a.value);
+            auto y = to_double(b.value);
+
+            if( op == "==" ) return m_builder.CreateFCmpOEQ(x, y);
+            if( op == "!=" ) return m_builder.CreateFCmpONE(x, y);
+            if( op == "<" ) return m_builder.CreateFCmpOLT(x, y);
+            if( op == "<=" ) return m_builder.CreateFCmpOLE(x, y);
+            if( op == ">" ) return m_builder.CreateFCmpOGT(x, y);
+            return m_builder.CreateFCmpOGE(x, y);
+          }
+
+          if( !ta->isIntegerTy() || !tb->isIntegerTy() )
+            error("signal can not be compared");
+
+          // extend to the wider type, bool is unsigned
+          auto wa = ta->getIntegerBitWidth();
+          auto wb = tb->getIntegerBitWidth();
+          auto x = a.value;
+          auto y = b.value;
+          if( wa < wb )
+            x = (wa == 1) ? m_builder.CreateZExt(x, tb) : m_builder.CreateSExt(x, tb);
+          else if( wb < wa )
+            y = (wb == 1) ? m_builder.CreateZExt(y, ta) : m_builder.CreateSExt(y, ta);
+
+          bool is_signed = std::max(wa, wb) > 1;
+
+          if( op == "==" ) return m_builder.CreateICmpEQ(x, y);
+          if( op == "!=" ) return m_builder.CreateICmpNE(x, y);
+          if( op == "<" )
+            return is_signed ? m_builder.CreateICmpSLT(x, y) : m_builder.CreateICmpULT(x, y);
+          if( op == "<=" )
+            return is_signed ? m_builder.CreateICmpSLE(x, y) : m_builder.CreateICmpULE(x, y);
+          if( op == ">" )
+            return is_signed ? m_builder.CreateICmpSGT(x, y) : m_builder.CreateICmpUGT(x, y);
+          return is_signed ? m_builder.CreateICmpSGE(x, y) : m_builder.CreateICmpUGE(x, y);
+        }
+
+
+        void error(std::string const& msg) const {
+          std::stringstream strm;
+          strm << "Invalid dump condition '"
+            << m_expr
+            << "': "
+            << msg;
+          throw std::runtime_error(strm.str());
+        }
+    };
+
+  }
+
+
+
+  void
+  Dump_selection::add_glob(std::string const& pattern) {
+    m_patterns.push_back(std::regex(glob_to_regex(pattern)));
+  }
+
+
+  void
+  Dump_selection::add_regex(std::string const& pattern) {
+    try {
+      m_patterns.push_back(std::regex(pattern));
+    } catch( std::regex_error const& err ) {
+      std::stringstream strm;
+      strm << "Invalid regular expression '"
+        << pattern
+        << "': "
+        << err.what();
+      throw std::runtime_error(strm.str());
+    }
+  }
+
+
+  bool
+  Dump_selection::selected(std::string const& name) const {
+    if( m_patterns.empty() )
+      return true;
+
+    for(auto const& re : m_patterns) {
+      if( std::regex_match(name, re) )
+        return true;
+    }
+
+    return false;
+  }
+
+
+  std::string
+  Dump_selection::glob_to_regex(std::string const& pattern) {
+    std::string rv;
+
+    for(std::size_t i=0; i<pattern.size(); ++i) {
+      auto c = pattern[i];
+
+      if( c == '*' ) {
+        if( (i + 1 < pattern.size()) && (pattern[i+1] == '*') ) {
+          rv += ".*";
+          ++i;
+        } else {
+          rv += "[^.]*";
+        }
+      } else if( c == '?' ) {
+        rv += "[^.]";
+      } else if( std::isalnum(static_cast<unsigned char>(c)) || (c == '_') ) {
+        rv += c;
+      } else {
+        rv += '\\';
+        rv += c;
+      }
+    }
+
+    return rv;
+  }
+
+
+
+  Dump_condition::Dump_condition(std::string const& expr,
+      Resolver const& resolve,
+      llvm::Module& module,
+      llvm::ExecutionEngine* exe)
+    : m_expr(expr),
+      m_exe(exe) {
+    auto& ctx = module.getContext();
+    auto fn_type = llvm::FunctionType::get(llvm::Type::getInt32Ty(ctx), false);
+    auto f = llvm::Function::Create(fn_type,
+        llvm::Function::InternalLinkage,
+        "dump_condition",
+        &module);
+
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(ctx, "entry", f));
+    Condition_compiler compiler(m_expr, resolve, builder);
+
+    try {
+      auto cond = compiler.compile();
+      builder.CreateRet(builder.CreateZExt(cond, llvm::Type::getInt32Ty(ctx)));
+    } catch( ... ) {
+      f->eraseFromParent();
+      throw;
+    }
+
+    if( llvm::verifyFunction(*f) ) {
+      f->eraseFromParent();
+      throw std::runtime_error("Generated invalid code for dump condition '"
+          + m_expr + "'");
+    }
+
+    m_function = f;
+    m_fn = reinterpret_cast<int(*)()>(exe->getPointerToFunction(f));
+  }
+
+
+  Dump_condition::~Dump_condition() {
+    m_exe->freeMachineCodeForFunction(m_function);
+    m_function->eraseFromParent();
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <functional>
+#include <llvm/IR/Module.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+
+namespace sim {
+
+  /** Select dumped signals by hierarchical name
+   *
+   * Signal names consist of the name of the top level module, the instance
+   * names and the member name separated by '.', e.g. "top.cpu.alu.pc".
+   * Glob patterns match '*' against any characters within one element,
+   * '?' against a single character within one element and '**' against any
+   * number of elements, e.g. "top.cpu.*.pc" or "top.cpu.**". Without any
+   * pattern all signals are selected.
+   * */
+  class Dump_selection {
+    public:
+      /** Add a glob pattern */
+      void add_glob(std::string const& pattern);
+
+      /** Add a ECMAScript regular expression matched against the full name */
+      void add_regex(std::string const& pattern);
+
+      /** Only dump modules up to depth below the top level module (0) */
+      void max_depth(int depth) { m_max_depth = depth; }
+
+      bool selected(std::string const& name) const;
+      bool depth_selected(unsigned depth) const {
+        return (m_max_depth < 0) || (static_cast<int>(depth) <= m_max_depth);
+      }
+
+      /** Convert a glob pattern to an equivalent regular expression */
+      static std::string glob_to_regex(std::string const& pattern);
+
+
+    private:
+      std::vector<std::regex> m_patterns;
+      int m_max_depth = -1;
+  };
+
+
+  /** Condition on signal values compiled to native code
+   *
+   * Conditions compare signals with constants or other signals and are
+   * combined with &&, || and !, e.g. "top.state == 3 && !top.reset". Signals
+   * are named as for Dump_selection. A signal on its own is true if it is
+   * not zero. Comparisons of integers are signed except for bool. Constants
+   * are decimal numbers like 3, -2 or 0.5 and hexadecimal integers like
+   * 0x1f.
+   * */
+  class Dump_condition {
+    public:
+      /** Return the address of the current value and the type of a signal */
+      typedef std::function<std::pair<char*,llvm::Type*>(std::string const&)>
+        Resolver;
+
+      Dump_condition(std::string const& expr,
+          Resolver const& resolve,
+          llvm::Module& module,
+          llvm::ExecutionEngine* exe);
+
+      /** Removes the generated function from the module */
+      ~Dump_condition();
+
+      Dump_condition(Dump_condition const&) = delete;
+      Dump_condition& operator = (Dump_condition const&) = delete;
+
+      bool operator () () const { return m_fn() != 0; }
+
+      std::string const& expression() const { return m_expr; }
+
+
+    private:
+      std::string m_expr;
+      llvm::ExecutionEngine* m_exe;
+      llvm::Function* m_function = nullptr;
+      int (*m_fn)();
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,214 @@
+#include "sim/fork_fanout.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+namespace sim {
+
+  namespace {
+
+    /** Running experiment as seen by the parent */
+    struct Child {
+      pid_t pid;
+      int fd;
+      std::size_t index;
+    };
+
+  }
+
+
+  // local helper functions
+  static void run_child(int fd,
+      std::size_t index,
+      Experiment const& experiment);
+  static bool write_all(int fd, char const* data, std::size_t size);
+  static void wait_child(Child const& child, Experiment_result& result);
+  static void kill_children(std::vector<Child> const& running);
+
+
+
+  std::vector<Experiment_result> fork_experiments(std::size_t n,
+      Experiment const& experiment,
+      unsigned max_parallel) {
+    if( max_parallel == 0 )
+      max_parallel = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Experiment_result> results(n);
+    for(std::size_t i=0; i<n; ++i)
+      results[i].index = i;
+
+    // buffered output would be written by the parent and every child
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    std::vector<Child> running;
+    std::size_t next = 0;
+    char buf[1 << 16];
+
+    try {
+      while( (next < n) || !running.empty() ) {
+        while( (next < n) && (running.size() < max_parallel) ) {
+          int fds[2];
+          if( pipe(fds) != 0 )
+            throw std::runtime_error("Could not create pipe for experiment");
+
+          auto pid = fork();
+          if( pid < 0 ) {
+            close(fds[0]);
+            close(fds[1]);
+            throw std::runtime_error("Could not fork experiment");
+          }
+
+          if( pid == 0 ) {
+            close(fds[0]);
+            for(auto const& c : running)
+              close(c.fd);
+            run_child(fds[1], next, experiment);
+          }
+
+          close(fds[1]);
+          running.push_back(Child{pid, fds[0], next});
+          ++next;
+        }
+
+        std::vector<pollfd> pfds;
+        for(auto const& c : running)
+          pfds.push_back(pollfd{c.fd, POLLIN, 0});
+
+        if( poll(pfds.data(), pfds.size(), -1) < 0 ) {
+          if( errno == EINTR )
+            continue;
+          throw std::runtime_error("Could not wait for experiments");
+        }
+
+        for(std::size_t i=pfds.size(); i-- > 0;) {
+          if( !pfds[i].revents )
+            continue;
+
+          auto& c = running[i];
+          auto r = read(c.fd, buf, sizeof(buf));
+          if( r > 0 ) {
+            results[c.index].data.append(buf, r);
+          } else if( (r == 0) || (errno != EINTR) ) {
+            close(c.fd);
+            wait_child(c, results[c.index]);
+            running.erase(running.begin() + i);
+          }
+        }
+      }
+    } catch(...) {
+      kill_children(running);
+      throw;
+    }
+
+    return results;
+  }
+
+
+  /** Run the experiment and send its result, never returns */
+  static void run_child(int fd,
+      std::size_t index,
+      Experiment const& experiment) {
+    int status = 0;
+    std::string data;
+
+    try {
+      std::ostringstream os;
+      experiment(index, os);
+      data = os.str();
+    } catch(std::exception const& err) {
+      data = err.what();
+      status = 1;
+    } catch(...) {
+      data = "unknown exception";
+      status = 1;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    if( !write_all(fd, data.data(), data.size()) )
+      status = 2;
+    close(fd);
+    _exit(status);
+  }
+
+
+  static bool write_all(int fd, char const* data, std::size_t size) {
+    while( size > 0 ) {
+      auto w = write(fd, data, size);
+      if( w < 0 ) {
+        if( errno == EINTR )
+          continue;
+        return false;
+      }
+
+      data += w;
+      size -= w;
+    }
+
+    return true;
+  }
+
+
+  static void wait_child(Child const& child, Experiment_result& result) {
+    int status;
+    while( waitpid(child.pid, &status, 0) < 0 ) {
+      if( errno != EINTR ) {
+        result.error = "Could not wait for experiment";
+        return;
+      }
+    }
+
+    std::stringstream strm;
+    if( WIFEXITED(status) && (WEXITSTATUS(status) == 0) ) {
+      result.ok = true;
+      return;
+    } else if( WIFEXITED(status) && (WEXITSTATUS(status) == 1) ) {
+      result.error = result.data;
+      result.data.clear();
+      return;
+    } else if( WIFEXITED(status) ) {
+      strm << "Experiment " << child.index << " exited with status "
+        << WEXITSTATUS(status);
+    } else if( WIFSIGNALED(status) ) {
+      strm << "Experiment " << child.index << " was terminated by signal "
+        << WTERMSIG(status);
+    } else {
+      strm << "Experiment " << child.index << " ended unexpectedly";
+    }
+
+    result.error = strm.str();
+    result.data.clear();
+  }
+
+
+  static void kill_children(std::vector<Child> const& running) {
+    for(auto const& c : running) {
+      kill(c.pid, SIGKILL);
+      close(c.fd);
+    }
+
+    for(auto const& c : running) {
+      int status;
+      while( (waitpid(c.pid, &status, 0) < 0) && (errno == EINTR) )
+        ;
+    }
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace sim {
+
+  /** Outcome of an experiment run by fork_experiments() */
+  struct Experiment_result {
+    std::size_t index = 0;
+
+    /** true if the experiment returned and the child exited normally */
+    bool ok = false;
+
+    /** Bytes written by the experiment to its result stream */
+    std::string data;
+
+    /** Reason of the failure if not ok */
+    std::string error;
+  };
+
+
+  /** Experiment run in a forked child
+   *
+   * Called with the index of the experiment and a stream whose contents are
+   * sent back to the parent. Exceptions are reported as failure.
+   * */
+  typedef std::function<void (std::size_t, std::ostream&)> Experiment;
+
+
+  /** Run experiments in parallel in forked copies of this process
+   *
+   * @param n Number of experiments
+   * @param experiment Called in the child for every index in [0, n)
+   * @param max_parallel Maximum number of children running at the same time,
+   *        0 for the number of cores
+   * @return Results ordered by index
+   *
+   * Every child starts with a copy-on-write copy of the parent, so the
+   * compiled code and the module frames of a simulation that already ran a
+   * common prefix are shared instead of being recompiled and simulated again
+   * for every experiment. Typically the experiment changes a parameter, seed
+   * or stimulus and continues the simulation. Changes made by the children
+   * are not visible in the parent, only their results are.
+   *
+   * Only the calling thread exists in the children: do not fork while
+   * background threads of the simulation run, e.g. of Async_instrumenter or
+   * the watch mode. Children leave with _exit(), destructors and atexit()
+   * handlers of the parent's objects are not run in them.
+   * */
+  std::vector<Experiment_result> fork_experiments(std::size_t n,
+      Experiment const& experiment,
+      unsigned max_parallel = 0);
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
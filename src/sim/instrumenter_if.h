@@ -7,11 +7,17 @@ namespace sim {
 
   class Instrumenter_if {
     public:
+      virtual ~Instrumenter_if() {}
+
       virtual void push_hierarchy() = 0;
       virtual void pop_hierarchy() = 0;
       virtual void register_module(std::shared_ptr<Module_inspector> insp) = 0;
       virtual void initial(ir::Time const& t) = 0;
       virtual void step(ir::Time const& t) = 0;
+
+      /** Called by the engine's teardown(), all output must be complete
+       * when this returns */
+      virtual void teardown() {}
   };
 
 }
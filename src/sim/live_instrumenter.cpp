@@ -0,0 +1,250 @@
+#include "live_instrumenter.h"
+
+#include <cstring>
+#include <sstream>
+#include <new>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace sim {
+
+  // local helper functions
+  static std::size_t align(std::size_t n);
+
+
+
+  Live_instrumenter::Live_instrumenter(std::string const& name,
+      std::chrono::milliseconds interval)
+    : m_name(name),
+      m_interval(interval),
+      m_logger(log4cxx::Logger::getLogger("cell.live")) {
+    if( m_name.empty() || (m_name[0] != '/') )
+      m_name = '/' + m_name;
+  }
+
+
+  Live_instrumenter::~Live_instrumenter() {
+    if( m_addr ) {
+      munmap(m_addr, m_size);
+      shm_unlink(m_name.c_str());
+    }
+  }
+
+
+  void
+  Live_instrumenter::push_hierarchy() {
+  }
+
+
+  void
+  Live_instrumenter::pop_hierarchy() {
+  }
+
+
+  void
+  Live_instrumenter::register_module(std::shared_ptr<Module_inspector> insp) {
+    auto mod = insp->module();
+    auto lay = insp->data_layout();
+    auto const& float_type = ir::Builtins<sim::Llvm_impl>::types().at("float");
+
+    Frame frame;
+    frame.frame = insp->frame();
+    frame.offset = m_data_size;
+    m_frames.push_back(frame);
+    m_data_size = align(m_data_size + frame.frame->size());
+
+    auto prefix = insp->path().empty() ? mod->name : insp->path();
+
+    for(std::size_t i=0; i<insp->num_elements(); ++i) {
+      if( !insp->has_object(i) )
+        continue;
+
+      auto obj = insp->get_object(i);
+      if( mod->instantiations.count(obj->name) != 0 )
+        continue;
+      if( !insp->selected(i) )
+        continue;
+
+      auto ofs = frame.offset + insp->layout()->getElementOffset(i);
+      auto ty = obj->type->impl.type;
+      auto name = prefix + '.' + obj->name;
+
+      if( obj->type == float_type ) {
+        add_signal(name, ofs, ty, lay, live::real);
+      } else if( !obj->type->elements.empty() ) {
+        auto str_ty = llvm::cast<llvm::StructType>(ty);
+        auto str_lay = lay->getStructLayout(str_ty);
+        std::size_t j = 0;
+        for(auto const& elem : obj->type->elements) {
+          add_signal(name + '.' + elem.first,
+              ofs + str_lay->getElementOffset(j),
+              str_ty->getElementType(j),
+              lay,
+              (elem.second->type == float_type) ? live::real : live::integer);
+          ++j;
+        }
+      } else {
+        add_signal(name, ofs, ty, lay, live::integer);
+      }
+    }
+  }
+
+
+  void
+  Live_instrumenter::initial(ir::Time const& t) {
+    create_segment();
+    m_last_update = std::chrono::steady_clock::now();
+    m_last_step = t;
+    publish(t, live::running);
+  }
+
+
+  void
+  Live_instrumenter::step(ir::Time const& t) {
+    m_last_step = t;
+
+    auto now = std::chrono::steady_clock::now();
+    if( now - m_last_update < m_interval )
+      return;
+
+    m_last_update = now;
+    publish(t, live::running);
+  }
+
+
+  void
+  Live_instrumenter::teardown() {
+    if( !m_header )
+      return;
+
+    // the last step may not have been published
+    publish(m_last_step, live::finished);
+  }
+
+
+  void
+  Live_instrumenter::add_signal(std::string const& name,
+      std::size_t offset,
+      llvm::Type* type,
+      llvm::DataLayout const* layout,
+      live::Kind kind) {
+    auto width = layout->getTypeSizeInBits(type);
+    if( width == 0 )
+      return;
+
+    Signal sig;
+    sig.name = name;
+    sig.width = width;
+    sig.kind = kind;
+    sig.offset = offset;
+    m_signals.push_back(sig);
+  }
+
+
+  void
+  Live_instrumenter::create_segment() {
+    std::string names;
+    for(auto const& sig : m_signals)
+      names += sig.name;
+
+    auto signals_offset = align(sizeof(live::Header));
+    auto names_offset = align(signals_offset
+        + m_signals.size() * sizeof(live::Signal_entry));
+    auto data_offset = align(names_offset + names.size());
+    m_size = data_offset + m_data_size;
+
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if( fd < 0 ) {
+      std::stringstream strm;
+      strm << "Could not create shared memory segment '" << m_name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    if( ftruncate(fd, m_size) != 0 ) {
+      close(fd);
+      shm_unlink(m_name.c_str());
+      std::stringstream strm;
+      strm << "Could not resize shared memory segment '" << m_name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    m_addr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if( m_addr == MAP_FAILED ) {
+      m_addr = nullptr;
+      shm_unlink(m_name.c_str());
+      std::stringstream strm;
+      strm << "Could not map shared memory segment '" << m_name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    auto base = static_cast<char*>(m_addr);
+    m_header = new(base) live::Header;
+    m_header->sequence.store(0, std::memory_order_relaxed);
+    m_header->time_ps = 0;
+    m_header->num_updates = 0;
+    m_header->state = live::running;
+    m_header->reserved = 0;
+    m_header->version = live::format_version;
+    m_header->header_size = sizeof(live::Header);
+    m_header->segment_size = m_size;
+    m_header->num_signals = m_signals.size();
+    m_header->signals_offset = signals_offset;
+    m_header->names_offset = names_offset;
+    m_header->data_offset = data_offset;
+    m_header->data_size = m_data_size;
+
+    auto entries = reinterpret_cast<live::Signal_entry*>(base + signals_offset);
+    std::size_t name_offset = 0;
+    for(std::size_t i=0; i<m_signals.size(); ++i) {
+      entries[i].name_offset = name_offset;
+      entries[i].name_size = m_signals[i].name.size();
+      entries[i].width = m_signals[i].width;
+      entries[i].kind = m_signals[i].kind;
+      entries[i].reserved = 0;
+      entries[i].offset = m_signals[i].offset;
+      name_offset += m_signals[i].name.size();
+    }
+    std::memcpy(base + names_offset, names.data(), names.size());
+
+    m_data = base + data_offset;
+
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(m_header->magic, live::magic, sizeof(live::magic));
+
+    LOG4CXX_INFO(m_logger, "Created shared memory segment '"
+        << m_name << "' with "
+        << m_signals.size() << " signals ("
+        << m_size << " bytes)");
+  }
+
+
+  void
+  Live_instrumenter::publish(ir::Time const& t, uint32_t state) {
+    auto seq = m_header->sequence.load(std::memory_order_relaxed);
+    m_header->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for(auto const& frame : m_frames)
+      std::memcpy(m_data + frame.offset,
+          frame.frame->data(),
+          frame.frame->size());
+    m_header->time_ps = t.value(ir::Time::ps);
+    m_header->num_updates = ++m_num_updates;
+    m_header->state = state;
+
+    m_header->sequence.store(seq + 2, std::memory_order_release);
+  }
+
+
+
+  static std::size_t align(std::size_t n) {
+    return (n + 7) & ~std::size_t(7);
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "sim/instrumenter_if.h"
+#include "live/live_format.h"
+
+#include "logging/logger.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+
+namespace sim {
+
+  /** Publish module frames in a POSIX shared memory segment
+   *
+   * Copies of all registered module frames are written to the segment
+   * together with a table of all signals, see live/live_format.h. External
+   * monitors read it with live::Live_view. To keep the simulation fast the
+   * copy is refreshed at most once per interval of wall clock time and at
+   * teardown(). The segment is removed by the destructor.
+   * */
+  class Live_instrumenter : public Instrumenter_if {
+    public:
+      /**
+       * @param name Name of the shared memory segment, see shm_open()
+       * @param interval Minimum wall clock time between updates
+       * */
+      Live_instrumenter(std::string const& name,
+          std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+      virtual ~Live_instrumenter();
+
+      virtual void push_hierarchy();
+      virtual void pop_hierarchy();
+      virtual void register_module(std::shared_ptr<Module_inspector> insp);
+      virtual void initial(ir::Time const& t);
+      virtual void step(ir::Time const& t);
+      virtual void teardown();
+
+      std::string const& name() const { return m_name; }
+      std::size_t num_updates() const { return m_num_updates; }
+
+
+    private:
+      struct Frame {
+        Runset::Module_frame frame;
+        std::size_t offset;   /**< in the data area */
+      };
+
+      struct Signal {
+        std::string name;
+        uint32_t width;
+        live::Kind kind;
+        uint64_t offset;
+      };
+
+      std::string m_name;
+      std::chrono::milliseconds m_interval;
+      std::chrono::steady_clock::time_point m_last_update;
+      ir::Time m_last_step;
+      std::vector<Frame> m_frames;
+      std::vector<Signal> m_signals;
+      std::size_t m_data_size = 0;
+      std::size_t m_num_updates = 0;
+
+      void* m_addr = nullptr;
+      std::size_t m_size = 0;
+      live::Header* m_header = nullptr;
+      char* m_data = nullptr;
+      log4cxx::LoggerPtr m_logger;
+
+      void add_signal(std::string const& name,
+          std::size_t offset,
+          llvm::Type* type,
+          llvm::DataLayout const* layout,
+          live::Kind kind);
+      void create_segment();
+      void publish(ir::Time const& t, uint32_t state);
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -1,10 +1,14 @@
 #include "sim/llvm_builtins.h"
+#include "sim/llvm_math.h"
+#include "sim/llvm_rand.h"
 
 
 #define OP_LAMBDA \
       [&builtin_types](llvm::IRBuilder<> bld, llvm::Value* left, llvm::Value* right) -> llvm::Value*
 #define OP_C_LAMBDA \
       [&builtin_types](llvm::Constant* left, llvm::Constant* right) -> llvm::Constant*
+#define INLINE_LAMBDA \
+      [](llvm::IRBuilder<>& bld, llvm::Value* state, std::vector<llvm::Value*> const& args) -> llvm::Value*
 
 static void add_operator(ir::Label const& name,
     ir::Label const& return_type_name,
@@ -12,7 +16,7 @@ static void add_operator(ir::Label const& name,
     ir::Label const& right_name,
     std::function<llvm::Value* (llvm::IRBuilder<>, llvm::Value* left, llvm::Value* right)> insert_func,
     std::function<llvm::Constant* (llvm::Constant*, llvm::Constant*)> const_insert_func = nullptr) {
-  auto& builtin_types = ir::Builtins<sim::Llvm_impl>::types;
+  auto& builtin_types = ir::Builtins<sim::Llvm_impl>::types();
 
   auto op = std::make_shared<sim::Llvm_operator>();
   op->name = name;
@@ -22,17 +26,37 @@ static void add_operator(ir::Label const& name,
   op->impl.insert_func = insert_func;
   op->impl.const_insert_func = const_insert_func;
 
-  ir::Builtins<sim::Llvm_impl>::operators.insert(std::make_pair(name, op));
+  ir::Builtins<sim::Llvm_impl>::operators().insert(std::make_pair(name, op));
 }
 
 
-static void add_external_functions(std::shared_ptr<sim::Llvm_library> lib) {
-  std::vector<llvm::Type*> args;
-  auto& builtin_funcs = ir::Builtins<sim::Llvm_impl>::functions;
+static void set_inline(ir::Label const& name,
+    std::function<llvm::Value* (llvm::IRBuilder<>&, llvm::Value* state, std::vector<llvm::Value*> const& args)> insert_func,
+    bool uses_rand_state = false) {
+  auto& builtin_funcs = ir::Builtins<sim::Llvm_impl>::functions();
+
+  auto range = builtin_funcs.equal_range(name);
+  for(auto it=range.first; it != range.second; ++it) {
+    it->second->impl.insert_func = insert_func;
+    it->second->impl.uses_rand_state = uses_rand_state;
+  }
+}
+
+
+static void set_intrinsic(ir::Label const& name, llvm::Intrinsic::ID id) {
+  set_inline(name, [id](llvm::IRBuilder<>& bld, llvm::Value* state, std::vector<llvm::Value*> const& args) {
+        return sim::insert_intrinsic(bld, id, args);
+      });
+}
+
+
+void declare_builtin_functions(std::shared_ptr<sim::Llvm_library> lib) {
+  auto& builtin_funcs = ir::Builtins<sim::Llvm_impl>::functions();
   for(auto it : builtin_funcs) {
     auto& f = it.second;
     auto module = lib->impl.module.get();
 
+    std::vector<llvm::Type*> args;
     for(auto p : f->parameters)
       args.push_back(p->type->impl.type);
 
@@ -52,8 +76,8 @@ static void add_external_functions(std::shared_ptr<sim::Llvm_library> lib) {
 void init_builtins(std::shared_ptr<sim::Llvm_library> lib) {
   auto& context = lib->impl.context;
   auto module = lib->impl.module.get();
-  auto& builtin_types = ir::Builtins<sim::Llvm_impl>::types;
-  auto& builtin_funcs = ir::Builtins<sim::Llvm_impl>::functions;
+  auto& builtin_types = ir::Builtins<sim::Llvm_impl>::types();
+  auto& builtin_funcs = ir::Builtins<sim::Llvm_impl>::functions();
 
 
   ir::Builtins<sim::Llvm_impl>::init();
@@ -213,7 +237,55 @@ void init_builtins(std::shared_ptr<sim::Llvm_library> lib) {
   // builtin functions
   //
 
-  add_external_functions(lib);
+  declare_builtin_functions(lib);
+
+  // random number generators are inlined within modules, the runtime
+  // functions are called elsewhere
+  set_inline("rand", INLINE_LAMBDA {
+        return sim::insert_rand(bld, state);
+      }, true);
+  set_inline("rand_int", INLINE_LAMBDA {
+        return sim::insert_rand_int(bld, state, args.at(0), args.at(1));
+      }, true);
+  set_inline("rand_float", INLINE_LAMBDA {
+        return sim::insert_rand_float(bld, state);
+      }, true);
+  set_inline("rand_normal", INLINE_LAMBDA {
+        return sim::insert_rand_normal(bld, state, args.at(0), args.at(1));
+      }, true);
+  set_inline("rand_poisson", INLINE_LAMBDA {
+        return sim::insert_rand_poisson(bld, state, args.at(0));
+      }, true);
+
+  // math functions are always inlined, exp(), log() and pow() switch to
+  // their approximations in modules compiled with fast math
+  set_inline("exp", INLINE_LAMBDA {
+        return sim::insert_exp(bld, args.at(0));
+      });
+  set_inline("log", INLINE_LAMBDA {
+        return sim::insert_log(bld, args.at(0));
+      });
+  set_inline("pow", INLINE_LAMBDA {
+        return sim::insert_pow(bld, args.at(0), args.at(1));
+      });
+  set_intrinsic("sqrt", llvm::Intrinsic::sqrt);
+  set_intrinsic("sin", llvm::Intrinsic::sin);
+  set_intrinsic("cos", llvm::Intrinsic::cos);
+  set_intrinsic("floor", llvm::Intrinsic::floor);
+  set_intrinsic("ceil", llvm::Intrinsic::ceil);
+  set_intrinsic("fma", llvm::Intrinsic::fma);
+  set_inline("abs", INLINE_LAMBDA {
+        return sim::insert_abs(bld, args.at(0));
+      });
+  set_inline("min", INLINE_LAMBDA {
+        return sim::insert_min(bld, args.at(0), args.at(1));
+      });
+  set_inline("max", INLINE_LAMBDA {
+        return sim::insert_max(bld, args.at(0), args.at(1));
+      });
+  set_inline("clamp", INLINE_LAMBDA {
+        return sim::insert_clamp(bld, args.at(0), args.at(1), args.at(2));
+      });
 }
 
 
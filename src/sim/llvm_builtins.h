@@ -4,3 +4,9 @@
 #include "sim/llvm_namespace.h"
 
 extern void init_builtins(std::shared_ptr<sim::Llvm_library> lib);
+
+/** Declare builtin functions in the module of a library
+ *
+ * Used for libraries compiled after init_builtins() was already called, so
+ * that the builtin types are shared. */
+extern void declare_builtin_functions(std::shared_ptr<sim::Llvm_library> lib);
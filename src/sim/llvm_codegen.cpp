@@ -15,9 +15,9 @@ namespace sim {
 
   Llvm_codegen::Llvm_codegen() 
     : ir::Codegen_base(),
-      m_context(llvm::getGlobalContext()),
-      m_builder(llvm::getGlobalContext()),
-      m_module(new llvm::Module("top", llvm::getGlobalContext())),
+      m_context(llvm_context()),
+      m_builder(llvm_context()),
+      m_module(new llvm::Module("top", llvm_context())),
       m_fpm(m_module.get()) {
     m_fpm.add(llvm::createBasicAliasAnalysisPass());
     m_fpm.add(llvm::createPromoteMemoryToRegisterPass());
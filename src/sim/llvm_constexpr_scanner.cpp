@@ -63,9 +63,9 @@ namespace sim {
   Llvm_constexpr_scanner::visit_literal_int(ast::Literal<int> const& node) {
     using namespace llvm;
 
-    m_values[&node] = ConstantInt::get(getGlobalContext(),
+    m_values[&node] = ConstantInt::get(llvm_context(),
         APInt(64, node.value(), true));
-    m_types[&node] = ir::Builtins<Llvm_impl>::types.at("int");
+    m_types[&node] = ir::Builtins<Llvm_impl>::types().at("int");
 
     return true;
   }
@@ -75,7 +75,7 @@ namespace sim {
   Llvm_constexpr_scanner::visit_literal_double(ast::Literal<double> const& node) {
     using namespace llvm;
 
-    auto ty = ir::Builtins<Llvm_impl>::types.at("float");
+    auto ty = ir::Builtins<Llvm_impl>::types().at("float");
     auto v = ConstantFP::get(ty->impl.type, node.value());
     m_values[&node] = v;
     m_types[&node] = ty;
@@ -88,10 +88,10 @@ namespace sim {
   Llvm_constexpr_scanner::visit_literal_bool(ast::Literal<bool> const& node) {
     using namespace llvm;
 
-    auto v = ConstantInt::get(getGlobalContext(),
+    auto v = ConstantInt::get(llvm_context(),
         APInt(1, node.value(), true));
     m_values[&node] = v;
-    m_types[&node] = ir::Builtins<Llvm_impl>::types.at("bool");
+    m_types[&node] = ir::Builtins<Llvm_impl>::types().at("bool");
 
     return true;
   }
@@ -102,10 +102,10 @@ namespace sim {
     using namespace llvm;
 
     //auto v = m_builder.CreateGlobalStringPtr(node.value(), "stringconst");
-    auto v = ConstantDataArray::getString(getGlobalContext(),
+    auto v = ConstantDataArray::getString(llvm_context(),
         node.value());
     m_values[&node] = v;
-    m_types[&node] = ir::Builtins<Llvm_impl>::types.at("string");
+    m_types[&node] = ir::Builtins<Llvm_impl>::types().at("string");
 
     return true;
   }
@@ -13,7 +13,7 @@
     Llvm_function_scanner::Llvm_function_scanner(Llvm_namespace& ns, Llvm_function& function)
       : m_ns(ns),
         m_function(function),
-        m_builder(llvm::getGlobalContext()),
+        m_builder(llvm_context()),
         m_logger(log4cxx::Logger::getLogger("cell.scan")) {
       init_function();
       init_scanner();
@@ -24,7 +24,7 @@
       : m_ns(mod),
         m_mod(&mod),
         m_function(function),
-        m_builder(llvm::getGlobalContext()),
+        m_builder(llvm_context()),
         m_logger(log4cxx::Logger::getLogger("cell.scan")) {
       init_function();
       init_scanner();
@@ -50,9 +50,17 @@
           lib->impl.module.get());
 
       // create function entry code
-      auto bb = BasicBlock::Create(getGlobalContext(), "entry", m_function.impl.code);
+      auto bb = BasicBlock::Create(llvm_context(), "entry", m_function.impl.code);
       m_builder.SetInsertPoint(bb);
 
+      // floating point operations of the module may be reassociated and
+      // math builtins approximated
+      if( m_mod && lib->impl.frame_layout.fast_math.count(m_mod->name) ) {
+        FastMathFlags fast;
+        fast.setUnsafeAlgebra();
+        m_builder.SetFastMathFlags(fast);
+      }
+
       // name arguments
       auto arg_i = m_function.impl.code->arg_begin();
       if( m_mod ) {
@@ -84,7 +92,7 @@
       }
 
       // create function body
-      auto bb_body = BasicBlock::Create(getGlobalContext(), "body", m_function.impl.code);
+      auto bb_body = BasicBlock::Create(llvm_context(), "body", m_function.impl.code);
       m_builder.CreateBr(bb_body);
       m_builder.SetInsertPoint(bb_body);
 
@@ -182,6 +190,21 @@
     }
 
 
+    bool
+    Llvm_function_scanner::dead_store(ast::Assignment const& node) const {
+      if( !m_mod )
+        return false;
+
+      auto lhs = dynamic_cast<ast::Name_lookup const*>(&(node.identifier()));
+      if( !lhs || (lhs->qname().size() != 1) )
+        return false;
+
+      auto const& name = lhs->qname()[0];
+      return !m_named_values.count(name)
+        && m_mod->impl.dead_members.count(name);
+    }
+
+
     bool
     Llvm_function_scanner::insert_return(ast::Return_statement const& node) {
       auto v = m_values.at(node.objects()[0]);
@@ -264,7 +287,7 @@
           << "'");
 
       std::vector<llvm::Value*> indices;
-      indices.push_back(llvm::ConstantInt::get(llvm::getGlobalContext(),
+      indices.push_back(llvm::ConstantInt::get(llvm_context(),
           llvm::APInt(64, 0, true)));
       indices.push_back(index);
       auto ptr = m_builder.CreateInBoundsGEP(obj_ptr,
@@ -348,7 +371,7 @@
               0,
               index,
               std::string("read_mask_elem_") + qname[0]);
-          m_builder.CreateStore(llvm::ConstantInt::get(llvm::getGlobalContext(),
+          m_builder.CreateStore(llvm::ConstantInt::get(llvm_context(),
                 llvm::APInt(1, 1, false)), read_mask_elem);
         }
       }
@@ -445,9 +468,9 @@
     Llvm_function_scanner::insert_literal_int(ast::Literal<int> const& node) {
       using namespace llvm;
 
-      auto v = ConstantInt::get(getGlobalContext(),
+      auto v = ConstantInt::get(llvm_context(),
           APInt(64, node.value(), true));
-      auto ty = ir::Builtins<Llvm_impl>::types.at("int");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("int");
       m_values[&node] = v;
       m_types[&node] = ty;
 
@@ -459,7 +482,7 @@
     Llvm_function_scanner::insert_literal_double(ast::Literal<double> const& node) {
       using namespace llvm;
 
-      auto ty = ir::Builtins<Llvm_impl>::types.at("float");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("float");
       auto v = ConstantFP::get(ty->impl.type, node.value());
       m_values[&node] = v;
       m_types[&node] = ty;
@@ -472,9 +495,9 @@
     Llvm_function_scanner::insert_literal_bool(ast::Literal<bool> const& node) {
       using namespace llvm;
 
-      auto v = ConstantInt::get(getGlobalContext(),
+      auto v = ConstantInt::get(llvm_context(),
           APInt(1, node.value(), true));
-      auto ty = ir::Builtins<Llvm_impl>::types.at("bool");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("bool");
       m_values[&node] = v;
       m_types[&node] = ty;
 
@@ -487,7 +510,7 @@
       using namespace llvm;
 
       auto v = m_builder.CreateGlobalStringPtr(node.value(), "stringconst");
-      auto ty = ir::Builtins<Llvm_impl>::types.at("string");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("string");
       m_values[&node] = v;
       m_types[&node] = ty;
 
@@ -511,9 +534,9 @@
         throw std::runtime_error("Unknown time unit");
 
       int64_t value = node.value() * m;
-      auto v = ConstantInt::get(getGlobalContext(),
+      auto v = ConstantInt::get(llvm_context(),
           APInt(64, value, true));
-      auto ty = ir::Builtins<Llvm_impl>::types.at("int");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("int");
 
       m_values[&node] = v;
       m_types[&node] = ty;
@@ -818,6 +841,14 @@
 
     bool
     Llvm_function_scanner::enter_assignment(ast::Assignment const& node) {
+      // member was removed from the frame, only evaluate the expression
+      if( dead_store(node) ) {
+        node.expression().accept(*this);
+        m_values[&node] = m_values.at(&(node.expression()));
+        m_types[&node] = m_types.at(&(node.expression()));
+        return false;
+      }
+
       m_lookups.push_back(Lookup_source::out);
       return true;
     }
@@ -825,6 +856,9 @@
 
     bool
     Llvm_function_scanner::leave_assignment(ast::Assignment const& node) {
+      if( dead_store(node) )
+        return true;
+
       auto ptr = m_values.at(&(node.identifier()));
       auto target_type = m_types.at(&(node.identifier()));
 
@@ -882,7 +916,7 @@
         m_values[&node] = m_values.at(node.statements().back());
         m_types[&node] = m_types.at(node.statements().back());
       } else {
-        auto ty = ir::Builtins<Llvm_impl>::types.at("unit");
+        auto ty = ir::Builtins<Llvm_impl>::types().at("unit");
         m_values[&node] = llvm::Constant::getNullValue(ty->impl.type);
         m_types[&node] = ty;
       }
@@ -895,16 +929,16 @@
     Llvm_function_scanner::enter_if_statement(ast::If_statement const& node) {
       using namespace llvm;
 
-      m_type_targets.push_back(ir::Builtins<Llvm_impl>::types.at("bool"));
+      m_type_targets.push_back(ir::Builtins<Llvm_impl>::types().at("bool"));
       node.condition().accept(*this);
       m_type_targets.pop_back();
 
 
       // get condition result and create basic blocks
       auto cond_val = m_values.at(&(node.condition()));
-      auto bb_true = BasicBlock::Create(getGlobalContext(), "if_true", m_function.impl.code);
-      auto bb_false = BasicBlock::Create(getGlobalContext(), "if_false", m_function.impl.code);
-      auto bb_resume = BasicBlock::Create(getGlobalContext(), "if_resume", m_function.impl.code);
+      auto bb_true = BasicBlock::Create(llvm_context(), "if_true", m_function.impl.code);
+      auto bb_false = BasicBlock::Create(llvm_context(), "if_false", m_function.impl.code);
+      auto bb_resume = BasicBlock::Create(llvm_context(), "if_resume", m_function.impl.code);
 
       // create conditional branch instruction
       m_builder.CreateCondBr(cond_val, bb_true, bb_false);
@@ -986,6 +1020,27 @@
         throw std::runtime_error(strm.str());
       }
 
+      // inline builtins, random number generators only within modules
+      // having the state in their frame
+      bool const inline_call = func->impl.insert_func
+        && (!func->impl.uses_rand_state || (m_mod && m_mod->impl.rand_index));
+      if( inline_call ) {
+        for(auto i : node.expressions())
+          args.push_back(m_values.at(i));
+
+        llvm::Value* state = nullptr;
+        if( func->impl.uses_rand_state ) {
+          state = m_builder.CreateStructGEP(m_named_values.at("this_out"),
+              m_mod->impl.rand_index,
+              "rand_state_ptr");
+        }
+
+        m_values[&node] = func->impl.insert_func(m_builder, state, args);
+        m_types[&node] = func->return_type;
+
+        return true;
+      }
+
       // add module arguments
       if( func->within_module ) {
         args.push_back(m_named_values.at("this_out"));
@@ -1021,7 +1076,7 @@
 
     bool
     Llvm_function_scanner::leave_process(ast::Process const& node) {
-      auto ty = ir::Builtins<Llvm_impl>::types.at("unit");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("unit");
       auto v = llvm::Constant::getNullValue(ty->impl.type);
       m_values[&node] = m_builder.CreateRet(v);
       m_type_targets.pop_back();
@@ -1032,7 +1087,7 @@
 
     bool
     Llvm_function_scanner::leave_periodic(ast::Periodic const& node) {
-      auto ty = ir::Builtins<Llvm_impl>::types.at("unit");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("unit");
       auto v = llvm::Constant::getNullValue(ty->impl.type);
       m_values[&node] = m_builder.CreateRet(v);
       m_type_targets.pop_back();
@@ -1043,7 +1098,7 @@
 
     bool
     Llvm_function_scanner::leave_once(ast::Once const& node) {
-      auto ty = ir::Builtins<Llvm_impl>::types.at("unit");
+      auto ty = ir::Builtins<Llvm_impl>::types().at("unit");
       auto v = llvm::Constant::getNullValue(ty->impl.type);
       m_values[&node] = m_builder.CreateRet(v);
       m_type_targets.pop_back();
@@ -1077,7 +1132,7 @@
     Llvm_function_scanner::enter_while(ast::While_expression const& node) {
       using namespace llvm;
 
-      auto bb_test = BasicBlock::Create(getGlobalContext(),
+      auto bb_test = BasicBlock::Create(llvm_context(),
           "while_test",
           m_function.impl.code);
       m_builder.CreateBr(bb_test);
@@ -1087,10 +1142,10 @@
       node.expression().accept(*this);
       auto cond_val = m_values.at(&(node.expression()));
 
-      auto bb_body = BasicBlock::Create(getGlobalContext(),
+      auto bb_body = BasicBlock::Create(llvm_context(),
           "while_body",
           m_function.impl.code);
-      auto bb_resume = BasicBlock::Create(getGlobalContext(),
+      auto bb_resume = BasicBlock::Create(llvm_context(),
           "while_resume",
           m_function.impl.code);
       m_builder.CreateCondBr(cond_val, bb_body, bb_resume);
@@ -1114,7 +1169,7 @@
       using namespace llvm;
 
       // create index variable
-      auto index_ty = ir::Builtins<Llvm_impl>::types.at("int");
+      auto index_ty = ir::Builtins<Llvm_impl>::types().at("int");
       auto index_ptr = m_builder.CreateAlloca(index_ty->impl.type,
           nullptr,
           "for_index_ptr");
@@ -1141,7 +1196,7 @@
       }
 
       // basic block for condition testing
-      auto bb_test = BasicBlock::Create(getGlobalContext(),
+      auto bb_test = BasicBlock::Create(llvm_context(),
           "for_test",
           m_function.impl.code);
       m_builder.CreateBr(bb_test);
@@ -1151,10 +1206,10 @@
       auto index_val = m_builder.CreateLoad(index_ptr, "for_index");
       auto cond_val = m_builder.CreateICmpSLT(index_val, size_val);
 
-      auto bb_body = BasicBlock::Create(getGlobalContext(),
+      auto bb_body = BasicBlock::Create(llvm_context(),
           "for_body",
           m_function.impl.code);
-      auto bb_resume = BasicBlock::Create(getGlobalContext(),
+      auto bb_resume = BasicBlock::Create(llvm_context(),
           "for_resume",
           m_function.impl.code);
       m_builder.CreateCondBr(cond_val, bb_body, bb_resume);
@@ -1162,7 +1217,7 @@
 
       // codegen for body
       std::vector<llvm::Value*> indices;
-      indices.push_back(llvm::ConstantInt::get(llvm::getGlobalContext(),
+      indices.push_back(llvm::ConstantInt::get(llvm_context(),
           llvm::APInt(64, 0, true)));
       indices.push_back(index_val);
       auto iter_ptr = m_builder.CreateInBoundsGEP(iterand_ptr,
@@ -46,6 +46,7 @@ namespace sim {
       void init_scanner();
       llvm::FunctionType* get_function_type(Llvm_function const& function) const;
       llvm::ArrayType* read_mask_type() const;
+      bool dead_store(ast::Assignment const& node) const;
 
 
       // scanner callbacks
@@ -0,0 +1,191 @@
+#include "sim/llvm_math.h"
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+
+
+namespace sim {
+
+  // local helper functions
+  static bool fast_math(llvm::IRBuilder<>& bld);
+  static llvm::Value* insert_fast_exp(llvm::IRBuilder<>& bld, llvm::Value* x);
+  static llvm::Value* insert_fast_log(llvm::IRBuilder<>& bld, llvm::Value* x);
+  static llvm::Value* insert_polynomial(llvm::IRBuilder<>& bld,
+      llvm::Value* x,
+      std::vector<double> const& coeffs);
+
+
+  static double const ln2 = 0.6931471805599453;
+  static double const ln2_hi = 6.93147180369123816490e-01;
+  static double const ln2_lo = 1.90821492927058770002e-10;
+  static double const log2e = 1.4426950408889634;
+  static double const sqrt2 = 1.4142135623730951;
+
+
+
+  llvm::Value* insert_intrinsic(llvm::IRBuilder<>& bld,
+      llvm::Intrinsic::ID id,
+      std::vector<llvm::Value*> const& args) {
+    auto module = bld.GetInsertBlock()->getParent()->getParent();
+    auto f = llvm::Intrinsic::getDeclaration(module,
+        id,
+        std::vector<llvm::Type*>{args.at(0)->getType()});
+
+    return bld.CreateCall(f, args);
+  }
+
+
+  llvm::Value* insert_exp(llvm::IRBuilder<>& bld, llvm::Value* x) {
+    if( fast_math(bld) )
+      return insert_fast_exp(bld, x);
+
+    return insert_intrinsic(bld, llvm::Intrinsic::exp, {x});
+  }
+
+
+  llvm::Value* insert_log(llvm::IRBuilder<>& bld, llvm::Value* x) {
+    if( fast_math(bld) )
+      return insert_fast_log(bld, x);
+
+    return insert_intrinsic(bld, llvm::Intrinsic::log, {x});
+  }
+
+
+  llvm::Value* insert_pow(llvm::IRBuilder<>& bld,
+      llvm::Value* x,
+      llvm::Value* y) {
+    if( fast_math(bld) )
+      return insert_fast_exp(bld, bld.CreateFMul(y, insert_fast_log(bld, x)));
+
+    return insert_intrinsic(bld, llvm::Intrinsic::pow, {x, y});
+  }
+
+
+  llvm::Value* insert_abs(llvm::IRBuilder<>& bld, llvm::Value* x) {
+    if( x->getType()->isFloatingPointTy() )
+      return insert_intrinsic(bld, llvm::Intrinsic::fabs, {x});
+
+    auto zero = llvm::ConstantInt::get(x->getType(), 0);
+    return bld.CreateSelect(bld.CreateICmpSLT(x, zero),
+        bld.CreateNeg(x),
+        x,
+        "abs");
+  }
+
+
+  llvm::Value* insert_min(llvm::IRBuilder<>& bld,
+      llvm::Value* a,
+      llvm::Value* b) {
+    auto less = a->getType()->isFloatingPointTy()
+      ? bld.CreateFCmpOLT(b, a)
+      : bld.CreateICmpSLT(b, a);
+
+    return bld.CreateSelect(less, b, a, "min");
+  }
+
+
+  llvm::Value* insert_max(llvm::IRBuilder<>& bld,
+      llvm::Value* a,
+      llvm::Value* b) {
+    auto greater = a->getType()->isFloatingPointTy()
+      ? bld.CreateFCmpOGT(b, a)
+      : bld.CreateICmpSGT(b, a);
+
+    return bld.CreateSelect(greater, b, a, "max");
+  }
+
+
+  llvm::Value* insert_clamp(llvm::IRBuilder<>& bld,
+      llvm::Value* x,
+      llvm::Value* lo,
+      llvm::Value* hi) {
+    return insert_min(bld, insert_max(bld, x, lo), hi);
+  }
+
+
+  static bool fast_math(llvm::IRBuilder<>& bld) {
+    return bld.getFastMathFlags().unsafeAlgebra();
+  }
+
+
+  static llvm::Value* insert_fast_exp(llvm::IRBuilder<>& bld, llvm::Value* x) {
+    using namespace llvm;
+
+    auto i64 = bld.getInt64Ty();
+    auto dbl = bld.getDoubleTy();
+
+    // x = k ln(2) + r with |r| <= ln(2)/2, k rounded to nearest
+    x = insert_clamp(bld,
+        x,
+        ConstantFP::get(dbl, -708.0),
+        ConstantFP::get(dbl, 709.0));
+    auto t = bld.CreateFMul(x, ConstantFP::get(dbl, log2e));
+    auto half = bld.CreateSelect(bld.CreateFCmpOLT(t, ConstantFP::get(dbl, 0.0)),
+        ConstantFP::get(dbl, -0.5),
+        ConstantFP::get(dbl, 0.5));
+    auto k = bld.CreateFPToSI(bld.CreateFAdd(t, half), i64);
+    auto kf = bld.CreateSIToFP(k, dbl);
+    auto r = bld.CreateFSub(
+        bld.CreateFSub(x, bld.CreateFMul(kf, ConstantFP::get(dbl, ln2_hi))),
+        bld.CreateFMul(kf, ConstantFP::get(dbl, ln2_lo)));
+
+    // exp(r) by its Taylor polynomial, times 2^k built from the exponent bits
+    auto p = insert_polynomial(bld,
+        r,
+        {1.0, 1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720});
+    auto scale = bld.CreateBitCast(
+        bld.CreateShl(bld.CreateAdd(k, ConstantInt::get(i64, 1023)), 52),
+        dbl);
+
+    return bld.CreateFMul(p, scale, "fast_exp");
+  }
+
+
+  static llvm::Value* insert_fast_log(llvm::IRBuilder<>& bld, llvm::Value* x) {
+    using namespace llvm;
+
+    auto i64 = bld.getInt64Ty();
+    auto dbl = bld.getDoubleTy();
+    auto one = ConstantFP::get(dbl, 1.0);
+
+    // x = 2^e m with m in [sqrt(1/2), sqrt(2))
+    auto bits = bld.CreateBitCast(x, i64);
+    auto e = bld.CreateSub(bld.CreateLShr(bits, 52), ConstantInt::get(i64, 1023));
+    auto m = bld.CreateBitCast(
+        bld.CreateOr(bld.CreateAnd(bits, ConstantInt::get(i64, 0x000fffffffffffffull)),
+          ConstantInt::get(i64, 0x3ff0000000000000ull)),
+        dbl);
+    auto big = bld.CreateFCmpOGE(m, ConstantFP::get(dbl, sqrt2));
+    m = bld.CreateSelect(big, bld.CreateFMul(m, ConstantFP::get(dbl, 0.5)), m);
+    e = bld.CreateSelect(big, bld.CreateAdd(e, ConstantInt::get(i64, 1)), e);
+
+    // log(m) = 2 atanh(s) with s = (m - 1) / (m + 1) by its series
+    auto s = bld.CreateFDiv(bld.CreateFSub(m, one), bld.CreateFAdd(m, one));
+    auto p = insert_polynomial(bld,
+        bld.CreateFMul(s, s),
+        {2.0, 2.0/3, 2.0/5, 2.0/7, 2.0/9});
+
+    return bld.CreateFAdd(
+        bld.CreateFMul(bld.CreateSIToFP(e, dbl), ConstantFP::get(dbl, ln2)),
+        bld.CreateFMul(p, s),
+        "fast_log");
+  }
+
+
+  /** Horner's scheme, coefficients in order of increasing degree */
+  static llvm::Value* insert_polynomial(llvm::IRBuilder<>& bld,
+      llvm::Value* x,
+      std::vector<double> const& coeffs) {
+    auto dbl = bld.getDoubleTy();
+
+    llvm::Value* rv = llvm::ConstantFP::get(dbl, coeffs.back());
+    for(auto it=++coeffs.rbegin(); it != coeffs.rend(); ++it)
+      rv = bld.CreateFAdd(bld.CreateFMul(rv, x), llvm::ConstantFP::get(dbl, *it));
+
+    return rv;
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/Value.h>
+
+#include <vector>
+
+
+namespace sim {
+
+  /** @name Inline code of the builtin math functions
+   *
+   * The functions are lowered to LLVM intrinsics or plain instructions so
+   * the optimizer sees through them. If the builder has unsafe algebra set
+   * in its fast math flags, see Frame_layout_options::fast_math, exp(),
+   * log() and pow() are replaced by polynomial approximations with a
+   * relative error below 1e-6.
+   * */
+  ///@{
+
+  /** Call to an intrinsic overloaded on the type of the first argument */
+  llvm::Value* insert_intrinsic(llvm::IRBuilder<>& bld,
+      llvm::Intrinsic::ID id,
+      std::vector<llvm::Value*> const& args);
+
+  /** exp(x), the approximation saturates outside of [-708, 709] */
+  llvm::Value* insert_exp(llvm::IRBuilder<>& bld, llvm::Value* x);
+
+  /** log(x), the approximation requires x to be positive and normal */
+  llvm::Value* insert_log(llvm::IRBuilder<>& bld, llvm::Value* x);
+
+  /** pow(x, y), the approximation requires x to be positive */
+  llvm::Value* insert_pow(llvm::IRBuilder<>& bld,
+      llvm::Value* x,
+      llvm::Value* y);
+
+  /** abs(x) of an int or float */
+  llvm::Value* insert_abs(llvm::IRBuilder<>& bld, llvm::Value* x);
+
+  /** min(a, b) of ints or floats */
+  llvm::Value* insert_min(llvm::IRBuilder<>& bld,
+      llvm::Value* a,
+      llvm::Value* b);
+
+  /** max(a, b) of ints or floats */
+  llvm::Value* insert_max(llvm::IRBuilder<>& bld,
+      llvm::Value* a,
+      llvm::Value* b);
+
+  /** clamp(x, lo, hi) of ints or floats, hi if lo > hi */
+  llvm::Value* insert_clamp(llvm::IRBuilder<>& bld,
+      llvm::Value* x,
+      llvm::Value* lo,
+      llvm::Value* hi);
+
+  ///@}
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -5,9 +5,14 @@
 #include "ir/find.hpp"
 #include "ir/find_hierarchy.h"
 #include "ir/builtins.h"
-
+#include "ast/ast_find.h"
+#include "ast/name_lookup.h"
+#include "ast/assignment.h"
+#include "ast/function_call.h"
 
 #include <iostream>
+#include <algorithm>
+#include <set>
 
 
 namespace sim {
@@ -95,7 +100,7 @@ namespace sim {
 
     auto func = std::make_shared<Llvm_function>();
     func->name = "__process__";
-    func->return_type = ir::Builtins<Llvm_impl>::types.at("unit");
+    func->return_type = ir::Builtins<Llvm_impl>::types().at("unit");
     func->within_module = true;
     m_todo_functions.push_back(std::make_tuple(func, &node));
     proc->function = func;
@@ -126,7 +131,7 @@ namespace sim {
 
     auto func = std::make_shared<Llvm_function>();
     func->name = "__periodic__";
-    func->return_type = ir::Builtins<Llvm_impl>::types.at("unit");
+    func->return_type = ir::Builtins<Llvm_impl>::types().at("unit");
     func->within_module = true;
     m_todo_functions.push_back(std::make_tuple(func, &node));
     per->function = func;
@@ -156,7 +161,7 @@ namespace sim {
 
     auto func = std::make_shared<Llvm_function>();
     func->name = "__once__";
-    func->return_type = ir::Builtins<Llvm_impl>::types.at("unit");
+    func->return_type = ir::Builtins<Llvm_impl>::types().at("unit");
     func->within_module = true;
     m_todo_functions.push_back(std::make_tuple(func, &node));
     once->function = func;
@@ -173,11 +178,11 @@ namespace sim {
 
     auto param = std::make_shared<Llvm_object>();
     param->name = rec->time_id;
-    param->type = ir::Builtins<Llvm_impl>::types.at("int");
+    param->type = ir::Builtins<Llvm_impl>::types().at("int");
 
     auto func = std::make_shared<Llvm_function>();
     func->name = "__recurrent__";
-    func->return_type = ir::Builtins<Llvm_impl>::types.at("int");
+    func->return_type = ir::Builtins<Llvm_impl>::types().at("int");
     func->parameters.push_back(param);
     func->within_module = true;
     m_todo_functions.push_back(std::make_tuple(func, &node));
@@ -193,6 +198,17 @@ namespace sim {
     m_mod.objects.at("port")->impl.struct_index = 0;
     m_member_types[0] = m_mod.socket->impl.type;
 
+    auto const& layout_opts = find_library(m_mod)->impl.frame_layout;
+    if( layout_opts.eliminate_unused || layout_opts.reorder )
+      optimize_frame_layout(layout_opts);
+
+    // state of the random number generators, not visible as an object
+    if( calls_rand(node) ) {
+      m_mod.impl.rand_index = m_member_types.size();
+      m_member_types.push_back(
+          llvm::Type::getInt64Ty(find_library(m_mod)->impl.context));
+    }
+
     m_mod.impl.mod_type->setBody(m_member_types);
 
     for(auto f : m_todo_functions) {
@@ -245,7 +261,7 @@ namespace sim {
     //if( cnst_int )
       //LOG4CXX_TRACE(m_logger, "constant evaluates to "
           //<< cnst_int->getSExtValue());
-    if( c->type == ir::Builtins<Llvm_impl>::types["int"] )
+    if( c->type == ir::Builtins<Llvm_impl>::types().at("int") )
       LOG4CXX_TRACE(m_logger, "constant integer: "
           << c->impl.expr->getUniqueInteger().getLimitedValue());
 
@@ -321,6 +337,119 @@ namespace sim {
   }
 
 
+  void
+  Llvm_module_scanner::optimize_frame_layout(Frame_layout_options const& opts) {
+    // count reads of all members and writes outside of __init__, the
+    // target of an assignment is not a read, local names shadowing members
+    // are counted as well
+    std::map<ir::Label, unsigned> reads;
+    std::map<ir::Label, unsigned> writes;
+
+    for(auto const& f : m_todo_functions) {
+      auto const& node = *std::get<1>(f);
+      bool const init = (std::get<0>(f)->name == "__init__");
+
+      std::set<ast::Node_if const*> targets;
+      for(auto assign : ast::find_by_type<ast::Assignment>(node)) {
+        auto lhs = dynamic_cast<ast::Name_lookup const*>(&(assign->identifier()));
+        if( !lhs || (lhs->qname().size() != 1) )
+          continue;
+
+        targets.insert(lhs);
+        if( !init )
+          ++writes[lhs->qname()[0]];
+      }
+
+      for(auto lookup : ast::find_by_type<ast::Name_lookup>(node)) {
+        auto qname = lookup->qname();
+        if( (qname.size() == 1) && !targets.count(lookup) )
+          ++reads[qname[0]];
+      }
+    }
+
+    // members in declaration order
+    std::vector<std::pair<ir::Label, std::shared_ptr<Llvm_object>>> members;
+    for(auto const& obj : m_mod.objects) {
+      if( obj.second->impl.struct_index != 0 )
+        members.push_back(obj);
+    }
+    std::sort(members.begin(), members.end(),
+        [](decltype(members)::value_type const& a,
+          decltype(members)::value_type const& b) {
+          return a.second->impl.struct_index < b.second->impl.struct_index;
+        });
+
+    // remove variables never read together with their stores
+    if( opts.eliminate_unused ) {
+      auto unused = [&](decltype(members)::value_type const& m) -> bool {
+        if( m_mod.instantiations.count(m.first)
+            || reads.count(m.first)
+            || opts.keep.count(m.first)
+            || opts.keep.count(m_mod.name + "." + m.first) )
+          return false;
+
+        LOG4CXX_DEBUG(m_logger, "removing unread member '"
+            << m.first << "' from module '" << m_mod.name << "'");
+        m_mod.objects.erase(m.first);
+        m_mod.impl.dead_members.insert(m.first);
+        return true;
+      };
+
+      members.erase(std::remove_if(members.begin(), members.end(), unused),
+          members.end());
+    }
+
+    // hot members by number of writes, then members not written after
+    // __init__ and pointers to instantiated modules
+    if( opts.reorder ) {
+      auto num_writes = [&](ir::Label const& name) -> unsigned {
+        if( m_mod.instantiations.count(name) )
+          return 0;
+        auto it = writes.find(name);
+        return (it == writes.end()) ? 0 : it->second;
+      };
+
+      std::stable_sort(members.begin(), members.end(),
+          [&](decltype(members)::value_type const& a,
+            decltype(members)::value_type const& b) {
+            return num_writes(a.first) > num_writes(b.first);
+          });
+    }
+
+    // assign new struct indices
+    auto& context = find_library(m_mod)->impl.context;
+    std::vector<llvm::Type*> member_types(1, m_member_types[0]);
+
+    for(auto const& m : members) {
+      member_types.push_back(m_member_types.at(m.second->impl.struct_index));
+      m.second->impl.struct_index = member_types.size() - 1;
+    }
+
+    m_mod.impl.declared_type = llvm::StructType::get(context, m_member_types);
+    m_member_types = member_types;
+  }
+
+
+  bool
+  Llvm_module_scanner::calls_rand(ast::Module_def const& node) const {
+    auto const& builtins = ir::Builtins<Llvm_impl>::functions();
+
+    for(auto call : ast::find_by_type<ast::Function_call>(node)) {
+      auto qname = call->name();
+      if( qname.size() != 1 )
+        continue;
+
+      auto range = builtins.equal_range(qname[0]);
+      for(auto it=range.first; it != range.second; ++it) {
+        if( it->second->impl.uses_rand_state )
+          return true;
+      }
+    }
+
+    return false;
+  }
+
+
   std::shared_ptr<Llvm_type>
   Llvm_module_scanner::create_array_type(ast::Array_type const& node) {
     // process constant expression to determine size
@@ -338,7 +467,7 @@ namespace sim {
     }
 
     // get size from constant expression
-    if( sz_cnst->type != ir::Builtins<Llvm_impl>::types["int"] ) {
+    if( sz_cnst->type != ir::Builtins<Llvm_impl>::types().at("int") ) {
       std::stringstream strm;
       strm << node.location()
         << ": Constant for array size is not of type 'int'"
@@ -38,6 +38,11 @@ namespace sim {
           std::map<ir::Label,std::shared_ptr<Llvm_type>> const& args);
 
       virtual std::shared_ptr<Llvm_type> create_array_type(ast::Array_type const& node);
+
+      void optimize_frame_layout(Frame_layout_options const& opts);
+
+      /** true if the module calls a builtin random number generator */
+      bool calls_rand(ast::Module_def const& node) const;
   };
 
 }
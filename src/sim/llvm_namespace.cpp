@@ -3,6 +3,25 @@
 
 namespace sim {
 
+  static thread_local llvm::LLVMContext* current_context = nullptr;
+
+
+  llvm::LLVMContext& llvm_context() {
+    static thread_local llvm::LLVMContext thread_context;
+    return current_context ? *current_context : thread_context;
+  }
+
+
+  Context_scope::Context_scope(llvm::LLVMContext& context)
+    : m_prev(current_context) {
+    current_context = &context;
+  }
+
+
+  Context_scope::~Context_scope() {
+    current_context = m_prev;
+  }
+
 
   Llvm_impl::Library
   create_library_impl(std::string const& name) {
@@ -11,6 +11,8 @@
 //#include <llvm/Transforms/Scalar.h>
 #include <llvm/IR/TypeBuilder.h>
 #include <stdexcept>
+#include <set>
+#include <string>
 
 
 /** Simulation related namespace */
@@ -19,6 +21,45 @@ namespace sim {
   struct Socket_operator_codegen;
 
 
+  /** Options for the layout of module frames and the code of modules */
+  struct Frame_layout_options {
+    /** Remove members not read by any function of their module and the
+     * stores to them */
+    bool eliminate_unused = false;
+    /** Place frequently written members first and cold members last */
+    bool reorder = false;
+    /** Members kept even if unreferenced, as "member" or "module.member" */
+    std::set<std::string> keep;
+    /** Modules using the fast approximations of the math builtins and fast
+     * math flags on their floating point operations */
+    std::set<std::string> fast_math;
+  };
+
+
+  /** LLVM context for code generation on the calling thread
+   *
+   * Refers to the context made current by a Context_scope, or to a context
+   * private to the thread if there is none. Libraries are created in the
+   * current context, see Llvm_impl::Library.
+   * */
+  llvm::LLVMContext& llvm_context();
+
+
+  /** Make an LLVM context current for the calling thread during the lifetime
+   * of the object */
+  class Context_scope {
+    public:
+      explicit Context_scope(llvm::LLVMContext& context);
+      ~Context_scope();
+
+      Context_scope(Context_scope const&) = delete;
+      Context_scope& operator = (Context_scope const&) = delete;
+
+    private:
+      llvm::LLVMContext* m_prev;
+  };
+
+
   struct Llvm_impl {
     struct Type {
       llvm::Type* type;
@@ -44,6 +85,17 @@ namespace sim {
     struct Function {
       llvm::Function* code;
       llvm::FunctionType* func_type;
+      /** Generates the code of a builtin inline instead of calling code
+       *
+       * state points to the random number generator state of the calling
+       * module, see Module::rand_index, and is nullptr for builtins not
+       * using it. */
+      std::function<llvm::Value* (llvm::IRBuilder<>& bld,
+          llvm::Value* state,
+          std::vector<llvm::Value*> const& args)> insert_func;
+      /** insert_func draws from the stream of the module, calls outside of
+       * modules use code instead */
+      bool uses_rand_state = false;
     };
 
     struct Operator {
@@ -56,11 +108,22 @@ namespace sim {
     struct Once {};
     struct Recurrent {};
     struct Socket {};
-    struct Namespace {};
+    struct Namespace {
+      /** File the namespace was read from if referenced by name only */
+      std::string source_file;
+    };
 
     struct Module {
       llvm::StructType* mod_type;
       llvm::Function* ctor;
+      /** Frame type in declaration order if the layout was optimized */
+      llvm::StructType* declared_type = nullptr;
+      /** Frame member holding the state of the random number generators,
+       * 0 if the module does not call them */
+      std::size_t rand_index = 0;
+      /** Members removed by Frame_layout_options::eliminate_unused, stores
+       * to them are dropped */
+      std::set<std::string> dead_members;
     };
 
     struct Module_template {};
@@ -70,10 +133,11 @@ namespace sim {
       std::unique_ptr<llvm::IRBuilder<>> builder;
       std::unique_ptr<llvm::Module> module;
       //std::unique_ptr<llvm::FunctionPassManager> fpm;
+      Frame_layout_options frame_layout;
 
 
       Library()
-        : context(llvm::getGlobalContext()) {
+        : context(llvm_context()) {
       }
 
       Library(Library&& other)
@@ -81,6 +145,7 @@ namespace sim {
         builder = std::move(other.builder);
         module = std::move(other.module);
         //fpm = std::move(other.fpm);
+        frame_layout = other.frame_layout;
       }
 
       Library& operator = (Library&& o) {
@@ -90,6 +155,7 @@ namespace sim {
         builder = std::move(o.builder);
         module = std::move(o.module);
         //fpm = std::move(o.fpm);
+        frame_layout = o.frame_layout;
 
         return *this;
       }
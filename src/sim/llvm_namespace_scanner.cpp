@@ -36,7 +36,8 @@ namespace sim {
 
     if( ns.empty() ) {
       // try to parse namespace from another file
-      auto filename = ir::path_lookup(m_ns.enclosing_library.lock(), n->name);
+      auto lib = m_ns.enclosing_library.lock();
+      auto filename = ir::path_lookup(lib, n->name);
       if( filename.empty() ) {
         std::stringstream strm;
         strm << ns.location() << ": "
@@ -45,11 +46,20 @@ namespace sim {
           << "'";
         throw std::runtime_error(strm.str());
       }
-      Parse_driver driver;
-      if( driver.parse(filename) )
-        throw std::runtime_error("Parse failed");
-
-      driver.ast_root().accept(scanner);
+      n->impl.source_file = filename;
+
+      // use the AST if the file was already parsed
+      auto parsed = lib->parsed_files.find(filename);
+      if( parsed != lib->parsed_files.end() ) {
+        parsed->second->ast_root().accept(scanner);
+      } else {
+        auto driver = std::make_shared<Parse_driver>();
+        if( driver->parse(filename) )
+          throw std::runtime_error("Parse failed");
+
+        lib->parsed_files[filename] = driver;
+        driver->ast_root().accept(scanner);
+      }
     } else {
       ns.accept(scanner);
     }
@@ -159,7 +169,7 @@ namespace sim {
 
     // create operators
     auto base_op_eq = ir::find_operator(m_ns, "==",
-        ir::Builtins<Llvm_impl>::types.at("bool"),
+        ir::Builtins<Llvm_impl>::types().at("bool"),
         ty.first->array_base_type,
         ty.first->array_base_type);
     if( !base_op_eq ) {
@@ -171,7 +181,7 @@ namespace sim {
     }
 
     auto base_op_neq = ir::find_operator(m_ns, "!=",
-        ir::Builtins<Llvm_impl>::types.at("bool"),
+        ir::Builtins<Llvm_impl>::types().at("bool"),
         ty.first->array_base_type,
         ty.first->array_base_type);
     if( !base_op_neq ) {
@@ -185,7 +195,7 @@ namespace sim {
     // equality comparison
     auto op_eq = std::make_shared<Llvm_operator>();
     op_eq->name = "==";
-    op_eq->return_type = ir::Builtins<Llvm_impl>::types.at("bool");
+    op_eq->return_type = ir::Builtins<Llvm_impl>::types().at("bool");
     op_eq->left = op_eq->right = ty.first;
     op_eq->impl.insert_func = base_op_eq->impl.insert_func;
     op_eq->impl.const_insert_func = base_op_eq->impl.const_insert_func;
@@ -194,7 +204,7 @@ namespace sim {
     // inequality operator
     auto op_neq = std::make_shared<Llvm_operator>();
     op_neq->name = "!=";
-    op_neq->return_type = ir::Builtins<Llvm_impl>::types.at("bool");
+    op_neq->return_type = ir::Builtins<Llvm_impl>::types().at("bool");
     op_neq->left = op_neq->right = ty.first;
     op_neq->impl.insert_func = base_op_neq->impl.insert_func;
     op_neq->impl.const_insert_func = base_op_neq->impl.const_insert_func;
@@ -246,7 +256,7 @@ namespace sim {
     node.size_expr().accept(scanner);
 
     // get size from constant expression
-    if( sz_cnst->type != ir::Builtins<Llvm_impl>::types["int"] ) {
+    if( sz_cnst->type != ir::Builtins<Llvm_impl>::types().at("int") ) {
       std::stringstream strm;
       strm << node.location()
         << ": Constant for array size is not of type 'int'"
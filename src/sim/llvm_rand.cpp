@@ -0,0 +1,173 @@
+#include "sim/llvm_rand.h"
+
+#include "sim/llvm_math.h"
+#include "sim/runtime.h"
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+
+
+namespace sim {
+
+  // local helper functions
+  static llvm::Value* insert_rand_open(llvm::IRBuilder<>& bld,
+      llvm::Value* state);
+
+
+
+  llvm::Value* insert_rand_bits(llvm::IRBuilder<>& bld, llvm::Value* state) {
+    auto i64 = bld.getInt64Ty();
+
+    auto s = bld.CreateAdd(bld.CreateLoad(state, "rand_state"),
+        llvm::ConstantInt::get(i64, rand_increment),
+        "rand_counter");
+    bld.CreateStore(s, state);
+
+    // cell_rand_mix()
+    auto z = bld.CreateMul(bld.CreateXor(s, bld.CreateLShr(s, 30)),
+        llvm::ConstantInt::get(i64, rand_mix_mul1));
+    z = bld.CreateMul(bld.CreateXor(z, bld.CreateLShr(z, 27)),
+        llvm::ConstantInt::get(i64, rand_mix_mul2));
+    return bld.CreateXor(z, bld.CreateLShr(z, 31), "rand_bits");
+  }
+
+
+  llvm::Value* insert_rand(llvm::IRBuilder<>& bld, llvm::Value* state) {
+    return bld.CreateLShr(insert_rand_bits(bld, state), 33, "rand");
+  }
+
+
+  llvm::Value* insert_rand_int(llvm::IRBuilder<>& bld,
+      llvm::Value* state,
+      llvm::Value* lo,
+      llvm::Value* hi) {
+    auto i64 = bld.getInt64Ty();
+    auto i128 = bld.getIntNTy(128);
+
+    // multiply-shift maps the bits to [0, n) without division
+    auto n = bld.CreateSelect(bld.CreateICmpSGT(hi, lo),
+        bld.CreateSub(hi, lo),
+        llvm::ConstantInt::get(i64, 0),
+        "rand_range");
+    auto wide = bld.CreateMul(bld.CreateZExt(insert_rand_bits(bld, state), i128),
+        bld.CreateZExt(n, i128));
+    auto r = bld.CreateTrunc(bld.CreateLShr(wide, 64), i64);
+
+    return bld.CreateAdd(lo, r, "rand_int");
+  }
+
+
+  llvm::Value* insert_rand_float(llvm::IRBuilder<>& bld, llvm::Value* state) {
+    auto dbl = bld.getDoubleTy();
+    auto bits = bld.CreateLShr(insert_rand_bits(bld, state), 11);
+
+    return bld.CreateFMul(bld.CreateUIToFP(bits, dbl),
+        llvm::ConstantFP::get(dbl, rand_float_scale),
+        "rand_float");
+  }
+
+
+  llvm::Value* insert_rand_normal(llvm::IRBuilder<>& bld,
+      llvm::Value* state,
+      llvm::Value* mean,
+      llvm::Value* sd) {
+    auto dbl = bld.getDoubleTy();
+
+    // Box-Muller, one of the two values is dropped to keep no extra state
+    auto u1 = insert_rand_open(bld, state);
+    auto u2 = insert_rand_float(bld, state);
+    auto r = insert_intrinsic(bld,
+        llvm::Intrinsic::sqrt,
+        {bld.CreateFMul(llvm::ConstantFP::get(dbl, -2.0),
+          insert_intrinsic(bld, llvm::Intrinsic::log, {u1}))});
+    auto c = insert_intrinsic(bld,
+        llvm::Intrinsic::cos,
+        {bld.CreateFMul(llvm::ConstantFP::get(dbl, rand_two_pi), u2)});
+
+    return bld.CreateFAdd(mean,
+        bld.CreateFMul(bld.CreateFMul(sd, r), c),
+        "rand_normal");
+  }
+
+
+  llvm::Value* insert_rand_poisson(llvm::IRBuilder<>& bld,
+      llvm::Value* state,
+      llvm::Value* lambda) {
+    using namespace llvm;
+
+    // same algorithm as cell_rand_poisson()
+    auto& context = bld.getContext();
+    auto func = bld.GetInsertBlock()->getParent();
+    auto i64 = bld.getInt64Ty();
+    auto dbl = bld.getDoubleTy();
+    auto one = ConstantFP::get(dbl, 1.0);
+    auto zero = ConstantFP::get(dbl, 0.0);
+    auto step_max = ConstantFP::get(dbl, rand_poisson_step);
+
+    auto bb_entry = bld.GetInsertBlock();
+    auto bb_loop = BasicBlock::Create(context, "poisson_loop", func);
+    auto bb_fill = BasicBlock::Create(context, "poisson_fill", func);
+    auto bb_step = BasicBlock::Create(context, "poisson_step", func);
+    auto bb_test = BasicBlock::Create(context, "poisson_test", func);
+    auto bb_done = BasicBlock::Create(context, "poisson_done", func);
+    bld.CreateBr(bb_loop);
+
+    // multiply uniform numbers ...
+    bld.SetInsertPoint(bb_loop);
+    auto k = bld.CreatePHI(i64, 2, "poisson_k");
+    auto p = bld.CreatePHI(dbl, 2, "poisson_p");
+    auto left = bld.CreatePHI(dbl, 2, "poisson_left");
+    auto k_next = bld.CreateAdd(k, ConstantInt::get(i64, 1));
+    auto p_next = bld.CreateFMul(p, insert_rand_open(bld, state));
+    auto bb_loop_end = bld.GetInsertBlock();
+    bld.CreateBr(bb_fill);
+
+    // ... scaling the product up by exp(lambda) in steps ...
+    bld.SetInsertPoint(bb_fill);
+    auto p_fill = bld.CreatePHI(dbl, 2, "poisson_p_fill");
+    auto left_fill = bld.CreatePHI(dbl, 2, "poisson_left_fill");
+    auto need_fill = bld.CreateAnd(bld.CreateFCmpOLT(p_fill, one),
+        bld.CreateFCmpOGT(left_fill, zero));
+    bld.CreateCondBr(need_fill, bb_step, bb_test);
+
+    bld.SetInsertPoint(bb_step);
+    auto step = bld.CreateSelect(bld.CreateFCmpOGT(left_fill, step_max),
+        step_max,
+        left_fill);
+    auto p_step = bld.CreateFMul(p_fill,
+        insert_intrinsic(bld, Intrinsic::exp, {step}));
+    auto left_step = bld.CreateFSub(left_fill, step);
+    bld.CreateBr(bb_fill);
+
+    p_fill->addIncoming(p_next, bb_loop_end);
+    p_fill->addIncoming(p_step, bb_step);
+    left_fill->addIncoming(left, bb_loop_end);
+    left_fill->addIncoming(left_step, bb_step);
+
+    // ... until it drops below one
+    bld.SetInsertPoint(bb_test);
+    bld.CreateCondBr(bld.CreateFCmpOGT(p_fill, one), bb_loop, bb_done);
+
+    k->addIncoming(ConstantInt::get(i64, 0), bb_entry);
+    k->addIncoming(k_next, bb_test);
+    p->addIncoming(one, bb_entry);
+    p->addIncoming(p_fill, bb_test);
+    left->addIncoming(lambda, bb_entry);
+    left->addIncoming(left_fill, bb_test);
+
+    bld.SetInsertPoint(bb_done);
+    return k;
+  }
+
+
+  /** Uniform in (0, 1), safe to take the logarithm of */
+  static llvm::Value* insert_rand_open(llvm::IRBuilder<>& bld,
+      llvm::Value* state) {
+    auto dbl = bld.getDoubleTy();
+    return bld.CreateFAdd(insert_rand_float(bld, state),
+        llvm::ConstantFP::get(dbl, 0.5 * rand_float_scale));
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Value.h>
+
+
+namespace sim {
+
+  /** @name Inline code of the builtin random number generators
+   *
+   * The generators draw from the splitmix64 stream whose 64 bit state is
+   * pointed to by state, usually the frame member of the calling module
+   * instance, see Llvm_impl::Module::rand_index. The sequences equal the
+   * ones of the runtime functions in sim/runtime.h. The builder is left at
+   * the end of the generated code, which may span several basic blocks.
+   * */
+  ///@{
+
+  /** Next 64 random bits, advances the state */
+  llvm::Value* insert_rand_bits(llvm::IRBuilder<>& bld, llvm::Value* state);
+
+  /** rand(): int in [0, 2^31) */
+  llvm::Value* insert_rand(llvm::IRBuilder<>& bld, llvm::Value* state);
+
+  /** rand_int(lo, hi): int uniform in [lo, hi), lo if hi <= lo */
+  llvm::Value* insert_rand_int(llvm::IRBuilder<>& bld,
+      llvm::Value* state,
+      llvm::Value* lo,
+      llvm::Value* hi);
+
+  /** rand_float(): float uniform in [0, 1) */
+  llvm::Value* insert_rand_float(llvm::IRBuilder<>& bld, llvm::Value* state);
+
+  /** rand_normal(mean, sd): normally distributed float */
+  llvm::Value* insert_rand_normal(llvm::IRBuilder<>& bld,
+      llvm::Value* state,
+      llvm::Value* mean,
+      llvm::Value* sd);
+
+  /** rand_poisson(lambda): Poisson distributed int with mean lambda */
+  llvm::Value* insert_rand_poisson(llvm::IRBuilder<>& bld,
+      llvm::Value* state,
+      llvm::Value* lambda);
+
+  ///@}
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
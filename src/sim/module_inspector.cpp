@@ -25,10 +25,18 @@ namespace sim {
     if( it != std::end(m_runset.modules) ) {
       this_in = it->this_in;
       this_out = it->this_out;
+      this_prev = it->this_prev;
       read_mask = it->read_mask;
     } else {
       throw std::runtime_error("unable to find matching module in runset");
     }
+
+    m_objects.resize(num_elements);
+    for(auto const& obj : m_module->objects) {
+      auto idx = obj.second->impl.struct_index;
+      if( (idx < num_elements) && !m_objects[idx] )
+        m_objects[idx] = obj.second;
+    }
   }
 
 }
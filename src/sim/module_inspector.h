@@ -7,12 +7,76 @@
 #include <algorithm>
 #include <sstream>
 #include <stdexcept>
+#include <cstring>
+#include <vector>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/ExecutionEngine/JIT.h>
 
 
 namespace sim {
 
+  /** Typed access to a member of a module instance
+   *
+   * Created by Module_inspector::handle(). Holds the module frames and the
+   * offset of the member, so accesses do not look up names or layouts.
+   * get() reads the current value (this_in), set() writes the next value
+   * (this_out) like Module_inspector::get() and Module_inspector::set().
+   * */
+  template<typename T>
+  class Signal_handle {
+    public:
+      Signal_handle() {}
+
+      Signal_handle(Runset::Module_frame this_in,
+          Runset::Module_frame this_out,
+          std::size_t offset)
+        : m_in(this_in),
+          m_out(this_out),
+          m_offset(offset) {
+      }
+
+      T get() const {
+        T rv;
+        std::memcpy(&rv, m_in->data() + m_offset, sizeof(rv));
+        return rv;
+      }
+
+      void set(T val) const {
+        std::memcpy(m_out->data() + m_offset, &val, sizeof(val));
+      }
+
+      bool valid() const { return bool(m_in); }
+
+
+    private:
+      Runset::Module_frame m_in, m_out;
+      std::size_t m_offset = 0;
+  };
+
+
+  /** Read the current values of many handles into values */
+  template<typename T>
+  void get_all(std::vector<Signal_handle<T>> const& handles,
+      std::vector<T>& values) {
+    values.resize(handles.size());
+    for(std::size_t i=0; i<handles.size(); ++i)
+      values[i] = handles[i].get();
+  }
+
+
+  /** Write values to many handles, values must have one entry per handle */
+  template<typename T>
+  void set_all(std::vector<Signal_handle<T>> const& handles,
+      std::vector<T> const& values) {
+    if( values.size() != handles.size() )
+      throw std::runtime_error("number of values does not match number of "
+          "signal handles");
+
+    for(std::size_t i=0; i<handles.size(); ++i)
+      handles[i].set(values[i]);
+  }
+
+
   /** Inspect module instances in the design
    *
    * Use Simulation_engine::inspect_module() to create an instance of this
@@ -67,6 +131,29 @@ namespace sim {
         std::copy_n(reinterpret_cast<char*>(&val), sizeof(val), this_ptr + ofs);
       }
 
+      /** set value of a member variable in all frames
+       *
+       * Replaces the value as if __init__ had set it. Call after
+       * Simulation_engine::setup() and before simulating, e.g. to override
+       * constants of the design.
+       * */
+      template<typename T>
+      void set_initial(ir::Label const& var_name, T val) {
+        auto it = m_module->objects.find(var_name);
+        if( it == m_module->objects.end() ) {
+          std::stringstream strm;
+          strm << "object '" << var_name << "' requested for introspection"
+            " not found in module '"
+            << m_module->name << "'";
+          throw std::runtime_error(strm.str());
+        }
+
+        auto idx = it->second->impl.struct_index;
+        auto ofs = m_layout->getElementOffset(idx);
+        for(auto frame : {this_in, this_out, this_prev})
+          std::memcpy(frame->data() + ofs, &val, sizeof(val));
+      }
+
       /** get value of member variable by index */
       template<typename T>
       T get(std::size_t idx) {
@@ -79,59 +166,87 @@ namespace sim {
       }
 
 
+      /** true if the member at index idx is an IR object, frames also hold
+       * hidden members like the state of the random number generators */
+      bool has_object(std::size_t idx) const {
+        return (idx < m_objects.size()) && m_objects[idx];
+      }
+
+
       /** return the IR object struct */
       std::shared_ptr<Llvm_object> get_object(std::size_t idx) {
-        auto it = std::find_if(std::begin(m_module->objects),
-            std::end(m_module->objects),
-            [&idx](std::pair<ir::Label,std::shared_ptr<Llvm_object>> x) {
-              return x.second->impl.struct_index == idx;
-            });
-
-        if( it == std::end(m_module->objects) ) {
+        if( (idx >= m_objects.size()) || !m_objects[idx] ) {
           std::stringstream strm;
           strm << "no element with index " << idx << " found in module";
           throw std::runtime_error(strm.str());
         }
 
-        return it->second;
+        return m_objects[idx];
+      }
+
+
+      /** create a handle to access a member variable without lookups */
+      template<typename T>
+      Signal_handle<T> handle(ir::Label const& var_name) {
+        auto it = m_module->objects.find(var_name);
+        if( it == m_module->objects.end() ) {
+          std::stringstream strm;
+          strm << "object '" << var_name << "' requested for introspection"
+            " not found in module '"
+            << m_module->name << "'";
+          throw std::runtime_error(strm.str());
+        }
+
+        auto idx = it->second->impl.struct_index;
+        auto size = m_exe->getDataLayout()->getTypeStoreSize(
+            it->second->type->impl.type);
+        if( sizeof(T) > size ) {
+          std::stringstream strm;
+          strm << "handle type of " << sizeof(T) << " bytes is larger than"
+            " object '" << var_name << "' (" << size << " bytes)";
+          throw std::runtime_error(strm.str());
+        }
+
+        return Signal_handle<T>(this_in,
+            this_out,
+            m_layout->getElementOffset(idx));
       }
 
 
       /** get the bit representation */
       ir::Bitset get_bits(std::size_t idx) {
+        ir::Bitset rv;
+        get_bits(idx, rv);
+        return rv;
+      }
+
+
+      /** get the bit representation into dst, reusing its storage */
+      void get_bits(std::size_t idx, ir::Bitset& dst) {
         llvm::Type* ty = get_object(idx)->type->impl.type;
-        auto lay = m_exe->getDataLayout();
-        auto bit_sz = lay->getTypeSizeInBits(ty);
-        auto alloc_bit_sz = lay->getTypeAllocSizeInBits(ty);
-        auto byte_sz = bit_sz / 8;
+        auto bit_sz = m_exe->getDataLayout()->getTypeSizeInBits(ty);
         auto ofs = m_layout->getElementOffset(idx);
 
-        ir::Bitset rv(alloc_bit_sz);
-        char* ptr = this_in->data() + ofs;
-        for(std::size_t i=0; i<alloc_bit_sz; i++) {
-          auto bit_i = i % 8;
-          rv[i] = (*ptr >> bit_i) & 1;
+        copy_bits(this_in->data() + ofs, bit_sz, dst);
+      }
 
-          if( bit_i == 7 )
-            ++ptr;
-        }
 
-        rv.resize(bit_sz);
+      std::map<ir::Label,ir::Bitset> get_named_element_bits(std::size_t idx) {
+        std::map<ir::Label,ir::Bitset> rv;
+        get_named_element_bits(idx, rv);
         return rv;
       }
 
 
-      std::map<ir::Label,ir::Bitset> get_named_element_bits(std::size_t idx) {
+      /** get the bit representation of all elements by name into dst,
+       * reusing its storage */
+      void get_named_element_bits(std::size_t idx,
+          std::map<ir::Label,ir::Bitset>& dst) {
         auto type = get_object(idx)->type;
         llvm::StructType* ty = static_cast<llvm::StructType*>(type->impl.type);
         auto lay = m_exe->getDataLayout();
-        auto bit_sz = lay->getTypeSizeInBits(ty);
-        auto alloc_bit_sz = lay->getTypeAllocSizeInBits(ty);
-        auto byte_sz = bit_sz / 8;
         auto ofs = m_layout->getElementOffset(idx);
 
-        std::map<ir::Label,ir::Bitset> rv;
-
         if( !ty->isStructTy() )
           throw std::runtime_error("requested variable is not a structure type");
 
@@ -140,25 +255,12 @@ namespace sim {
         for(auto const& it : type->elements) {
           auto el_idx = it.second->impl.struct_index;
           auto el = ty->getElementType(el_idx);
-          auto el_bit_sz = lay->getTypeSizeInBits(el);
-          auto el_alloc_bit_sz = lay->getTypeAllocSizeInBits(el);
-          auto el_byte_sz = bit_sz / 8;
           auto el_ofs = str_lay->getElementOffset(el_idx);
 
-          ir::Bitset elem(alloc_bit_sz);
-          char* ptr = this_in->data() + ofs + el_ofs;
-          for(std::size_t i=0; i<alloc_bit_sz; i++) {
-            auto bit_i = i % 8;
-            elem[i] = (*ptr >> bit_i) & 1;
-
-            if( bit_i == 7 )
-              ++ptr;
-          }
-          elem.resize(el_bit_sz);
-          rv[it.first] = elem;
+          copy_bits(this_in->data() + ofs + el_ofs,
+              lay->getTypeSizeInBits(el),
+              dst[it.first]);
         }
-
-        return rv;
       }
 
 
@@ -178,41 +280,33 @@ namespace sim {
 
 
       std::vector<ir::Bitset> get_element_bits(std::size_t idx) {
+        std::vector<ir::Bitset> rv;
+        get_element_bits(idx, rv);
+        return rv;
+      }
+
+
+      /** get the bit representation of all elements in struct order into
+       * dst, reusing its storage */
+      void get_element_bits(std::size_t idx, std::vector<ir::Bitset>& dst) {
         llvm::StructType* ty = static_cast<llvm::StructType*>(get_object(idx)->type->impl.type);
         auto lay = m_exe->getDataLayout();
-        auto bit_sz = lay->getTypeSizeInBits(ty);
-        auto alloc_bit_sz = lay->getTypeAllocSizeInBits(ty);
-        auto byte_sz = bit_sz / 8;
         auto ofs = m_layout->getElementOffset(idx);
 
-        std::vector<ir::Bitset> rv;
-
         if( !ty->isStructTy() )
           throw std::runtime_error("requested variable is not a structure type");
 
         auto str_lay = lay->getStructLayout(ty);
 
+        dst.resize(ty->getNumElements());
         for(auto it=ty->element_begin(); it != ty->element_end(); ++it) {
           auto el_idx = it - ty->element_begin();
-          auto el_bit_sz = lay->getTypeSizeInBits(*it);
-          auto el_alloc_bit_sz = lay->getTypeAllocSizeInBits(*it);
-          auto el_byte_sz = bit_sz / 8;
           auto el_ofs = str_lay->getElementOffset(el_idx);
 
-          ir::Bitset elem(alloc_bit_sz);
-          char* ptr = this_in->data() + ofs + el_ofs;
-          for(std::size_t i=0; i<alloc_bit_sz; i++) {
-            auto bit_i = i % 8;
-            elem[i] = (*ptr >> bit_i) & 1;
-
-            if( bit_i == 7 )
-              ++ptr;
-          }
-          elem.resize(el_bit_sz);
-          rv.push_back(elem);
+          copy_bits(this_in->data() + ofs + el_ofs,
+              lay->getTypeSizeInBits(*it),
+              dst[el_idx]);
         }
-
-        return rv;
       }
 
 
@@ -233,16 +327,8 @@ namespace sim {
 
       /** get the bit representation of the full module */
       ir::Bitset get_bits() {
-        auto a = reinterpret_cast<ir::Bitset::block_type*>(
-            this_in->data()
-          );
-        auto b = reinterpret_cast<ir::Bitset::block_type*>(
-            this_in->data() + this_in->size() - 1
-          );
-
-        ir::Bitset rv(8 * this_in->size());
-        boost::from_block_range(a, b, rv);
-
+        ir::Bitset rv;
+        copy_bits(this_in->data(), 8 * this_in->size(), rv);
         return rv;
       }
 
@@ -337,14 +423,70 @@ namespace sim {
       }
 
 
+      /** frame holding the current values (this_in) */
+      Runset::Module_frame frame() const { return this_in; }
+
+      /** layout of the module frame */
+      llvm::StructLayout const* layout() const { return m_layout; }
+
+      llvm::DataLayout const* data_layout() const {
+        return m_exe->getDataLayout();
+      }
+
+      /** hierarchical instance path, e.g. top.cpu, set for instrumenters */
+      std::string const& path() const { return m_path; }
+      void path(std::string const& p) { m_path = p; }
+
+      /** mark members for instrumentation by index, all by default */
+      void select(std::vector<bool> const& selected) { m_selected = selected; }
+
+      bool selected(std::size_t idx) const {
+        return m_selected.empty() || m_selected.at(idx);
+      }
+
+      /** inspector of the same module reading and writing another frame */
+      Module_inspector with_frame(Runset::Module_frame frame) const {
+        Module_inspector rv(*this);
+        rv.this_in = frame;
+        rv.this_out = frame;
+        rv.this_prev = frame;
+        return rv;
+      }
+
+
+      /** Copy num_bits bits starting at ptr into dst
+       *
+       * Copies 64 bit blocks and reuses the storage of dst. Frames are in
+       * host byte order, which is assumed to be little endian, so the
+       * first byte holds the least significant bits.
+       * */
+      static void copy_bits(char const* ptr,
+          std::size_t num_bits,
+          ir::Bitset& dst) {
+        typedef ir::Bitset::block_type Block;
+        std::size_t const num_bytes = (num_bits + 7) / 8;
+
+        dst.clear();
+        for(std::size_t i=0; i<num_bytes; i += sizeof(Block)) {
+          Block block = 0;
+          std::memcpy(&block, ptr + i, std::min(sizeof(Block), num_bytes - i));
+          dst.append(block);
+        }
+        dst.resize(num_bits);
+      }
+
+
     private:
       std::shared_ptr<Llvm_module> m_module;
       llvm::StructLayout const* m_layout;
       unsigned m_num_elements;
       llvm::ExecutionEngine* m_exe;
       Runset& m_runset;
-      Runset::Module_frame this_in, this_out;
+      Runset::Module_frame this_in, this_out, this_prev;
       Runset::Read_mask read_mask;
+      std::vector<bool> m_selected;
+      std::string m_path;
+      std::vector<std::shared_ptr<Llvm_object>> m_objects;  /**< by index */
   };
 
 }
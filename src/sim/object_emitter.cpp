@@ -0,0 +1,331 @@
+#include "sim/object_emitter.h"
+
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/ValueMap.h>
+#include <llvm/PassManager.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include "aot/cell_runtime.h"
+
+
+namespace sim {
+
+  namespace {
+
+    /** Module instance in the design hierarchy */
+    struct Instance {
+      std::shared_ptr<Llvm_module> mod;
+      std::string path;
+      std::vector<int64_t> child_offsets;
+      std::vector<int64_t> child_instances;
+    };
+
+
+    class Descriptor_builder {
+      public:
+        Descriptor_builder(llvm::Module& module,
+            llvm::DataLayout const& layout,
+            llvm::ValueToValueMapTy& vmap)
+          : m_module(module),
+            m_layout(layout),
+            m_vmap(vmap),
+            m_context(module.getContext()) {
+          m_i64 = llvm::Type::getInt64Ty(m_context);
+          m_i8_ptr = llvm::Type::getInt8PtrTy(m_context);
+          m_process_ty = llvm::StructType::get(m_context,
+              std::vector<llvm::Type*>{m_i64, m_i64, m_i8_ptr});
+          m_instance_ty = llvm::StructType::get(m_context,
+              std::vector<llvm::Type*>{
+                m_i8_ptr,                       // path
+                m_i64,                          // frame_size
+                m_i64,                          // read_mask_size
+                m_i64,                          // num_elements
+                m_i64->getPointerTo(),          // element_offsets
+                m_i64,                          // num_processes
+                m_process_ty->getPointerTo(),   // processes
+                m_i8_ptr,                       // init
+                m_i64,                          // num_children
+                m_i64->getPointerTo(),          // child_offsets
+                m_i64->getPointerTo(),          // child_instances
+                m_i64                           // rand_state_offset
+              });
+          m_design_ty = llvm::StructType::get(m_context,
+              std::vector<llvm::Type*>{m_i64, m_i64, m_instance_ty->getPointerTo()});
+        }
+
+
+        std::size_t add_instance(std::shared_ptr<Llvm_module> mod,
+            std::string const& path) {
+          auto index = m_instances.size();
+          m_instances.push_back(Instance{mod, path, {}, {}});
+
+          auto struct_layout = m_layout.getStructLayout(mod->impl.mod_type);
+          for(auto const& i : mod->instantiations) {
+            auto obj = mod->objects.at(i.first);
+            auto ofs = struct_layout->getElementOffset(obj->impl.struct_index);
+            auto child_path = path.empty() ? i.first : path + "." + i.first;
+            auto child = add_instance(i.second->module, child_path);
+
+            m_instances[index].child_offsets.push_back(ofs);
+            m_instances[index].child_instances.push_back(child);
+          }
+
+          return index;
+        }
+
+
+        void emit(std::string const& symbol) {
+          std::vector<llvm::Constant*> instances;
+
+          for(auto const& inst : m_instances)
+            instances.push_back(instance_desc(inst));
+
+          auto inst_array = private_array(m_instance_ty, instances, "instances");
+
+          auto design = llvm::ConstantStruct::get(m_design_ty,
+              std::vector<llvm::Constant*>{
+                int64(CELL_DESIGN_VERSION),
+                int64(m_instances.size()),
+                inst_array
+              });
+
+          new llvm::GlobalVariable(m_module,
+              m_design_ty,
+              true,
+              llvm::GlobalValue::ExternalLinkage,
+              design,
+              symbol);
+        }
+
+
+      private:
+        llvm::Module& m_module;
+        llvm::DataLayout const& m_layout;
+        llvm::ValueToValueMapTy& m_vmap;
+        llvm::LLVMContext& m_context;
+        llvm::Type* m_i64;
+        llvm::Type* m_i8_ptr;
+        llvm::StructType* m_process_ty;
+        llvm::StructType* m_instance_ty;
+        llvm::StructType* m_design_ty;
+        std::vector<Instance> m_instances;
+
+
+        llvm::Constant* int64(int64_t v) {
+          return llvm::ConstantInt::get(m_i64, v);
+        }
+
+
+        /** Pointer to a function in the cloned module */
+        llvm::Constant* code(llvm::Function* f) {
+          auto it = m_vmap.find(f);
+          if( it == m_vmap.end() )
+            throw std::runtime_error("function not found in cloned module");
+
+          return llvm::ConstantExpr::getBitCast(
+              llvm::cast<llvm::Function>(it->second), m_i8_ptr);
+        }
+
+
+        /** Private constant array, returns pointer to the first element */
+        llvm::Constant* private_array(llvm::Type* elem_ty,
+            std::vector<llvm::Constant*> const& elems,
+            std::string const& name) {
+          if( elems.empty() )
+            return llvm::ConstantPointerNull::get(elem_ty->getPointerTo());
+
+          auto ty = llvm::ArrayType::get(elem_ty, elems.size());
+          auto gv = new llvm::GlobalVariable(m_module,
+              ty,
+              true,
+              llvm::GlobalValue::PrivateLinkage,
+              llvm::ConstantArray::get(ty, elems),
+              "cell." + name);
+
+          return llvm::ConstantExpr::getBitCast(gv, elem_ty->getPointerTo());
+        }
+
+
+        llvm::Constant* int64_array(std::vector<int64_t> const& values,
+            std::string const& name) {
+          std::vector<llvm::Constant*> elems;
+          for(auto v : values)
+            elems.push_back(int64(v));
+
+          return private_array(m_i64, elems, name);
+        }
+
+
+        llvm::Constant* string(std::string const& s) {
+          auto init = llvm::ConstantDataArray::getString(m_context, s, true);
+          auto gv = new llvm::GlobalVariable(m_module,
+              init->getType(),
+              true,
+              llvm::GlobalValue::PrivateLinkage,
+              init,
+              "cell.path");
+
+          return llvm::ConstantExpr::getBitCast(gv, m_i8_ptr);
+        }
+
+
+        llvm::Constant* process_desc(int64_t kind,
+            int64_t time,
+            llvm::Function* f) {
+          return llvm::ConstantStruct::get(m_process_ty,
+              std::vector<llvm::Constant*>{int64(kind), int64(time), code(f)});
+        }
+
+
+        llvm::Constant* instance_desc(Instance const& inst) {
+          auto mod = inst.mod;
+          auto mod_type = mod->impl.mod_type;
+          auto struct_layout = m_layout.getStructLayout(mod_type);
+
+          // element offsets
+          std::vector<int64_t> offsets;
+          for(unsigned i=0; i<mod_type->getNumElements(); ++i)
+            offsets.push_back(struct_layout->getElementOffset(i));
+
+          // read mask, see Runset::read_mask_size()
+          auto read_mask_ty = llvm::ArrayType::get(
+              llvm::IntegerType::get(m_context, 1),
+              mod_type->getNumElements());
+
+          // processes in the order of Runset::add_module()
+          std::vector<llvm::Constant*> procs;
+          for(auto proc : mod->processes)
+            procs.push_back(process_desc(CELL_PROCESS,
+                  0,
+                  proc->function->impl.code));
+          for(auto proc : mod->periodicals)
+            procs.push_back(process_desc(CELL_PERIODIC,
+                  proc->period.value(ir::Time::ps),
+                  proc->function->impl.code));
+          for(auto proc : mod->onces)
+            procs.push_back(process_desc(CELL_ONCE,
+                  proc->time.value(ir::Time::ps),
+                  proc->function->impl.code));
+          for(auto proc : mod->recurrents)
+            procs.push_back(process_desc(CELL_RECURRENT,
+                  0,
+                  proc->function->impl.code));
+
+          int64_t rand_state_offset = 0;
+          if( mod->impl.rand_index )
+            rand_state_offset = struct_layout->getElementOffset(mod->impl.rand_index);
+
+          llvm::Constant* init = llvm::ConstantPointerNull::get(
+              llvm::cast<llvm::PointerType>(m_i8_ptr));
+          auto init_f = mod->functions.find("__init__");
+          if( init_f != mod->functions.end() )
+            init = code(init_f->second->impl.code);
+
+          return llvm::ConstantStruct::get(m_instance_ty,
+              std::vector<llvm::Constant*>{
+                string(inst.path),
+                int64(m_layout.getTypeAllocSize(mod_type)),
+                int64(m_layout.getTypeAllocSize(read_mask_ty)),
+                int64(offsets.size()),
+                int64_array(offsets, "element_offsets"),
+                int64(procs.size()),
+                private_array(m_process_ty, procs, "processes"),
+                init,
+                int64(inst.child_offsets.size()),
+                int64_array(inst.child_offsets, "child_offsets"),
+                int64_array(inst.child_instances, "child_instances"),
+                int64(rand_state_offset)
+              });
+        }
+    };
+
+  }
+
+
+  std::unique_ptr<llvm::TargetMachine> create_host_target_machine() {
+    using namespace llvm;
+
+    InitializeNativeTarget();
+
+    // set-up target machine for the host
+    auto triple = sys::getProcessTriple();
+    std::string err_str;
+    auto target = TargetRegistry::lookupTarget(triple, err_str);
+    if( !target ) {
+      std::stringstream strm;
+      strm << "Failed to find target '" << triple << "': " << err_str;
+      throw std::runtime_error(strm.str());
+    }
+
+    std::unique_ptr<TargetMachine> machine(target->createTargetMachine(triple,
+          sys::getHostCPUName(),
+          "",
+          TargetOptions(),
+          Reloc::PIC_,
+          CodeModel::Default,
+          CodeGenOpt::Default));
+    if( !machine )
+      throw std::runtime_error("Failed to create target machine");
+
+    return machine;
+  }
+
+
+  void emit_object(std::shared_ptr<Llvm_library> lib,
+      std::shared_ptr<Llvm_module> top,
+      std::string const& filename,
+      std::string const& symbol) {
+    using namespace llvm;
+
+    InitializeNativeTargetAsmPrinter();
+
+    auto machine = create_host_target_machine();
+    auto triple = machine->getTargetTriple();
+    auto layout = machine->getDataLayout();
+
+    // work on a copy, the library module is owned by the execution engine
+    ValueToValueMapTy vmap;
+    std::unique_ptr<Module> module(CloneModule(lib->impl.module.get(), vmap));
+    module->setTargetTriple(triple);
+    module->setDataLayout(layout);
+
+    Descriptor_builder builder(*module, *layout, vmap);
+    builder.add_instance(top, "");
+    builder.emit(symbol);
+
+    // emit object code
+    std::string err_str;
+    raw_fd_ostream out(filename.c_str(), err_str, sys::fs::F_None);
+    if( !err_str.empty() ) {
+      std::stringstream strm;
+      strm << "Failed to open '" << filename << "': " << err_str;
+      throw std::runtime_error(strm.str());
+    }
+
+    formatted_raw_ostream fout(out);
+    PassManager pm;
+    pm.add(new DataLayoutPass(*layout));
+    if( machine->addPassesToEmitFile(pm, fout, TargetMachine::CGFT_ObjectFile) )
+      throw std::runtime_error("Target can not emit object files");
+
+    pm.run(*module);
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
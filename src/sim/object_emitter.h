@@ -0,0 +1,35 @@
+#pragma once
+
+#include "sim/llvm_namespace.h"
+
+#include <string>
+#include <memory>
+#include <llvm/Target/TargetMachine.h>
+
+
+namespace sim {
+
+  /** Create a target machine for the host, its DataLayout matches the JIT */
+  std::unique_ptr<llvm::TargetMachine> create_host_target_machine();
+
+
+  /** Write a design as native object file
+   *
+   * @param lib Compiled library containing the design.
+   * @param top Top level module of the design.
+   * @param filename Name of the object file to write.
+   * @param symbol Name of the design descriptor in the object file.
+   *
+   * The object file contains the code of all functions in the library and a
+   * descriptor of the module hierarchy (struct cell_design_desc, see
+   * aot/cell_runtime.h) exported as symbol. Link it together with the cellrt
+   * runtime library to simulate the design without JIT compilation.
+   * */
+  void emit_object(std::shared_ptr<Llvm_library> lib,
+      std::shared_ptr<Llvm_module> top,
+      std::string const& filename,
+      std::string const& symbol = "cell_design");
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,436 @@
+#include "sim/port_specializer.h"
+
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/PassManager.h>
+#include <llvm/Analysis/Passes.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+
+namespace sim {
+
+  // local helper functions
+  static std::vector<llvm::Function*> process_functions(Llvm_module const& mod);
+  static std::vector<llvm::Function*> written_functions(Llvm_module const& mod);
+  static llvm::Value* frame_root(llvm::Value* v,
+      llvm::DataLayout const& layout,
+      int64_t& offset,
+      bool& exact);
+  static bool is_frame_arg(llvm::Value* v);
+  static void mark_ports(llvm::StructLayout const& sock_layout,
+      unsigned num_ports,
+      int64_t begin,
+      int64_t end,
+      std::set<unsigned>& ports);
+  static void mark_all_ports(unsigned num_ports, std::set<unsigned>& ports);
+
+
+
+  Port_specializer::Port_specializer(llvm::ExecutionEngine* exe,
+      llvm::DataLayout const& layout)
+    : m_exe(exe),
+      m_layout(layout) {
+    m_logger = log4cxx::Logger::getLogger("cell.sim.specialize");
+  }
+
+
+  std::size_t
+  Port_specializer::specialize(Runset& runset) {
+    // values are copied into integer constants byte by byte
+    if( !m_layout.isLittleEndian() ) {
+      LOG4CXX_WARN(m_logger, "port specialization needs a little endian target");
+      return 0;
+    }
+
+    // find the instantiating module of every runset entry, see
+    // Runset::setup_hierarchy()
+    std::map<std::size_t, std::vector<std::tuple<std::size_t, uint64_t>>> parents;
+    for(std::size_t i=0; i<runset.modules.size(); ++i) {
+      auto const& m = runset.modules[i];
+
+      for(auto const& inst : m.mod->instantiations) {
+        auto it = std::find_if(std::begin(runset.modules),
+            std::end(runset.modules),
+            [&inst](Runset::Module const& x) {
+              return x.mod == inst.second->module;
+            });
+        if( it == std::end(runset.modules) )
+          continue;
+
+        auto index = m.mod->objects.at(inst.first)->impl.struct_index;
+        auto ofs = m.layout->getElementOffset(index);
+        parents[it - std::begin(runset.modules)].push_back(std::make_tuple(i, ofs));
+      }
+    }
+
+    std::size_t num_specialized = 0;
+
+    for(auto const& p : parents) {
+      // frames shared by several parents are not specialized
+      if( p.second.size() != 1 )
+        continue;
+
+      auto& child = runset.modules[p.first];
+      auto const& parent = runset.modules[std::get<0>(p.second.front())];
+      auto sock_ty = llvm::cast<llvm::StructType>(child.mod->socket->impl.type);
+      auto sock_layout = m_layout.getStructLayout(sock_ty);
+      auto port_ofs = child.layout->getElementOffset(0);
+      auto num_ports = sock_ty->getNumElements();
+
+      auto dynamic = self_written_ports(*child.mod);
+      auto written = parent_written_ports(*parent.mod,
+          std::get<1>(p.second.front()),
+          *child.mod);
+      dynamic.insert(written.begin(), written.end());
+
+      // take values of constant ports from the frame written in __init__
+      Port_values values;
+      for(unsigned k=0; k<num_ports; ++k) {
+        if( dynamic.count(k) )
+          continue;
+
+        auto begin = child.this_out->begin() + port_ofs
+          + sock_layout->getElementOffset(k);
+        auto size = m_layout.getTypeStoreSize(sock_ty->getElementType(k));
+        values[k] = std::vector<char>(begin, begin + size);
+      }
+
+      if( values.empty() )
+        continue;
+
+      auto const& fmap = variant(*child.mod, values);
+      if( fmap.empty() )
+        continue;
+
+      runset.replace_functions(child, m_exe, fmap);
+      child.variants = fmap;
+      ++num_specialized;
+
+      LOG4CXX_DEBUG(m_logger, "specialized instance of '" << child.mod->name
+          << "' for " << values.size() << " of "
+          << num_ports << " ports");
+    }
+
+    LOG4CXX_INFO(m_logger, "specialized " << num_specialized
+        << " instances using " << m_variants.size() << " variants");
+
+    return num_specialized;
+  }
+
+
+  std::set<unsigned>
+  Port_specializer::self_written_ports(Llvm_module const& mod) const {
+    auto sock_ty = llvm::cast<llvm::StructType>(mod.socket->impl.type);
+    auto sock_layout = m_layout.getStructLayout(sock_ty);
+    auto num_ports = sock_ty->getNumElements();
+    int64_t const port_ofs = m_layout.getStructLayout(mod.impl.mod_type)
+      ->getElementOffset(0);
+    std::set<unsigned> rv;
+
+    for(auto f : written_functions(mod)) {
+      for(auto it=llvm::inst_begin(f); it != llvm::inst_end(f); ++it) {
+        llvm::Value* ptr = nullptr;
+        int64_t size = 0;
+
+        if( auto store = llvm::dyn_cast<llvm::StoreInst>(&*it) ) {
+          ptr = store->getPointerOperand();
+          size = m_layout.getTypeStoreSize(store->getValueOperand()->getType());
+        } else if( auto mem = llvm::dyn_cast<llvm::MemIntrinsic>(&*it) ) {
+          int64_t ofs = 0;
+          bool exact = true;
+          if( is_frame_arg(frame_root(mem->getDest(), m_layout, ofs, exact)) )
+            mark_all_ports(num_ports, rv);
+          continue;
+        } else
+          continue;
+
+        int64_t ofs = 0;
+        bool exact = true;
+        auto root = frame_root(ptr, m_layout, ofs, exact);
+        if( !is_frame_arg(root) )
+          continue;
+
+        if( exact )
+          mark_ports(*sock_layout, num_ports, ofs - port_ofs, ofs - port_ofs + size, rv);
+        else
+          mark_all_ports(num_ports, rv);
+      }
+    }
+
+    return rv;
+  }
+
+
+  std::set<unsigned>
+  Port_specializer::parent_written_ports(Llvm_module const& parent,
+      uint64_t slot_offset,
+      Llvm_module const& child) const {
+    auto sock_ty = llvm::cast<llvm::StructType>(child.socket->impl.type);
+    auto sock_layout = m_layout.getStructLayout(sock_ty);
+    auto num_ports = sock_ty->getNumElements();
+    int64_t const port_ofs = m_layout.getStructLayout(child.impl.mod_type)
+      ->getElementOffset(0);
+    std::set<unsigned> rv;
+
+    // follow all uses of the pointer to the child's frame
+    std::function<void(llvm::Value*)> follow = [&](llvm::Value* v) {
+      for(auto user : v->users()) {
+        if( llvm::isa<llvm::GetElementPtrInst>(user)
+            || llvm::isa<llvm::BitCastInst>(user) ) {
+          follow(user);
+        } else if( llvm::isa<llvm::LoadInst>(user) ) {
+          continue;
+        } else if( auto store = llvm::dyn_cast<llvm::StoreInst>(user) ) {
+          if( store->getValueOperand() == v ) {
+            mark_all_ports(num_ports, rv);
+            continue;
+          }
+
+          int64_t ofs = 0;
+          bool exact = true;
+          frame_root(store->getPointerOperand(), m_layout, ofs, exact);
+          auto size = m_layout.getTypeStoreSize(store->getValueOperand()->getType());
+          if( exact )
+            mark_ports(*sock_layout, num_ports, ofs - port_ofs, ofs - port_ofs + size, rv);
+          else
+            mark_all_ports(num_ports, rv);
+        } else {
+          // pointer escapes
+          mark_all_ports(num_ports, rv);
+        }
+      }
+    };
+
+    for(auto f : written_functions(parent)) {
+      for(auto it=llvm::inst_begin(f); it != llvm::inst_end(f); ++it) {
+        auto load = llvm::dyn_cast<llvm::LoadInst>(&*it);
+        if( !load || !load->getType()->isPointerTy() )
+          continue;
+
+        int64_t ofs = 0;
+        bool exact = true;
+        auto root = frame_root(load->getPointerOperand(), m_layout, ofs, exact);
+        if( !is_frame_arg(root) )
+          continue;
+
+        if( !exact || (static_cast<uint64_t>(ofs) == slot_offset) )
+          follow(load);
+      }
+    }
+
+    return rv;
+  }
+
+
+  Port_specializer::Function_map const&
+  Port_specializer::variant(Llvm_module const& mod,
+      Port_values const& values) {
+    auto key = std::make_tuple(&mod, values);
+    auto it = m_variants.find(key);
+    if( it != m_variants.end() )
+      return it->second;
+
+    Function_map fmap;
+    unsigned num_folded = 0;
+    for(auto f : process_functions(mod)) {
+      if( !fmap.count(f) )
+        fmap[f] = specialize_function(f, mod, values, num_folded);
+    }
+
+    // nothing to gain if no port is read
+    if( num_folded == 0 ) {
+      for(auto const& i : fmap)
+        i.second->eraseFromParent();
+      fmap.clear();
+    } else {
+      LOG4CXX_DEBUG(m_logger, "created variant of '" << mod.name
+          << "' with " << num_folded << " constant port reads");
+    }
+
+    return m_variants.insert(std::make_pair(key, fmap)).first->second;
+  }
+
+
+  llvm::Function*
+  Port_specializer::specialize_function(llvm::Function* f,
+      Llvm_module const& mod,
+      Port_values const& values,
+      unsigned& num_folded) {
+    auto sock_ty = llvm::cast<llvm::StructType>(mod.socket->impl.type);
+    auto sock_layout = m_layout.getStructLayout(sock_ty);
+    int64_t const port_ofs = m_layout.getStructLayout(mod.impl.mod_type)
+      ->getElementOffset(0);
+
+    llvm::ValueToValueMapTy vmap;
+    auto rv = llvm::CloneFunction(f, vmap, false);
+    rv->setName(f->getName() + ".spec");
+    f->getParent()->getFunctionList().push_back(rv);
+
+    // replace port reads from any frame by constants
+    std::vector<llvm::LoadInst*> loads;
+    for(auto it=llvm::inst_begin(rv); it != llvm::inst_end(rv); ++it) {
+      if( auto load = llvm::dyn_cast<llvm::LoadInst>(&*it) )
+        loads.push_back(load);
+    }
+
+    for(auto load : loads) {
+      int64_t ofs = 0;
+      bool exact = true;
+      auto root = frame_root(load->getPointerOperand(), m_layout, ofs, exact);
+      if( !exact || !is_frame_arg(root) )
+        continue;
+
+      auto ty = load->getType();
+      int64_t const size = m_layout.getTypeStoreSize(ty);
+      int64_t const begin = ofs - port_ofs;
+      if( (begin < 0)
+          || (static_cast<uint64_t>(begin) >= sock_layout->getSizeInBytes()) )
+        continue;
+
+      auto k = sock_layout->getElementContainingOffset(begin);
+      auto value = values.find(k);
+      if( value == values.end() )
+        continue;
+
+      int64_t const rel = begin - sock_layout->getElementOffset(k);
+      if( rel + size > static_cast<int64_t>(value->second.size()) )
+        continue;
+
+      llvm::Constant* cnst = nullptr;
+      if( ty->isIntegerTy() && (size <= 8) ) {
+        uint64_t v = 0;
+        std::memcpy(&v, value->second.data() + rel, size);
+        cnst = llvm::ConstantInt::get(ty, v);
+      } else if( ty->isDoubleTy() ) {
+        double v;
+        std::memcpy(&v, value->second.data() + rel, sizeof(v));
+        cnst = llvm::ConstantFP::get(ty, v);
+      }
+
+      if( !cnst )
+        continue;
+
+      load->replaceAllUsesWith(cnst);
+      load->eraseFromParent();
+      ++num_folded;
+    }
+
+    // fold constants through the process code
+    llvm::FunctionPassManager fpm(f->getParent());
+    fpm.add(new llvm::DataLayoutPass(m_layout));
+    fpm.add(llvm::createBasicAliasAnalysisPass());
+    fpm.add(llvm::createInstructionCombiningPass());
+    fpm.add(llvm::createGVNPass());
+    fpm.add(llvm::createCFGSimplificationPass());
+    fpm.add(llvm::createConstantPropagationPass());
+    fpm.add(llvm::createDeadInstEliminationPass());
+    fpm.doInitialization();
+    fpm.run(*rv);
+    fpm.doFinalization();
+
+    return rv;
+  }
+
+
+
+  //--------------------------------------------------------------------------
+  // local helper functions
+  //--------------------------------------------------------------------------
+
+  /** Process functions in the order used by Runset::add_module() */
+  static std::vector<llvm::Function*> process_functions(Llvm_module const& mod) {
+    std::vector<llvm::Function*> rv;
+
+    for(auto proc : mod.processes)
+      rv.push_back(proc->function->impl.code);
+    for(auto proc : mod.periodicals)
+      rv.push_back(proc->function->impl.code);
+    for(auto proc : mod.onces)
+      rv.push_back(proc->function->impl.code);
+    for(auto proc : mod.recurrents)
+      rv.push_back(proc->function->impl.code);
+
+    return rv;
+  }
+
+
+  /** Functions of a module that may write frames after __init__ */
+  static std::vector<llvm::Function*> written_functions(Llvm_module const& mod) {
+    auto rv = process_functions(mod);
+
+    for(auto const& f : mod.functions) {
+      if( f.second->within_module && (f.first != "__init__") )
+        rv.push_back(f.second->impl.code);
+    }
+
+    return rv;
+  }
+
+
+  /** Find the value a pointer is derived from
+   *
+   * Accumulates the constant byte offset into offset. exact is cleared if
+   * the pointer is computed using non-constant indices.
+   * */
+  static llvm::Value* frame_root(llvm::Value* v,
+      llvm::DataLayout const& layout,
+      int64_t& offset,
+      bool& exact) {
+    while( true ) {
+      llvm::APInt ofs(layout.getPointerSizeInBits(), 0);
+      v = v->stripAndAccumulateInBoundsConstantOffsets(layout, ofs);
+      offset += ofs.getSExtValue();
+
+      if( auto gep = llvm::dyn_cast<llvm::GEPOperator>(v) ) {
+        exact = false;
+        v = gep->getPointerOperand();
+      } else if( auto cast = llvm::dyn_cast<llvm::BitCastOperator>(v) ) {
+        v = cast->getOperand(0);
+      } else
+        return v;
+    }
+  }
+
+
+  /** Arguments this_out, this_in, this_prev of module functions */
+  static bool is_frame_arg(llvm::Value* v) {
+    auto arg = llvm::dyn_cast<llvm::Argument>(v);
+    return arg && (arg->getArgNo() < 3);
+  }
+
+
+  static void mark_ports(llvm::StructLayout const& sock_layout,
+      unsigned num_ports,
+      int64_t begin,
+      int64_t end,
+      std::set<unsigned>& ports) {
+    int64_t const sock_size = sock_layout.getSizeInBytes();
+    if( (end <= 0) || (begin >= sock_size) )
+      return;
+
+    begin = std::max<int64_t>(begin, 0);
+    end = std::min<int64_t>(end, sock_size);
+
+    auto first = sock_layout.getElementContainingOffset(begin);
+    auto last = sock_layout.getElementContainingOffset(end - 1);
+    for(auto k=first; (k <= last) && (k < num_ports); ++k)
+      ports.insert(k);
+  }
+
+
+  static void mark_all_ports(unsigned num_ports, std::set<unsigned>& ports) {
+    for(unsigned k=0; k<num_ports; ++k)
+      ports.insert(k);
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+#include <memory>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <log4cxx/logger.h>
+
+#include "sim/runset.h"
+#include "sim/llvm_namespace.h"
+
+
+namespace sim {
+
+  /** Specialize process code of module instances for constant ports
+   *
+   * An input port of an instance is constant if neither the instantiating
+   * module nor the instance itself writes it outside of __init__. The values
+   * of these ports are taken from the module frames after __init__ was
+   * called and substituted into copies of the module's process functions,
+   * which are then optimized. Instances with the same module and the same
+   * constant port values share their specialized code.
+   *
+   * Ports written by drivers or through a Module_inspector are not detected,
+   * so specialization must be requested explicitly.
+   * */
+  class Port_specializer {
+    public:
+      Port_specializer(llvm::ExecutionEngine* exe,
+          llvm::DataLayout const& layout);
+
+      /** Specialize all instances in runset
+       *
+       * @return Number of instances now using specialized code
+       * */
+      std::size_t specialize(Runset& runset);
+
+      /** Number of distinct specialized variants created */
+      std::size_t num_variants() const { return m_variants.size(); }
+
+
+    private:
+      /** Constant values by socket element index */
+      typedef std::map<unsigned, std::vector<char>> Port_values;
+      typedef std::tuple<Llvm_module const*, Port_values> Variant_key;
+      typedef std::map<llvm::Function*, llvm::Function*> Function_map;
+
+      llvm::ExecutionEngine* m_exe;
+      llvm::DataLayout const& m_layout;
+      std::map<Variant_key, Function_map> m_variants;
+      log4cxx::LoggerPtr m_logger;
+
+
+      std::set<unsigned> self_written_ports(Llvm_module const& mod) const;
+      std::set<unsigned> parent_written_ports(Llvm_module const& parent,
+          uint64_t slot_offset,
+          Llvm_module const& child) const;
+      Function_map const& variant(Llvm_module const& mod,
+          Port_values const& values);
+      llvm::Function* specialize_function(llvm::Function* f,
+          Llvm_module const& mod,
+          Port_values const& values,
+          unsigned& num_folded);
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,79 @@
+#include "print_log.h"
+
+#include "ir/time.h"
+
+
+namespace sim {
+
+  Print_log::Print_log(std::ostream& os)
+    : m_os(&os) {
+    m_records.reserve(m_capacity);
+  }
+
+
+  Print_log::~Print_log() {
+    drain();
+  }
+
+
+  void
+  Print_log::output(std::ostream& os) {
+    drain();
+    m_os = &os;
+  }
+
+
+  void
+  Print_log::capacity(std::size_t n) {
+    m_capacity = n;
+    m_records.reserve(n);
+  }
+
+
+  void
+  Print_log::print(char const* msg) {
+    append(Kind::text, msg);
+  }
+
+
+  void
+  Print_log::print(char const* msg, int64_t value) {
+    append(Kind::int_value, msg);
+    m_records.back().value.i = value;
+  }
+
+
+  void
+  Print_log::print(char const* msg, double value) {
+    append(Kind::float_value, msg);
+    m_records.back().value.f = value;
+  }
+
+
+  void
+  Print_log::drain() {
+    if( m_records.empty() )
+      return;
+
+    auto& os = *m_os;
+    for(auto const& r : m_records) {
+      os << '[' << ir::Time(r.time, ir::Time::ps) << "] ";
+      if( (r.instance < m_paths.size()) && !m_paths[r.instance].empty() )
+        os << m_paths[r.instance] << ": ";
+      os << r.msg;
+
+      switch( r.kind ) {
+        case Kind::int_value: os << r.value.i; break;
+        case Kind::float_value: os << r.value.f; break;
+        case Kind::text: break;
+      }
+      os << '\n';
+    }
+
+    os.flush();
+    m_records.clear();
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace sim {
+
+  /** Buffered output of the builtin print functions
+   *
+   * Process code only appends fixed size records holding the message, an
+   * optional int or float value, the simulation time and the instance
+   * running. Records are formatted as
+   *
+   *   [<time>] <instance path>: <message><value>
+   *
+   * and written when the log is drained, which the engine does at the end
+   * of a step once capacity() records are buffered and at the end of
+   * simulate(). Messages are not copied, they must be string constants of
+   * the generated code.
+   * */
+  class Print_log {
+    public:
+      static std::size_t const default_capacity = 4096;
+
+
+      explicit Print_log(std::ostream& os = std::cout);
+
+      /** Drains the log */
+      ~Print_log();
+
+      Print_log(Print_log const&) = delete;
+      Print_log& operator = (Print_log const&) = delete;
+
+
+      /** Stream the records are written to, drains the log first */
+      void output(std::ostream& os);
+
+      /** Paths of the instances, indexed like Runset::modules */
+      void paths(std::vector<std::string> paths) { m_paths = std::move(paths); }
+
+      /** Number of records buffered before full() */
+      std::size_t capacity() const { return m_capacity; }
+      void capacity(std::size_t n);
+
+      /** Time in picoseconds of the following records */
+      void time(int64_t t) { m_time = t; }
+
+      /** Instance of the following records, index into paths() */
+      void instance(std::size_t i) { m_instance = i; }
+
+
+      void print(char const* msg);
+      void print(char const* msg, int64_t value);
+      void print(char const* msg, double value);
+
+      /** Number of buffered records */
+      std::size_t size() const { return m_records.size(); }
+
+      bool full() const { return m_records.size() >= m_capacity; }
+
+      /** Format and write all buffered records and flush the stream */
+      void drain();
+
+
+    private:
+      enum class Kind : uint32_t { text, int_value, float_value };
+
+      struct Record {
+        int64_t time;
+        uint32_t instance;
+        Kind kind;
+        char const* msg;
+        union {
+          int64_t i;
+          double f;
+        } value;
+      };
+
+      std::ostream* m_os;
+      std::vector<std::string> m_paths;
+      std::vector<Record> m_records;
+      std::size_t m_capacity = default_capacity;
+      int64_t m_time = 0;
+      std::size_t m_instance = 0;
+
+      void append(Kind kind, char const* msg) {
+        Record r;
+        r.time = m_time;
+        r.instance = static_cast<uint32_t>(m_instance);
+        r.kind = kind;
+        r.msg = msg;
+        r.value.i = 0;
+        m_records.push_back(r);
+      }
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -1,6 +1,9 @@
 #include "sim/runset.h"
+#include "sim/print_log.h"
+#include "sim/runtime.h"
 
 #include <iostream>
+#include <sstream>
 
 namespace sim {
 
@@ -9,6 +12,8 @@ namespace sim {
       std::shared_ptr<Llvm_module> mod) {
     Module rv;
     rv.mod = mod;
+    rv.code = mod;
+    rv.exe = exe;
     rv.this_in = allocate_module_frame(mod);
     std::fill(rv.this_in->begin(), rv.this_in->end(), 0);
     rv.this_out = allocate_module_frame(mod);
@@ -108,9 +113,13 @@ namespace sim {
 
   void
   Runset::call_init(llvm::ExecutionEngine* exe) {
-    for(auto& m : modules) {
+    for(std::size_t i=0; i<modules.size(); ++i) {
+      auto& m = modules[i];
       auto mod = m.mod;
 
+      if( auto log = print_log() )
+        log->instance(i);
+
       // call __init__ if it exists
       auto init_f = mod->functions.find("__init__");
       if( init_f != mod->functions.end() ) {
@@ -143,6 +152,104 @@ namespace sim {
   }
 
 
+  void
+  Runset::replace_processes(Module& m,
+      llvm::ExecutionEngine* exe,
+      std::shared_ptr<Llvm_module> mod) {
+    std::map<llvm::Function*, llvm::Function*> replace;
+
+    auto match = [&replace](llvm::Function* a, llvm::Function* b) {
+      replace[a] = b;
+    };
+
+    auto check_count = [&mod](std::size_t a, std::size_t b, char const* kind) {
+      if( a != b ) {
+        std::stringstream strm;
+        strm << "Number of " << kind << " in module '"
+          << mod->name << "' changed, can not replace code";
+        throw std::runtime_error(strm.str());
+      }
+    };
+
+    // the processes run the functions of m.code, not necessarily of m.mod
+    auto const& cur = *(m.code);
+    check_count(cur.processes.size(), mod->processes.size(), "processes");
+    check_count(cur.periodicals.size(), mod->periodicals.size(), "periodic processes");
+    check_count(cur.onces.size(), mod->onces.size(), "once processes");
+    check_count(cur.recurrents.size(), mod->recurrents.size(), "recurrent processes");
+
+    for(std::size_t i=0; i<mod->processes.size(); ++i)
+      match(cur.processes[i]->function->impl.code,
+          mod->processes[i]->function->impl.code);
+    for(std::size_t i=0; i<mod->periodicals.size(); ++i)
+      match(cur.periodicals[i]->function->impl.code,
+          mod->periodicals[i]->function->impl.code);
+    for(std::size_t i=0; i<mod->onces.size(); ++i)
+      match(cur.onces[i]->function->impl.code,
+          mod->onces[i]->function->impl.code);
+    for(std::size_t i=0; i<mod->recurrents.size(); ++i)
+      match(cur.recurrents[i]->function->impl.code,
+          mod->recurrents[i]->function->impl.code);
+
+    // specialized variants fall back to the new generic code
+    for(auto const& v : m.variants) {
+      auto it = replace.find(v.first);
+      if( it != replace.end() )
+        replace[v.second] = it->second;
+    }
+    m.variants.clear();
+
+    replace_functions(m, exe, replace);
+    m.code = mod;
+    m.exe = exe;
+  }
+
+
+  void
+  Runset::replace_functions(Module& m,
+      llvm::ExecutionEngine* exe,
+      std::map<llvm::Function*, llvm::Function*> const& replace) {
+    std::map<llvm::Function*, void*> exe_ptrs;
+    auto convert = [&](Process const& p) -> Process {
+      auto it = replace.find(p.function);
+      if( it == replace.end() )
+        return p;
+
+      Process rv = p;
+      rv.function = it->second;
+      auto ptr = exe_ptrs.find(rv.function);
+      if( ptr == exe_ptrs.end() )
+        ptr = exe_ptrs.insert(std::make_pair(rv.function,
+              exe->getPointerToFunction(rv.function))).first;
+      rv.exe_ptr = ptr->second;
+      return rv;
+    };
+
+    auto convert_set = [&convert](Process_set const& set) -> Process_set {
+      Process_set rv;
+      for(auto const& p : set)
+        rv.insert(convert(p));
+      return rv;
+    };
+
+    for(auto& p : m.processes)
+      p = convert(p);
+    for(auto& p : m.periodicals)
+      p.second = convert(p.second);
+    for(auto& s : m.sensitivity)
+      s = convert_set(s);
+    m.run_list = convert_set(m.run_list);
+    for(auto& p : m.schedule)
+      std::get<1>(p.second) = convert(std::get<1>(p.second));
+    for(auto& p : m.recurrent_schedule)
+      p.second = convert(p.second);
+
+    // re-evaluate sensitive processes with the new code
+    for(auto const& p : m.processes)
+      m.run_list.insert(p);
+  }
+
+
   Runset::Module_frame
   Runset::allocate_module_frame(std::shared_ptr<Llvm_module> mod) {
     //auto mod_sz = m_layout->getTypeAllocSize(mod->impl.mod_type);
@@ -5,6 +5,7 @@
 #include <vector>
 #include <unordered_set>
 #include <map>
+#include <stdexcept>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 
 #include "sim/llvm_namespace.h"
@@ -54,6 +55,11 @@ namespace sim {
       /** Internal data structure for module runtime data */
       struct Module {
         std::shared_ptr<Llvm_module> mod;
+        /** Module the process functions belong to, an earlier version of
+         * mod if its code was kept by Simulation_engine::reload() */
+        std::shared_ptr<Llvm_module> code;
+        /** Execution engine the process functions were compiled by */
+        llvm::ExecutionEngine* exe = nullptr;
         Module_frame this_in;
         Module_frame this_out;
         Module_frame this_prev;
@@ -66,6 +72,8 @@ namespace sim {
         Process_schedule schedule;
         Time_process_map recurrent_schedule;
         Driver_list drivers;  /**< List of driver/observer callbacks */
+        /** Specialized code used instead of the module's process functions */
+        std::map<llvm::Function*, llvm::Function*> variants;
       };
 
       typedef std::vector<Module> Module_list;
@@ -81,6 +89,27 @@ namespace sim {
       void setup_hierarchy();
       void call_init(llvm::ExecutionEngine* exe);
 
+      /** Replace the processes of a module by the ones of another module
+       *
+       * Processes are matched by their position in the module definition.
+       * Schedules and sensitivities are kept, all sensitive processes are
+       * scheduled to run in the next cycle. Afterwards m.code is mod and
+       * m.exe is exe.
+       * */
+      void replace_processes(Module& m,
+          llvm::ExecutionEngine* exe,
+          std::shared_ptr<Llvm_module> mod);
+
+      /** Replace process functions of a module
+       *
+       * @param replace Map from the current to the new function.
+       *
+       * Processes with functions not in replace are kept.
+       * */
+      void replace_functions(Module& m,
+          llvm::ExecutionEngine* exe,
+          std::map<llvm::Function*, llvm::Function*> const& replace);
+
 
       Module_frame allocate_module_frame(std::shared_ptr<Llvm_module> mod);
       Read_mask allocate_read_mask(std::shared_ptr<Llvm_module> mod);
@@ -91,7 +120,7 @@ namespace sim {
 
       std::size_t read_mask_size(std::shared_ptr<Llvm_module> mod) const {
         auto read_mask_ty = llvm::ArrayType::get(
-            llvm::IntegerType::get(llvm::getGlobalContext(), 1),
+            llvm::IntegerType::get(mod->impl.mod_type->getContext(), 1),
             mod->impl.mod_type->getNumElements()
           );
         return m_layout->getTypeAllocSize(read_mask_ty);
@@ -1,7 +1,109 @@
 #include "runtime.h"
+#include "print_log.h"
+#include <cmath>
 #include <iostream>
 
+// per thread, engines swap in their own state while they simulate
+static thread_local uint64_t rand_x = initial_rand_state;
+static thread_local sim::Print_log* log_current = nullptr;
+
+static uint64_t rand_next() {
+	rand_x += rand_increment;
+	return cell_rand_mix(rand_x);
+}
+
+/** Uniform in (0, 1), safe to take the logarithm of */
+static double rand_open() {
+	return (rand_next() >> 11) * rand_float_scale + 0.5 * rand_float_scale;
+}
+
 int print(char* msg) {
-	std::cout << msg << std::endl;
+	if( log_current )
+		log_current->print(msg);
+	else
+		std::cout << msg << '\n';
 	return 0;
 }
+
+int cell_print_int(char* msg, int64_t value) {
+	if( log_current )
+		log_current->print(msg, value);
+	else
+		std::cout << msg << value << '\n';
+	return 0;
+}
+
+int cell_print_float(char* msg, double value) {
+	if( log_current )
+		log_current->print(msg, value);
+	else
+		std::cout << msg << value << '\n';
+	return 0;
+}
+
+sim::Print_log* print_log() {
+	return log_current;
+}
+
+void print_log(sim::Print_log* log) {
+	log_current = log;
+}
+
+int64_t cell_rand() {
+	return rand_next() >> 33;
+}
+
+int64_t cell_rand_int(int64_t lo, int64_t hi) {
+	uint64_t n = (hi > lo) ? uint64_t(hi) - uint64_t(lo) : 0;
+	auto r = static_cast<uint64_t>((static_cast<unsigned __int128>(rand_next()) * n) >> 64);
+	return int64_t(uint64_t(lo) + r);
+}
+
+double cell_rand_float() {
+	return (rand_next() >> 11) * rand_float_scale;
+}
+
+double cell_rand_normal(double mean, double sd) {
+	auto u1 = rand_open();
+	auto u2 = cell_rand_float();
+	return mean + sd * std::sqrt(-2.0 * std::log(u1)) * std::cos(rand_two_pi * u2);
+}
+
+int64_t cell_rand_poisson(double lambda) {
+	// Knuth's multiplication method, the running product is scaled up in
+	// steps so that large lambda do not underflow exp(-lambda)
+	int64_t k = 0;
+	double p = 1.0;
+	double left = lambda;
+
+	do {
+		++k;
+		p *= rand_open();
+		while( (p < 1.0) && (left > 0.0) ) {
+			auto step = (left > rand_poisson_step) ? rand_poisson_step : left;
+			p *= std::exp(step);
+			left -= step;
+		}
+	} while( p > 1.0 );
+
+	return k - 1;
+}
+
+uint64_t cell_rand_stream(uint64_t seed, char const* path) {
+	// FNV-1a of the path, mixed so that similar paths give unrelated streams
+	uint64_t h = 0xcbf29ce484222325ull;
+	for(auto p=path; *p; ++p) {
+		h ^= static_cast<unsigned char>(*p);
+		h *= 0x100000001b3ull;
+	}
+
+	return cell_rand_mix(cell_rand_mix(seed) ^ h);
+}
+
+uint64_t rand_state() {
+	return rand_x;
+}
+
+void rand_state(uint64_t state) {
+	rand_x = state;
+}
@@ -1,4 +1,100 @@
 #pragma once
 
+#include <cstdint>
+
+namespace sim {
+  class Print_log;
+}
+
+/** @name Builtin print functions
+ *
+ * Messages are appended to the log of the engine simulating on the calling
+ * thread, see sim::Print_log, or written to std::cout if there is none.
+ * */
+///@{
+
+/** Builtin print(msg) */
 extern "C"
 int print(char* msg);
+
+/** Builtin print(msg, value) of an int, msg is followed by the value */
+extern "C"
+int cell_print_int(char* msg, int64_t value);
+
+/** Builtin print(msg, value) of a float */
+extern "C"
+int cell_print_float(char* msg, double value);
+
+/** Log of the engine simulating on the calling thread, nullptr if none */
+sim::Print_log* print_log();
+void print_log(sim::Print_log* log);
+
+///@}
+
+/** @name Random number generators
+ *
+ * Streams are splitmix64 counters: every draw adds rand_increment to the
+ * 64 bit state and mixes the result with cell_rand_mix(). Module instances
+ * calling the builtins own a stream in their frame whose draws are inlined
+ * into the generated code, see sim/llvm_rand.h. The functions below draw
+ * from the engine's stream on the calling thread and are used by functions
+ * outside of modules.
+ * */
+///@{
+
+/** Builtin rand(), returns values in [0, 2^31) like the C library's rand() */
+extern "C"
+int64_t cell_rand();
+
+/** Builtin rand_int(lo, hi), uniform in [lo, hi), lo if hi <= lo */
+extern "C"
+int64_t cell_rand_int(int64_t lo, int64_t hi);
+
+/** Builtin rand_float(), uniform in [0, 1) */
+extern "C"
+double cell_rand_float();
+
+/** Builtin rand_normal(mean, sd), Box-Muller transform */
+extern "C"
+double cell_rand_normal(double mean, double sd);
+
+/** Builtin rand_poisson(lambda), number of events with mean lambda */
+extern "C"
+int64_t cell_rand_poisson(double lambda);
+
+/** Initial state of the stream of a module instance
+ *
+ * @param seed Seed of the simulation
+ * @param path Hierarchical path of the instance, "" for the top level
+ *   module
+ * */
+extern "C"
+uint64_t cell_rand_stream(uint64_t seed, char const* path);
+
+///@}
+
+static uint64_t const rand_increment = 0x9e3779b97f4a7c15ull;
+static uint64_t const rand_mix_mul1 = 0xbf58476d1ce4e5b9ull;
+static uint64_t const rand_mix_mul2 = 0x94d049bb133111ebull;
+
+/** 2^-53, scales 53 random bits to [0, 1) */
+static double const rand_float_scale = 1.0 / 9007199254740992.0;
+
+static double const rand_two_pi = 6.283185307179586;
+
+/** Rate consumed per refill of the running product in rand_poisson(),
+ * exp(rand_poisson_step) must not overflow */
+static double const rand_poisson_step = 500.0;
+
+inline uint64_t cell_rand_mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * rand_mix_mul1;
+  z = (z ^ (z >> 27)) * rand_mix_mul2;
+  return z ^ (z >> 31);
+}
+
+/** Seed of the engine's stream if none is given */
+static uint64_t const initial_rand_state = 0x853c49e6748fea9bull;
+
+/** State of the engine's stream on the calling thread, saved in checkpoints */
+uint64_t rand_state();
+void rand_state(uint64_t state);
@@ -1,28 +1,50 @@
 #include "sim/simulation_engine.h"
 
 #include <iomanip>
+#include <chrono>
+#include <fstream>
 #include <algorithm>
 #include <iterator>
 #include <list>
+#include <cmath>
 #include <cstdlib>
+#include <regex>
+#include <set>
+#include <mutex>
 #include <llvm/ExecutionEngine/JIT.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/IR/Instructions.h>
 //#include <llvm/Assembly/PrintModulePass.h>
 #include <llvm/Analysis/Passes.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Support/raw_os_ostream.h>
 #include <boost/filesystem.hpp>
 
-#include "parse_driver.h"
+#include "parallel_parse.h"
 #include "sim/llvm_namespace_scanner.h"
 #include "ast/ast_printer.h"
 #include "sim/llvm_builtins.h"
 #include "ir/find_hierarchy.h"
 #include "sim/runtime.h"
+#include "sim/object_emitter.h"
+#include "sim/port_specializer.h"
+#include "sim/compile.h"
+#include "sim/checkpoint.h"
 
 namespace sim {
 
+  // local helper functions
+  static void check_frame_layout(Llvm_module const& a,
+      Llvm_module const& b,
+      llvm::DataLayout const& layout);
+  static std::string code_fingerprint(Llvm_module const& mod);
+  static std::size_t file_hash(std::string const& filename);
+  static void print_with_callees(llvm::Function const* f,
+      std::set<llvm::Function const*>& printed,
+      llvm::raw_ostream& os);
+  static void* math_function(std::string const& name);
+
 
 
   Simulation_engine::Simulation_engine(std::string const& filename,
@@ -40,8 +62,11 @@ namespace sim {
 
   Simulation_engine::Simulation_engine(std::string const& filename,
       std::string const& toplevel,
-      std::vector<std::string> const& lookup_path) {
-    init(filename, lookup_path);
+      std::vector<std::string> const& lookup_path,
+      unsigned jobs,
+      Frame_layout_options const& frame_layout)
+    : m_frame_layout(frame_layout) {
+    init(filename, lookup_path, jobs);
     set_toplevel(toplevel);
 
     LOG4CXX_INFO(m_logger, "initialized simulation using file '"
@@ -62,8 +87,11 @@ namespace sim {
 
 
   Simulation_engine::Simulation_engine(std::string const& filename,
-      std::vector<std::string> const& lookup_path) {
-    init(filename, lookup_path);
+      std::vector<std::string> const& lookup_path,
+      unsigned jobs,
+      Frame_layout_options const& frame_layout)
+    : m_frame_layout(frame_layout) {
+    init(filename, lookup_path, jobs);
 
     LOG4CXX_INFO(m_logger, "initialized simulation using file '"
         << filename
@@ -71,78 +99,95 @@ namespace sim {
   }
 
 
-  Simulation_engine::~Simulation_engine() {
-    teardown();
-  }
+  Simulation_engine::Simulation_engine(Simulation_engine& design,
+      std::string const& toplevel)
+    : m_context(design.m_context),
+      m_exe(design.m_exe),
+      m_layout(design.m_layout),
+      m_lib(design.m_lib),
+      m_filename(design.m_filename),
+      m_lookup_path(design.m_lookup_path),
+      m_jobs(design.m_jobs),
+      m_frame_layout(design.m_frame_layout),
+      m_instance(true) {
+    m_logger = log4cxx::Logger::getLogger("cell.sim");
+    m_runset.layout(m_layout);
+    m_time.v = 0;
+    m_time.magnitude = ir::Time::ps;
 
+    if( design.m_reloaded )
+      throw std::runtime_error("Can not share a design that was reloaded");
 
-  void
-  Simulation_engine::init(std::string const& filename,
-      std::vector<std::string> const& lookup_path) {
-    using namespace llvm;
-    using namespace std;
-    namespace bf = boost::filesystem;
+    set_toplevel(toplevel.empty() ? design.m_toplevel : toplevel);
+    compile_all();
 
-    m_logger = log4cxx::Logger::getLogger("cell.sim");
+    LOG4CXX_INFO(m_logger, "initialized simulation sharing the design of file '"
+        << m_filename
+        << "' with top module '"
+        << m_toplevel
+        << "'");
+  }
 
-    Parse_driver driver;
-    if( driver.parse(filename) )
-      throw std::runtime_error("parse failed");
 
-    m_lib = std::make_shared<ir::Library<sim::Llvm_impl>>();
+  Simulation_engine::~Simulation_engine() {
+    teardown();
 
-    m_lib->name = "main";
-    m_lib->ns = std::make_shared<sim::Llvm_namespace>();
-    m_lib->ns->enclosing_library = m_lib;
-    m_lib->impl = sim::create_library_impl(m_lib->name);
+    // nothing runs the code replaced by reload() anymore
+    for(auto const& r : m_retired) {
+      r.exe->removeModule(r.lib->impl.module.get());
+      delete r.exe;
+    }
+  }
 
-    // set-up lookup path
-    bf::path file_path(filename);
-    m_lib->lookup_path.push_back(file_path.parent_path().string());
-    std::copy(lookup_path.begin(),
-        lookup_path.end(),
-        std::back_inserter(m_lib->lookup_path));
 
+  Simulation_engine::Scope::Scope(Simulation_engine& engine)
+    : m_engine(engine),
+      m_context(engine.m_context->llvm),
+      m_builtins(engine.m_context->builtins) {
+    if( m_engine.m_scope_depth++ == 0 ) {
+      m_prev_rand = rand_state();
+      rand_state(m_engine.m_rand_state);
+      m_prev_log = ::print_log();
+      ::print_log(&m_engine.m_print_log);
+    }
+  }
 
-    // LLVM initialization
-    llvm::InitializeNativeTarget();
 
-    // init builtins
-    init_builtins(m_lib);
+  Simulation_engine::Scope::~Scope() {
+    if( --m_engine.m_scope_depth == 0 ) {
+      m_engine.m_rand_state = rand_state();
+      rand_state(m_prev_rand);
+      ::print_log(m_prev_log);
+    }
+  }
 
-    // print AST
-    std::stringstream strm_ast;
-    ast::Ast_printer printer(strm_ast);
-    driver.ast_root().accept(printer);
-    LOG4CXX_DEBUG(m_logger, strm_ast.str());
 
-    // generate code
-    sim::Llvm_namespace_scanner scanner(*(m_lib->ns));
-    driver.ast_root().accept(scanner);
+  void
+  Simulation_engine::init(std::string const& filename,
+      std::vector<std::string> const& lookup_path,
+      unsigned jobs) {
+    m_logger = log4cxx::Logger::getLogger("cell.sim");
 
-    //verifyModule(*(m_lib->impl.module));
+    m_filename = filename;
+    m_lookup_path = lookup_path;
+    m_jobs = jobs;
 
-    // create JIT execution engine
-    EngineBuilder exe_bld(m_lib->impl.module.get());
-    string err_str;
-    exe_bld.setErrorStr(&err_str);
-    exe_bld.setEngineKind(EngineKind::JIT);
+    // LLVM initialization
+    static std::once_flag llvm_initialized;
+    std::call_once(llvm_initialized, []() { llvm::InitializeNativeTarget(); });
 
-    m_exe = exe_bld.create();
-    if( !m_exe ) {
-      stringstream strm;
-      strm << "Failed to create execution engine!: " << err_str;
-      throw std::runtime_error(strm.str());
-    }
-    // no lookup using dlsym
-    m_exe->DisableSymbolSearching(true);
+    // code, types and builtins of this engine live in its own context
+    m_context = std::make_shared<Engine_context>();
+    Scope scope(*this);
 
+    m_lib = compile(true);
+    m_exe = create_execution_engine(m_lib);
 
     m_layout = m_exe->getDataLayout();
     m_runset.layout(m_layout);
 
     // optimize
-    optimize();
+    optimize(*(m_lib->impl.module));
 
     // show generated code
     std::stringstream strm_ir;
@@ -157,6 +202,41 @@ namespace sim {
     m_time.v = 0;
     m_time.magnitude = ir::Time::ps;
 
+    record_source_times();
+  }
+
+
+  std::shared_ptr<sim::Llvm_library>
+  Simulation_engine::compile(bool init_builtin_types) {
+    return compile_file(m_filename,
+        m_lookup_path,
+        m_jobs,
+        m_frame_layout,
+        init_builtin_types);
+  }
+
+
+  llvm::ExecutionEngine*
+  Simulation_engine::create_execution_engine(std::shared_ptr<sim::Llvm_library> lib) {
+    using namespace llvm;
+
+    // create JIT execution engine
+    EngineBuilder exe_bld(lib->impl.module.get());
+    std::string err_str;
+    exe_bld.setErrorStr(&err_str);
+    exe_bld.setEngineKind(EngineKind::JIT);
+
+    auto rv = exe_bld.create();
+    if( !rv ) {
+      std::stringstream strm;
+      strm << "Failed to create execution engine!: " << err_str;
+      throw std::runtime_error(strm.str());
+    }
+    // no lookup using dlsym, only the math functions intrinsics are lowered to
+    rv->DisableSymbolSearching(true);
+    rv->InstallLazyFunctionCreator(&math_function);
+
+    return rv;
   }
 
 
@@ -166,21 +246,14 @@ namespace sim {
 
     LOG4CXX_DEBUG(m_logger, "setup for simulation...");
 
+    if( m_instance && m_specialize )
+      throw std::runtime_error("Port specialization is not available for "
+          "engines sharing a design");
 
-    // add mappings for runtime functions
-    if( ir::Builtins<Llvm_impl>::functions.count("print") != 1 )
-      throw std::runtime_error("There can only be one builtin print function!");
-    {
-      auto f = ir::Builtins<Llvm_impl>::functions.find("print")->second;
-      m_exe->addGlobalMapping(f->impl.code, (void*)(&print));
-    }
+    Scope scope(*this);
+    std::lock_guard<std::mutex> lock(m_context->mutex);
 
-    if( ir::Builtins<Llvm_impl>::functions.count("rand") != 1 )
-      throw std::runtime_error("There can only be one builtin rand function!");
-    {
-      auto f = ir::Builtins<Llvm_impl>::functions.find("rand")->second;
-      m_exe->addGlobalMapping(f->impl.code, (void*)(&rand));
-    }
+    map_runtime_functions(m_exe);
 
 /*
     // generate wrapper function to setup simulation
@@ -205,30 +278,302 @@ namespace sim {
 
     m_runset.add_module(m_exe, m_top_mod);
     m_runset.setup_hierarchy();
+    report_frame_layout();
+    seed_instances();
+    m_print_log.paths(instance_paths());
+    m_print_log.time(m_time.value(ir::Time::ps));
     m_runset.call_init(m_exe);
 
+    if( m_specialize ) {
+      Port_specializer specializer(m_exe, *m_layout);
+      m_num_specialized = specializer.specialize(m_runset);
+    }
+
     m_setup_complete = true;
 
   }
 
 
+  void
+  Simulation_engine::map_runtime_functions(llvm::ExecutionEngine* exe) {
+    // add mappings for runtime functions, builtins are declared under the
+    // names of their runtime functions
+    std::map<std::string, void*> const runtime_functions{
+      {"print", (void*)(&print)},
+      {"cell_print_int", (void*)(&cell_print_int)},
+      {"cell_print_float", (void*)(&cell_print_float)},
+      {"cell_rand", (void*)(&cell_rand)},
+      {"cell_rand_int", (void*)(&cell_rand_int)},
+      {"cell_rand_float", (void*)(&cell_rand_float)},
+      {"cell_rand_normal", (void*)(&cell_rand_normal)},
+      {"cell_rand_poisson", (void*)(&cell_rand_poisson)}
+    };
+
+    std::size_t num_mapped = 0;
+    for(auto const& f : ir::Builtins<Llvm_impl>::functions()) {
+      auto it = runtime_functions.find(f.second->name);
+      if( it != runtime_functions.end() ) {
+        exe->updateGlobalMapping(f.second->impl.code, it->second);
+        ++num_mapped;
+      }
+    }
+
+    if( num_mapped != runtime_functions.size() )
+      throw std::runtime_error("Builtin functions do not match the runtime "
+          "functions");
+  }
+
+
+  /** Paths of the instances in the order of Runset::add_module() */
+  std::vector<std::string>
+  Simulation_engine::instance_paths() const {
+    std::vector<std::string> paths;
+    std::function<void(std::shared_ptr<Llvm_module>, std::string const&)> add_paths;
+    add_paths = [&](std::shared_ptr<Llvm_module> mod, std::string const& path) {
+      paths.push_back(path);
+      for(auto const& i : mod->instantiations)
+        add_paths(i.second->module, path.empty() ? i.first : path + "." + i.first);
+    };
+    add_paths(m_top_mod, "");
+
+    return paths;
+  }
+
+
+  /** Reset the random number streams in the frames of all instances */
+  void
+  Simulation_engine::seed_instances() {
+    auto paths = instance_paths();
+    for(std::size_t i=0; i<m_runset.modules.size(); ++i) {
+      auto& m = m_runset.modules[i];
+      auto index = m.mod->impl.rand_index;
+      if( index == 0 )
+        continue;
+
+      auto state = cell_rand_stream(m_seed, paths.at(i).c_str());
+      auto ofs = m.layout->getElementOffset(index);
+      for(auto frame : {m.this_in, m.this_out, m.this_prev})
+        std::copy_n(reinterpret_cast<char const*>(&state),
+            sizeof(state),
+            frame->data() + ofs);
+    }
+  }
+
+
+  /** Compile all code of the shared design, so that engines simulating it
+   * concurrently do not compile lazily */
+  void
+  Simulation_engine::compile_all() {
+    Scope scope(*this);
+    std::lock_guard<std::mutex> lock(m_context->mutex);
+
+    if( m_context->compiled )
+      return;
+
+    map_runtime_functions(m_exe);
+    for(auto& f : *(m_lib->impl.module)) {
+      if( !f.isDeclaration() )
+        m_exe->getPointerToFunction(&f);
+    }
+    m_context->compiled = true;
+  }
+
+
+  void
+  Simulation_engine::seed(uint64_t seed) {
+    m_seed = seed;
+    if( m_scope_depth > 0 )
+      rand_state(seed);
+    else
+      m_rand_state = seed;
+
+    if( m_setup_complete )
+      seed_instances();
+  }
+
+
   void
   Simulation_engine::simulate(ir::Time const& duration) {
     LOG4CXX_INFO(m_logger, "simulating " << duration);
+    Scope scope(*this);
     for(ir::Time t=m_time; t<(m_time + duration); ) {
       t = simulate_step(t, duration);
+      watch_sources();
+    }
+
+    m_time = m_time + duration;
+    m_print_log.drain();
+  }
+
+
+  std::size_t
+  Simulation_engine::reload() {
+    if( !m_setup_complete )
+      throw std::runtime_error("Call Simulation_engine::setup() before "
+          "Simulation_engine::reload()");
+    if( m_instance || (m_context.use_count() > 1) )
+      throw std::runtime_error("Can not reload a design shared by several "
+          "engines");
+
+    LOG4CXX_INFO(m_logger, "reloading design from '" << m_filename << "'");
+    Scope scope(*this);
+
+    auto lib = compile(false);
+    auto exe = create_execution_engine(lib);
+    optimize(*(lib->impl.module));
+    map_runtime_functions(exe);
+
+    auto top = find_by_path(*(lib->ns),
+        &ir::Namespace<Llvm_impl>::modules,
+        m_toplevel);
+    if( !top )
+      throw std::runtime_error("Can not find top level module '"
+          + m_toplevel + "' after reload");
+
+    // pair up modules of the running and the new design, this throws if
+    // the frame layout of any module changed
+    Module_pairs pairs;
+    match_modules(m_top_mod, top, pairs);
+
+    std::size_t num_changed = 0;
+    for(auto const& p : pairs) {
+      bool changed = code_fingerprint(*p.first) != code_fingerprint(*p.second);
+
+      if( changed ) {
+        LOG4CXX_INFO(m_logger, "replacing code of module '"
+            << p.second->name << "'");
+        ++num_changed;
+      }
+
+      for(auto& m : m_runset.modules) {
+        if( m.mod != p.first )
+          continue;
+
+        if( changed )
+          m_runset.replace_processes(m, exe, p.second);
+        m.mod = p.second;
+      }
+    }
+
+    // code of unchanged modules still lives in the previous library
+    m_retired.push_back(Retired_code{m_lib, m_exe});
+    m_lib = lib;
+    m_exe = exe;
+    m_top_mod = top;
+    m_reloaded = true;
+    release_retired();
+
+    LOG4CXX_INFO(m_logger, "reload complete, replaced code of "
+        << num_changed << " modules");
+
+    return num_changed;
+  }
+
+
+  bool
+  Simulation_engine::reload_if_changed() {
+    namespace bf = boost::filesystem;
+
+    bool changed = false;
+    for(auto& src : m_source_times) {
+      boost::system::error_code ec;
+      auto t = bf::last_write_time(src.first, ec);
+      if( ec || (t == src.second) )
+        continue;
+
+      // saved without changes, nothing to compile
+      src.second = t;
+      if( file_hash(src.first) == m_source_hashes[src.first] )
+        continue;
+
+      LOG4CXX_DEBUG(m_logger, "source file '" << src.first << "' changed");
+      changed = true;
+    }
+
+    if( !changed )
+      return false;
+
+    // do not retry until the next modification if the reload fails
+    record_source_times();
+
+    try {
+      reload();
+    } catch( Frame_layout_error const& err ) {
+      throw;
+    } catch( std::runtime_error const& err ) {
+      LOG4CXX_ERROR(m_logger, "reload failed, continuing with previous code: "
+          << err.what());
+      return false;
     }
+
+    record_source_times();
+    return true;
   }
 
 
   void
   Simulation_engine::teardown() {
     m_setup_complete = false;
+    m_wakeups.clear();
+    m_print_log.drain();
+  }
+
+
+  void
+  Simulation_engine::checkpoint(std::string const& filename) {
+    if( !m_setup_complete )
+      throw std::runtime_error("Call Simulation_engine::setup() before "
+          "Simulation_engine::checkpoint()");
+
+    std::ofstream os(filename, std::ios::binary);
+    if( !os ) {
+      std::stringstream strm;
+      strm << "Could not open checkpoint file '" << filename << "' for writing";
+      throw std::runtime_error(strm.str());
+    }
+
+    LOG4CXX_INFO(m_logger, "writing checkpoint at " << m_time
+        << " to '" << filename << "'");
+    Scope scope(*this);
+    save_checkpoint(os, m_runset, m_time);
+  }
+
+
+  void
+  Simulation_engine::restore(std::string const& filename) {
+    if( !m_setup_complete )
+      throw std::runtime_error("Call Simulation_engine::setup() before "
+          "Simulation_engine::restore()");
+
+    std::ifstream is(filename, std::ios::binary);
+    if( !is ) {
+      std::stringstream strm;
+      strm << "Could not open checkpoint file '" << filename << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    Scope scope(*this);
+    m_time = load_checkpoint(is, m_runset);
+    m_runset.setup_hierarchy();
+    LOG4CXX_INFO(m_logger, "restored checkpoint of " << m_time
+        << " from '" << filename << "'");
   }
 
 
   void
-  Simulation_engine::optimize() {
+  Simulation_engine::emit_object(std::string const& filename,
+      std::string const& symbol) {
+    if( !m_top_mod )
+      throw std::runtime_error("No top level module set for object emission");
+
+    LOG4CXX_INFO(m_logger, "writing object file '" << filename << "'");
+    Scope scope(*this);
+    sim::emit_object(m_lib, m_top_mod, filename, symbol);
+  }
+
+
+  void
+  Simulation_engine::optimize(llvm::Module& module) {
     m_mpm = std::make_shared<llvm::PassManager>();
     //m_mpm->add(llvm::createPrintFunctionPass("function optimization in:",
           //new llvm::raw_os_ostream(std::cout)));
@@ -245,12 +590,32 @@ namespace sim {
     //m_mpm->add(llvm::createPrintFunctionPass("function optimization out:",
           //new llvm::raw_os_ostream(std::cout)));
 
-    m_mpm->run(*m_lib->impl.module.get());
+    m_mpm->run(module);
+  }
+
+
+  void
+  Simulation_engine::report_frame_layout() {
+    std::set<std::shared_ptr<Llvm_module>> reported;
+
+    for(auto const& m : m_runset.modules) {
+      auto declared = m.mod->impl.declared_type;
+      if( !declared || !reported.insert(m.mod).second )
+        continue;
+
+      auto before = m_layout->getTypeAllocSize(declared);
+      auto after = m_layout->getTypeAllocSize(m.mod->impl.mod_type);
+      LOG4CXX_INFO(m_logger, "frame of module '" << m.mod->name << "': "
+          << declared->getNumElements() << " -> "
+          << m.mod->impl.mod_type->getNumElements() << " members, "
+          << before << " -> " << after << " bytes");
+    }
   }
 
 
   void
   Simulation_engine::set_toplevel(std::string const& toplevel) {
+    m_toplevel = toplevel;
     m_top_mod = find_by_path(*(m_lib->ns), &ir::Namespace<Llvm_impl>::modules, toplevel);
     if( !m_top_mod ) {
       std::stringstream strm;
@@ -298,9 +663,11 @@ namespace sim {
     ir::Time next_t = m_time + duration.to_unit(ir::Time::ps);
 
     LOG4CXX_DEBUG(m_logger, "===== time: " << t << " =====");
+    m_print_log.time(t.value(ir::Time::ps));
 
     // add timed processes to the run list
     for(auto& mod : m_runset.modules) {
+      m_print_log.instance(&mod - m_runset.modules.data());
       std::list<Runset::Process_schedule::value_type> new_schedules;
       std::list<Runset::Time_process_map::value_type> new_schedules_recurrent;
 
@@ -368,6 +735,14 @@ namespace sim {
     if( cycle >= max_cycles )
       LOG4CXX_ERROR(m_logger, "Exceeded max number of cycles. Probably a loop.");
 
+    // wake-ups requested by drivers, possibly during this step
+    m_wakeups.erase(m_wakeups.begin(), m_wakeups.upper_bound(t));
+    if( !m_wakeups.empty() )
+      next_t = std::min(next_t, *m_wakeups.begin());
+
+    if( m_print_log.full() )
+      m_print_log.drain();
+
     return next_t;
   }
 
@@ -382,6 +757,7 @@ namespace sim {
           << mod.run_list.size()
           << " processes in module "
           << mod.mod->name);
+      m_print_log.instance(&mod - m_runset.modules.data());
 
       // call observer/checker code to observe ptr_out
       for(auto& drv : mod.drivers) {
@@ -537,24 +913,259 @@ namespace sim {
 
 
 
+  void
+  Simulation_engine::match_modules(std::shared_ptr<Llvm_module> a,
+      std::shared_ptr<Llvm_module> b,
+      Module_pairs& pairs) {
+    check_frame_layout(*a, *b, *m_layout);
+
+    auto known = std::find_if(std::begin(pairs),
+        std::end(pairs),
+        [&a](Module_pairs::value_type const& x) { return x.first == a; });
+    if( known != std::end(pairs) )
+      return;
+    pairs.push_back(std::make_pair(a, b));
+
+    for(auto const& inst : a->instantiations) {
+      // existence is guaranteed by the layout check
+      auto other = b->instantiations.at(inst.first);
+      match_modules(inst.second->module, other->module, pairs);
+    }
+  }
+
+
+  void
+  Simulation_engine::record_source_times() {
+    namespace bf = boost::filesystem;
+
+    m_source_times.clear();
+    m_source_hashes.clear();
+    for(auto const& f : m_lib->parsed_files) {
+      boost::system::error_code ec;
+      auto t = bf::last_write_time(f.first, ec);
+      if( !ec ) {
+        m_source_times[f.first] = t;
+        m_source_hashes[f.first] = file_hash(f.first);
+      }
+    }
+  }
+
+
+  void
+  Simulation_engine::release_retired() {
+    for(auto it=m_retired.begin(); it!=m_retired.end(); ) {
+      auto exe = it->exe;
+      bool used = (exe == m_pinned_exe)
+        || std::any_of(m_runset.modules.begin(),
+            m_runset.modules.end(),
+            [exe](Runset::Module const& m) { return m.exe == exe; });
+
+      if( used ) {
+        ++it;
+        continue;
+      }
+
+      // the execution engine owns the module it was created for
+      LOG4CXX_DEBUG(m_logger, "releasing code replaced by reload()");
+      exe->removeModule(it->lib->impl.module.get());
+      delete exe;
+      it = m_retired.erase(it);
+    }
+  }
+
+
+  void
+  Simulation_engine::watch_sources() {
+    if( !m_watch )
+      return;
+
+    auto now = std::chrono::steady_clock::now();
+    if( now - m_last_watch < m_watch_interval )
+      return;
+    m_last_watch = now;
+
+    reload_if_changed();
+  }
+
+
+
+  static void check_frame_layout(Llvm_module const& a,
+      Llvm_module const& b,
+      llvm::DataLayout const& layout) {
+    auto error = [&b](std::string const& what) {
+      std::stringstream strm;
+      strm << "Frame layout of module '" << b.name
+        << "' changed (" << what << "), "
+        << "can not replace code of a running simulation";
+      throw Frame_layout_error(strm.str());
+    };
+
+    if( layout.getTypeAllocSize(a.impl.mod_type)
+        != layout.getTypeAllocSize(b.impl.mod_type) )
+      error("frame size differs");
+
+    if( a.objects.size() != b.objects.size() )
+      error("number of members differs");
+
+    auto lay_a = layout.getStructLayout(a.impl.mod_type);
+    auto lay_b = layout.getStructLayout(b.impl.mod_type);
+
+    for(auto const& obj : a.objects) {
+      auto it = b.objects.find(obj.first);
+      if( it == b.objects.end() )
+        error("member '" + obj.first + "' removed");
+
+      auto idx_a = obj.second->impl.struct_index;
+      auto idx_b = it->second->impl.struct_index;
+      if( (idx_a != idx_b)
+          || (lay_a->getElementOffset(idx_a) != lay_b->getElementOffset(idx_b)) )
+        error("member '" + obj.first + "' moved");
+
+      if( (obj.second->type->name != it->second->type->name)
+          || (layout.getTypeAllocSize(a.impl.mod_type->getElementType(idx_a))
+            != layout.getTypeAllocSize(b.impl.mod_type->getElementType(idx_b))) )
+        error("type of member '" + obj.first + "' changed");
+    }
+  }
+
+
+  static std::string code_fingerprint(Llvm_module const& mod) {
+    std::string rv;
+    llvm::raw_string_ostream os(rv);
+    std::set<llvm::Function const*> printed;
+
+    for(auto const& p : mod.processes)
+      print_with_callees(p->function->impl.code, printed, os);
+    for(auto const& p : mod.periodicals)
+      print_with_callees(p->function->impl.code, printed, os);
+    for(auto const& p : mod.onces)
+      print_with_callees(p->function->impl.code, printed, os);
+    for(auto const& p : mod.recurrents)
+      print_with_callees(p->function->impl.code, printed, os);
+    for(auto const& f : mod.functions)
+      print_with_callees(f.second->impl.code, printed, os);
+    os.flush();
+
+    // named struct types get a numeric suffix when they are created again in
+    // the same LLVMContext; strip it for comparison
+    static std::regex const suffix("(%\"?[A-Za-z_.:0-9]*[A-Za-z_:])\\.[0-9]+");
+    return std::regex_replace(rv, suffix, std::string("$1"));
+  }
+
+
+  /** Hash of the contents of a file, of no contents if it can not be read */
+  static std::size_t file_hash(std::string const& filename) {
+    std::ifstream is(filename, std::ios::binary);
+    std::stringstream strm;
+    strm << is.rdbuf();
+    return std::hash<std::string>()(strm.str());
+  }
+
+
+  /** Print f and all functions it calls directly or indirectly, e.g.
+   * functions of the enclosing namespaces, each function once */
+  static void print_with_callees(llvm::Function const* f,
+      std::set<llvm::Function const*>& printed,
+      llvm::raw_ostream& os) {
+    if( !printed.insert(f).second )
+      return;
+
+    f->print(os);
+    for(auto const& bb : *f) {
+      for(auto const& inst : bb) {
+        auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+        if( call && call->getCalledFunction() )
+          print_with_callees(call->getCalledFunction(), printed, os);
+      }
+    }
+  }
+
+
+  /** Resolve library calls generated for math intrinsics, see llvm_math.h */
+  static void* math_function(std::string const& name) {
+    static std::map<std::string, void*> const functions{
+      {"exp", (void*)(static_cast<double (*)(double)>(&std::exp))},
+      {"log", (void*)(static_cast<double (*)(double)>(&std::log))},
+      {"sqrt", (void*)(static_cast<double (*)(double)>(&std::sqrt))},
+      {"sin", (void*)(static_cast<double (*)(double)>(&std::sin))},
+      {"cos", (void*)(static_cast<double (*)(double)>(&std::cos))},
+      {"floor", (void*)(static_cast<double (*)(double)>(&std::floor))},
+      {"ceil", (void*)(static_cast<double (*)(double)>(&std::ceil))},
+      {"pow", (void*)(static_cast<double (*)(double, double)>(&std::pow))},
+      {"fma", (void*)(static_cast<double (*)(double, double, double)>(&std::fma))}
+    };
+
+    auto it = functions.find(name);
+    return (it == functions.end()) ? nullptr : it->second;
+  }
+
+
   //--------------------------------------------------------------------------
   //--------------------------------------------------------------------------
 
 
+  Instrumented_simulation_engine::~Instrumented_simulation_engine() {
+    // ~Simulation_engine() does not reach the instrumenter
+    if( m_setup_complete )
+      teardown();
+
+    std::lock_guard<std::mutex> lock(m_context->mutex);
+    m_start.reset();
+    m_stop.reset();
+  }
+
+
   void
   Instrumented_simulation_engine::setup() {
+    Scope scope(*this);
     Simulation_engine::setup();
 
-    if( m_instrumenter ) {
-      setup_module(m_top_mod);
-
-      m_instrumenter->initial(ir::Time(0, ir::Time::ps));
+    // a failed setup leaves nothing for teardown()
+    try {
+      using namespace std::placeholders;
+      auto resolve = std::bind(&Instrumented_simulation_engine::resolve_signal,
+          this,
+          _1);
+
+      // conditions of a previous setup() remove their code from the module
+      std::unique_lock<std::mutex> lock(m_context->mutex);
+      m_start.reset();
+      m_stop.reset();
+      if( !m_start_expr.empty() )
+        m_start.reset(new Dump_condition(m_start_expr,
+              resolve,
+              *(m_lib->impl.module),
+              m_exe));
+      if( !m_stop_expr.empty() )
+        m_stop.reset(new Dump_condition(m_stop_expr,
+              resolve,
+              *(m_lib->impl.module),
+              m_exe));
+      lock.unlock();
+      m_dumping = !m_start;
+
+      // reload() keeps the code of the conditions
+      m_pinned_exe = (m_start || m_stop) ? m_exe : nullptr;
+
+      if( m_instrumenter ) {
+        setup_module(m_top_mod, m_top_mod->name, 0);
+
+        m_instrumenter->initial(ir::Time(0, ir::Time::ps));
+      }
+    } catch( ... ) {
+      Simulation_engine::teardown();
+      throw;
     }
   }
 
 
   void
-  Instrumented_simulation_engine::setup_module(std::shared_ptr<Llvm_module> mod) {
+  Instrumented_simulation_engine::setup_module(std::shared_ptr<Llvm_module> mod,
+      std::string const& path,
+      unsigned depth) {
+    if( !m_selection.depth_selected(depth) )
+      return;
+
     auto num_elements = mod->impl.mod_type->getNumElements();
     auto layout = m_layout->getStructLayout(mod->impl.mod_type);
     auto insp = std::make_shared<Module_inspector>(mod,
@@ -562,6 +1173,16 @@ namespace sim {
         num_elements,
         m_exe,
         m_runset);
+
+    std::vector<bool> selected(num_elements, false);
+    for(auto const& obj : mod->objects) {
+      auto idx = obj.second->impl.struct_index;
+      if( idx < num_elements )
+        selected[idx] = m_selection.selected(path + '.' + obj.first);
+    }
+    insp->select(selected);
+    insp->path(path);
+
     m_instrumenter->push_hierarchy();
     m_instrumenter->register_module(insp);
 
@@ -571,7 +1192,7 @@ namespace sim {
 
       std::tie(inst_name, inst) = i;
 
-      setup_module(inst->module);
+      setup_module(inst->module, path + '.' + inst_name, depth + 1);
     }
     m_instrumenter->pop_hierarchy();
   }
@@ -580,15 +1201,102 @@ namespace sim {
   void
   Instrumented_simulation_engine::simulate(ir::Time const& duration) {
     LOG4CXX_INFO(m_logger, "simulating " << duration);
+    Scope scope(*this);
 
     for(ir::Time t=m_time; t<(m_time + duration); ) {
       ir::Time next_t = simulate_step(t, duration);
 
-      if( m_instrumenter )
+      if( m_instrumenter && dump_active(t) )
         m_instrumenter->step(t);
 
       t = next_t;
+      watch_sources();
+    }
+
+    m_time = m_time + duration;
+    m_print_log.drain();
+  }
+
+
+  std::pair<char*,llvm::Type*>
+  Instrumented_simulation_engine::resolve_signal(std::string const& name) {
+    // name is <top>.<instance>...<member>
+    auto first = name.find('.');
+    auto last = name.rfind('.');
+    if( (first == std::string::npos)
+        || (name.substr(0, first) != m_top_mod->name) ) {
+      std::stringstream strm;
+      strm << "Signal '" << name << "' must start with the top level module '"
+        << m_top_mod->name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    auto inst_path = (first == last) ? std::string()
+      : name.substr(first + 1, last - first - 1);
+    auto member = name.substr(last + 1);
+
+    auto mod = ir::find_instance(m_top_mod, inst_path);
+    if( !mod ) {
+      std::stringstream strm;
+      strm << "Could not find instance '" << inst_path << "' of signal '"
+        << name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    auto obj = mod->objects.find(member);
+    if( (obj == mod->objects.end())
+        || (mod->instantiations.count(member) != 0) ) {
+      std::stringstream strm;
+      strm << "Could not find signal '" << name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    auto it = std::find_if(std::begin(m_runset.modules),
+        std::end(m_runset.modules),
+        [&mod](Runset::Module const& m) -> bool { return m.mod == mod; });
+    if( it == std::end(m_runset.modules) )
+      throw std::runtime_error("Module not available in runset");
+
+    auto idx = obj->second->impl.struct_index;
+    auto ofs = m_layout->getStructLayout(mod->impl.mod_type)->getElementOffset(idx);
+
+    return std::make_pair(it->this_in->data() + ofs, obj->second->type->impl.type);
+  }
+
+
+  bool
+  Instrumented_simulation_engine::dump_active(ir::Time const& t) {
+    if( !m_dumping && m_start && (*m_start)() ) {
+      LOG4CXX_INFO(m_logger, "start dumping at " << t
+          << " (" << m_start->expression() << ")");
+      m_dumping = true;
+    } else if( m_dumping && m_stop && (*m_stop)() ) {
+      LOG4CXX_INFO(m_logger, "stop dumping at " << t
+          << " (" << m_stop->expression() << ")");
+      m_dumping = false;
     }
+
+    if( !m_dumping )
+      return false;
+
+    if( m_windows.empty() )
+      return true;
+
+    for(auto const& w : m_windows) {
+      if( !(t < w.first) && (t < w.second) )
+        return true;
+    }
+
+    return false;
+  }
+
+
+  void
+  Instrumented_simulation_engine::teardown() {
+    if( m_instrumenter && m_setup_complete )
+      m_instrumenter->teardown();
+
+    Simulation_engine::teardown();
   }
 
 }
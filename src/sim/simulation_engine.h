@@ -6,7 +6,11 @@
 #include <functional>
 #include <unordered_set>
 #include <map>
+#include <set>
+#include <mutex>
 #include <stdexcept>
+#include <chrono>
+#include <ctime>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/GenericValue.h>
 #include <llvm/PassManager.h>
@@ -15,13 +19,43 @@
 #include "sim/runset.h"
 #include "sim/module_inspector.h"
 #include "sim/instrumenter_if.h"
+#include "sim/dump_control.h"
+#include "sim/print_log.h"
+#include "sim/runtime.h"
 #include "sim/llvm_namespace.h"
+#include "ir/builtins.h"
 #include "ir/find_hierarchy.h"
 #include "ir/time.h"
 
 
 namespace sim {
 
+  /** Thrown if code can not be replaced because a module frame changed */
+  class Frame_layout_error : public std::runtime_error {
+    public:
+      explicit Frame_layout_error(std::string const& what)
+        : std::runtime_error(what) {
+      }
+  };
+
+
+  /** Compilation state of a design
+   *
+   * Owned by the Simulation_engine compiling the design and shared with the
+   * engines created from it, nothing of it is global.
+   * */
+  struct Engine_context {
+    llvm::LLVMContext llvm;
+    ir::Builtins<Llvm_impl>::Tables builtins;
+
+    /** Serializes changes to the shared code, e.g. JIT compilation */
+    std::mutex mutex;
+
+    /** All functions were compiled to native code */
+    bool compiled = false;
+  };
+
+
   class Simulation_engine {
     public:
       //
@@ -32,10 +66,34 @@ namespace sim {
           std::string const& toplevel);
       Simulation_engine(std::string const& filename,
           std::string const& toplevel,
-          std::vector<std::string> const& lookup_path);
+          std::vector<std::string> const& lookup_path,
+          unsigned jobs = 1,
+          Frame_layout_options const& frame_layout = Frame_layout_options());
       Simulation_engine(std::string const& filename);
       Simulation_engine(std::string const& filename,
-          std::vector<std::string> const& lookup_path);
+          std::vector<std::string> const& lookup_path,
+          unsigned jobs = 1,
+          Frame_layout_options const& frame_layout = Frame_layout_options());
+
+      /** Simulate the design compiled by another engine
+       *
+       * @param design Engine the design was compiled by
+       * @param toplevel Top level module, empty for the one of design
+       *
+       * The code, types and execution engine of design are shared read-only,
+       * module frames, schedules, drivers and the state of the builtin
+       * rand() are private. So several engines created from the same design
+       * simulate concurrently on different threads without compiling it
+       * again. The first engine created from a design compiles all of its
+       * code to native code, later ones can be created while others
+       * simulate.
+       *
+       * Neither design nor the new engine can reload() afterwards, port
+       * specialization is not available for the new engine.
+       * */
+      Simulation_engine(Simulation_engine& design,
+          std::string const& toplevel);
+
       ~Simulation_engine();
 
 
@@ -52,6 +110,53 @@ namespace sim {
       void teardown();
 
 
+      /** Recompile the design and replace code of changed modules
+       *
+       * @return Number of modules with replaced code
+       *
+       * Parses and compiles all source files again and swaps the process code
+       * of all modules whose generated code changed. Module frames,
+       * schedules and registered drivers are kept, so the simulation
+       * continues from the current state. Throws Frame_layout_error if the
+       * frame layout of any module in the hierarchy changed.
+       *
+       * The IR of the whole design is generated again, modules depend on
+       * the namespaces they use. Only the functions of changed modules are
+       * compiled to native code. Unchanged modules keep running the code of
+       * the library they were compiled in, a replaced library and its
+       * execution engine are released as soon as no module runs its code.
+       * At most one library per module instance and the one of dump
+       * conditions are kept this way.
+       * */
+      std::size_t reload();
+
+      /** Call reload() if any of the source files was modified
+       *
+       * @return true if the code was reloaded
+       *
+       * Compilation errors are logged and the previous code is kept. Files
+       * with a new modification time but unchanged contents do not trigger
+       * a reload.
+       * */
+      bool reload_if_changed();
+
+      /** Watch source files during simulate() and reload on changes */
+      void watch(bool enable) { m_watch = enable; }
+
+      /** Specialize process code for constant ports during setup()
+       *
+       * Ports of instances that are only written in __init__ are treated as
+       * constants, see Port_specializer. Drivers must not write these ports.
+       * */
+      void specialize_ports(bool enable) { m_specialize = enable; }
+
+      /** Number of instances using specialized code after setup() */
+      std::size_t specialized_instances() const { return m_num_specialized; }
+
+      /** Number of libraries replaced by reload() still running code */
+      std::size_t retired_libraries() const { return m_retired.size(); }
+
+
       /** Create a Module_inspector object
        *
        * @param name Path to a module instance within the design
@@ -106,6 +211,69 @@ namespace sim {
       }
 
 
+      /** Current simulation time */
+      ir::Time const& time() const { return m_time; }
+
+      /** Seed the builtin random number generators
+       *
+       * Every module instance calling them draws from its own stream,
+       * derived from seed and the path of the instance with
+       * cell_rand_stream(), so its numbers do not depend on other instances
+       * or engines. Functions outside of modules draw from a stream of the
+       * engine started at seed. Streams are reset immediately if the engine
+       * is already set up, otherwise by setup() before __init__ runs.
+       * */
+      void seed(uint64_t seed);
+
+
+      /** Output of the builtin print functions
+       *
+       * Messages printed by the design are buffered and written at step
+       * boundaries, see Print_log. Set its output stream or capacity
+       * before simulate().
+       * */
+      Print_log& print_log() { return m_print_log; }
+
+
+      /** Write the simulation state to a file
+       *
+       * Saves all module frames, schedules, sensitivities, the state of
+       * the builtin rand() and the current time, see sim/checkpoint.h.
+       * State of drivers and instrumenters is not included.
+       * */
+      void checkpoint(std::string const& filename);
+
+      /** Continue the simulation from a checkpoint
+       *
+       * Call after setup() with the same design that wrote the checkpoint.
+       * The frames are overwritten in place, so inspectors and drivers stay
+       * valid.
+       * */
+      void restore(std::string const& filename);
+
+
+      /** Simulate a step at time t
+       *
+       * Makes sure that drivers are called at time t even if no process of
+       * the design is scheduled then. Used by testbenches waiting for a
+       * point in time, see method::Testbench. Times before the next step
+       * are ignored.
+       * */
+      void schedule_wakeup(ir::Time const& t) {
+        m_wakeups.insert(t);
+      }
+
+
+      /** Write the design as native object file
+       *
+       * Compiles the code of the top level module and all modules in its
+       * hierarchy together with a descriptor of the hierarchy. See
+       * sim::emit_object() and aot/cell_runtime.h.
+       * */
+      void emit_object(std::string const& filename,
+          std::string const& symbol = "cell_design");
+
+
       std::shared_ptr<sim::Llvm_library> library() { return m_lib; }
 
 
@@ -113,6 +281,34 @@ namespace sim {
       static unsigned const max_cycles = 20;
 
 
+      /** Makes the LLVM context, builtins, rand() state and print log of an
+       * engine current for the calling thread, see Engine_context */
+      class Scope {
+        public:
+          explicit Scope(Simulation_engine& engine);
+          ~Scope();
+
+          Scope(Scope const&) = delete;
+          Scope& operator = (Scope const&) = delete;
+
+        private:
+          Simulation_engine& m_engine;
+          Context_scope m_context;
+          ir::Builtins<Llvm_impl>::Scope m_builtins;
+          uint64_t m_prev_rand;
+          Print_log* m_prev_log;
+      };
+
+
+      /** Library and execution engine replaced by reload() */
+      struct Retired_code {
+        std::shared_ptr<sim::Llvm_library> lib;
+        llvm::ExecutionEngine* exe;
+      };
+
+
+      // first member, the libraries below are created in its context
+      std::shared_ptr<Engine_context> m_context;
       Runset m_runset;
       llvm::ExecutionEngine* m_exe = nullptr;
       llvm::DataLayout const* m_layout = nullptr;
@@ -123,12 +319,52 @@ namespace sim {
       log4cxx::LoggerPtr m_logger;
       std::shared_ptr<llvm::PassManager> m_mpm;
       std::shared_ptr<llvm::FunctionPassManager> m_fpm;
-
+      std::string m_filename;
+      std::string m_toplevel;
+      std::vector<std::string> m_lookup_path;
+      unsigned m_jobs = 1;
+      Frame_layout_options m_frame_layout;
+      bool m_watch = false;
+      bool m_specialize = false;
+      std::size_t m_num_specialized = 0;
+      std::chrono::milliseconds m_watch_interval{500};
+      std::chrono::steady_clock::time_point m_last_watch;
+      std::map<std::string, std::time_t> m_source_times;
+      std::map<std::string, std::size_t> m_source_hashes;
+      std::vector<Retired_code> m_retired;
+      bool m_reloaded = false;
+      /** Execution engine of code called outside of the runset */
+      llvm::ExecutionEngine* m_pinned_exe = nullptr;
+      std::set<ir::Time> m_wakeups;
+      bool m_instance = false;
+      unsigned m_scope_depth = 0;
+      uint64_t m_seed = initial_rand_state;
+      uint64_t m_rand_state = initial_rand_state;
+      Print_log m_print_log;
+
+
+      typedef std::vector<std::pair<std::shared_ptr<Llvm_module>,
+              std::shared_ptr<Llvm_module>>> Module_pairs;
 
       void init(std::string const& filename,
-          std::vector<std::string> const& lookup_path);
-      void optimize();
+          std::vector<std::string> const& lookup_path,
+          unsigned jobs = 1);
+      std::shared_ptr<sim::Llvm_library> compile(bool init_builtin_types);
+      llvm::ExecutionEngine* create_execution_engine(
+          std::shared_ptr<sim::Llvm_library> lib);
+      void map_runtime_functions(llvm::ExecutionEngine* exe);
+      std::vector<std::string> instance_paths() const;
+      void seed_instances();
+      void compile_all();
+      void optimize(llvm::Module& module);
       void set_toplevel(std::string const& toplevel);
+      void report_frame_layout();
+      void match_modules(std::shared_ptr<Llvm_module> a,
+          std::shared_ptr<Llvm_module> b,
+          Module_pairs& pairs);
+      void record_source_times();
+      void release_retired();
+      void watch_sources();
       ir::Time simulate_step(ir::Time const& t, ir::Time const& duration);
       bool simulate_cycle(ir::Time const& t);
   };
@@ -144,8 +380,10 @@ namespace sim {
 
       Instrumented_simulation_engine(std::string const& filename,
           std::string const& toplevel,
-          std::vector<std::string> const& lookup_path)
-        : Simulation_engine(filename, toplevel, lookup_path) {
+          std::vector<std::string> const& lookup_path,
+          unsigned jobs = 1,
+          Frame_layout_options const& frame_layout = Frame_layout_options())
+        : Simulation_engine(filename, toplevel, lookup_path, jobs, frame_layout) {
       }
 
       Instrumented_simulation_engine(std::string const& filename)
@@ -153,19 +391,71 @@ namespace sim {
       }
 
       Instrumented_simulation_engine(std::string const& filename,
-          std::vector<std::string> const& lookup_path)
-        : Simulation_engine(filename, lookup_path) {
+          std::vector<std::string> const& lookup_path,
+          unsigned jobs = 1,
+          Frame_layout_options const& frame_layout = Frame_layout_options())
+        : Simulation_engine(filename, lookup_path, jobs, frame_layout) {
+      }
+
+      Instrumented_simulation_engine(Simulation_engine& design,
+          std::string const& toplevel)
+        : Simulation_engine(design, toplevel) {
       }
 
+      ~Instrumented_simulation_engine();
+
       void setup();
-      void setup_module(std::shared_ptr<Llvm_module> mod);
+      void setup_module(std::shared_ptr<Llvm_module> mod,
+          std::string const& path,
+          unsigned depth);
       void simulate(ir::Time const& duration);
+      void teardown();
 
       void instrument(Instrumenter_if& instr) { m_instrumenter = &instr; }
 
+      /** Pass only selected signals to the instrumenter, call before setup() */
+      void dump_scope(Dump_selection const& selection) {
+        m_selection = selection;
+      }
+
+      /** Call the instrumenter only for steps within [begin, end)
+       *
+       * Can be called multiple times to add several windows.
+       * */
+      void dump_window(ir::Time const& begin, ir::Time const& end) {
+        m_windows.push_back(std::make_pair(begin, end));
+      }
+
+      /** Start calling the instrumenter once condition is true
+       *
+       * See Dump_condition for the syntax. The condition is compiled in
+       * setup() and evaluated after every step.
+       * */
+      void dump_when(std::string const& condition) {
+        m_start_expr = condition;
+      }
+
+      /** Stop calling the instrumenter once condition is true */
+      void dump_until(std::string const& condition) {
+        m_stop_expr = condition;
+      }
+
+      /** true if the instrumenter is called for the current step */
+      bool dumping() const { return m_dumping; }
+
 
     private:
       Instrumenter_if* m_instrumenter = nullptr;
+      Dump_selection m_selection;
+      std::vector<std::pair<ir::Time,ir::Time>> m_windows;
+      std::string m_start_expr;
+      std::string m_stop_expr;
+      std::unique_ptr<Dump_condition> m_start;
+      std::unique_ptr<Dump_condition> m_stop;
+      bool m_dumping = true;
+
+      std::pair<char*,llvm::Type*> resolve_signal(std::string const& name);
+      bool dump_active(ir::Time const& t);
   };
 }
 
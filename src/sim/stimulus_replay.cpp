@@ -0,0 +1,141 @@
+#include "sim/stimulus_replay.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <boost/algorithm/string.hpp>
+#include <llvm/IR/DerivedTypes.h>
+
+
+namespace sim {
+
+  Stimulus_replay::Stimulus_replay(Simulation_engine& engine,
+      std::string const& filename,
+      ir::Label const& path,
+      std::string const& prefix)
+    : m_engine(engine),
+      m_file(filename),
+      m_logger(log4cxx::Logger::getLogger("cell.stim")) {
+    auto insp = engine.inspect_module(path);
+    auto mod = insp.module();
+    auto lay = insp.data_layout();
+
+    for(auto const& sig : m_file.signals()) {
+      Target target{false, 0, 0};
+
+      if( sig.name.compare(0, prefix.size(), prefix) != 0 ) {
+        m_targets.push_back(target);
+        continue;
+      }
+
+      // member or member.element..., socket elements also without "port."
+      std::vector<std::string> names;
+      auto name = sig.name.substr(prefix.size());
+      boost::algorithm::split(names, name, boost::algorithm::is_any_of("."));
+
+      auto obj = mod->objects.find(names[0]);
+      if( (obj == mod->objects.end())
+          && mod->socket
+          && mod->socket->elements.count(names[0]) ) {
+        names.insert(names.begin(), "port");
+        obj = mod->objects.find("port");
+      }
+
+      if( obj != mod->objects.end() ) {
+        auto ty = obj->second->type;
+        std::size_t ofs = insp.layout()->getElementOffset(obj->second->impl.struct_index);
+        target.valid = true;
+
+        for(std::size_t i=1; i<names.size(); ++i) {
+          auto elem = ty->elements.find(names[i]);
+          if( elem == ty->elements.end() ) {
+            target.valid = false;
+            break;
+          }
+
+          auto str_ty = llvm::cast<llvm::StructType>(ty->impl.type);
+          ofs += lay->getStructLayout(str_ty)->getElementOffset(
+              elem->second->impl.struct_index);
+          ty = elem->second->type;
+        }
+
+        target.offset = ofs;
+        target.size = lay->getTypeStoreSize(ty->impl.type);
+      }
+
+      if( target.valid ) {
+        if( sig.size() > target.size ) {
+          std::stringstream strm;
+          strm << "stimulus signal '" << sig.name << "' of " << sig.width
+            << " bits does not fit into '" << name << "' ("
+            << target.size << " bytes)";
+          throw std::runtime_error(strm.str());
+        }
+        ++m_num_targets;
+      } else {
+        LOG4CXX_WARN(m_logger, "ignoring stimulus signal '" << sig.name
+            << "', not found in module '" << mod->name << "'");
+      }
+
+      m_targets.push_back(target);
+    }
+
+    if( m_num_targets == 0 ) {
+      std::stringstream strm;
+      strm << "no signal of stimulus file '" << filename
+        << "' matches module '" << mod->name << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    LOG4CXX_INFO(m_logger, "replaying " << m_file.num_events() << " events of "
+        << m_num_targets << " signals from '" << filename << "'");
+    schedule_next();
+  }
+
+
+  void
+  Stimulus_replay::operator () (ir::Time const& t,
+      Runset::Module_frame this_in,
+      Runset::Module_frame this_out,
+      Runset::Module_frame this_prev) {
+    auto t_ps = static_cast<uint64_t>(t.value(ir::Time::ps));
+    auto n = m_file.num_events();
+    auto first = m_next;
+
+    for(; (m_next < n) && (m_file.event(m_next).time_ps <= t_ps); ++m_next) {
+      if( !m_file.valid(m_next) ) {
+        std::stringstream strm;
+        strm << "invalid event " << m_next << " in stimulus file";
+        throw std::runtime_error(strm.str());
+      }
+
+      auto const& ev = m_file.event(m_next);
+      auto const& target = m_targets[ev.signal];
+      if( !target.valid )
+        continue;
+
+      // zero extend to the size of the member
+      auto size = m_file.signals()[ev.signal].size();
+      auto dst = this_out->data() + target.offset;
+      std::memcpy(dst, m_file.value(ev), size);
+      std::fill(dst + size, dst + target.size, 0);
+      ++m_num_applied;
+    }
+
+    if( m_next != first )
+      schedule_next();
+  }
+
+
+  void
+  Stimulus_replay::schedule_next() {
+    if( m_next < m_file.num_events() ) {
+      m_engine.schedule_wakeup(ir::Time(m_file.event(m_next).time_ps,
+            ir::Time::ps));
+    }
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "sim/simulation_engine.h"
+#include "stim/stim_file.h"
+
+#include "logging/logger.h"
+
+#include <string>
+#include <vector>
+
+
+namespace sim {
+
+  /** Drive a module from a memory mapped stimulus file
+   *
+   * Signals of the stimulus file (see stim/stim_format.h, convert VCD or CSV
+   * files with stimconv) are matched by name against the socket elements
+   * and members of the module, after removing prefix from the signal names.
+   * Unmatched signals are ignored.
+   *
+   * Register the object with Simulation_engine::add_driver() for the same
+   * module. Events are deposited on this_out at the beginning of the step at
+   * their time, the time of the next event is requested from the engine
+   * with Simulation_engine::schedule_wakeup(). Values are copied from the
+   * mapped file, nothing is parsed during the simulation.
+   * */
+  class Stimulus_replay {
+    public:
+      /**
+       * @param engine Engine after setup()
+       * @param filename Stimulus file
+       * @param path Path to the module to drive
+       * @param prefix Removed from the names of the stimulus signals
+       * */
+      Stimulus_replay(Simulation_engine& engine,
+          std::string const& filename,
+          ir::Label const& path,
+          std::string const& prefix = "");
+
+      Stimulus_replay(Stimulus_replay const&) = delete;
+      Stimulus_replay& operator = (Stimulus_replay const&) = delete;
+
+      /** Call back from Simulation_engine, see add_driver() */
+      void operator () (ir::Time const& t,
+          Runset::Module_frame this_in,
+          Runset::Module_frame this_out,
+          Runset::Module_frame this_prev);
+
+      /** Number of stimulus signals matching the module */
+      std::size_t num_targets() const { return m_num_targets; }
+
+      /** Number of events applied so far */
+      std::size_t num_applied() const { return m_num_applied; }
+
+      /** true once all events were applied */
+      bool finished() const { return m_next >= m_file.num_events(); }
+
+
+    private:
+      /** Location of a stimulus signal in the module frame */
+      struct Target {
+        bool valid;
+        std::size_t offset;
+        std::size_t size;
+      };
+
+      Simulation_engine& m_engine;
+      stim::Stimulus_file m_file;
+      std::vector<Target> m_targets;
+      std::size_t m_num_targets = 0;
+      std::size_t m_next = 0;
+      std::size_t m_num_applied = 0;
+      log4cxx::LoggerPtr m_logger;
+
+      void schedule_next();
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,387 @@
+#include "sim/sweep.h"
+#include "sim/runtime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <boost/algorithm/string.hpp>
+
+
+namespace sim {
+
+  namespace {
+
+    /** Variable of a module instance read or overridden by a sweep */
+    struct Variable {
+      enum Kind { floating, integer, boolean };
+
+      Module_inspector insp;
+      std::string member;
+      Kind kind;
+    };
+
+  }
+
+
+  // local helper functions
+  static double parse_number(std::string const& str, std::string const& spec);
+  static Variable find_variable(Simulation_engine& engine,
+      std::string const& name);
+  static double get_value(Variable& var);
+  static void set_initial(Variable& var, double value);
+  static void run_point(Simulation_engine& design,
+      std::string const& toplevel,
+      std::vector<Sweep_parameter> const& params,
+      Sweep_options const& options,
+      std::size_t index,
+      std::mutex& out_mutex,
+      Sweep_writer& out);
+  template<typename T>
+  static void put(std::ostream& os, T v);
+
+
+
+  std::vector<Sweep_parameter> parse_sweep(std::string const& spec) {
+    std::vector<Sweep_parameter> rv;
+    std::vector<std::string> items;
+    boost::algorithm::split(items, spec, boost::algorithm::is_any_of(";"));
+
+    for(auto item : items) {
+      boost::algorithm::trim(item);
+      if( item.empty() )
+        continue;
+
+      auto eq = item.find('=');
+      if( (eq == std::string::npos) || (eq == 0) ) {
+        std::stringstream strm;
+        strm << "Invalid sweep parameter '" << item << "', expected "
+          "<variable>=<values>";
+        throw std::runtime_error(strm.str());
+      }
+
+      Sweep_parameter param;
+      param.name = boost::algorithm::trim_copy(item.substr(0, eq));
+      auto values = item.substr(eq + 1);
+
+      std::vector<std::string> parts;
+      if( values.find(':') != std::string::npos ) {
+        boost::algorithm::split(parts, values, boost::algorithm::is_any_of(":"));
+        if( parts.size() != 3 ) {
+          std::stringstream strm;
+          strm << "Invalid range '" << values << "' of sweep parameter '"
+            << param.name << "', expected <begin>:<end>:<step>";
+          throw std::runtime_error(strm.str());
+        }
+
+        auto begin = parse_number(parts[0], item);
+        auto end = parse_number(parts[1], item);
+        auto step = parse_number(parts[2], item);
+        if( (step == 0.0) || ((end - begin) / step < 0.0) ) {
+          std::stringstream strm;
+          strm << "Step of sweep parameter '" << param.name
+            << "' does not lead from " << begin << " to " << end;
+          throw std::runtime_error(strm.str());
+        }
+
+        // tolerate rounding of the last step
+        auto n = static_cast<std::size_t>(std::floor((end - begin) / step + 1e-9));
+        for(std::size_t i=0; i<=n; ++i)
+          param.values.push_back(begin + i * step);
+      } else {
+        boost::algorithm::split(parts, values, boost::algorithm::is_any_of(","));
+        for(auto const& p : parts)
+          param.values.push_back(parse_number(p, item));
+      }
+
+      rv.push_back(param);
+    }
+
+    if( rv.empty() )
+      throw std::runtime_error("Sweep specification without parameters");
+
+    return rv;
+  }
+
+
+  std::size_t num_sweep_points(std::vector<Sweep_parameter> const& params) {
+    std::size_t rv = params.empty() ? 0 : 1;
+    for(auto const& p : params)
+      rv *= p.values.size();
+
+    return rv;
+  }
+
+
+  std::vector<double> sweep_point(std::vector<Sweep_parameter> const& params,
+      std::size_t index) {
+    std::vector<double> rv(params.size());
+    for(std::size_t i=params.size(); i-- > 0;) {
+      auto n = params[i].values.size();
+      rv[i] = params[i].values[index % n];
+      index /= n;
+    }
+
+    return rv;
+  }
+
+
+  uint64_t run_seed(uint64_t seed, std::size_t index) {
+    // splitmix64, neighbouring indices give unrelated sequences
+    return cell_rand_mix(seed + (index + 1) * rand_increment);
+  }
+
+
+  Csv_sweep_writer::Csv_sweep_writer(std::ostream& os)
+    : m_os(os) {
+    m_os.precision(17);
+  }
+
+
+  void
+  Csv_sweep_writer::header(std::vector<Sweep_parameter> const& params,
+      std::vector<std::string> const& record) {
+    m_os << "point";
+    for(auto const& p : params)
+      m_os << ',' << p.name;
+    m_os << ",time_ps";
+    for(auto const& r : record)
+      m_os << ',' << r;
+    m_os << '\n';
+  }
+
+
+  void
+  Csv_sweep_writer::row(std::size_t index,
+      std::vector<double> const& point,
+      ir::Time const& t,
+      std::vector<double> const& values) {
+    m_os << index;
+    for(auto v : point)
+      m_os << ',' << v;
+    m_os << ',' << t.value(ir::Time::ps);
+    for(auto v : values)
+      m_os << ',' << v;
+    m_os << '\n';
+  }
+
+
+  Binary_sweep_writer::Binary_sweep_writer(std::ostream& os)
+    : m_os(os) {
+  }
+
+
+  void
+  Binary_sweep_writer::header(std::vector<Sweep_parameter> const& params,
+      std::vector<std::string> const& record) {
+    m_os.write("CELLSWEP", 8);
+    put<uint32_t>(m_os, 1);
+    put<uint32_t>(m_os, params.size());
+    put<uint32_t>(m_os, record.size());
+
+    auto put_name = [this](std::string const& name) {
+      put<uint32_t>(m_os, name.size());
+      m_os.write(name.data(), name.size());
+    };
+    for(auto const& p : params)
+      put_name(p.name);
+    for(auto const& r : record)
+      put_name(r);
+  }
+
+
+  void
+  Binary_sweep_writer::row(std::size_t index,
+      std::vector<double> const& point,
+      ir::Time const& t,
+      std::vector<double> const& values) {
+    put<uint64_t>(m_os, index);
+    put<int64_t>(m_os, t.value(ir::Time::ps));
+    for(auto v : point)
+      put<double>(m_os, v);
+    for(auto v : values)
+      put<double>(m_os, v);
+  }
+
+
+  std::size_t run_sweep(Simulation_engine& design,
+      std::string const& toplevel,
+      std::vector<Sweep_parameter> const& params,
+      Sweep_options const& options,
+      Sweep_writer& out) {
+    auto num_points = num_sweep_points(params);
+    auto num_threads = options.threads;
+    if( num_threads == 0 )
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min<std::size_t>(num_threads, num_points);
+
+    out.header(params, options.record);
+
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex out_mutex;
+
+    auto worker = [&]() {
+      for(auto i=next++; (i < num_points) && !failed; i=next++) {
+        try {
+          run_point(design, toplevel, params, options, i, out_mutex, out);
+        } catch(...) {
+          std::lock_guard<std::mutex> lock(out_mutex);
+          if( !failed )
+            error = std::current_exception();
+          failed = true;
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned i=0; i<num_threads; ++i)
+      threads.emplace_back(worker);
+    for(auto& t : threads)
+      t.join();
+
+    if( error )
+      std::rethrow_exception(error);
+
+    return num_points;
+  }
+
+
+  static double parse_number(std::string const& str, std::string const& spec) {
+    auto s = boost::algorithm::trim_copy(str);
+    char* end = nullptr;
+    auto rv = std::strtod(s.c_str(), &end);
+    if( s.empty() || (*end != '\0') ) {
+      std::stringstream strm;
+      strm << "Invalid number '" << s << "' in sweep parameter '" << spec << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    return rv;
+  }
+
+
+  static Variable find_variable(Simulation_engine& engine,
+      std::string const& name) {
+    auto sep = name.rfind('.');
+    auto path = (sep == std::string::npos) ? std::string() : name.substr(0, sep);
+    auto member = (sep == std::string::npos) ? name : name.substr(sep + 1);
+
+    auto insp = engine.inspect_module(path);
+    auto obj = insp.module()->objects.find(member);
+    if( obj == insp.module()->objects.end() ) {
+      std::stringstream strm;
+      strm << "Variable '" << name << "' not found in the design";
+      throw std::runtime_error(strm.str());
+    }
+
+    auto const& type_name = obj->second->type->name;
+    Variable::Kind kind;
+    if( type_name == "float" )
+      kind = Variable::floating;
+    else if( type_name == "int" )
+      kind = Variable::integer;
+    else if( type_name == "bool" )
+      kind = Variable::boolean;
+    else {
+      std::stringstream strm;
+      strm << "Variable '" << name << "' of type '" << type_name
+        << "' can not be swept or recorded";
+      throw std::runtime_error(strm.str());
+    }
+
+    return Variable{insp, member, kind};
+  }
+
+
+  static double get_value(Variable& var) {
+    switch( var.kind ) {
+      case Variable::floating:
+        return var.insp.get<double>(var.member);
+      case Variable::integer:
+        return var.insp.get<int64_t>(var.member);
+      case Variable::boolean:
+        return var.insp.get<bool>(var.member);
+    }
+
+    return 0.0;
+  }
+
+
+  static void set_initial(Variable& var, double value) {
+    switch( var.kind ) {
+      case Variable::floating:
+        var.insp.set_initial<double>(var.member, value);
+        break;
+      case Variable::integer:
+        var.insp.set_initial<int64_t>(var.member, std::llround(value));
+        break;
+      case Variable::boolean:
+        var.insp.set_initial<bool>(var.member, value != 0.0);
+        break;
+    }
+  }
+
+
+  static void run_point(Simulation_engine& design,
+      std::string const& toplevel,
+      std::vector<Sweep_parameter> const& params,
+      Sweep_options const& options,
+      std::size_t index,
+      std::mutex& out_mutex,
+      Sweep_writer& out) {
+    Simulation_engine engine(design, toplevel);
+    engine.seed(run_seed(options.seed, index));
+    engine.setup();
+
+    auto point = sweep_point(params, index);
+    for(std::size_t i=0; i<params.size(); ++i) {
+      auto var = find_variable(engine, params[i].name);
+      set_initial(var, point[i]);
+    }
+
+    std::vector<Variable> record;
+    for(auto const& name : options.record)
+      record.push_back(find_variable(engine, name));
+
+    std::vector<double> values(record.size());
+    auto write_row = [&]() {
+      for(std::size_t i=0; i<record.size(); ++i)
+        values[i] = get_value(record[i]);
+
+      std::lock_guard<std::mutex> lock(out_mutex);
+      out.row(index, point, engine.time(), values);
+    };
+
+    auto end = options.duration.value(ir::Time::ps);
+    auto period = options.sample_period.value(ir::Time::ps);
+    if( period > 0 ) {
+      write_row();
+      for(long long t=0; t<end; t+=period) {
+        engine.simulate(ir::Time(std::min(period, end - t), ir::Time::ps));
+        write_row();
+      }
+    } else {
+      if( end > 0 )
+        engine.simulate(ir::Time(end, ir::Time::ps));
+      write_row();
+    }
+
+    engine.teardown();
+  }
+
+
+  template<typename T>
+  static void put(std::ostream& os, T v) {
+    os.write(reinterpret_cast<char const*>(&v), sizeof(v));
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
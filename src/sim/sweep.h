@@ -0,0 +1,145 @@
+#pragma once
+
+#include "sim/simulation_engine.h"
+#include "ir/time.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace sim {
+
+  /** Values of one variable in a parameter sweep */
+  struct Sweep_parameter {
+    /** Member of the top level module, or instance path and member like
+     * "cpu.alu.width" */
+    std::string name;
+    std::vector<double> values;
+  };
+
+
+  /** Parse a sweep specification
+   *
+   * Parameters are separated by ';', each is "<variable>=<values>" with
+   * values given as list "v1,v2,..." or as range "<begin>:<end>:<step>"
+   * including end, e.g. "gl=0.05:0.2:0.05;vthresh=-55,-50".
+   * */
+  std::vector<Sweep_parameter> parse_sweep(std::string const& spec);
+
+  /** Number of points in the cartesian product of the parameters */
+  std::size_t num_sweep_points(std::vector<Sweep_parameter> const& params);
+
+  /** Parameter values of a point, the last parameter changes fastest */
+  std::vector<double> sweep_point(std::vector<Sweep_parameter> const& params,
+      std::size_t index);
+
+  /** Seed for run index derived from seed, independent of the order in
+   * which runs are executed */
+  uint64_t run_seed(uint64_t seed, std::size_t index);
+
+
+  /** Receives the results of a parameter sweep
+   *
+   * Rows are passed in the order in which points finish, which differs from
+   * the order of the points if several threads are used. Calls are
+   * serialized by run_sweep().
+   * */
+  class Sweep_writer {
+    public:
+      virtual ~Sweep_writer() {}
+
+      virtual void header(std::vector<Sweep_parameter> const& params,
+          std::vector<std::string> const& record) = 0;
+
+      /** Values of the recorded variables of point index at time t */
+      virtual void row(std::size_t index,
+          std::vector<double> const& point,
+          ir::Time const& t,
+          std::vector<double> const& values) = 0;
+  };
+
+
+  /** Write sweep results as CSV, one line per row */
+  class Csv_sweep_writer : public Sweep_writer {
+    public:
+      explicit Csv_sweep_writer(std::ostream& os);
+
+      virtual void header(std::vector<Sweep_parameter> const& params,
+          std::vector<std::string> const& record);
+      virtual void row(std::size_t index,
+          std::vector<double> const& point,
+          ir::Time const& t,
+          std::vector<double> const& values);
+
+    private:
+      std::ostream& m_os;
+  };
+
+
+  /** Write sweep results in a compact binary format
+   *
+   * Little endian: "CELLSWEP", u32 version, u32 number of parameters, u32
+   * number of recorded variables, per name u32 length and characters
+   * (parameters first), then per row u64 point index, i64 time in ps,
+   * double parameter values and double recorded values.
+   * */
+  class Binary_sweep_writer : public Sweep_writer {
+    public:
+      explicit Binary_sweep_writer(std::ostream& os);
+
+      virtual void header(std::vector<Sweep_parameter> const& params,
+          std::vector<std::string> const& record);
+      virtual void row(std::size_t index,
+          std::vector<double> const& point,
+          ir::Time const& t,
+          std::vector<double> const& values);
+
+    private:
+      std::ostream& m_os;
+  };
+
+
+  /** Options of run_sweep() */
+  struct Sweep_options {
+    /** Simulated time of every point */
+    ir::Time duration;
+
+    /** Variables whose values are written, named like parameters */
+    std::vector<std::string> record;
+
+    /** Write the recorded variables every period, only at the end if zero */
+    ir::Time sample_period;
+
+    /** Number of threads, 0 for the number of cores */
+    unsigned threads = 0;
+
+    /** Seed of the random number generators, see run_seed() */
+    uint64_t seed = 1;
+  };
+
+
+  /** Simulate every point of a parameter sweep
+   *
+   * @param design Engine the design was compiled by, see
+   *   Simulation_engine(Simulation_engine&, std::string const&)
+   * @param toplevel Top level module, empty for the one of design
+   * @return Number of simulated points
+   *
+   * The design is compiled only once. Points are simulated on a pool of
+   * threads, each by an engine with private frames sharing the code of
+   * design. After __init__ the parameters of the point override the values
+   * of their variables (float, int or bool) with
+   * Module_inspector::set_initial(). Results are passed to out as soon as
+   * a point finishes. The first error stops the sweep and is rethrown.
+   * */
+  std::size_t run_sweep(Simulation_engine& design,
+      std::string const& toplevel,
+      std::vector<Sweep_parameter> const& params,
+      Sweep_options const& options,
+      Sweep_writer& out);
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,126 @@
+#include "trace_db.h"
+
+
+namespace sim {
+
+  Trace_db::Trace_db()
+    : m_logger(log4cxx::Logger::getLogger("cell.trace")) {
+  }
+
+
+  void
+  Trace_db::push_hierarchy() {
+  }
+
+
+  void
+  Trace_db::pop_hierarchy() {
+  }
+
+
+  void
+  Trace_db::register_module(std::shared_ptr<Module_inspector> insp) {
+    auto mod = insp->module();
+    LOG4CXX_DEBUG(m_logger, "register module '"
+        << mod->name
+        << "'");
+
+    auto prefix = insp->path().empty() ? mod->name : insp->path();
+
+    for(std::size_t i=0; i<insp->num_elements(); ++i) {
+      if( !insp->has_object(i) )
+        continue;
+
+      auto obj = insp->get_object(i);
+      // Don't include pointers to instantiated modules
+      if( mod->instantiations.count(obj->name) != 0 )
+        continue;
+      if( !insp->selected(i) )
+        continue;
+
+      auto ofs = insp->layout()->getElementOffset(i);
+      auto ty = obj->type->impl.type;
+      auto name = prefix + '.' + obj->name;
+
+      if( !obj->type->elements.empty() ) {
+        auto str_ty = llvm::cast<llvm::StructType>(ty);
+        auto str_lay = insp->data_layout()->getStructLayout(str_ty);
+        std::size_t j = 0;
+        for(auto const& elem : obj->type->elements) {
+          add_signal(insp,
+              ofs + str_lay->getElementOffset(j),
+              str_ty->getElementType(j),
+              name + '.' + elem.first);
+          ++j;
+        }
+      } else {
+        add_signal(insp, ofs, ty, name);
+      }
+    }
+  }
+
+
+  void
+  Trace_db::initial(ir::Time const& t) {
+    record(t);
+  }
+
+
+  void
+  Trace_db::step(ir::Time const& t) {
+    record(t);
+  }
+
+
+  std::size_t
+  Trace_db::num_changes() const {
+    std::size_t rv = 0;
+    for(auto const& sig : m_signals)
+      rv += sig.series.size();
+    return rv;
+  }
+
+
+  Trace_db::Signal_id
+  Trace_db::find(std::string const& name) const {
+    auto it = m_names.find(name);
+    if( it == m_names.end() ) {
+      std::stringstream strm;
+      strm << "signal '" << name << "' not found in trace";
+      throw std::runtime_error(strm.str());
+    }
+
+    return it->second;
+  }
+
+
+  void
+  Trace_db::add_signal(std::shared_ptr<Module_inspector> const& insp,
+      std::size_t offset,
+      llvm::Type* type,
+      std::string const& name) {
+    auto width = insp->data_layout()->getTypeSizeInBits(type);
+    if( width == 0 )
+      return;
+
+    Signal sig(insp->data_layout()->getTypeStoreSize(type));
+    sig.name = name;
+    sig.width = width;
+    sig.frame = insp->frame();
+    sig.offset = offset;
+
+    m_names[name] = m_signals.size();
+    m_signals.push_back(std::move(sig));
+  }
+
+
+  void
+  Trace_db::record(ir::Time const& t) {
+    auto t_ps = ps(t);
+    for(auto& sig : m_signals)
+      sig.series.update(t_ps, sig.frame->data() + sig.offset);
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "sim/instrumenter_if.h"
+#include "sim/trace_series.h"
+
+#include "logging/logger.h"
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <unordered_map>
+
+
+namespace sim {
+
+  /** Record signal changes in memory for queries after the simulation
+   *
+   * Keeps a Trace_series for every signal passed by the engine, so checks
+   * can run in the same process without writing and parsing a dump file.
+   * Signals are named by their hierarchical path, e.g. test.cpu.pc or
+   * test.bus.addr for an element of a structure.
+   *
+   * Values are the raw bytes of the module frame. The typed queries copy
+   * at most sizeof(T) bytes into a zero initialized T.
+   * */
+  class Trace_db : public Instrumenter_if {
+    public:
+      typedef std::size_t Signal_id;
+
+      /** Change of a signal returned by edges() */
+      template<typename T>
+      struct Change {
+        ir::Time time;
+        T value;
+      };
+
+
+      Trace_db();
+
+      virtual void push_hierarchy();
+      virtual void pop_hierarchy();
+      virtual void register_module(std::shared_ptr<Module_inspector> insp);
+      virtual void initial(ir::Time const& t);
+      virtual void step(ir::Time const& t);
+
+
+      /** Number of recorded signals */
+      std::size_t num_signals() const { return m_signals.size(); }
+
+      /** Total number of recorded changes of all signals */
+      std::size_t num_changes() const;
+
+      /** Hierarchical name of a signal */
+      std::string const& name(Signal_id id) const {
+        return m_signals.at(id).name;
+      }
+
+      /** Width of a signal in bits */
+      std::size_t width(Signal_id id) const {
+        return m_signals.at(id).width;
+      }
+
+      /** Find a signal by hierarchical name, throws if it does not exist */
+      Signal_id find(std::string const& name) const;
+
+      /** Recorded changes of a signal */
+      Trace_series const& series(Signal_id id) const {
+        return m_signals.at(id).series;
+      }
+
+
+      /** Value of a signal at time t
+       *
+       * Throws if t is before the first recorded value.
+       * */
+      template<typename T>
+      T value_at(Signal_id id, ir::Time const& t) const {
+        auto const& s = series(id);
+        std::vector<char> buf(s.value_size());
+        if( !s.value_at(ps(t), buf.data()) ) {
+          std::stringstream strm;
+          strm << "no value of signal '" << name(id) << "' recorded at "
+            << t;
+          throw std::runtime_error(strm.str());
+        }
+
+        return convert<T>(s, buf.data());
+      }
+
+
+      /** All changes of a signal with t0 <= time <= t1 */
+      template<typename T>
+      std::vector<Change<T>> edges(Signal_id id,
+          ir::Time const& t0,
+          ir::Time const& t1) const {
+        std::vector<Change<T>> rv;
+        auto const& s = series(id);
+        s.for_each(ps(t0), ps(t1), [&](uint64_t t, char const* value) {
+          Change<T> c;
+          c.time = ir::Time(t, ir::Time::ps);
+          c.value = convert<T>(s, value);
+          rv.push_back(c);
+        });
+        return rv;
+      }
+
+
+      /** Call fn(time, value) for all changes with t0 <= time <= t1
+       *
+       * Like edges() without building a vector.
+       * */
+      template<typename T, typename Fn>
+      void for_each(Signal_id id,
+          ir::Time const& t0,
+          ir::Time const& t1,
+          Fn fn) const {
+        auto const& s = series(id);
+        s.for_each(ps(t0), ps(t1), [&](uint64_t t, char const* value) {
+          fn(ir::Time(t, ir::Time::ps), convert<T>(s, value));
+        });
+      }
+
+
+      /** Find the first time >= t0 at which pred(value) holds
+       *
+       * @return false if the predicate never holds from t0 on
+       * */
+      template<typename T, typename Pred>
+      bool first(Signal_id id,
+          ir::Time const& t0,
+          Pred pred,
+          ir::Time& t) const {
+        auto const& s = series(id);
+        uint64_t found;
+        if( !s.find_first(ps(t0),
+              [&](char const* value) { return pred(convert<T>(s, value)); },
+              found) )
+          return false;
+
+        t = ir::Time(found, ir::Time::ps);
+        return true;
+      }
+
+
+    private:
+      struct Signal {
+        std::string name;
+        std::size_t width;
+        Runset::Module_frame frame;
+        std::size_t offset;
+        Trace_series series;
+
+        Signal(std::size_t size) : series(size) {}
+      };
+
+      std::vector<Signal> m_signals;
+      std::unordered_map<std::string,Signal_id> m_names;
+      log4cxx::LoggerPtr m_logger;
+
+      void add_signal(std::shared_ptr<Module_inspector> const& insp,
+          std::size_t offset,
+          llvm::Type* type,
+          std::string const& name);
+      void record(ir::Time const& t);
+
+      static uint64_t ps(ir::Time const& t) {
+        return t.value(ir::Time::ps);
+      }
+
+      template<typename T>
+      static T convert(Trace_series const& s, char const* value) {
+        T rv = T();
+        std::memcpy(&rv, value, std::min(sizeof(T), s.value_size()));
+        return rv;
+      }
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,93 @@
+#include "trace_series.h"
+
+
+namespace sim {
+
+  Trace_series::Trace_series(std::size_t value_size)
+    : m_value_size(value_size),
+      m_last(value_size) {
+  }
+
+
+  bool
+  Trace_series::update(uint64_t t, char const* value) {
+    if( (m_size > 0) && (std::memcmp(m_last.data(), value, m_value_size) == 0) )
+      return false;
+
+    if( m_size % block_changes == 0 ) {
+      Block blk;
+      blk.time = t;
+      blk.offset = m_data.size();
+      m_index.push_back(blk);
+      m_data.insert(m_data.end(), value, value + m_value_size);
+    } else {
+      put_varint(t - m_last_time);
+      if( m_value_size <= sizeof(uint64_t) ) {
+        uint64_t a = 0, b = 0;
+        std::memcpy(&a, m_last.data(), m_value_size);
+        std::memcpy(&b, value, m_value_size);
+        put_varint(a ^ b);
+      } else {
+        m_data.insert(m_data.end(), value, value + m_value_size);
+      }
+    }
+
+    std::copy_n(value, m_value_size, m_last.begin());
+    m_last_time = t;
+    ++m_size;
+    return true;
+  }
+
+
+  bool
+  Trace_series::value_at(uint64_t t, char* dst) const {
+    if( (m_size == 0) || (t < m_index.front().time) )
+      return false;
+
+    if( t >= m_last_time ) {
+      std::copy_n(m_last.begin(), m_value_size, dst);
+      return true;
+    }
+
+    Decoder dec(*this, last_block(t));
+    while( dec.next() && (dec.time() <= t) )
+      std::copy_n(dec.value(), m_value_size, dst);
+
+    return true;
+  }
+
+
+  std::size_t
+  Trace_series::first_block(uint64_t t) const {
+    auto it = std::lower_bound(m_index.begin(),
+        m_index.end(),
+        t,
+        [](Block const& blk, uint64_t t) { return blk.time < t; });
+
+    return (it == m_index.begin()) ? 0 : (it - m_index.begin() - 1);
+  }
+
+
+  std::size_t
+  Trace_series::last_block(uint64_t t) const {
+    auto it = std::upper_bound(m_index.begin(),
+        m_index.end(),
+        t,
+        [](uint64_t t, Block const& blk) { return t < blk.time; });
+
+    return (it == m_index.begin()) ? 0 : (it - m_index.begin() - 1);
+  }
+
+
+  void
+  Trace_series::put_varint(uint64_t v) {
+    while( v >= 0x80 ) {
+      m_data.push_back(static_cast<char>((v & 0x7f) | 0x80));
+      v >>= 7;
+    }
+    m_data.push_back(static_cast<char>(v));
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+
+namespace sim {
+
+  /** Compressed time series of the values of one signal
+   *
+   * Stores only changes. Changes are grouped into blocks of
+   * block_changes entries, each block starts with the full value and the
+   * remaining entries are encoded relative to their predecessor: the time
+   * as varint delta and the value as varint of the XOR with the previous
+   * value for values up to 8 bytes, raw bytes otherwise. The start times
+   * of all blocks are kept in an index, so queries binary search the
+   * index and decode at most one block before reaching the first
+   * relevant change.
+   *
+   * Times are unsigned integers, Trace_db uses picoseconds.
+   * */
+  class Trace_series {
+    public:
+      static std::size_t const block_changes = 128;
+
+
+      /** @param value_size Size of a value in bytes */
+      explicit Trace_series(std::size_t value_size);
+
+      /** Append value at time t if it differs from the last value
+       *
+       * @return true if a change was recorded
+       *
+       * Times must not decrease. The first value is always recorded.
+       * */
+      bool update(uint64_t t, char const* value);
+
+      /** Number of recorded changes */
+      std::size_t size() const { return m_size; }
+
+      /** Size of a value in bytes */
+      std::size_t value_size() const { return m_value_size; }
+
+      /** Size of the encoded changes and the index in bytes */
+      std::size_t memory_size() const {
+        return m_data.size() + m_index.size() * sizeof(Block);
+      }
+
+      /** Time of the first change, only valid if size() > 0 */
+      uint64_t begin_time() const { return m_index.front().time; }
+
+      /** Time of the last change, only valid if size() > 0 */
+      uint64_t end_time() const { return m_last_time; }
+
+      /** Last recorded value, only valid if size() > 0 */
+      char const* last_value() const { return m_last.data(); }
+
+
+      /** Copy the value valid at time t to dst
+       *
+       * @return false if t is before the first change, dst is not modified
+       * */
+      bool value_at(uint64_t t, char* dst) const;
+
+
+      /** Call fn(t, value) for every change with t0 <= t <= t1
+       *
+       * value points to value_size() bytes valid during the call.
+       * */
+      template<typename Fn>
+      void for_each(uint64_t t0, uint64_t t1, Fn fn) const {
+        if( (m_size == 0) || (t1 < t0) )
+          return;
+
+        Decoder dec(*this, first_block(t0));
+        while( dec.next() ) {
+          if( dec.time() > t1 )
+            break;
+          if( dec.time() >= t0 )
+            fn(dec.time(), dec.value());
+        }
+      }
+
+
+      /** Find the first time t >= t0 at which pred(value) holds
+       *
+       * @return false if pred holds for no value from t0 on
+       *
+       * If the value valid at t0 satisfies the predicate t is t0. Times
+       * before the first change are not considered.
+       * */
+      template<typename Pred>
+      bool find_first(uint64_t t0, Pred pred, uint64_t& t) const {
+        if( m_size == 0 )
+          return false;
+
+        Decoder dec(*this, last_block(t0));
+        bool have_prev = false;
+        std::vector<char> prev(m_value_size);
+
+        while( dec.next() ) {
+          if( dec.time() > t0 ) {
+            // the value valid at t0 was set by the previous change
+            if( have_prev && pred(prev.data()) ) {
+              t = t0;
+              return true;
+            }
+            break;
+          }
+          std::copy_n(dec.value(), m_value_size, prev.begin());
+          have_prev = true;
+        }
+
+        if( dec.done() ) {
+          if( have_prev && pred(prev.data()) ) {
+            t = t0;
+            return true;
+          }
+          return false;
+        }
+
+        // dec is at the first change after t0
+        do {
+          if( pred(dec.value()) ) {
+            t = dec.time();
+            return true;
+          }
+        } while( dec.next() );
+
+        return false;
+      }
+
+
+    private:
+      struct Block {
+        uint64_t time;
+        std::size_t offset;
+      };
+
+
+      /** Sequential decoder starting at a block */
+      class Decoder {
+        public:
+          Decoder(Trace_series const& series, std::size_t block)
+            : m_series(series),
+              m_block(block),
+              m_value(series.m_value_size) {
+            m_remaining = series.m_size - block * block_changes;
+          }
+
+          /** Decode the next change, false at the end of the series */
+          bool next() {
+            if( m_remaining == 0 ) {
+              m_done = true;
+              return false;
+            }
+
+            if( m_pos == 0 )
+              start_block();
+            else
+              decode_delta();
+
+            --m_remaining;
+            if( ++m_pos == block_changes ) {
+              m_pos = 0;
+              ++m_block;
+            }
+            return true;
+          }
+
+          bool done() const { return m_done; }
+          uint64_t time() const { return m_time; }
+          char const* value() const { return m_value.data(); }
+
+
+        private:
+          Trace_series const& m_series;
+          std::size_t m_block;
+          std::size_t m_pos = 0;
+          std::size_t m_remaining;
+          char const* m_p = nullptr;
+          uint64_t m_time = 0;
+          std::vector<char> m_value;
+          bool m_done = false;
+
+          void start_block() {
+            m_p = m_series.m_data.data() + m_series.m_index[m_block].offset;
+            m_time = m_series.m_index[m_block].time;
+            std::memcpy(m_value.data(), m_p, m_value.size());
+            m_p += m_value.size();
+          }
+
+          void decode_delta() {
+            m_time += get_varint();
+            if( m_value.size() <= sizeof(uint64_t) ) {
+              uint64_t v = 0;
+              std::memcpy(&v, m_value.data(), m_value.size());
+              v ^= get_varint();
+              std::memcpy(m_value.data(), &v, m_value.size());
+            } else {
+              std::memcpy(m_value.data(), m_p, m_value.size());
+              m_p += m_value.size();
+            }
+          }
+
+          uint64_t get_varint() {
+            uint64_t v = 0;
+            for(unsigned shift=0; ; shift+=7) {
+              auto c = static_cast<unsigned char>(*m_p++);
+              v |= static_cast<uint64_t>(c & 0x7f) << shift;
+              if( !(c & 0x80) )
+                return v;
+            }
+          }
+      };
+
+
+      std::size_t m_value_size;
+      std::size_t m_size = 0;
+      std::vector<char> m_data;
+      std::vector<Block> m_index;
+      std::vector<char> m_last;
+      uint64_t m_last_time = 0;
+
+      /** Index of the block holding the first change at or after t */
+      std::size_t first_block(uint64_t t) const;
+      /** Index of the block holding the last change at or before t, or 0 */
+      std::size_t last_block(uint64_t t) const;
+      void put_varint(uint64_t v);
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -1,21 +1,20 @@
 #include "vcd_instrumenter.h"
 
 #include <bitset>
+#include <cstring>
 
 
 namespace sim {
 
   // local helper functions
   static std::string reference(std::size_t i);
-  static std::size_t write_value(std::ostream& os,
-      std::shared_ptr<Module_inspector> const& insp,
-      std::size_t index,
-      std::size_t ref);
 
 
 
-  Vcd_instrumenter::Vcd_instrumenter(std::string const& filename)
+  Vcd_instrumenter::Vcd_instrumenter(std::string const& filename,
+      bool changes_only)
     : m_filename(filename),
+      m_changes_only(changes_only),
       m_logger(log4cxx::Logger::getLogger("cell.vcd")) {
     m_os.open(filename);
     if( !m_os ) {
@@ -69,6 +68,12 @@ namespace sim {
   }
 
 
+  void
+  Vcd_instrumenter::teardown() {
+    m_os.flush();
+  }
+
+
   void
   Vcd_instrumenter::write_vcd_header(std::ostream& os, ir::Time const& t) {
     LOG4CXX_TRACE(m_logger, "writing VCD header");
@@ -117,13 +122,24 @@ namespace sim {
       << mod->name
       << " $end\n";
 
+    auto const float_type = ir::Builtins<sim::Llvm_impl>::types().at("float");
+
     for(std::size_t i=0; i<insp->num_elements(); ++i) {
+      if( !insp->has_object(i) )
+        continue;
+
       auto obj = insp->get_object(i);
       // Don't include pointers to instantiated modules
       if( mod->instantiations.count(obj->name) != 0 )
         continue;
+      if( !insp->selected(i) )
+        continue;
 
-      if( obj->type == ir::Builtins<sim::Llvm_impl>::types["float"] ) {
+      auto ofs = insp->layout()->getElementOffset(i);
+      auto ty = obj->type->impl.type;
+
+      if( obj->type == float_type ) {
+        add_signal(insp, ofs, ty, Signal::real);
         os << "$var "
           << "real 1 "
           << reference(m_ref_counter++)
@@ -132,9 +148,18 @@ namespace sim {
           << " $end\n";
       } else if( !obj->type->elements.empty() ) {
         auto bits = insp->get_element_bits(i);
+        auto str_ty = llvm::cast<llvm::StructType>(ty);
+        auto str_lay = insp->data_layout()->getStructLayout(str_ty);
         std::size_t j = 0;
         for(auto const& elem : obj->type->elements) {
-          if( elem.second->type == ir::Builtins<sim::Llvm_impl>::types["float"] )
+          // get_element_bits() returns elements in struct order
+          add_signal(insp,
+              ofs + str_lay->getElementOffset(j),
+              str_ty->getElementType(j),
+              (elem.second->type == float_type)
+                ? Signal::real : Signal::integer);
+
+          if( elem.second->type == float_type )
             os << "$var "
               << "real 1 "
               << reference(m_ref_counter++)
@@ -160,6 +185,7 @@ namespace sim {
         auto bits = insp->get_bits(i);
 
         if( bits.size() > 0 ) {
+          add_signal(insp, ofs, ty, Signal::integer);
           os << "$var "
             << "integer "
             << bits.size()
@@ -177,10 +203,10 @@ namespace sim {
   Vcd_instrumenter::write_dump_all(std::ostream& os) {
     os << "$dumpvars\n";
 
-    std::size_t ref_counter = 0;
-    for(auto const& insp : m_inspected) {
-      for(std::size_t i=0; i<insp->num_elements(); ++i)
-        ref_counter = write_value(os, insp, i, ref_counter);
+    for(auto const& sig : m_signals) {
+      auto value = sig.frame->data() + sig.offset;
+      std::copy_n(value, sig.size, m_last_values.begin() + sig.last);
+      write_signal(os, sig);
     }
 
     os << "$end\n";
@@ -190,13 +216,77 @@ namespace sim {
   void
   Vcd_instrumenter::write_update(std::ostream& os,
       ir::Time const& t) {
-    os << '#' << t.value(m_unit) << '\n';
+    if( !m_changes_only ) {
+      os << '#' << t.value(m_unit) << '\n';
+
+      for(auto const& sig : m_signals)
+        write_signal(os, sig);
+      m_num_changes += m_signals.size();
+      return;
+    }
+
+    // the time stamp is only written if any signal changed
+    bool time_written = false;
+
+    for(auto const& sig : m_signals) {
+      auto value = sig.frame->data() + sig.offset;
+      auto last = &m_last_values[sig.last];
+
+      if( std::memcmp(value, last, sig.size) == 0 )
+        continue;
+
+      if( !time_written ) {
+        os << '#' << t.value(m_unit) << '\n';
+        time_written = true;
+      }
+
+      std::copy_n(value, sig.size, last);
+      write_signal(os, sig);
+      ++m_num_changes;
+    }
+  }
 
-    std::size_t ref_counter = 0;
-    for(auto const& insp : m_inspected) {
-      for(std::size_t i=0; i<insp->num_elements(); ++i)
-        ref_counter = write_value(os, insp, i, ref_counter);
+
+  void
+  Vcd_instrumenter::add_signal(std::shared_ptr<Module_inspector> const& insp,
+      std::size_t offset,
+      llvm::Type* type,
+      Signal::Kind kind) {
+    auto lay = insp->data_layout();
+
+    Signal sig;
+    sig.frame = insp->frame();
+    sig.offset = offset;
+    sig.width = lay->getTypeSizeInBits(type);
+    sig.size = lay->getTypeStoreSize(type);
+    sig.last = m_last_values.size();
+    sig.kind = kind;
+    sig.ref = reference(m_ref_counter);
+
+    m_last_values.resize(m_last_values.size() + sig.size, 0);
+    m_signals.push_back(sig);
+  }
+
+
+  void
+  Vcd_instrumenter::write_signal(std::ostream& os, Signal const& sig) {
+    auto value = sig.frame->data() + sig.offset;
+
+    if( sig.kind == Signal::real ) {
+      double v;
+      std::memcpy(&v, value, sizeof(v));
+      os << 'r' << v << ' ' << sig.ref << '\n';
+      return;
+    }
+
+    // most significant bit first, like boost::dynamic_bitset
+    m_buffer.resize(sig.width);
+    for(std::size_t i=0; i<sig.width; ++i) {
+      auto bit = (value[i / 8] >> (i % 8)) & 1;
+      m_buffer[sig.width - 1 - i] = bit ? '1' : '0';
     }
+
+    os << 'b' << m_buffer << ' ' << sig.ref << '\n';
   }
 
 
@@ -217,48 +307,6 @@ namespace sim {
 
     return rv;
   }
-
-
-
-  static std::size_t write_value(std::ostream& os,
-      std::shared_ptr<Module_inspector> const& insp,
-      std::size_t index,
-      std::size_t ref) {
-    auto mod = insp->module();
-    auto obj = insp->get_object(index);
-
-    if( mod->instantiations.count(obj->name) != 0 )
-      return ref;
-
-    if( obj->type == ir::Builtins<sim::Llvm_impl>::types["float"] ) {
-      os << 'r'
-        << insp->get<double>(index)
-        << ' '
-        << reference(ref++)
-        << '\n';
-    } else if( !obj->type->elements.empty() ) {
-      auto bits = insp->get_element_bits(index);
-
-      for(auto const& b : bits) {
-        os << 'b'
-          << b
-          << ' '
-          << reference(ref++)
-          << '\n';
-      }
-    } else {
-      auto bits = insp->get_bits(index);
-      if( bits.size() > 0 ) {
-        os << 'b'
-          << bits
-          << ' '
-          << reference(ref++)
-          << '\n';
-      }
-    }
-
-    return ref;
-  }
 }
 
 /* vim: set et ff=unix sts=2 sw=2 ts=2 : */
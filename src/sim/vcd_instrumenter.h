@@ -6,23 +6,53 @@
 
 #include <string>
 #include <fstream>
+#include <vector>
 
 
 namespace sim {
 
   class Vcd_instrumenter : public Instrumenter_if {
     public:
-      Vcd_instrumenter(std::string const& filename);
+      /** Write signal values to a VCD file
+       *
+       * @param filename Name of the VCD file.
+       * @param changes_only Write only signals that changed since the last
+       *   step. Otherwise all signals are written in every step.
+       * */
+      Vcd_instrumenter(std::string const& filename, bool changes_only = true);
 
       virtual void push_hierarchy();
       virtual void pop_hierarchy();
       virtual void register_module(std::shared_ptr<Module_inspector> insp);
       virtual void initial(ir::Time const& t);
       virtual void step(ir::Time const& t);
+      virtual void teardown();
+
+
+      /** Number of value changes written after the initial dump */
+      std::size_t num_changes() const { return m_num_changes; }
 
 
     protected:
+      /** Dumped signal, created at register_module() */
+      struct Signal {
+        enum Kind { integer, real };
+
+        Runset::Module_frame frame;
+        std::size_t offset;  /**< offset in frame in bytes */
+        std::size_t width;   /**< width in bits */
+        std::size_t size;    /**< size in bytes */
+        std::size_t last;    /**< offset of last value in m_last_values */
+        Kind kind;
+        std::string ref;
+      };
+
       std::string m_filename;
+      bool m_changes_only;
+      std::vector<Signal> m_signals;
+      std::vector<char> m_last_values;
+      std::string m_buffer;
+      std::size_t m_num_changes = 0;
       std::ofstream m_os;
       bool m_initial = true;
       ir::Time::Unit m_unit;
@@ -36,6 +66,11 @@ namespace sim {
       virtual void write_dump_all(std::ostream& os);
       virtual void write_update(std::ostream& os,
           ir::Time const& t);
+      void add_signal(std::shared_ptr<Module_inspector> const& insp,
+          std::size_t offset,
+          llvm::Type* type,
+          Signal::Kind kind);
+      void write_signal(std::ostream& os, Signal const& sig);
   };
 
 }
@@ -0,0 +1,125 @@
+#include "wave_instrumenter.h"
+
+#include <cstring>
+
+
+namespace sim {
+
+  Wave_instrumenter::Wave_instrumenter(std::string const& filename,
+      std::size_t block_steps)
+    : m_writer(filename, block_steps),
+      m_logger(log4cxx::Logger::getLogger("cell.wave")) {
+    LOG4CXX_INFO(m_logger, "Opened '" << filename << "' for waveform output");
+  }
+
+
+  void
+  Wave_instrumenter::push_hierarchy() {
+  }
+
+
+  void
+  Wave_instrumenter::pop_hierarchy() {
+    m_scopes.pop_back();
+  }
+
+
+  void
+  Wave_instrumenter::register_module(std::shared_ptr<Module_inspector> insp) {
+    auto mod = insp->module();
+    LOG4CXX_DEBUG(m_logger, "register module '"
+        << mod->name
+        << "'");
+
+    auto parent = m_scopes.empty() ? -1 : m_scopes.back();
+    m_scopes.push_back(m_writer.add_scope(parent, mod->name));
+
+    auto const& float_type = ir::Builtins<sim::Llvm_impl>::types().at("float");
+
+    for(std::size_t i=0; i<insp->num_elements(); ++i) {
+      if( !insp->has_object(i) )
+        continue;
+
+      auto obj = insp->get_object(i);
+      // Don't include pointers to instantiated modules
+      if( mod->instantiations.count(obj->name) != 0 )
+        continue;
+      if( !insp->selected(i) )
+        continue;
+
+      auto ofs = insp->layout()->getElementOffset(i);
+      auto ty = obj->type->impl.type;
+
+      if( obj->type == float_type ) {
+        add_signal(insp, ofs, ty, obj->name, wave::Signal::real);
+      } else if( !obj->type->elements.empty() ) {
+        auto str_ty = llvm::cast<llvm::StructType>(ty);
+        auto str_lay = insp->data_layout()->getStructLayout(str_ty);
+        std::size_t j = 0;
+        for(auto const& elem : obj->type->elements) {
+          add_signal(insp,
+              ofs + str_lay->getElementOffset(j),
+              str_ty->getElementType(j),
+              obj->name + '.' + elem.first,
+              (elem.second->type == float_type)
+                ? wave::Signal::real : wave::Signal::integer);
+          ++j;
+        }
+      } else {
+        add_signal(insp, ofs, ty, obj->name, wave::Signal::integer);
+      }
+    }
+  }
+
+
+  void
+  Wave_instrumenter::initial(ir::Time const& t) {
+    LOG4CXX_TRACE(m_logger, "initial dump");
+
+    m_values.resize(m_writer.values_size());
+    gather();
+    m_writer.initial(m_values.data());
+  }
+
+
+  void
+  Wave_instrumenter::step(ir::Time const& t) {
+    LOG4CXX_TRACE(m_logger, "step to time " << t);
+
+    gather();
+    m_writer.step(t.value(ir::Time::ps), m_values.data());
+  }
+
+
+  void
+  Wave_instrumenter::add_signal(std::shared_ptr<Module_inspector> const& insp,
+      std::size_t offset,
+      llvm::Type* type,
+      std::string const& name,
+      wave::Signal::Kind kind) {
+    auto width = insp->data_layout()->getTypeSizeInBits(type);
+    if( width == 0 )
+      return;
+
+    auto sig = m_writer.add_signal(m_scopes.back(), name, width, kind);
+
+    Source src;
+    src.frame = insp->frame();
+    src.offset = offset;
+    src.size = insp->data_layout()->getTypeStoreSize(type);
+    src.value_offset = m_writer.value_offset(sig);
+    m_sources.push_back(src);
+  }
+
+
+  void
+  Wave_instrumenter::gather() {
+    for(auto const& src : m_sources)
+      std::memcpy(&m_values[src.value_offset],
+          src.frame->data() + src.offset,
+          src.size);
+  }
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
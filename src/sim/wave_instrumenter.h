@@ -0,0 +1,63 @@
+#pragma once
+
+#include "sim/instrumenter_if.h"
+#include "wave/wave_writer.h"
+
+#include "logging/logger.h"
+
+#include <string>
+#include <vector>
+
+
+namespace sim {
+
+  /** Write signal values to a binary waveform file
+   *
+   * See wave/wave_format.h for the format. Use wave::Reader to read the
+   * file or wave2vcd to convert it to VCD.
+   * */
+  class Wave_instrumenter : public Instrumenter_if {
+    public:
+      /**
+       * @param filename Name of the waveform file
+       * @param block_steps Maximum number of simulation steps per block
+       * */
+      Wave_instrumenter(std::string const& filename,
+          std::size_t block_steps = 4096);
+
+      virtual void push_hierarchy();
+      virtual void pop_hierarchy();
+      virtual void register_module(std::shared_ptr<Module_inspector> insp);
+      virtual void initial(ir::Time const& t);
+      virtual void step(ir::Time const& t);
+
+      /** Finish the file, also called by the destructor */
+      virtual void teardown() { m_writer.close(); }
+
+
+    private:
+      /** Location of a signal in a module frame */
+      struct Source {
+        Runset::Module_frame frame;
+        std::size_t offset;
+        std::size_t size;
+        std::size_t value_offset;
+      };
+
+      wave::Writer m_writer;
+      std::vector<int64_t> m_scopes;
+      std::vector<Source> m_sources;
+      std::vector<char> m_values;
+      log4cxx::LoggerPtr m_logger;
+
+      void add_signal(std::shared_ptr<Module_inspector> const& insp,
+          std::size_t offset,
+          llvm::Type* type,
+          std::string const& name,
+          wave::Signal::Kind kind);
+      void gather();
+  };
+
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
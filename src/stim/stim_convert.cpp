@@ -0,0 +1,264 @@
+#include "stim/stim_convert.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace stim {
+
+  // local helper functions
+  static std::string read_section(std::istream& is);
+  static uint64_t parse_timescale(std::string const& ts);
+  static void parse_bits(std::string const& bits, std::vector<char>& value);
+  static void parse_number(std::string const& field, std::vector<char>& value);
+  static std::vector<std::string> split(std::string const& line);
+  static std::string trim(std::string const& s);
+
+
+
+  void convert_vcd(std::istream& is, Stimulus_writer& writer) {
+    std::vector<std::string> scopes;
+    std::map<std::string,std::vector<std::size_t>> ids;
+    std::vector<uint32_t> widths;
+    uint64_t scale = 1;
+    uint64_t t = 0;
+    std::vector<char> value;
+    std::string token;
+
+    auto assign = [&](std::string const& id) {
+      auto it = ids.find(id);
+      if( it == ids.end() ) {
+        std::stringstream strm;
+        strm << "Undeclared VCD identifier '" << id << "'";
+        throw std::runtime_error(strm.str());
+      }
+
+      for(auto sig : it->second) {
+        value.resize((widths[sig] + 7) / 8);
+        writer.add(t, sig, value.data());
+      }
+    };
+
+    while( is >> token ) {
+      if( token == "$scope" ) {
+        std::stringstream strm(read_section(is));
+        std::string type, name;
+        strm >> type >> name;
+        scopes.push_back(name);
+      } else if( token == "$upscope" ) {
+        read_section(is);
+        if( scopes.empty() )
+          throw std::runtime_error("Unbalanced $upscope in VCD file");
+        scopes.pop_back();
+      } else if( token == "$var" ) {
+        std::stringstream strm(read_section(is));
+        std::string type, id, name;
+        uint32_t width;
+        if( !(strm >> type >> width >> id >> name) )
+          throw std::runtime_error("Invalid $var in VCD file");
+
+        std::string path;
+        for(auto const& s : scopes)
+          path += s + ".";
+        path += name;
+
+        if( type == "real" )
+          width = 64;
+        ids[id].push_back(writer.add_signal(path, width));
+        widths.push_back(width);
+      } else if( token == "$timescale" ) {
+        scale = parse_timescale(read_section(is));
+      } else if( (token == "$dumpvars") || (token == "$dumpall")
+          || (token == "$dumpon") || (token == "$dumpoff")
+          || (token == "$end") ) {
+        // values within these sections are plain value changes
+      } else if( token[0] == '$' ) {
+        read_section(is);
+      } else if( token[0] == '#' ) {
+        t = std::stoull(token.substr(1)) * scale;
+      } else if( (token[0] == 'b') || (token[0] == 'B') ) {
+        std::string id;
+        is >> id;
+        auto it = ids.find(id);
+        value.resize(it != ids.end() ? (widths[it->second.front()] + 7) / 8 : 0);
+        parse_bits(token.substr(1), value);
+        assign(id);
+      } else if( (token[0] == 'r') || (token[0] == 'R') ) {
+        std::string id;
+        is >> id;
+        double v = std::stod(token.substr(1));
+        value.resize(sizeof(v));
+        std::memcpy(value.data(), &v, sizeof(v));
+        assign(id);
+      } else if( std::strchr("01xXzZ", token[0]) ) {
+        value.assign(1, token[0] == '1' ? 1 : 0);
+        assign(token.substr(1));
+      } else {
+        std::stringstream strm;
+        strm << "Unexpected token '" << token << "' in VCD file";
+        throw std::runtime_error(strm.str());
+      }
+    }
+  }
+
+
+  void convert_csv(std::istream& is, Stimulus_writer& writer) {
+    std::string line;
+    if( !std::getline(is, line) )
+      throw std::runtime_error("CSV file without header");
+
+    auto columns = split(line);
+    if( columns.size() < 2 )
+      throw std::runtime_error("CSV file needs a time and at least one signal column");
+
+    std::vector<std::size_t> signals;
+    std::vector<std::vector<char>> last(columns.size() - 1);
+    std::vector<bool> assigned(columns.size() - 1, false);
+    for(std::size_t i=1; i<columns.size(); ++i) {
+      uint32_t width = 64;
+      auto name = columns[i];
+      auto sep = name.find(':');
+      if( sep != std::string::npos ) {
+        width = std::stoul(name.substr(sep + 1));
+        name = name.substr(0, sep);
+      }
+
+      signals.push_back(writer.add_signal(name, width));
+      last[i - 1].resize((width + 7) / 8);
+    }
+
+    std::vector<char> value;
+    std::size_t line_no = 1;
+    while( std::getline(is, line) ) {
+      ++line_no;
+      if( trim(line).empty() )
+        continue;
+
+      auto fields = split(line);
+      if( fields.size() > columns.size() ) {
+        std::stringstream strm;
+        strm << "Too many fields in line " << line_no << " of CSV file";
+        throw std::runtime_error(strm.str());
+      }
+
+      uint64_t t = std::stoull(fields[0]);
+      for(std::size_t i=1; i<fields.size(); ++i) {
+        if( fields[i].empty() )
+          continue;
+
+        value.assign(last[i - 1].size(), 0);
+        parse_number(fields[i], value);
+        if( assigned[i - 1] && (value == last[i - 1]) )
+          continue;
+
+        writer.add(t, signals[i - 1], value.data());
+        last[i - 1] = value;
+        assigned[i - 1] = true;
+      }
+    }
+  }
+
+
+  /** Read tokens up to the next $end */
+  static std::string read_section(std::istream& is) {
+    std::string rv, token;
+    while( (is >> token) && (token != "$end") )
+      rv += token + " ";
+
+    return rv;
+  }
+
+
+  static uint64_t parse_timescale(std::string const& ts) {
+    std::string s;
+    for(auto c : ts) {
+      if( c != ' ' )
+        s.push_back(c);
+    }
+
+    std::size_t pos;
+    uint64_t n = std::stoull(s, &pos);
+    auto unit = s.substr(pos);
+
+    if( unit == "s" ) return n * 1000000000000ull;
+    if( unit == "ms" ) return n * 1000000000ull;
+    if( unit == "us" ) return n * 1000000ull;
+    if( unit == "ns" ) return n * 1000ull;
+    if( unit == "ps" ) return n;
+
+    std::stringstream strm;
+    strm << "Unsupported VCD timescale '" << ts << "'";
+    throw std::runtime_error(strm.str());
+  }
+
+
+  /** Binary digits, most significant first, x and z are 0 */
+  static void parse_bits(std::string const& bits, std::vector<char>& value) {
+    std::fill(value.begin(), value.end(), 0);
+    auto n = bits.size();
+    for(std::size_t i=0; (i < n) && (i / 8 < value.size()); ++i) {
+      if( bits[n - 1 - i] == '1' )
+        value[i / 8] |= 1 << (i % 8);
+    }
+  }
+
+
+  /** Decimal or 0x prefixed hexadecimal number */
+  static void parse_number(std::string const& field, std::vector<char>& value) {
+    if( (field.size() > 2) && (field[0] == '0')
+        && ((field[1] == 'x') || (field[1] == 'X')) ) {
+      std::string bits;
+      for(std::size_t i=2; i<field.size(); ++i) {
+        auto c = std::tolower(field[i]);
+        if( !std::isxdigit(c) )
+          throw std::runtime_error("Invalid hexadecimal value '" + field + "'");
+        int digit = (c >= 'a') ? (c - 'a' + 10) : (c - '0');
+        for(int b=3; b>=0; --b)
+          bits.push_back(((digit >> b) & 1) ? '1' : '0');
+      }
+      parse_bits(bits, value);
+      return;
+    }
+
+    std::size_t pos;
+    int64_t v = std::stoll(field, &pos);
+    if( pos != field.size() )
+      throw std::runtime_error("Invalid value '" + field + "'");
+
+    // two's complement, sign extended to the width of the signal
+    for(std::size_t i=0; i<value.size(); ++i)
+      value[i] = (i < sizeof(v)) ? char(v >> (8 * i)) : (v < 0 ? char(-1) : 0);
+  }
+
+
+  static std::vector<std::string> split(std::string const& line) {
+    std::vector<std::string> rv;
+    std::stringstream strm(line);
+    std::string field;
+
+    while( std::getline(strm, field, ',') )
+      rv.push_back(trim(field));
+    if( !line.empty() && (line.back() == ',') )
+      rv.push_back("");
+
+    return rv;
+  }
+
+
+  static std::string trim(std::string const& s) {
+    auto begin = s.find_first_not_of(" \t\r");
+    if( begin == std::string::npos )
+      return "";
+    auto end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
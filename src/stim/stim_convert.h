@@ -0,0 +1,31 @@
+#pragma once
+
+#include "stim/stim_file.h"
+
+#include <istream>
+
+
+namespace stim {
+
+  /** Convert a VCD file to stimulus events
+   *
+   * Signals are named by their scopes and name separated by '.', e.g.
+   * top.port.a. x and z bits are converted to 0, real values are stored
+   * as double. Times are scaled to picoseconds using $timescale.
+   * */
+  void convert_vcd(std::istream& is, Stimulus_writer& writer);
+
+  /** Convert a CSV file to stimulus events
+   *
+   * The first line names the columns. The first column holds the time in
+   * picoseconds, all other columns are signals given as name or name:width
+   * with a default width of 64 bits. Values are decimal or hexadecimal
+   * with prefix 0x, negative decimal values are stored as two's
+   * complement. Empty fields keep the signal unchanged, an event is only
+   * created if the value differs from the previous row.
+   * */
+  void convert_csv(std::istream& is, Stimulus_writer& writer);
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
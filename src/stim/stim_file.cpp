@@ -0,0 +1,264 @@
+#include "stim/stim_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace stim {
+
+  // local helper functions
+  static uint64_t align8(uint64_t n);
+
+
+
+  Stimulus_file::Stimulus_file(std::string const& filename)
+    : m_filename(filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if( fd < 0 ) {
+      std::stringstream strm;
+      strm << "Could not open stimulus file '" << filename << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    struct stat st;
+    if( (fstat(fd, &st) != 0) || (st.st_size < static_cast<off_t>(sizeof(Header))) ) {
+      close(fd);
+      std::stringstream strm;
+      strm << "Stimulus file '" << filename << "' is too small";
+      throw std::runtime_error(strm.str());
+    }
+
+    m_size = st.st_size;
+    m_addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( m_addr == MAP_FAILED ) {
+      m_addr = nullptr;
+      std::stringstream strm;
+      strm << "Could not map stimulus file '" << filename << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    // events are replayed front to back
+    madvise(m_addr, m_size, MADV_SEQUENTIAL);
+
+    auto base = static_cast<char const*>(m_addr);
+    auto const& header = *reinterpret_cast<Header const*>(base);
+    try {
+      validate(header);
+    } catch( std::runtime_error const& ) {
+      munmap(m_addr, m_size);
+      m_addr = nullptr;
+      throw;
+    }
+
+    m_events = reinterpret_cast<Event const*>(base + header.events_offset);
+    m_num_events = header.num_events;
+    m_values = base + header.values_offset;
+
+    auto entries = reinterpret_cast<Signal_entry const*>(base
+        + header.signals_offset);
+    auto names = base + header.names_offset;
+    for(uint64_t i=0; i<header.num_signals; ++i) {
+      Signal sig;
+      sig.name.assign(names + entries[i].name_offset, entries[i].name_size);
+      sig.width = entries[i].width;
+      m_signals.push_back(sig);
+    }
+  }
+
+
+  Stimulus_file::~Stimulus_file() {
+    if( m_addr )
+      munmap(m_addr, m_size);
+  }
+
+
+  int64_t
+  Stimulus_file::find(std::string const& name) const {
+    for(std::size_t i=0; i<m_signals.size(); ++i) {
+      if( m_signals[i].name == name )
+        return i;
+    }
+
+    return -1;
+  }
+
+
+  std::size_t
+  Stimulus_file::lower_bound(uint64_t t) const {
+    auto it = std::lower_bound(m_events,
+        m_events + m_num_events,
+        t,
+        [](Event const& ev, uint64_t t) { return ev.time_ps < t; });
+    return it - m_events;
+  }
+
+
+  void
+  Stimulus_file::validate(Header const& header) const {
+    bool valid = (std::memcmp(header.magic, magic, sizeof(magic)) == 0)
+      && (header.version == format_version)
+      && (header.header_size == sizeof(Header))
+      && (header.file_size == m_size)
+      && (header.signals_offset
+          + header.num_signals * sizeof(Signal_entry) <= header.names_offset)
+      && (header.names_offset <= header.events_offset)
+      && (header.events_offset % alignof(Event) == 0)
+      && (header.events_offset
+          + header.num_events * sizeof(Event) <= header.values_offset)
+      && (header.values_offset <= m_size);
+
+    if( !valid ) {
+      std::stringstream strm;
+      strm << "'" << m_filename << "' is not a stimulus file of version "
+        << format_version;
+      throw std::runtime_error(strm.str());
+    }
+
+    // references must stay within the file
+    auto base = static_cast<char const*>(m_addr);
+    auto entries = reinterpret_cast<Signal_entry const*>(base
+        + header.signals_offset);
+    auto names_size = header.events_offset - header.names_offset;
+
+    for(uint64_t i=0; i<header.num_signals; ++i) {
+      if( entries[i].name_offset + entries[i].name_size > names_size ) {
+        std::stringstream strm;
+        strm << "Invalid name of signal " << i << " in '" << m_filename << "'";
+        throw std::runtime_error(strm.str());
+      }
+    }
+  }
+
+
+  bool
+  Stimulus_file::valid(std::size_t i) const {
+    if( i >= m_num_events )
+      return false;
+
+    auto const& ev = m_events[i];
+    auto values_size = m_size - (m_values - static_cast<char const*>(m_addr));
+    return (ev.signal < m_signals.size())
+      && (ev.value_offset + m_signals[ev.signal].size() <= values_size)
+      && ((i == 0) || (m_events[i-1].time_ps <= ev.time_ps));
+  }
+
+
+
+  Stimulus_writer::Stimulus_writer(std::string const& filename)
+    : m_filename(filename) {
+    m_os.open(filename, std::ios::binary);
+    if( !m_os ) {
+      std::stringstream strm;
+      strm << "Could not open stimulus file '"
+        << filename
+        << "' for writing";
+      throw std::runtime_error(strm.str());
+    }
+  }
+
+
+  Stimulus_writer::~Stimulus_writer() {
+    try {
+      close();
+    } catch( std::exception const& ) {
+    }
+  }
+
+
+  std::size_t
+  Stimulus_writer::add_signal(std::string const& name, uint32_t width) {
+    if( width == 0 )
+      throw std::runtime_error("Stimulus signals must be at least one bit wide");
+
+    Signal_entry entry;
+    entry.name_offset = m_names.size();
+    entry.name_size = name.size();
+    entry.width = width;
+
+    m_signals.push_back(entry);
+    m_names += name;
+    return m_signals.size() - 1;
+  }
+
+
+  void
+  Stimulus_writer::add(uint64_t t, std::size_t signal, char const* value) {
+    if( signal >= m_signals.size() )
+      throw std::runtime_error("Invalid stimulus signal");
+
+    Event ev;
+    ev.time_ps = t;
+    ev.signal = signal;
+    ev.reserved = 0;
+    ev.value_offset = m_values.size();
+    m_events.push_back(ev);
+
+    m_values.insert(m_values.end(),
+        value,
+        value + (m_signals[signal].width + 7) / 8);
+  }
+
+
+  void
+  Stimulus_writer::close() {
+    if( m_closed )
+      return;
+    m_closed = true;
+
+    std::stable_sort(m_events.begin(), m_events.end(),
+        [](Event const& a, Event const& b) { return a.time_ps < b.time_ps; });
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = format_version;
+    header.header_size = sizeof(Header);
+    header.num_signals = m_signals.size();
+    header.signals_offset = align8(sizeof(Header));
+    header.names_offset = header.signals_offset
+      + m_signals.size() * sizeof(Signal_entry);
+    header.num_events = m_events.size();
+    header.events_offset = align8(header.names_offset + m_names.size());
+    header.values_offset = header.events_offset
+      + m_events.size() * sizeof(Event);
+    header.file_size = header.values_offset + m_values.size();
+
+    auto pad = [this](uint64_t pos) {
+      static char const zeros[8] = {0};
+      auto n = align8(pos) - pos;
+      m_os.write(zeros, n);
+    };
+
+    m_os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    pad(sizeof(header));
+    m_os.write(reinterpret_cast<char const*>(m_signals.data()),
+        m_signals.size() * sizeof(Signal_entry));
+    m_os.write(m_names.data(), m_names.size());
+    pad(header.names_offset + m_names.size());
+    m_os.write(reinterpret_cast<char const*>(m_events.data()),
+        m_events.size() * sizeof(Event));
+    m_os.write(m_values.data(), m_values.size());
+    m_os.close();
+
+    if( !m_os ) {
+      std::stringstream strm;
+      strm << "Failed to write stimulus file '" << m_filename << "'";
+      throw std::runtime_error(strm.str());
+    }
+  }
+
+
+  static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "stim/stim_format.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+
+
+namespace stim {
+
+  /** Memory mapped stimulus file, see stim_format.h
+   *
+   * Opening a file only validates the header and reads the signal table.
+   * Events and values are accessed in place, so replaying a stimulus does
+   * not parse or copy anything. Use valid() to check an event before
+   * accessing its value.
+   * */
+  class Stimulus_file {
+    public:
+      struct Signal {
+        std::string name;
+        uint32_t width;
+
+        /** size of a value in bytes */
+        std::size_t size() const { return (width + 7) / 8; }
+      };
+
+
+      explicit Stimulus_file(std::string const& filename);
+      ~Stimulus_file();
+
+      Stimulus_file(Stimulus_file const&) = delete;
+      Stimulus_file& operator = (Stimulus_file const&) = delete;
+
+      std::vector<Signal> const& signals() const { return m_signals; }
+
+      /** @return Index of the signal or -1 if not found */
+      int64_t find(std::string const& name) const;
+
+      std::size_t num_events() const { return m_num_events; }
+
+      Event const& event(std::size_t i) const { return m_events[i]; }
+
+      char const* value(Event const& ev) const {
+        return m_values + ev.value_offset;
+      }
+
+      /** Check event i, events are not validated when opening a file */
+      bool valid(std::size_t i) const;
+
+      /** Index of the first event at or after t */
+      std::size_t lower_bound(uint64_t t) const;
+
+
+    private:
+      std::string m_filename;
+      void* m_addr = nullptr;
+      std::size_t m_size = 0;
+      Event const* m_events = nullptr;
+      std::size_t m_num_events = 0;
+      char const* m_values = nullptr;
+      std::vector<Signal> m_signals;
+
+      void validate(Header const& header) const;
+  };
+
+
+  /** Write a stimulus file, see stim_format.h
+   *
+   * Events can be added in any order, they are sorted by time when the file
+   * is written. Events at the same time keep the order they were added in.
+   * */
+  class Stimulus_writer {
+    public:
+      explicit Stimulus_writer(std::string const& filename);
+      ~Stimulus_writer();
+
+      /** @return Index of the signal */
+      std::size_t add_signal(std::string const& name, uint32_t width);
+
+      /** Assign value to signal at time t in picoseconds
+       *
+       * value must hold (width + 7) / 8 bytes, least significant byte first.
+       * */
+      void add(uint64_t t, std::size_t signal, char const* value);
+
+      std::size_t num_events() const { return m_events.size(); }
+
+      /** Write the file, called by the destructor if not called before */
+      void close();
+
+
+    private:
+      std::string m_filename;
+      std::ofstream m_os;
+      bool m_closed = false;
+      std::vector<Signal_entry> m_signals;
+      std::string m_names;
+      std::vector<Event> m_events;
+      std::vector<char> m_values;
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,56 @@
+#pragma once
+
+/** @file
+ * Binary stimulus format read by stim::Stimulus_file.
+ *
+ * The file is designed to be memory mapped and used in place. All integers
+ * are stored little endian, all sections are aligned to 8 bytes. Times are
+ * given in picoseconds.
+ *
+ *   header        Header
+ *   signals       Signal_entry per signal
+ *   names         signal names, referenced by Signal_entry
+ *   events        Event per assignment, ordered by time
+ *   values        values referenced by Event
+ *
+ * A value occupies (width + 7) / 8 bytes with the least significant byte
+ * first. Events at the same time are applied in file order.
+ * */
+
+#include <cstdint>
+
+
+namespace stim {
+
+  static char const magic[8] = {'C','E','L','L','S','T','I','M'};
+  static uint32_t const format_version = 1;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t file_size;
+    uint64_t num_signals;
+    uint64_t signals_offset;
+    uint64_t names_offset;
+    uint64_t num_events;
+    uint64_t events_offset;
+    uint64_t values_offset;
+  };
+
+  struct Signal_entry {
+    uint64_t name_offset;   /**< relative to the names section */
+    uint32_t name_size;
+    uint32_t width;         /**< in bits */
+  };
+
+  struct Event {
+    uint64_t time_ps;
+    uint32_t signal;
+    uint32_t reserved;
+    uint64_t value_offset;  /**< relative to the values section */
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,102 @@
+#include "stim/stim_file.h"
+#include "stim/stim_convert.h"
+
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+
+namespace po = boost::program_options;
+
+
+void print_info(std::string const& filename) {
+  stim::Stimulus_file file(filename);
+
+  for(auto const& sig : file.signals())
+    std::cout << sig.name << " (" << sig.width << " bits)\n";
+
+  std::cout << file.num_events() << " events";
+  if( file.num_events() > 0 ) {
+    std::cout << ", " << file.event(0).time_ps << " - "
+      << file.event(file.num_events() - 1).time_ps << " ps";
+  }
+  std::cout << '\n';
+}
+
+
+int main(int argc, char* argv[]) {
+  using namespace std;
+
+  try {
+    po::options_description desc("Options");
+    desc.add_options()
+      ("help,h", "print usage info")
+      ("input,i", po::value<std::string>(),
+       "input VCD or CSV file")
+      ("output,o", po::value<std::string>(),
+       "output stimulus file")
+      ("format,f", po::value<std::string>()->default_value(""),
+       "input format 'vcd' or 'csv', derived from the file extension by default")
+      ("info", "print signals and events of a stimulus file instead of converting")
+    ;
+    po::positional_options_description pos_opts;
+    pos_opts.add("input", 1);
+    pos_opts.add("output", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv)
+        .options(desc)
+        .positional(pos_opts)
+        .run(),
+        vm);
+    po::notify(vm);
+
+    if( vm.count("help")
+        || !vm.count("input")
+        || (!vm.count("output") && !vm.count("info")) ) {
+      cout << "Usage: " << argv[0]
+        << " [options] <VCD or CSV file> <stimulus file>\n\n"
+        << desc << endl;
+      return 0;
+    }
+
+    auto input = vm["input"].as<std::string>();
+    if( vm.count("info") ) {
+      print_info(input);
+      return 0;
+    }
+
+    auto format = vm["format"].as<std::string>();
+    if( format.empty() ) {
+      auto dot = input.rfind('.');
+      if( dot != std::string::npos )
+        format = input.substr(dot + 1);
+    }
+
+    std::ifstream is(input);
+    if( !is )
+      throw std::runtime_error("Failed to open file '" + input + "'");
+
+    stim::Stimulus_writer writer(vm["output"].as<std::string>());
+    if( format == "vcd" )
+      stim::convert_vcd(is, writer);
+    else if( format == "csv" )
+      stim::convert_csv(is, writer);
+    else
+      throw std::runtime_error("Unknown input format '" + format + "'");
+    writer.close();
+
+    cout << "converted " << writer.num_events() << " events" << endl;
+
+  } catch( std::runtime_error const& err ) {
+    cerr << "Encountered runtime error: " << err.what() << endl;
+    return 1;
+  } catch( std::logic_error const& err ) {
+    cerr << "Invalid input: " << err.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
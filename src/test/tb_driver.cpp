@@ -37,6 +37,29 @@ class My_driver : public method::Driver<My_driver, cell::s> {
 };
 
 
+class My_view_driver : public method::Driver<My_view_driver, cell::s_view> {
+  public:
+    My_view_driver()
+      : Driver() {
+    }
+
+    void drive(ir::Time const& t, cell::s_view& port) {
+      // only write if My_driver did not set the value yet
+      if( port.a() != 1 )
+        port.a(1);
+      if( port.written() )
+        ++m_writes;
+    }
+
+    void observe(ir::Time const& t, cell::s_view const& port) {
+      ++m_cycles;
+    }
+
+    unsigned m_cycles = 0;
+    unsigned m_writes = 0;
+};
+
+
 class My_observer : public method::Observer_channel<My_observer, cell::s> {
   public:
     bool pass;
@@ -84,15 +107,22 @@ class Tb_driver {
 
       m_engine.setup();
       m_engine.add_driver(m_driver, "");
+      m_engine.add_driver(m_view_driver, "");
       m_engine.add_driver(m_my_observer, "");
     }
 
     void run() {
       m_engine.simulate(ir::Time(100, ir::Time::ns));
+      m_my_observer.flush();
 
       if( !m_driver.m_hit )
         m_pass = false;
 
+      // the view only writes until a is stable
+      if( (m_view_driver.m_cycles == 0)
+          || (m_view_driver.m_writes >= m_view_driver.m_cycles) )
+        m_pass = false;
+
       if( !m_my_observer.pass )
         m_pass = false;
     }
@@ -108,6 +138,7 @@ class Tb_driver {
     sim::Instrumented_simulation_engine m_engine;
     std::unique_ptr<sim::Vcd_instrumenter> m_instrumenter;
     My_driver m_driver;
+    My_view_driver m_view_driver;
     My_observer m_my_observer;
 };
 
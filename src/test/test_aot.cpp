@@ -0,0 +1,235 @@
+#include "sim/simulation_engine.h"
+#include "aot/cell_runtime.h"
+#include "logging/logger.h"
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <dlfcn.h>
+
+
+class Test_aot : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      init_logging();
+    }
+};
+
+
+// Handcrafted design: frame { int64 counter; int64 twice; }
+static void periodic_inc(char* out, char* in, char*, char*) {
+  int64_t counter;
+  std::memcpy(&counter, in, sizeof(counter));
+  counter += 1;
+  std::memcpy(out, &counter, sizeof(counter));
+}
+
+
+static void process_twice(char* out, char* in, char*, char* mask) {
+  int64_t counter;
+  std::memcpy(&counter, in, sizeof(counter));
+  mask[0] = 1;
+  counter *= 2;
+  std::memcpy(out + 8, &counter, sizeof(counter));
+}
+
+
+static int64_t const element_offsets[] = { 0, 8 };
+
+static cell_process_desc const processes[] = {
+  { CELL_PROCESS, 0, reinterpret_cast<void*>(&process_twice) },
+  { CELL_PERIODIC, 1000, reinterpret_cast<void*>(&periodic_inc) }
+};
+
+static cell_instance_desc const instances[] = {
+  { "", 16, 2, 2, element_offsets, 2, processes, nullptr, 0, nullptr, nullptr }
+};
+
+static cell_design_desc const design = { CELL_DESIGN_VERSION, 1, instances };
+
+
+TEST_F(Test_aot, runtime_schedule) {
+  auto sim = cell_sim_create(&design);
+  ASSERT_NE(nullptr, sim);
+
+  unsigned steps = 0;
+  cell_sim_on_step(sim,
+      [](int64_t, void* user) { ++*static_cast<unsigned*>(user); },
+      &steps);
+
+  unsigned driver_calls = 0;
+  auto inst = cell_sim_find_instance(sim, "");
+  ASSERT_EQ(0, inst);
+  EXPECT_EQ(-1, cell_sim_find_instance(sim, "foo"));
+  EXPECT_EQ(0, cell_sim_add_driver(sim, inst,
+        [](int64_t, char*, char*, char*, void* user) {
+          ++*static_cast<unsigned*>(user);
+        },
+        &driver_calls));
+
+  EXPECT_EQ(0, cell_sim_simulate(sim, 10000));
+  EXPECT_EQ(10000, cell_sim_time(sim));
+
+  int64_t values[2];
+  std::memcpy(values, cell_sim_frame(sim, inst), sizeof(values));
+  EXPECT_EQ(10, values[0]);
+  EXPECT_EQ(20, values[1]);
+  EXPECT_EQ(10u, steps);
+  EXPECT_LT(steps, driver_calls);
+
+  cell_sim_destroy(sim);
+}
+
+
+TEST_F(Test_aot, version_mismatch) {
+  cell_design_desc const bad = { CELL_DESIGN_VERSION + 1, 1, instances };
+  EXPECT_EQ(nullptr, cell_sim_create(&bad));
+}
+
+
+TEST_F(Test_aot, emit_object) {
+  sim::Simulation_engine engine("../lib/test/basic_periodic.cell",
+      "test::basic_periodic");
+
+  engine.emit_object("basic_periodic.o");
+
+  std::ifstream in("basic_periodic.o", std::ios::binary);
+  ASSERT_TRUE(in.good());
+
+  char magic[4] = { 0 };
+  in.read(magic, sizeof(magic));
+  EXPECT_EQ(0, std::memcmp(magic, "\x7f" "ELF", 4));
+}
+
+
+/** Design emitted by Simulation_engine::emit_object(), linked with
+ * libcellrt into a shared object and loaded together with its runtime */
+class Aot_design {
+  public:
+    Aot_design(sim::Simulation_engine& engine, std::string const& name) {
+      auto const obj = name + ".o";
+      auto const lib = "./" + name + ".so";
+      engine.emit_object(obj);
+
+      auto cxx = std::getenv("CXX");
+      std::stringstream cmd;
+      cmd << (cxx ? cxx : "c++") << " -shared -o " << lib << " " << obj
+        << " -L. -lcellrt -lm";
+      if( std::system(cmd.str().c_str()) != 0 )
+        throw std::runtime_error("Failed to link '" + lib + "'");
+
+      m_handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+      if( !m_handle )
+        throw std::runtime_error(dlerror());
+
+      design = symbol<cell_design_desc const*>("cell_design");
+      create = symbol<decltype(&cell_sim_create)>("cell_sim_create");
+      destroy = symbol<decltype(&cell_sim_destroy)>("cell_sim_destroy");
+      simulate = symbol<decltype(&cell_sim_simulate)>("cell_sim_simulate");
+      find_instance = symbol<decltype(&cell_sim_find_instance)>(
+          "cell_sim_find_instance");
+      frame = symbol<decltype(&cell_sim_frame)>("cell_sim_frame");
+    }
+
+    ~Aot_design() {
+      dlclose(m_handle);
+    }
+
+    Aot_design(Aot_design const&) = delete;
+    Aot_design& operator = (Aot_design const&) = delete;
+
+    /** Value of element idx of an instance, see Llvm_impl struct_index */
+    template<typename T>
+    T get(cell_sim* sim, char const* path, std::size_t idx) const {
+      auto inst = find_instance(sim, path);
+      if( inst < 0 )
+        throw std::runtime_error(std::string("No instance '") + path + "'");
+
+      T rv;
+      auto ofs = design->instances[inst].element_offsets[idx];
+      std::memcpy(&rv, frame(sim, inst) + ofs, sizeof(rv));
+      return rv;
+    }
+
+    cell_design_desc const* design;
+    decltype(&cell_sim_create) create;
+    decltype(&cell_sim_destroy) destroy;
+    decltype(&cell_sim_simulate) simulate;
+    decltype(&cell_sim_find_instance) find_instance;
+    decltype(&cell_sim_frame) frame;
+
+  private:
+    void* m_handle;
+
+    template<typename T>
+    T symbol(char const* name) {
+      auto rv = dlsym(m_handle, name);
+      if( !rv )
+        throw std::runtime_error(std::string("Missing symbol ") + name);
+      return reinterpret_cast<T>(rv);
+    }
+};
+
+
+TEST_F(Test_aot, run_object) {
+  sim::Simulation_engine engine("../lib/test/basic_periodic.cell",
+      "test::basic_periodic");
+  Aot_design aot(engine, "run_basic_periodic");
+  EXPECT_EQ(CELL_DESIGN_VERSION, aot.design->version);
+
+  engine.setup();
+  engine.simulate(ir::Time(10, ir::Time::ns));
+  auto intro = engine.inspect_module("");
+
+  auto sim = aot.create(aot.design);
+  ASSERT_NE(nullptr, sim);
+  EXPECT_EQ(0, aot.simulate(sim, ir::Time(10, ir::Time::ns).value(ir::Time::ps)));
+
+  for(auto name : {"counter", "acc"}) {
+    auto idx = intro.module()->objects.at(name)->impl.struct_index;
+    EXPECT_EQ(intro.get<int64_t>(name), aot.get<int64_t>(sim, "", idx))
+      << name;
+  }
+  EXPECT_LT(0, intro.get<int64_t>("counter"));
+
+  aot.destroy(sim);
+  engine.teardown();
+}
+
+
+TEST_F(Test_aot, run_object_random) {
+  // the instances draw from the same streams as in the simulator
+  sim::Simulation_engine engine("../lib/test/random.cell", "test::random");
+  Aot_design aot(engine, "run_random");
+
+  engine.setup();
+  engine.simulate(ir::Time(1, ir::Time::us));
+
+  auto sim = aot.create(aot.design);
+  ASSERT_NE(nullptr, sim);
+  EXPECT_EQ(0, aot.simulate(sim, ir::Time(1, ir::Time::us).value(ir::Time::ps)));
+
+  auto top = engine.inspect_module("");
+  auto idx = top.module()->objects.at("first")->impl.struct_index;
+  EXPECT_EQ(top.get<int64_t>("first"), aot.get<int64_t>(sim, "", idx));
+
+  auto noise = engine.inspect_module("n");
+  for(auto name : {"first", "count", "uniform", "events"}) {
+    idx = noise.module()->objects.at(name)->impl.struct_index;
+    EXPECT_EQ(noise.get<int64_t>(name), aot.get<int64_t>(sim, "n", idx))
+      << name;
+  }
+  for(auto name : {"normal", "frac"}) {
+    idx = noise.module()->objects.at(name)->impl.struct_index;
+    EXPECT_DOUBLE_EQ(noise.get<double>(name), aot.get<double>(sim, "n", idx))
+      << name;
+  }
+
+  aot.destroy(sim);
+  engine.teardown();
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
 #include "sim/cpp_gen.h"
+#include "sim/cpp_header.h"
+#include "sim/compile.h"
+#include "sim/object_emitter.h"
 #include "sim/simulation_engine.h"
 #include "logging/logger.h"
 #include <llvm/IR/LLVMContext.h>
@@ -93,6 +96,104 @@ TEST_F(Test_cpp_gen, write_ir_nested) {
 }
 
 
+TEST_F(Test_cpp_gen, view_from_code) {
+  auto lib = sim::compile_file("../lib/test/driver.cell",
+      std::vector<std::string>());
+  auto machine = sim::create_host_target_machine();
+  sim::Cpp_header_writer writer(*machine->getDataLayout(), true);
+
+  std::stringstream strm;
+  writer.write(strm, *lib->ns);
+
+  EXPECT_EQ("struct s {\n\tint64_t a;\n\tint64_t b;\n\tbool clk;\n\tint64_t y;\n};\n"
+      "static_assert(sizeof(s) == 32, \"size of s differs from the simulator\");\n"
+      "static_assert(offsetof(s, a) == 0, \"offset of s::a differs from the simulator\");\n"
+      "static_assert(offsetof(s, b) == 8, \"offset of s::b differs from the simulator\");\n"
+      "static_assert(offsetof(s, clk) == 16, \"offset of s::clk differs from the simulator\");\n"
+      "static_assert(offsetof(s, y) == 24, \"offset of s::y differs from the simulator\");\n"
+      "class s_view : public method::Frame_view {\n"
+      "\tpublic:\n"
+      "\t\ts_view(char const* in, char* out) : method::Frame_view(in, out) {}\n"
+      "\t\tint64_t a() const { return load<int64_t>(0); }\n"
+      "\t\tvoid a(int64_t v) { store<int64_t>(0, 0, v); }\n"
+      "\t\tint64_t b() const { return load<int64_t>(8); }\n"
+      "\t\tvoid b(int64_t v) { store<int64_t>(8, 1, v); }\n"
+      "\t\tbool clk() const { return load<bool>(16); }\n"
+      "\t\tvoid clk(bool v) { store<bool>(16, 2, v); }\n"
+      "\t\tint64_t y() const { return load<int64_t>(24); }\n"
+      "\t\tvoid y(int64_t v) { store<int64_t>(24, 3, v); }\n"
+      "};\n",
+      strm.str());
+}
+
+
+TEST_F(Test_cpp_gen, header_from_ir) {
+  auto lib = sim::compile_file("../lib/test/driver.cell",
+      std::vector<std::string>());
+  auto machine = sim::create_host_target_machine();
+  sim::Cpp_header_writer writer(*machine->getDataLayout());
+
+  std::stringstream strm;
+  writer.write(strm, *lib->ns);
+
+  EXPECT_EQ("struct s {\n\tint64_t a;\n\tint64_t b;\n\tbool clk;\n\tint64_t y;\n};\n"
+      "static_assert(sizeof(s) == 32, \"size of s differs from the simulator\");\n"
+      "static_assert(offsetof(s, a) == 0, \"offset of s::a differs from the simulator\");\n"
+      "static_assert(offsetof(s, b) == 8, \"offset of s::b differs from the simulator\");\n"
+      "static_assert(offsetof(s, clk) == 16, \"offset of s::clk differs from the simulator\");\n"
+      "static_assert(offsetof(s, y) == 24, \"offset of s::y differs from the simulator\");\n",
+      strm.str());
+}
+
+
+TEST_F(Test_cpp_gen, header_namespaces) {
+  auto lib = sim::compile_file("../lib/test/table.cell",
+      std::vector<std::string>());
+  auto machine = sim::create_host_target_machine();
+  sim::Cpp_header_writer writer(*machine->getDataLayout(), true);
+
+  std::stringstream strm;
+  writer.write(strm, *lib->ns);
+
+  EXPECT_EQ("namespace n {\ntypedef int64_t tbl;\n}\n", strm.str());
+}
+
+
+TEST_F(Test_cpp_gen, header_imports) {
+  auto lib = sim::compile_file("../lib/test/header_import.cell",
+      std::vector<std::string>());
+  auto machine = sim::create_host_target_machine();
+  sim::Cpp_header_writer writer(*machine->getDataLayout());
+
+  // the imported structure is referenced by name, not written
+  std::stringstream strm;
+  writer.write(strm, *lib->ns);
+  EXPECT_EQ("struct s {\n\theader_types::Pair a;\n\tint64_t y;\n};\n"
+      "static_assert(sizeof(s) == 24, \"size of s differs from the simulator\");\n"
+      "static_assert(offsetof(s, a) == 0, \"offset of s::a differs from the simulator\");\n"
+      "static_assert(offsetof(s, y) == 16, \"offset of s::y differs from the simulator\");\n",
+      strm.str());
+
+  ASSERT_EQ(1u, writer.imports().size());
+  auto const& imp = writer.imports()[0];
+  EXPECT_EQ(std::vector<std::string>{"header_types"}, imp.scope);
+  EXPECT_NE(std::string::npos, imp.ns->impl.source_file.find("header_types.cell"));
+
+  // header of the imported namespace
+  std::stringstream imp_strm;
+  sim::Cpp_header_writer imp_writer(*machine->getDataLayout());
+  imp_writer.write(imp_strm, imp);
+  EXPECT_EQ("namespace header_types {\n"
+      "struct Pair {\n\tint64_t x;\n\tint64_t y;\n};\n"
+      "static_assert(sizeof(Pair) == 16, \"size of Pair differs from the simulator\");\n"
+      "static_assert(offsetof(Pair, x) == 0, \"offset of Pair::x differs from the simulator\");\n"
+      "static_assert(offsetof(Pair, y) == 8, \"offset of Pair::y differs from the simulator\");\n"
+      "}\n",
+      imp_strm.str());
+  EXPECT_TRUE(imp_writer.imports().empty());
+}
+
+
 TEST_F(Test_cpp_gen, cpp_name) {
   EXPECT_EQ("hallo_welt", sim::cpp_name("hallo.welt"));
   EXPECT_EQ("foo", sim::cpp_name("foo"));
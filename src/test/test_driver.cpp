@@ -1,4 +1,5 @@
 #include "sim/simulation_engine.h"
+#include "method/testbench.h"
 #include "logging/logger.h"
 
 #include <gtest/gtest.h>
@@ -105,3 +106,45 @@ TEST_F(Test_driver, add_driver_struct) {
 }
 
 
+TEST_F(Test_driver, testbench_tasks) {
+  typedef Test_driver_struct::Socket Socket;
+  sim::Simulation_engine engine("../lib/test/driver.cell", "m");
+
+  engine.setup();
+  method::Testbench<Socket> tb(engine);
+  engine.add_driver(tb, "");
+
+  std::vector<ir::Time> edges;
+  ir::Time delayed;
+  bool result = false;
+
+  tb.spawn([&]() {
+    for(int64_t i=0; i<3; ++i) {
+      tb.wait_edge(&Socket::clk);
+      edges.push_back(tb.now());
+      tb.port().a = i;
+      tb.port().b = 10;
+    }
+
+    // no process of the design runs at this time
+    tb.delay(ir::Time(3, ir::Time::ns));
+    delayed = tb.now();
+    tb.port().a = 5;
+
+    tb.until([](Socket const& p) { return p.y == 15; });
+    result = true;
+  });
+
+  engine.simulate(ir::Time(100, ir::Time::ns));
+
+  ASSERT_EQ(3u, edges.size());
+  EXPECT_EQ(20000, edges[1].value(ir::Time::ps) - edges[0].value(ir::Time::ps));
+  EXPECT_EQ(20000, edges[2].value(ir::Time::ps) - edges[1].value(ir::Time::ps));
+  EXPECT_EQ(edges[2].value(ir::Time::ps) + 3000, delayed.value(ir::Time::ps));
+  EXPECT_TRUE(result);
+  EXPECT_EQ(0u, tb.num_tasks());
+  // only resumed on events: start, 3 edges, delay, until
+  EXPECT_EQ(6u, tb.num_resumes());
+
+  engine.teardown();
+}
@@ -0,0 +1,88 @@
+#include "sim/simulation_engine.h"
+#include "sim/live_instrumenter.h"
+#include "live/live_view.h"
+#include "logging/logger.h"
+
+#include <gtest/gtest.h>
+
+
+class Test_live : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      init_logging();
+    }
+};
+
+
+TEST_F(Test_live, view_frames) {
+  sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+      "test");
+  sim::Live_instrumenter instr("cell_test_live", std::chrono::milliseconds(0));
+
+  engine.instrument(instr);
+  engine.setup();
+
+  live::Live_view view("/cell_test_live");
+  EXPECT_FALSE(view.finished());
+  EXPECT_EQ(0, view.time());
+
+  auto state = view.find("test.state");
+  auto reset = view.find("test.reset");
+  ASSERT_NE(-1, state);
+  ASSERT_NE(-1, reset);
+  EXPECT_EQ(64u, view.signals()[state].width);
+  EXPECT_EQ(1u, view.signals()[reset].width);
+  EXPECT_EQ(1, view.get<int64_t>(state));
+
+  engine.simulate(ir::Time(200, ir::Time::ns));
+
+  auto intro = engine.inspect_module("");
+  EXPECT_EQ(intro.get<int64_t>("state"), view.get<int64_t>(state));
+  EXPECT_EQ(intro.get<bool>("reset"), view.get<bool>(reset));
+  EXPECT_GT(view.time(), 0);
+  EXPECT_EQ(instr.num_updates(), view.num_updates());
+
+  std::vector<char> data;
+  view.snapshot(data);
+  int64_t v;
+  std::memcpy(&v, data.data() + view.signals()[state].offset, sizeof(v));
+  EXPECT_EQ(intro.get<int64_t>("state"), v);
+
+  engine.teardown();
+  EXPECT_TRUE(view.finished());
+}
+
+
+TEST_F(Test_live, teardown_publishes_last_step) {
+  sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+      "test");
+  sim::Live_instrumenter instr("cell_test_live_throttled",
+      std::chrono::hours(1));
+
+  engine.instrument(instr);
+  engine.setup();
+  engine.simulate(ir::Time(200, ir::Time::ns));
+
+  // all steps were throttled
+  live::Live_view view("/cell_test_live_throttled");
+  EXPECT_EQ(0, view.time());
+  EXPECT_EQ(1u, instr.num_updates());
+
+  engine.teardown();
+  EXPECT_TRUE(view.finished());
+  EXPECT_GT(view.time(), 0);
+  EXPECT_LE(view.time(), ir::Time(200, ir::Time::ns).value(ir::Time::ps));
+
+  auto intro = engine.inspect_module("");
+  auto state = view.find("test.state");
+  ASSERT_NE(-1, state);
+  EXPECT_EQ(intro.get<int64_t>("state"), view.get<int64_t>(state));
+}
+
+
+TEST_F(Test_live, missing_segment) {
+  EXPECT_THROW(live::Live_view("/cell_test_no_such_segment"),
+      std::runtime_error);
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -127,4 +127,143 @@ TEST_F(Test_module_inspector, get_element_bits) {
 }
 
 
+TEST_F(Test_module_inspector, get_bits_into) {
+  sim::Simulation_engine engine("../lib/test/inspector_bits.cell",
+      "test::bits");
+
+  engine.setup();
+  auto intro = engine.inspect_module("");
+
+  intro.set_initial<int64_t>("a", 0x0123456789abcdefll);
+  intro.set_initial<int64_t>("b", -2);
+  intro.set_initial<bool>("flag", false);
+  intro.set_initial<bool>("last", true);
+
+  auto index = [&intro](ir::Label const& name) {
+    return intro.module()->objects.at(name)->impl.struct_index;
+  };
+
+  // last starts within the final block of the frame, off a word boundary
+  auto last_ofs = intro.layout()->getElementOffset(index("last"));
+  ASSERT_NE(0u, last_ofs % 8);
+  ASSERT_LT(intro.frame()->size() - last_ofs, 8u);
+
+  // the same storage is reused for all members
+  ir::Bitset bits;
+  intro.get_bits(index("a"), bits);
+  EXPECT_EQ(ir::Bitset(std::string(
+          "0000000100100011010001010110011110001001101010111100110111101111")),
+      bits);
+
+  intro.get_bits(index("last"), bits);
+  EXPECT_EQ(ir::Bitset(std::string("1")), bits);
+
+  intro.get_bits(index("b"), bits);
+  EXPECT_EQ(ir::Bitset(std::string(
+          "1111111111111111111111111111111111111111111111111111111111111110")),
+      bits);
+
+  intro.get_bits(index("flag"), bits);
+  EXPECT_EQ(ir::Bitset(std::string("0")), bits);
+
+  // bits of the full frame
+  auto all_bits = intro.get_bits();
+  ASSERT_EQ(8 * intro.frame()->size(), all_bits.size());
+  EXPECT_TRUE(all_bits[8 * last_ofs]);
+  EXPECT_FALSE(all_bits[8 * last_ofs + 1]);
+
+  engine.teardown();
+}
+
+
+TEST_F(Test_module_inspector, get_element_bits_into) {
+  sim::Simulation_engine engine("../lib/test/demo_fsm.cell",
+      "demo::Fsm");
+
+  engine.setup();
+  auto intro = engine.inspect_module("");
+
+  auto obj = intro.module()->objects.at("ctrl");
+  std::vector<ir::Bitset> elem_bits(7);
+  intro.get_element_bits(obj->impl.struct_index, elem_bits);
+
+  ASSERT_EQ(4u, elem_bits.size());
+  auto elem = [&obj](ir::Label const& name) {
+    return obj->type->elements.at(name)->impl.struct_index;
+  };
+  EXPECT_EQ(ir::Bitset(std::string("0")), elem_bits[elem("clk")]);
+  EXPECT_EQ(ir::Bitset(std::string("1")), elem_bits[elem("reset")]);
+  EXPECT_EQ(ir::Bitset(std::string("0")), elem_bits[elem("en")]);
+  EXPECT_EQ(ir::Bitset(std::string(
+          "0000000000000000000000000000000000000000000000000000000000000000")),
+      elem_bits[elem("op")]);
+
+  // named elements into a map reused across calls
+  std::map<ir::Label,ir::Bitset> named;
+  named["op"] = ir::Bitset(std::string("1"));
+  intro.get_named_element_bits(obj->impl.struct_index, named);
+  ASSERT_EQ(4u, named.size());
+  EXPECT_EQ(ir::Bitset(std::string("0")), named["clk"]);
+  EXPECT_EQ(ir::Bitset(std::string("1")), named["reset"]);
+  EXPECT_EQ(ir::Bitset(std::string("0")), named["en"]);
+  EXPECT_EQ(elem_bits[elem("op")], named["op"]);
+
+  engine.teardown();
+}
+
+
+TEST_F(Test_module_inspector, handles) {
+  sim::Simulation_engine engine("../lib/test/basic_fsm.cell",
+      "test");
+
+  engine.setup();
+  auto intro = engine.inspect_module("");
+
+  auto state = intro.handle<int64_t>("state");
+  auto reset = intro.handle<bool>("reset");
+  EXPECT_TRUE(state.valid());
+  EXPECT_EQ(1, state.get());
+  EXPECT_EQ(true, reset.get());
+
+  EXPECT_THROW(intro.handle<int64_t>("reset"), std::runtime_error);
+  EXPECT_THROW(intro.handle<int64_t>("nothing"), std::runtime_error);
+
+  std::vector<sim::Signal_handle<int64_t>> handles {
+    intro.handle<int64_t>("state"),
+    intro.handle<int64_t>("ctr")
+  };
+
+  engine.simulate(ir::Time(200, ir::Time::ns));
+
+  EXPECT_EQ(intro.get<int64_t>("state"), state.get());
+  EXPECT_EQ(intro.get<bool>("reset"), reset.get());
+
+  std::vector<int64_t> values;
+  sim::get_all(handles, values);
+  ASSERT_EQ(2u, values.size());
+  EXPECT_EQ(intro.get<int64_t>("state"), values[0]);
+  EXPECT_EQ(intro.get<int64_t>("ctr"), values[1]);
+
+  EXPECT_THROW(sim::set_all(handles, std::vector<int64_t>(1)),
+      std::runtime_error);
+
+  // the final state keeps the values written, visible after the next step
+  ASSERT_EQ(3, state.get());
+  sim::set_all(handles, std::vector<int64_t>{3, 42});
+  engine.simulate(ir::Time(10, ir::Time::ns));
+  sim::get_all(handles, values);
+  EXPECT_EQ(std::vector<int64_t>({3, 42}), values);
+  EXPECT_EQ(42, intro.get<int64_t>("ctr"));
+
+  // reset brings state and ctr back to their initial values
+  reset.set(true);
+  engine.simulate(ir::Time(10, ir::Time::ns));
+  EXPECT_EQ(true, reset.get());
+  EXPECT_EQ(1, state.get());
+  EXPECT_EQ(0, handles[1].get());
+
+  engine.teardown();
+}
+
+
 /* vim: set et ff=unix sts=2 sw=2 ts=2 : */
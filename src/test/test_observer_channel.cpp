@@ -0,0 +1,167 @@
+#include "method/observer_channel.h"
+#include "logging/logger.h"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+
+class Test_observer_channel : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      init_logging();
+    }
+};
+
+
+struct Sample {
+  int64_t key;
+  int64_t seq;
+};
+
+static std::ostream& operator << (std::ostream& os, Sample const& s) {
+  return os << "(" << s.key << ", " << s.seq << ")";
+}
+
+
+/** Records the items it observes per key */
+class Recorder : public method::Observer_channel<Recorder, Sample> {
+  public:
+    explicit Recorder(method::Observer_options const& options)
+      : Observer_channel(options) {
+    }
+
+    bool clocked(Sample const& in, Sample const& prev) { return true; }
+
+    std::size_t partition(Sample const& s) const {
+      return static_cast<std::size_t>(s.key);
+    }
+
+    void cycle_batch(Sample const* items, std::size_t n) {
+      if( delay_us > 0 )
+        std::this_thread::sleep_for(std::chrono::microseconds(delay_us.load()));
+
+      std::lock_guard<std::mutex> lock(mutex);
+      max_batch = std::max(max_batch, n);
+      for(std::size_t i=0; i<n; ++i)
+        seen[items[i].key].push_back(items[i].seq);
+      received += n;
+    }
+
+    /** Pass s as this_in and this_prev like the engine does */
+    void feed(Sample const& s) {
+      auto frame = std::make_shared<std::vector<char>>(sizeof(Sample));
+      std::copy_n(reinterpret_cast<char const*>(&s), sizeof(s), frame->data());
+      (*this)(ir::Time(), frame, frame, frame);
+    }
+
+    std::atomic<int> delay_us{0};
+    std::mutex mutex;
+    std::map<int64_t, std::vector<int64_t>> seen;
+    std::size_t max_batch = 0;
+    std::size_t received = 0;
+};
+
+
+TEST_F(Test_observer_channel, partition_order) {
+  method::Observer_options opts;
+  opts.threads = 3;
+  opts.capacity = 16;
+  opts.batch = 4;
+  opts.spin = 10;
+  Recorder rec(opts);
+
+  for(int64_t i=0; i<3000; ++i)
+    rec.feed(Sample{i % 5, i});
+  rec.flush();
+
+  // items of a partition are processed in the order they were pushed
+  std::lock_guard<std::mutex> lock(rec.mutex);
+  ASSERT_EQ(5u, rec.seen.size());
+  for(auto const& k : rec.seen) {
+    ASSERT_EQ(600u, k.second.size());
+    for(std::size_t i=0; i<k.second.size(); ++i)
+      EXPECT_EQ(k.first + 5 * static_cast<int64_t>(i), k.second[i]);
+  }
+}
+
+
+TEST_F(Test_observer_channel, batch_bounded) {
+  method::Observer_options opts;
+  opts.capacity = 1024;
+  opts.batch = 8;
+  Recorder rec(opts);
+
+  // a slow consumer lets items pile up beyond the batch size
+  rec.delay_us = 1000;
+  for(int64_t i=0; i<500; ++i)
+    rec.feed(Sample{0, i});
+  rec.flush();
+
+  auto stats = rec.stats();
+  EXPECT_EQ(500u, stats.items);
+  EXPECT_EQ(500u, rec.received);
+  EXPECT_EQ(8u, rec.max_batch);
+  EXPECT_GE(stats.batches, 500u / 8);
+}
+
+
+TEST_F(Test_observer_channel, producer_stalls) {
+  method::Observer_options opts;
+  opts.capacity = 4;
+  opts.batch = 2;
+  opts.spin = 10;
+  Recorder rec(opts);
+
+  rec.delay_us = 500;
+  for(int64_t i=0; i<64; ++i)
+    rec.feed(Sample{0, i});
+  rec.flush();
+
+  auto stats = rec.stats();
+  EXPECT_GT(stats.producer_stalls, 0u);
+  EXPECT_LE(stats.max_occupancy, 4u);
+  EXPECT_EQ(64u, rec.received);
+}
+
+
+TEST_F(Test_observer_channel, consumer_sleeps_when_idle) {
+  method::Observer_options opts;
+  opts.spin = 10;
+  Recorder rec(opts);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  rec.feed(Sample{0, 0});
+  rec.flush();
+
+  EXPECT_GT(rec.stats().consumer_sleeps, 0u);
+  EXPECT_EQ(1u, rec.received);
+}
+
+
+TEST_F(Test_observer_channel, flush_drains) {
+  method::Observer_options opts;
+  opts.threads = 2;
+  opts.capacity = 256;
+  Recorder rec(opts);
+
+  rec.delay_us = 200;
+  for(int64_t i=0; i<1000; ++i)
+    rec.feed(Sample{i % 2, i});
+  rec.flush();
+
+  // everything was processed when flush() returns
+  std::lock_guard<std::mutex> lock(rec.mutex);
+  EXPECT_EQ(1000u, rec.received);
+  EXPECT_EQ(1000u, rec.stats().items);
+  EXPECT_EQ(500u, rec.seen[0].size());
+  EXPECT_EQ(500u, rec.seen[1].size());
+}
+
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
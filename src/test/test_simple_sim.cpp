@@ -1,11 +1,24 @@
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/ExecutionEngine/JIT.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
 #include "sim/simulation_engine.h"
+#include "parallel_parse.h"
 #include "sim/stream_instrumenter.h"
 #include "sim/vcd_instrumenter.h"
+#include "sim/async_instrumenter.h"
+#include "sim/fork_fanout.h"
 #include "logging/logger.h"
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <sstream>
+#include <thread>
 
 class Simulator_test : public ::testing::Test {
   protected:
@@ -94,6 +107,226 @@ TEST_F(Simulator_test, basic_fsm) {
 }
 
 
+TEST_F(Simulator_test, checkpoint) {
+  int64_t ctr, state, test;
+  {
+    sim::Simulation_engine engine("../lib/test/basic_fsm.cell", "test");
+    engine.setup();
+    engine.simulate(ir::Time(20, ir::Time::ns));
+    engine.checkpoint("test_checkpoint.ckpt");
+    engine.simulate(ir::Time(60, ir::Time::ns));
+
+    auto intro = engine.inspect_module("");
+    ctr = intro.get<int64_t>("ctr");
+    state = intro.get<int64_t>("state");
+    test = intro.get<int64_t>("test");
+    engine.teardown();
+  }
+
+  // once() already ran, the recurrent process continues with its schedule
+  sim::Simulation_engine engine("../lib/test/basic_fsm.cell", "test");
+  engine.setup();
+  engine.restore("test_checkpoint.ckpt");
+  EXPECT_EQ(ir::Time(20, ir::Time::ns).value(ir::Time::ps),
+      engine.time().value(ir::Time::ps));
+
+  engine.simulate(ir::Time(60, ir::Time::ns));
+  auto intro = engine.inspect_module("");
+  EXPECT_EQ(ctr, intro.get<int64_t>("ctr"));
+  EXPECT_EQ(state, intro.get<int64_t>("state"));
+  EXPECT_EQ(test, intro.get<int64_t>("test"));
+  engine.teardown();
+
+  sim::Simulation_engine other("../lib/test/basic_periodic.cell",
+      "test::basic_periodic");
+  other.setup();
+  EXPECT_THROW(other.restore("test_checkpoint.ckpt"), std::runtime_error);
+  other.teardown();
+}
+
+
+TEST_F(Simulator_test, fork_experiments) {
+  sim::Simulation_engine engine("../lib/test/basic_fsm.cell", "test");
+  engine.setup();
+  engine.simulate(ir::Time(20, ir::Time::ns));
+  auto ctr = engine.inspect_module("").get<int64_t>("ctr");
+
+  // experiment 1 keeps the module in reset
+  auto results = sim::fork_experiments(3, [&](std::size_t i, std::ostream& os) {
+    auto intro = engine.inspect_module("");
+    if( i == 2 )
+      throw std::runtime_error("failed");
+
+    for(int j=0; j<8; ++j) {
+      if( i == 1 )
+        intro.set<bool>("reset", true);
+      engine.simulate(ir::Time(10, ir::Time::ns));
+    }
+    os << intro.get<int64_t>("ctr");
+  }, 2);
+
+  ASSERT_EQ(3u, results.size());
+  EXPECT_TRUE(results[0].ok);
+  EXPECT_EQ("11", results[0].data);
+  EXPECT_TRUE(results[1].ok);
+  EXPECT_EQ("0", results[1].data);
+  EXPECT_FALSE(results[2].ok);
+  EXPECT_EQ("failed", results[2].error);
+
+  // the parent continues from the common prefix
+  auto intro = engine.inspect_module("");
+  EXPECT_EQ(ir::Time(20, ir::Time::ns).value(ir::Time::ps),
+      engine.time().value(ir::Time::ps));
+  EXPECT_EQ(ctr, intro.get<int64_t>("ctr"));
+  engine.teardown();
+}
+
+
+TEST_F(Simulator_test, parallel_engines) {
+  sim::Simulation_engine design("../lib/test/basic_fsm.cell", "test");
+  sim::Simulation_engine shared(design, "");
+
+  int64_t ctr[2] = {0, 0};
+  auto run_fsm = [&ctr](sim::Simulation_engine& engine, int i) {
+    engine.setup();
+    engine.simulate(ir::Time(100, ir::Time::ns));
+    ctr[i] = engine.inspect_module("").get<int64_t>("ctr");
+    engine.teardown();
+  };
+
+  // compiles another design while the shared one is simulated
+  int64_t counter = 0, acc = -1;
+  auto run_periodic = [&counter, &acc]() {
+    sim::Simulation_engine engine("../lib/test/basic_periodic.cell",
+        "test::basic_periodic");
+    engine.setup();
+    engine.simulate(ir::Time(10, ir::Time::ns));
+    auto intro = engine.inspect_module("");
+    counter = intro.get<int64_t>("counter");
+    acc = intro.get<int64_t>("acc");
+    engine.teardown();
+  };
+
+  std::thread a(run_fsm, std::ref(design), 0);
+  std::thread b(run_fsm, std::ref(shared), 1);
+  std::thread c(run_periodic);
+  a.join();
+  b.join();
+  c.join();
+
+  EXPECT_EQ(11, ctr[0]);
+  EXPECT_EQ(11, ctr[1]);
+  EXPECT_EQ(acc, counter);
+}
+
+
+TEST_F(Simulator_test, random_streams) {
+  struct Draws {
+    int64_t top_first;
+    int64_t first;
+    int64_t uniform;
+    double normal;
+    int64_t events;
+    double frac;
+  };
+
+  auto run = [](uint64_t seed) {
+    sim::Simulation_engine engine("../lib/test/random.cell", "test::random");
+    engine.seed(seed);
+    engine.setup();
+    engine.simulate(ir::Time(1, ir::Time::us));
+
+    auto intro = engine.inspect_module("n");
+    EXPECT_EQ(1000, intro.get<int64_t>("count"));
+    Draws rv{engine.inspect_module("").get<int64_t>("first"),
+      intro.get<int64_t>("first"),
+      intro.get<int64_t>("uniform"),
+      intro.get<double>("normal"),
+      intro.get<int64_t>("events"),
+      intro.get<double>("frac")};
+    engine.teardown();
+    return rv;
+  };
+
+  auto r1 = run(1);
+  auto r2 = run(1);
+  auto r3 = run(2);
+
+  // reproducible per seed, instances draw from their own streams
+  EXPECT_EQ(r1.top_first, r2.top_first);
+  EXPECT_EQ(r1.first, r2.first);
+  EXPECT_EQ(r1.uniform, r2.uniform);
+  EXPECT_EQ(r1.normal, r2.normal);
+  EXPECT_EQ(r1.events, r2.events);
+  EXPECT_NE(r1.first, r3.first);
+  EXPECT_NE(r1.top_first, r1.first);
+
+  // means of 1000 draws
+  EXPECT_NEAR(4.5, r1.uniform / 1000.0, 0.3);
+  EXPECT_NEAR(2.0, r1.normal / 1000.0, 0.15);
+  EXPECT_NEAR(3.0, r1.events / 1000.0, 0.2);
+  EXPECT_NEAR(0.5, r1.frac / 1000.0, 0.05);
+}
+
+
+TEST_F(Simulator_test, math_builtins) {
+  auto check = [](sim::Frame_layout_options const& opts, double tolerance) {
+    sim::Simulation_engine engine("../lib/test/math.cell",
+        "test::math",
+        std::vector<std::string>(),
+        1,
+        opts);
+    engine.setup();
+    engine.simulate(ir::Time(10, ir::Time::ns));
+
+    auto intro = engine.inspect_module("");
+    EXPECT_NEAR(std::exp(1.5), intro.get<double>("e"), tolerance * std::exp(1.5));
+    EXPECT_NEAR(std::log(10.0), intro.get<double>("l"), tolerance * std::log(10.0));
+    EXPECT_NEAR(std::sqrt(2.0), intro.get<double>("p"), tolerance * std::sqrt(2.0));
+    EXPECT_DOUBLE_EQ(std::sqrt(2.0), intro.get<double>("s"));
+    EXPECT_DOUBLE_EQ(1.0, intro.get<double>("trig"));
+    EXPECT_DOUBLE_EQ(2.0 + 3.0 + 7.0 + 1.5, intro.get<double>("rounded"));
+    EXPECT_EQ(3, intro.get<int64_t>("ia"));
+    EXPECT_EQ(47, intro.get<int64_t>("iminmax"));
+    EXPECT_EQ(10, intro.get<int64_t>("iclamp"));
+    EXPECT_DOUBLE_EQ(0.0, intro.get<double>("fclamp"));
+
+    // free functions are not affected by the options of modules
+    EXPECT_NEAR(std::exp(-0.1), intro.get<double>("v"), 1e-12);
+
+    engine.teardown();
+  };
+
+  check(sim::Frame_layout_options(), 1e-15);
+
+  sim::Frame_layout_options fast;
+  fast.fast_math.insert("math");
+  check(fast, 1e-6);
+}
+
+
+TEST_F(Simulator_test, print_log) {
+  std::stringstream out;
+  sim::Simulation_engine engine("../lib/test/print.cell", "test::printer");
+  engine.print_log().output(out);
+
+  // messages are buffered until the end of simulate()
+  engine.setup();
+  EXPECT_TRUE(out.str().empty());
+  EXPECT_EQ(2u, engine.print_log().size());
+
+  engine.simulate(ir::Time(3, ir::Time::ns));
+  EXPECT_EQ(0u, engine.print_log().size());
+
+  auto log = out.str();
+  EXPECT_EQ(0u, log.find("[0ps] top\n[0ps] t: start\n"));
+  EXPECT_NE(std::string::npos, log.find("[0ps] t: count = 1\n[0ps] t: x = 0.5\n"));
+  EXPECT_NE(std::string::npos, log.find("[2000ps] t: count = 3\n[2000ps] t: x = 1.5\n"));
+
+  engine.teardown();
+}
+
+
 TEST_F(Simulator_test, empty_module) {
   sim::Simulation_engine engine("../lib/test/empty_module.cell", "test::empty_module");
 
@@ -254,6 +487,165 @@ TEST_F(Simulator_test, vcd_logging_fsm) {
   engine.teardown();
 }
 
+
+TEST_F(Simulator_test, vcd_logging_random) {
+  // the state of the random number generators is not dumped
+  for(int changes_only=0; changes_only<2; ++changes_only) {
+    sim::Instrumented_simulation_engine engine("../lib/test/random.cell",
+        "test::random");
+    sim::Vcd_instrumenter instr("simulator_test__vcd_logging_random.vcd",
+        changes_only);
+    engine.instrument(instr);
+
+    engine.setup();
+    engine.simulate(ir::Time(100, ir::Time::ns));
+    engine.teardown();
+
+    EXPECT_GT(instr.num_changes(), 0u);
+  }
+
+  std::ifstream is("simulator_test__vcd_logging_random.vcd");
+  std::stringstream strm;
+  strm << is.rdbuf();
+  auto contents = strm.str();
+  EXPECT_NE(std::string::npos, contents.find(" count $end"));
+  EXPECT_NE(std::string::npos, contents.find(" frac $end"));
+}
+
+
+TEST_F(Simulator_test, vcd_changes_only) {
+  std::size_t size[2];
+  std::size_t changes[2];
+  char const* filenames[2] = {
+    "simulator_test__vcd_full.vcd",
+    "simulator_test__vcd_changes.vcd"
+  };
+
+  for(int changes_only=0; changes_only<2; ++changes_only) {
+    sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+        "test");
+    sim::Vcd_instrumenter instr(filenames[changes_only], changes_only);
+    engine.instrument(instr);
+    engine.setup();
+    engine.simulate(ir::Time(10, ir::Time::us));
+    engine.teardown();
+
+    changes[changes_only] = instr.num_changes();
+  }
+
+  for(int i=0; i<2; ++i) {
+    std::ifstream is(filenames[i], std::ios::binary | std::ios::ate);
+    ASSERT_TRUE(bool(is));
+    size[i] = is.tellg();
+  }
+
+  EXPECT_GT(changes[1], 0u);
+  EXPECT_LT(changes[1], changes[0]);
+  EXPECT_LT(size[1], size[0]);
+}
+
+
+TEST_F(Simulator_test, vcd_changes_only_speed) {
+  // best of three runs over 250000 steps
+  auto run_time = [](bool changes_only) {
+    auto rv = std::chrono::microseconds::max();
+    for(int run=0; run<3; ++run) {
+      sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+          "test");
+      sim::Vcd_instrumenter instr("simulator_test__vcd_speed.vcd",
+          changes_only);
+      engine.instrument(instr);
+      engine.setup();
+
+      auto start = std::chrono::steady_clock::now();
+      engine.simulate(ir::Time(1, ir::Time::ms));
+      auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start);
+      engine.teardown();
+      rv = std::min(rv, duration);
+    }
+    return rv;
+  };
+
+  auto full = run_time(false);
+  auto changes = run_time(true);
+  RecordProperty("vcd_full_us", static_cast<int>(full.count()));
+  RecordProperty("vcd_changes_only_us", static_cast<int>(changes.count()));
+  EXPECT_LT(changes.count(), full.count());
+}
+
+
+TEST_F(Simulator_test, vcd_async) {
+  char const* filenames[2] = {
+    "simulator_test__vcd_sync.vcd",
+    "simulator_test__vcd_async.vcd"
+  };
+
+  {
+    sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+        "test");
+    sim::Vcd_instrumenter instr(filenames[0]);
+    engine.instrument(instr);
+    engine.setup();
+    engine.simulate(ir::Time(10, ir::Time::us));
+    engine.teardown();
+  }
+
+  {
+    sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+        "test");
+    sim::Vcd_instrumenter instr(filenames[1]);
+
+    // small ring to exercise waiting for the writer
+    sim::Async_options opts;
+    opts.num_chunks = 2;
+    opts.chunk_size = 0;
+    sim::Async_instrumenter async(instr, opts);
+
+    engine.instrument(async);
+    engine.setup();
+    engine.simulate(ir::Time(10, ir::Time::us));
+    engine.teardown();
+
+    EXPECT_GT(async.stats().steps, 0u);
+    EXPECT_EQ(async.stats().steps, async.stats().chunks);
+  }
+
+  std::string contents[2];
+  for(int i=0; i<2; ++i) {
+    std::ifstream is(filenames[i]);
+    std::stringstream strm;
+    strm << is.rdbuf();
+    contents[i] = strm.str();
+  }
+
+  EXPECT_FALSE(contents[0].empty());
+  EXPECT_EQ(contents[0], contents[1]);
+}
+
+
+TEST_F(Simulator_test, vcd_async_publish) {
+  sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+      "test");
+  sim::Vcd_instrumenter instr("simulator_test__vcd_async_publish.vcd");
+
+  // chunks hold all steps, but are handed over after 100 steps
+  sim::Async_options opts;
+  opts.chunk_size = 1 << 24;
+  opts.max_steps = 100;
+  opts.max_delay = std::chrono::milliseconds(1000);
+  sim::Async_instrumenter async(instr, opts);
+
+  engine.instrument(async);
+  engine.setup();
+  engine.simulate(ir::Time(10, ir::Time::us));
+  engine.teardown();
+
+  auto const& stats = async.stats();
+  EXPECT_GT(stats.steps, opts.max_steps);
+  EXPECT_GE(stats.chunks, stats.steps / opts.max_steps);
+}
+
 TEST_F(Simulator_test, constants) {
   sim::Simulation_engine engine("../lib/test/constants.cell", "test::m");
 
@@ -329,3 +721,223 @@ TEST_F(Simulator_test, imports) {
   engine.teardown();
 }
 
+
+
+TEST_F(Simulator_test, imports_parallel_parse) {
+  sim::Simulation_engine engine("../lib/test/imports.cell",
+      "m",
+      std::vector<std::string>(),
+      4);
+
+  EXPECT_EQ(2, engine.library()->parsed_files.size());
+
+  engine.setup();
+  engine.simulate(ir::Time(10, ir::Time::ns));
+  auto insp = engine.inspect_module("");
+  EXPECT_EQ(12, insp.get<int64_t>("a"));
+  EXPECT_EQ(6, insp.get<int64_t>("b"));
+  EXPECT_EQ(30, insp.get<int64_t>("c"));
+  EXPECT_EQ(15, insp.get<int64_t>("d"));
+  engine.teardown();
+}
+
+
+TEST_F(Simulator_test, parallel_parse_same_code) {
+  // parsing on several threads must not change the generated code
+  auto compile = [this](unsigned jobs, std::string const& property) {
+    auto start = std::chrono::steady_clock::now();
+    sim::Simulation_engine engine("../lib/test/imports.cell",
+        "m",
+        std::vector<std::string>(),
+        jobs);
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    RecordProperty(property, static_cast<int>(duration.count()));
+
+    std::string ir;
+    llvm::raw_string_ostream os(ir);
+    engine.library()->impl.module->print(os, nullptr);
+    return os.str();
+  };
+
+  auto serial = compile(1, "compile_us_1_job");
+  auto parallel = compile(4, "compile_us_4_jobs");
+  EXPECT_FALSE(serial.empty());
+  EXPECT_EQ(serial, parallel);
+}
+
+
+TEST_F(Simulator_test, parallel_parse_speedup) {
+  namespace bf = boost::filesystem;
+
+  if( std::thread::hardware_concurrency() < 2 ) {
+    std::cout << "parallel_parse_speedup needs at least two hardware threads"
+      << std::endl;
+    return;
+  }
+
+  // several large namespace files referenced by the main file are
+  // independent of each other
+  auto const dir = bf::temp_directory_path()
+    / bf::unique_path("parallel_parse-%%%%-%%%%");
+  bf::create_directories(dir);
+
+  unsigned const num_files = 8;
+  std::ofstream main_file((dir / "main.cell").string());
+  for(unsigned i=0; i<num_files; ++i) {
+    std::stringstream name;
+    name << "ns" << i;
+    main_file << "namespace " << name.str() << "\n";
+
+    std::ofstream ns((dir / (name.str() + ".cell")).string());
+    for(int j=0; j<2000; ++j) {
+      ns << "def f" << j << "(x : int) -> int: if( x == 0 ) " << j
+        << " else x * f" << j << "(x - 1)\n";
+    }
+  }
+  main_file << "mod m: {\n  var a : int\n}\n";
+  main_file.close();
+
+  // best of three runs
+  auto parse_time = [&dir](unsigned jobs) {
+    auto rv = std::chrono::microseconds::max();
+    for(int run=0; run<3; ++run) {
+      auto start = std::chrono::steady_clock::now();
+      auto files = parse_files((dir / "main.cell").string(),
+          std::vector<std::string>{dir.string()},
+          jobs);
+      auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start);
+      EXPECT_EQ(num_files + 1, files.size());
+      rv = std::min(rv, duration);
+    }
+    return rv;
+  };
+
+  auto serial = parse_time(1);
+  auto parallel = parse_time(4);
+  RecordProperty("parse_us_1_job", static_cast<int>(serial.count()));
+  RecordProperty("parse_us_4_jobs", static_cast<int>(parallel.count()));
+  EXPECT_LT(parallel.count(), serial.count());
+
+  bf::remove_all(dir);
+}
+
+
+/** Module m adds increment to its counter using a namespace function */
+static void write_reload_source(std::string const& filename,
+    int increment,
+    bool extra_member = false) {
+  std::ofstream ofs(filename);
+  ofs << "namespace test: {\n"
+    << "  def step(x : int) -> int: x + " << increment << "\n"
+    << "  mod m: {\n"
+    << "    var counter : int\n";
+  if( extra_member )
+    ofs << "    var extra : int\n";
+  ofs << "    def __init__(): {\n"
+    << "      counter = 0;\n"
+    << "    }\n"
+    << "    periodic(2 ns): {\n"
+    << "      counter = step(counter);\n"
+    << "    }\n"
+    << "  }\n"
+    << "}\n";
+}
+
+
+TEST_F(Simulator_test, reload) {
+  namespace bf = boost::filesystem;
+
+  auto const path = bf::temp_directory_path()
+    / bf::unique_path("reload_periodic-%%%%-%%%%.cell");
+  std::string const filename(path.string());
+
+  write_reload_source(filename, 1);
+  sim::Simulation_engine engine(filename, "test::m");
+  engine.setup();
+  engine.simulate(ir::Time(10, ir::Time::ns));
+
+  auto insp = engine.inspect_module("");
+  auto counter = insp.get<int64_t>("counter");
+  EXPECT_LT(0, counter);
+
+  // unchanged source does not replace any code, the module keeps running
+  // the code of the first library
+  EXPECT_EQ(0, engine.reload());
+  EXPECT_EQ(1u, engine.retired_libraries());
+
+  // a new modification time alone does not trigger a reload
+  auto const mtime = bf::last_write_time(path);
+  bf::last_write_time(path, mtime + 10);
+  EXPECT_FALSE(engine.reload_if_changed());
+
+  // changes of called namespace functions are detected, no module runs the
+  // code of the replaced libraries afterwards
+  write_reload_source(filename, 10);
+  bf::last_write_time(path, mtime + 20);
+  EXPECT_TRUE(engine.reload_if_changed());
+  EXPECT_EQ(0u, engine.retired_libraries());
+  engine.simulate(ir::Time(10, ir::Time::ns));
+  EXPECT_EQ(counter + 10 * counter, insp.get<int64_t>("counter"));
+
+  write_reload_source(filename, 10, true);
+  EXPECT_THROW(engine.reload(), sim::Frame_layout_error);
+
+  engine.teardown();
+  bf::remove(path);
+}
+
+
+TEST_F(Simulator_test, specialize_ports) {
+  sim::Simulation_engine engine("../lib/test/specialize.cell",
+      "test::specialize");
+
+  engine.specialize_ports(true);
+  engine.setup();
+  EXPECT_EQ(1u, engine.specialized_instances());
+
+  engine.simulate(ir::Time(10, ir::Time::ns));
+
+  auto intro = engine.inspect_module("");
+  auto counter = intro.get<int64_t>("counter");
+  EXPECT_EQ(10, counter);
+  EXPECT_EQ(3 * counter + 1, intro.get<int64_t>("res"));
+
+  engine.teardown();
+}
+
+
+TEST_F(Simulator_test, frame_layout) {
+  sim::Frame_layout_options opts;
+  opts.eliminate_unused = true;
+  opts.reorder = true;
+  opts.keep.insert("frame_layout.debug");
+
+  sim::Simulation_engine engine("../lib/test/frame_layout.cell",
+      "test::frame_layout",
+      std::vector<std::string>(),
+      1,
+      opts);
+
+  engine.setup();
+  auto intro = engine.inspect_module("");
+  auto const& objects = intro.module()->objects;
+
+  // unreferenced and write-only members removed, kept member stays
+  EXPECT_EQ(0u, objects.count("unused"));
+  EXPECT_EQ(0u, objects.count("last"));
+  ASSERT_EQ(1u, objects.count("debug"));
+
+  // written members first, members only set in __init__ last
+  EXPECT_EQ(1u, objects.at("counter")->impl.struct_index);
+  EXPECT_EQ(2u, objects.at("acc")->impl.struct_index);
+  EXPECT_EQ(3u, objects.at("debug")->impl.struct_index);
+  EXPECT_EQ(4u, objects.at("config")->impl.struct_index);
+
+  engine.simulate(ir::Time(10, ir::Time::ns));
+  auto counter = intro.get<int64_t>("counter");
+  EXPECT_EQ(counter + 5, intro.get<int64_t>("acc"));
+
+  engine.teardown();
+}
@@ -0,0 +1,109 @@
+#include "sim/simulation_engine.h"
+#include "sim/stimulus_replay.h"
+#include "stim/stim_file.h"
+#include "stim/stim_convert.h"
+#include "logging/logger.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <cstring>
+
+
+class Test_stimulus : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      init_logging();
+    }
+};
+
+
+TEST_F(Test_stimulus, convert_csv) {
+  {
+    std::stringstream csv("time,a,b:8\n"
+        "0,1,0x10\n"
+        "1000,-2,\n"
+        "2000,-2,0x11\n");
+    stim::Stimulus_writer writer("test_stimulus_csv.stim");
+    stim::convert_csv(csv, writer);
+  }
+
+  stim::Stimulus_file file("test_stimulus_csv.stim");
+  ASSERT_EQ(2u, file.signals().size());
+  EXPECT_EQ("b", file.signals()[1].name);
+  EXPECT_EQ(8u, file.signals()[1].width);
+
+  // unchanged values are skipped
+  ASSERT_EQ(4u, file.num_events());
+  EXPECT_EQ(2u, file.lower_bound(1000));
+  EXPECT_EQ(3u, file.lower_bound(1001));
+
+  auto const& ev = file.event(2);
+  ASSERT_TRUE(file.valid(2));
+  EXPECT_EQ(1000u, ev.time_ps);
+  EXPECT_EQ(0u, ev.signal);
+  int64_t a;
+  std::memcpy(&a, file.value(ev), sizeof(a));
+  EXPECT_EQ(-2, a);
+
+  EXPECT_EQ(0x11, *file.value(file.event(3)));
+}
+
+
+TEST_F(Test_stimulus, convert_vcd) {
+  {
+    std::stringstream vcd("$timescale 1 ns $end\n"
+        "$scope module m $end\n"
+        "$var wire 1 ! clk $end\n"
+        "$var integer 16 \" a $end\n"
+        "$upscope $end\n"
+        "$enddefinitions $end\n"
+        "#0\n"
+        "$dumpvars\n0!\nb101 \"\n$end\n"
+        "#5\n1!\nbx11 \"\n");
+    stim::Stimulus_writer writer("test_stimulus_vcd.stim");
+    stim::convert_vcd(vcd, writer);
+  }
+
+  stim::Stimulus_file file("test_stimulus_vcd.stim");
+  EXPECT_EQ(1, file.find("m.a"));
+  ASSERT_EQ(4u, file.num_events());
+  EXPECT_EQ(5000u, file.event(2).time_ps);
+  EXPECT_EQ(1, *file.value(file.event(2)));
+  EXPECT_EQ(3, *file.value(file.event(3)));
+}
+
+
+TEST_F(Test_stimulus, replay) {
+  {
+    std::stringstream csv("time,m.a,m.port.b,m.unknown\n"
+        "0,1,2,0\n"
+        "15000,5,,\n"
+        "33000,,0x0a,\n");
+    stim::Stimulus_writer writer("test_stimulus_replay.stim");
+    stim::convert_csv(csv, writer);
+  }
+
+  sim::Simulation_engine engine("../lib/test/driver.cell", "m");
+  engine.setup();
+
+  sim::Stimulus_replay replay(engine, "test_stimulus_replay.stim", "", "m.");
+  engine.add_driver(replay, "");
+  EXPECT_EQ(2u, replay.num_targets());
+
+  auto insp = engine.inspect_module("");
+  engine.simulate(ir::Time(10, ir::Time::ns));
+  EXPECT_EQ(3, insp.get<int64_t>("y"));
+
+  // applied at 15 ns, no process of the design runs then
+  engine.simulate(ir::Time(6, ir::Time::ns));
+  EXPECT_EQ(7, insp.get<int64_t>("y"));
+
+  engine.simulate(ir::Time(24, ir::Time::ns));
+  EXPECT_EQ(15, insp.get<int64_t>("y"));
+  EXPECT_EQ(4u, replay.num_applied());
+  EXPECT_TRUE(replay.finished());
+
+  engine.teardown();
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
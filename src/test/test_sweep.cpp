@@ -0,0 +1,108 @@
+#include "sim/sweep.h"
+#include "logging/logger.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <map>
+
+
+class Test_sweep : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      init_logging();
+    }
+};
+
+
+/** Collects rows by point index */
+class Row_collector : public sim::Sweep_writer {
+  public:
+    virtual void header(std::vector<sim::Sweep_parameter> const& params,
+        std::vector<std::string> const& record) {
+      num_params = params.size();
+      num_record = record.size();
+    }
+
+    virtual void row(std::size_t index,
+        std::vector<double> const& point,
+        ir::Time const& t,
+        std::vector<double> const& values) {
+      rows.insert(std::make_pair(index, std::make_tuple(point,
+              t.value(ir::Time::ps),
+              values)));
+    }
+
+    std::size_t num_params = 0;
+    std::size_t num_record = 0;
+    std::multimap<std::size_t,
+      std::tuple<std::vector<double>, long long, std::vector<double>>> rows;
+};
+
+
+TEST_F(Test_sweep, parse) {
+  auto params = sim::parse_sweep("gl=0.05:0.2:0.05; vthresh=-55,-50");
+  ASSERT_EQ(2u, params.size());
+  EXPECT_EQ("gl", params[0].name);
+  ASSERT_EQ(4u, params[0].values.size());
+  EXPECT_DOUBLE_EQ(0.2, params[0].values[3]);
+  EXPECT_EQ(2u, params[1].values.size());
+  EXPECT_EQ(8u, sim::num_sweep_points(params));
+
+  auto point = sim::sweep_point(params, 3);
+  EXPECT_DOUBLE_EQ(0.1, point[0]);
+  EXPECT_DOUBLE_EQ(-50.0, point[1]);
+
+  EXPECT_THROW(sim::parse_sweep("gl"), std::runtime_error);
+  EXPECT_THROW(sim::parse_sweep("gl=1:0:0.1"), std::runtime_error);
+  EXPECT_THROW(sim::parse_sweep("gl=1,x"), std::runtime_error);
+}
+
+
+TEST_F(Test_sweep, lif) {
+  sim::Simulation_engine design("../lib/test/demo_lif.cell",
+      "demo::lif_neuron");
+  auto params = sim::parse_sweep("gl=0.05,0.1,0.2;vthresh=-55,-50");
+
+  sim::Sweep_options options;
+  options.duration = ir::Time(20, ir::Time::ms);
+  options.record = {"gl", "vthresh", "m"};
+  options.threads = 3;
+
+  Row_collector rows;
+  EXPECT_EQ(6u, sim::run_sweep(design, "", params, options, rows));
+  EXPECT_EQ(2u, rows.num_params);
+  EXPECT_EQ(3u, rows.num_record);
+  ASSERT_EQ(6u, rows.rows.size());
+
+  for(auto const& r : rows.rows) {
+    auto const& point = std::get<0>(r.second);
+    auto const& values = std::get<2>(r.second);
+    EXPECT_EQ(20000000000ll, std::get<1>(r.second));
+    EXPECT_DOUBLE_EQ(point[0], values[0]);
+    EXPECT_DOUBLE_EQ(point[1], values[1]);
+  }
+
+  // the same seed gives the same results, regardless of the threads
+  options.threads = 1;
+  options.sample_period = ir::Time(5, ir::Time::ms);
+  Row_collector sampled;
+  sim::run_sweep(design, "", params, options, sampled);
+  ASSERT_EQ(6u * 5u, sampled.rows.size());
+  for(std::size_t i=0; i<6; ++i) {
+    auto last = std::get<2>(std::prev(sampled.rows.upper_bound(i))->second);
+    EXPECT_EQ(std::get<2>(rows.rows.find(i)->second), last);
+  }
+
+  std::stringstream csv;
+  sim::Csv_sweep_writer writer(csv);
+  options.sample_period = ir::Time();
+  params = sim::parse_sweep("gl=0.1");
+  sim::run_sweep(design, "", params, options, writer);
+  std::string line;
+  std::getline(csv, line);
+  EXPECT_EQ("point,gl,time_ps,gl,vthresh,m", line);
+  std::getline(csv, line);
+  EXPECT_EQ(0u, line.find("0,0.10000000000000001,20000000000,"));
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
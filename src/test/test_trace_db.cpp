@@ -0,0 +1,168 @@
+#include "sim/simulation_engine.h"
+#include "sim/trace_db.h"
+#include "logging/logger.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <map>
+#include <cstring>
+
+
+class Test_trace_db : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      init_logging();
+    }
+};
+
+
+TEST_F(Test_trace_db, series) {
+  sim::Trace_series series(sizeof(int64_t));
+  std::map<uint64_t,int64_t> ref;
+  std::mt19937 rng(7);
+
+  uint64_t t = 100;
+  int64_t v = 0;
+  for(int i=0; i<10000; ++i) {
+    t += rng() % 5 + 1;
+    if( rng() % 3 )
+      v = rng() % 1000 - 500;
+
+    if( series.update(t, reinterpret_cast<char const*>(&v)) )
+      ref[t] = v;
+  }
+  ASSERT_EQ(ref.size(), series.size());
+  EXPECT_LT(series.memory_size(), ref.size() * (sizeof(v) + sizeof(t)));
+
+  int64_t val;
+  EXPECT_FALSE(series.value_at(50, reinterpret_cast<char*>(&val)));
+
+  for(int i=0; i<1000; ++i) {
+    uint64_t t0 = 100 + rng() % (t - 100);
+    uint64_t t1 = t0 + rng() % 200;
+
+    ASSERT_TRUE(series.value_at(t0, reinterpret_cast<char*>(&val)));
+    EXPECT_EQ((--ref.upper_bound(t0))->second, val);
+
+    std::vector<std::pair<uint64_t,int64_t>> edges;
+    series.for_each(t0, t1, [&](uint64_t t, char const* value) {
+      int64_t v;
+      std::memcpy(&v, value, sizeof(v));
+      edges.push_back(std::make_pair(t, v));
+    });
+    std::vector<std::pair<uint64_t,int64_t>> expected(ref.lower_bound(t0),
+        ref.upper_bound(t1));
+    EXPECT_EQ(expected, edges);
+
+    int64_t target = rng() % 1000 - 500;
+    auto pred = [target](char const* value) {
+      int64_t v;
+      std::memcpy(&v, value, sizeof(v));
+      return v == target;
+    };
+    uint64_t found;
+    auto it = --ref.upper_bound(t0);
+    bool expect_found = false;
+    uint64_t expect_time = 0;
+    for(; it != ref.end(); ++it) {
+      if( it->second == target ) {
+        expect_found = true;
+        expect_time = std::max(it->first, t0);
+        break;
+      }
+    }
+    ASSERT_EQ(expect_found, series.find_first(t0, pred, found));
+    if( expect_found )
+      EXPECT_EQ(expect_time, found);
+  }
+}
+
+
+TEST_F(Test_trace_db, query) {
+  sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+      "test");
+  sim::Trace_db db;
+
+  engine.instrument(db);
+  engine.setup();
+  engine.simulate(ir::Time(1, ir::Time::us));
+  engine.teardown();
+
+  EXPECT_THROW(db.find("test.nothing"), std::runtime_error);
+  auto clk = db.find("test.clk");
+  auto state = db.find("test.state");
+  auto ctr = db.find("test.ctr");
+  EXPECT_EQ(1u, db.width(clk));
+  EXPECT_EQ(64u, db.width(state));
+  EXPECT_GT(db.num_changes(), 250u);
+
+  // clock toggles every 4 ns
+  auto edges = db.edges<bool>(clk,
+      ir::Time(100, ir::Time::ns),
+      ir::Time(200, ir::Time::ns));
+  ASSERT_EQ(26u, edges.size());
+  for(std::size_t i=1; i<edges.size(); ++i) {
+    EXPECT_EQ(4000, edges[i].time.value(ir::Time::ps)
+        - edges[i-1].time.value(ir::Time::ps));
+    EXPECT_NE(edges[i].value, edges[i-1].value);
+  }
+
+  // state changes to 2 after reset and to 3 once ctr reaches 10
+  ir::Time t2, t10, t3;
+  ASSERT_TRUE(db.first<int64_t>(state,
+        ir::Time(0, ir::Time::ns),
+        [](int64_t v) { return v == 2; },
+        t2));
+  ASSERT_TRUE(db.first<int64_t>(ctr,
+        t2,
+        [](int64_t v) { return v == 10; },
+        t10));
+  ASSERT_TRUE(db.first<int64_t>(state,
+        t2,
+        [](int64_t v) { return v == 3; },
+        t3));
+  EXPECT_LT(t2, t10);
+  EXPECT_LT(t10, t3);
+  EXPECT_EQ(1, db.value_at<int64_t>(state, ir::Time(t2.value(ir::Time::ps) - 1,
+          ir::Time::ps)));
+  EXPECT_EQ(2, db.value_at<int64_t>(state, t2));
+  EXPECT_EQ(2, db.value_at<int64_t>(state, t10));
+
+  ir::Time never;
+  EXPECT_FALSE(db.first<int64_t>(state,
+        t3,
+        [](int64_t v) { return v == 1; },
+        never));
+
+  auto intro = engine.inspect_module("");
+  EXPECT_EQ(intro.get<int64_t>("state"),
+      db.value_at<int64_t>(state, ir::Time(1, ir::Time::us)));
+  EXPECT_EQ(intro.get<int64_t>("ctr"),
+      db.value_at<int64_t>(ctr, ir::Time(1, ir::Time::us)));
+}
+
+
+
+TEST_F(Test_trace_db, hidden_members) {
+  // modules calling rand() hold the state of their generator in the frame
+  sim::Instrumented_simulation_engine engine("../lib/test/random.cell",
+      "test::random");
+  sim::Trace_db db;
+
+  engine.instrument(db);
+  engine.setup();
+  engine.simulate(ir::Time(1, ir::Time::us));
+
+  auto end = ir::Time(1, ir::Time::us);
+  auto top = engine.inspect_module("");
+  auto noise = engine.inspect_module("n");
+  EXPECT_EQ(top.get<int64_t>("first"),
+      db.value_at<int64_t>(db.find("random.first"), end));
+  EXPECT_EQ(noise.get<int64_t>("count"),
+      db.value_at<int64_t>(db.find("random.n.count"), end));
+  EXPECT_EQ(noise.get<double>("frac"),
+      db.value_at<double>(db.find("random.n.frac"), end));
+  engine.teardown();
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
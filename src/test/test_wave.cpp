@@ -0,0 +1,255 @@
+#include "sim/simulation_engine.h"
+#include "sim/wave_instrumenter.h"
+#include "wave/wave_writer.h"
+#include "wave/wave_reader.h"
+#include "wave/lz.h"
+#include "logging/logger.h"
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <tuple>
+
+
+class Test_wave : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      init_logging();
+    }
+};
+
+
+static int64_t as_int(std::vector<char> const& v) {
+  int64_t rv = 0;
+  std::memcpy(&rv, v.data(), std::min(v.size(), sizeof(rv)));
+  return rv;
+}
+
+
+TEST_F(Test_wave, lz_roundtrip) {
+  std::mt19937 rng(42);
+  std::vector<char> repetitive;
+  for(int i=0; i<10000; ++i)
+    repetitive.push_back("abcabcabd"[i % 9]);
+
+  std::vector<char> random;
+  for(int i=0; i<10000; ++i)
+    random.push_back(static_cast<char>(rng()));
+
+  for(auto const* data : { &repetitive, &random }) {
+    std::vector<char> compressed;
+    wave::lz_compress(data->data(), data->size(), compressed);
+
+    std::vector<char> out;
+    wave::lz_decompress(compressed.data(), compressed.size(), data->size(), out);
+    EXPECT_EQ(*data, out);
+  }
+
+  std::vector<char> compressed;
+  wave::lz_compress(repetitive.data(), repetitive.size(), compressed);
+  EXPECT_LT(compressed.size(), repetitive.size() / 10);
+
+  std::vector<char> out;
+  EXPECT_THROW(wave::lz_decompress(compressed.data(),
+        compressed.size() / 2,
+        repetitive.size(),
+        out), std::runtime_error);
+}
+
+
+TEST_F(Test_wave, seek) {
+  {
+    wave::Writer writer("test_wave__seek.wave", 16);
+    auto top = writer.add_scope(-1, "top");
+    auto sub = writer.add_scope(top, "sub");
+    writer.add_signal(top, "ctr", 64, wave::Signal::integer);
+    writer.add_signal(sub, "flag", 1, wave::Signal::integer);
+    ASSERT_EQ(9u, writer.values_size());
+
+    char values[9] = {};
+    writer.initial(values);
+
+    // ctr counts every 10 ps, flag toggles every 100 ps
+    for(int64_t t=0; t<1000; t += 10) {
+      int64_t ctr = t / 10;
+      std::memcpy(values, &ctr, sizeof(ctr));
+      values[8] = (t / 100) % 2;
+      writer.step(t, values);
+    }
+    writer.close();
+    EXPECT_EQ(7u, writer.num_blocks());
+  }
+
+  wave::Reader reader("test_wave__seek.wave");
+  ASSERT_EQ(2u, reader.signals().size());
+  EXPECT_EQ("top.ctr", reader.path(0));
+  EXPECT_EQ("top.sub.flag", reader.path(1));
+  EXPECT_EQ(1, reader.find("top.sub.flag"));
+  EXPECT_EQ(-1, reader.find("flag"));
+  EXPECT_EQ(990u, reader.end_time());
+
+  EXPECT_EQ(55, as_int(reader.value_at(0, 555)));
+  EXPECT_EQ(1, as_int(reader.value_at(1, 555)));
+  EXPECT_EQ(0, as_int(reader.value_at(1, 250)));
+
+  std::vector<std::tuple<uint64_t,std::size_t,int64_t>> events;
+  reader.read(495, 600,
+      [&](uint64_t t, std::size_t sig, char const* value) {
+        int64_t v = 0;
+        std::memcpy(&v, value, reader.signals()[sig].size());
+        events.push_back(std::make_tuple(t, sig, v));
+      });
+
+  // initial state, 11 changes of ctr and two of flag
+  ASSERT_EQ(15u, events.size());
+  EXPECT_EQ(std::make_tuple(uint64_t(495), std::size_t(0), int64_t(49)), events[0]);
+  EXPECT_EQ(std::make_tuple(uint64_t(495), std::size_t(1), int64_t(0)), events[1]);
+  EXPECT_EQ(std::make_tuple(uint64_t(500), std::size_t(0), int64_t(50)), events[2]);
+  EXPECT_EQ(std::make_tuple(uint64_t(500), std::size_t(1), int64_t(1)), events[3]);
+  EXPECT_EQ(std::make_tuple(uint64_t(600), std::size_t(0), int64_t(60)), events[13]);
+  EXPECT_EQ(std::make_tuple(uint64_t(600), std::size_t(1), int64_t(0)), events[14]);
+}
+
+
+TEST_F(Test_wave, zero_steps) {
+  {
+    wave::Writer writer("test_wave__zero_steps.wave", 16);
+    auto top = writer.add_scope(-1, "top");
+    writer.add_signal(top, "ctr", 64, wave::Signal::integer);
+
+    int64_t ctr = 42;
+    writer.initial(reinterpret_cast<char const*>(&ctr));
+    writer.close();
+    EXPECT_EQ(1u, writer.num_blocks());
+  }
+
+  // the block without steps carries the initial values
+  wave::Reader reader("test_wave__zero_steps.wave");
+  ASSERT_EQ(1u, reader.signals().size());
+  EXPECT_EQ(0u, reader.begin_time());
+  EXPECT_EQ(0u, reader.end_time());
+  EXPECT_EQ(42, as_int(reader.value_at(0, 0)));
+  EXPECT_EQ(42, as_int(reader.value_at(0, 100)));
+}
+
+
+TEST_F(Test_wave, instrumenter) {
+  {
+    sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+        "test");
+    sim::Wave_instrumenter instr("test_wave__fsm.wave", 64);
+    engine.instrument(instr);
+    engine.setup();
+    engine.simulate(ir::Time(1, ir::Time::us));
+
+    auto insp = engine.inspect_module("");
+    auto state = insp.get<int64_t>("state");
+    engine.teardown();
+
+    wave::Reader reader("test_wave__fsm.wave");
+    EXPECT_GT(reader.blocks().size(), 1u);
+
+    int64_t state_sig = -1;
+    for(std::size_t i=0; i<reader.signals().size(); ++i) {
+      if( reader.signals()[i].name == "state" )
+        state_sig = i;
+    }
+    ASSERT_NE(-1, state_sig);
+    EXPECT_EQ(state, as_int(reader.value_at(state_sig, reader.end_time())));
+  }
+}
+
+
+TEST_F(Test_wave, dump_selection) {
+  sim::Dump_selection sel;
+  EXPECT_TRUE(sel.selected("top.anything"));
+
+  sel.add_glob("top.cpu.*.pc");
+  sel.add_glob("top.mem.**");
+  sel.add_regex("top\\.r[0-9]+");
+
+  EXPECT_TRUE(sel.selected("top.cpu.alu.pc"));
+  EXPECT_FALSE(sel.selected("top.cpu.alu.sub.pc"));
+  EXPECT_FALSE(sel.selected("top.cpu.alu.pcx"));
+  EXPECT_TRUE(sel.selected("top.mem.bank0.row"));
+  EXPECT_TRUE(sel.selected("top.r12"));
+  EXPECT_FALSE(sel.selected("top.rx"));
+
+  EXPECT_TRUE(sel.depth_selected(5));
+  sel.max_depth(1);
+  EXPECT_TRUE(sel.depth_selected(1));
+  EXPECT_FALSE(sel.depth_selected(2));
+}
+
+
+TEST_F(Test_wave, dump_when) {
+  sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+      "test");
+  sim::Wave_instrumenter instr("test_wave__dump_when.wave", 64);
+
+  sim::Dump_selection sel;
+  sel.add_glob("test.st*");
+  engine.dump_scope(sel);
+  engine.dump_when("test.state == 2 && !test.reset");
+  engine.dump_window(ir::Time(0, ir::Time::ns), ir::Time(500, ir::Time::ns));
+
+  engine.instrument(instr);
+  engine.setup();
+  engine.simulate(ir::Time(1, ir::Time::us));
+  engine.teardown();
+
+  wave::Reader reader("test_wave__dump_when.wave");
+  ASSERT_EQ(1u, reader.signals().size());
+  EXPECT_EQ("state", reader.signals()[0].name);
+  ASSERT_FALSE(reader.blocks().empty());
+  EXPECT_GT(reader.begin_time(), 0u);
+  EXPECT_LT(reader.end_time(), 500000u);
+  EXPECT_EQ(2, as_int(reader.value_at(0, reader.begin_time())));
+}
+
+
+TEST_F(Test_wave, dump_when_invalid) {
+  char const* conditions[] = {
+    "test.nothing == 1",
+    "test.state == ",
+    "test.state = 2",
+    "1 == 2",
+    "state == 2",
+    "test.state == 12abc",
+    "test.state == 1e5",
+    "test.state == 0x",
+    "test.state == 1."
+  };
+
+  for(auto cond : conditions) {
+    sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+        "test");
+    sim::Wave_instrumenter instr("test_wave__dump_when_invalid.wave");
+    engine.instrument(instr);
+    engine.dump_when(cond);
+    EXPECT_THROW(engine.setup(), std::runtime_error) << cond;
+  }
+}
+
+
+TEST_F(Test_wave, dump_when_setup_twice) {
+  sim::Instrumented_simulation_engine engine("../lib/test/basic_fsm.cell",
+      "test");
+  engine.dump_when("test.state == 0x2");
+
+  auto num_conditions = [&engine]() {
+    std::size_t rv = 0;
+    for(auto const& f : *(engine.library()->impl.module)) {
+      if( f.getName().startswith("dump_condition") )
+        ++rv;
+    }
+    return rv;
+  };
+
+  // the code of the previous condition is removed
+  for(int i=0; i<3; ++i) {
+    engine.setup();
+    EXPECT_EQ(1u, num_conditions());
+    engine.teardown();
+  }
+}
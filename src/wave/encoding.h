@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+
+namespace wave {
+
+  /** Helpers to write and read the little endian integers of the format */
+  namespace encoding {
+
+    template<typename T>
+    inline void put(std::vector<char>& dst, T v) {
+      for(std::size_t i=0; i<sizeof(T); ++i)
+        dst.push_back(static_cast<char>((static_cast<uint64_t>(v) >> (8 * i)) & 0xff));
+    }
+
+
+    inline void put_varint(std::vector<char>& dst, uint64_t v) {
+      while( v >= 0x80 ) {
+        dst.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+      }
+      dst.push_back(static_cast<char>(v));
+    }
+
+
+    inline void put_string(std::vector<char>& dst, std::string const& s) {
+      put<uint32_t>(dst, s.size());
+      dst.insert(dst.end(), s.begin(), s.end());
+    }
+
+
+    /** Sequential reader over a memory range */
+    class Cursor {
+      public:
+        Cursor(char const* begin, char const* end)
+          : m_p(begin),
+            m_end(end) {
+        }
+
+        template<typename T>
+        T get() {
+          check(sizeof(T));
+          uint64_t v = 0;
+          for(std::size_t i=0; i<sizeof(T); ++i)
+            v |= static_cast<uint64_t>(static_cast<unsigned char>(m_p[i])) << (8 * i);
+          m_p += sizeof(T);
+          return static_cast<T>(v);
+        }
+
+        uint64_t get_varint() {
+          uint64_t v = 0;
+          for(unsigned shift=0; shift<64; shift+=7) {
+            check(1);
+            auto c = static_cast<unsigned char>(*m_p++);
+            v |= static_cast<uint64_t>(c & 0x7f) << shift;
+            if( !(c & 0x80) )
+              return v;
+          }
+          throw std::runtime_error("Corrupt waveform: invalid varint");
+        }
+
+        std::string get_string() {
+          auto n = get<uint32_t>();
+          check(n);
+          std::string rv(m_p, m_p + n);
+          m_p += n;
+          return rv;
+        }
+
+        char const* get_bytes(std::size_t n) {
+          check(n);
+          auto rv = m_p;
+          m_p += n;
+          return rv;
+        }
+
+
+      private:
+        char const* m_p;
+        char const* m_end;
+
+        void check(std::size_t n) const {
+          if( static_cast<std::size_t>(m_end - m_p) < n )
+            throw std::runtime_error("Corrupt waveform: unexpected end of data");
+        }
+    };
+
+  }
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,165 @@
+#include "wave/lz.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace wave {
+
+  static std::size_t const min_match = 4;
+  static std::size_t const max_offset = 65535;
+  static unsigned const hash_bits = 12;
+
+  // local helper functions
+  static uint32_t hash(char const* p);
+  static void put_length(std::vector<char>& dst, std::size_t len);
+  static void put_sequence(std::vector<char>& dst,
+      char const* literals,
+      std::size_t num_literals,
+      std::size_t offset,
+      std::size_t match_len);
+  static std::size_t get_length(unsigned char const*& p,
+      unsigned char const* end,
+      std::size_t len);
+
+
+
+  void lz_compress(char const* src, std::size_t n, std::vector<char>& dst) {
+    static std::size_t const none = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> table(1 << hash_bits, none);
+
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+
+    while( i + min_match <= n ) {
+      auto h = hash(src + i);
+      auto cand = table[h];
+      table[h] = i;
+
+      if( (cand == none)
+          || (i - cand > max_offset)
+          || (std::memcmp(src + cand, src + i, min_match) != 0) ) {
+        ++i;
+        continue;
+      }
+
+      auto len = min_match;
+      while( (i + len < n) && (src[cand + len] == src[i + len]) )
+        ++len;
+
+      put_sequence(dst, src + anchor, i - anchor, i - cand, len);
+      i += len;
+      anchor = i;
+    }
+
+    if( anchor < n )
+      put_sequence(dst, src + anchor, n - anchor, 0, 0);
+  }
+
+
+  void lz_decompress(char const* src,
+      std::size_t n,
+      std::size_t raw_size,
+      std::vector<char>& dst) {
+    auto p = reinterpret_cast<unsigned char const*>(src);
+    auto end = p + n;
+    auto base = dst.size();
+
+    dst.reserve(base + raw_size);
+
+    while( p < end ) {
+      unsigned token = *p++;
+
+      auto num_literals = get_length(p, end, token >> 4);
+      if( static_cast<std::size_t>(end - p) < num_literals )
+        throw std::runtime_error("Corrupt compressed data: literals out of range");
+      dst.insert(dst.end(), p, p + num_literals);
+      p += num_literals;
+
+      // last sequence
+      if( p == end )
+        break;
+
+      if( end - p < 2 )
+        throw std::runtime_error("Corrupt compressed data: truncated offset");
+      std::size_t offset = p[0] | (p[1] << 8);
+      p += 2;
+
+      auto match_len = get_length(p, end, token & 0xf) + min_match;
+      if( (offset == 0) || (offset > dst.size() - base) )
+        throw std::runtime_error("Corrupt compressed data: invalid match offset");
+
+      // matches may overlap the output, so copy byte wise
+      auto from = dst.size() - offset;
+      for(std::size_t i=0; i<match_len; ++i)
+        dst.push_back(dst[from + i]);
+    }
+
+    if( dst.size() - base != raw_size )
+      throw std::runtime_error("Corrupt compressed data: size mismatch");
+  }
+
+
+
+  static uint32_t hash(char const* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - hash_bits);
+  }
+
+
+  static void put_length(std::vector<char>& dst, std::size_t len) {
+    while( len >= 255 ) {
+      dst.push_back(static_cast<char>(255));
+      len -= 255;
+    }
+    dst.push_back(static_cast<char>(len));
+  }
+
+
+  static void put_sequence(std::vector<char>& dst,
+      char const* literals,
+      std::size_t num_literals,
+      std::size_t offset,
+      std::size_t match_len) {
+    auto lit_nibble = num_literals < 15 ? num_literals : 15;
+    auto match_nibble = 0;
+    if( match_len > 0 )
+      match_nibble = (match_len - min_match) < 15 ? (match_len - min_match) : 15;
+
+    dst.push_back(static_cast<char>((lit_nibble << 4) | match_nibble));
+    if( lit_nibble == 15 )
+      put_length(dst, num_literals - 15);
+
+    dst.insert(dst.end(), literals, literals + num_literals);
+
+    if( match_len > 0 ) {
+      dst.push_back(static_cast<char>(offset & 0xff));
+      dst.push_back(static_cast<char>(offset >> 8));
+      if( match_nibble == 15 )
+        put_length(dst, match_len - min_match - 15);
+    }
+  }
+
+
+  static std::size_t get_length(unsigned char const*& p,
+      unsigned char const* end,
+      std::size_t len) {
+    if( len != 15 )
+      return len;
+
+    unsigned char c;
+    do {
+      if( p == end )
+        throw std::runtime_error("Corrupt compressed data: truncated length");
+      c = *p++;
+      len += c;
+    } while( c == 255 );
+
+    return len;
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
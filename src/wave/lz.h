@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+
+namespace wave {
+
+  /** Compress data with a byte oriented LZ77 codec
+   *
+   * The format follows the LZ4 block format: a sequence consists of a token
+   * byte holding the number of literals and the match length, the
+   * literals, and a 16 bit little endian match offset. The last sequence
+   * holds literals only. Compression uses a single hash table probe per
+   * position, which favours speed over ratio.
+   *
+   * The compressed data is appended to dst.
+   * */
+  void lz_compress(char const* src, std::size_t n, std::vector<char>& dst);
+
+  /** Decompress data written by lz_compress()
+   *
+   * @param raw_size Size of the uncompressed data
+   *
+   * The uncompressed data is appended to dst. Throws std::runtime_error on
+   * corrupt input.
+   * */
+  void lz_decompress(char const* src,
+      std::size_t n,
+      std::size_t raw_size,
+      std::vector<char>& dst);
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
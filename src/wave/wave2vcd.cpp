@@ -0,0 +1,191 @@
+#include "wave/wave_reader.h"
+
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <limits>
+
+namespace po = boost::program_options;
+
+
+/** VCD reference code, same scheme as sim::Vcd_instrumenter */
+std::string reference(std::size_t i) {
+  static char const lowest = 33;
+  static char const highest = 126;
+  static std::size_t const num_codes = highest - lowest;
+
+  std::string rv;
+  for(std::size_t j = 0; j < (i / num_codes); ++j)
+    rv.push_back(highest);
+  rv.push_back(lowest + (i % num_codes));
+
+  return rv;
+}
+
+
+void write_scope(std::ostream& os,
+    wave::Reader const& reader,
+    int64_t scope) {
+  auto const& scopes = reader.scopes();
+  auto const& signals = reader.signals();
+
+  os << "$scope module " << scopes[scope].name << " $end\n";
+
+  for(std::size_t i=0; i<signals.size(); ++i) {
+    if( static_cast<int64_t>(signals[i].scope) != scope )
+      continue;
+
+    if( signals[i].kind == wave::Signal::real )
+      os << "$var real 1 ";
+    else
+      os << "$var integer " << signals[i].width << ' ';
+    os << reference(i) << ' ' << signals[i].name << " $end\n";
+  }
+
+  for(std::size_t i=0; i<scopes.size(); ++i) {
+    if( scopes[i].parent == scope )
+      write_scope(os, reader, i);
+  }
+
+  os << "$upscope $end\n";
+}
+
+
+void write_value(std::ostream& os,
+    wave::Signal const& sig,
+    std::size_t index,
+    char const* value) {
+  if( sig.kind == wave::Signal::real ) {
+    double v;
+    std::memcpy(&v, value, sizeof(v));
+    os << 'r' << v << ' ' << reference(index) << '\n';
+    return;
+  }
+
+  std::string bits(sig.width, '0');
+  for(std::size_t i=0; i<sig.width; ++i) {
+    if( (value[i / 8] >> (i % 8)) & 1 )
+      bits[sig.width - 1 - i] = '1';
+  }
+
+  os << 'b' << bits << ' ' << reference(index) << '\n';
+}
+
+
+void convert(std::string const& input,
+    std::string const& output,
+    uint64_t t_begin,
+    uint64_t t_end) {
+  wave::Reader reader(input);
+
+  std::ofstream os(output);
+  if( !os )
+    throw std::runtime_error("Failed to open file '" + output + "'");
+
+  os << "$date today $end\n"
+    << "$version CELL's waveform converter v0.0 $end\n"
+    << "$comment converted from " << input << " $end\n"
+    << "$timescale 1 ps $end\n";
+
+  for(std::size_t i=0; i<reader.scopes().size(); ++i) {
+    if( reader.scopes()[i].parent < 0 )
+      write_scope(os, reader, i);
+  }
+
+  os << "$enddefinitions\n";
+
+  auto const& signals = reader.signals();
+  std::size_t num_initial = 0;
+  uint64_t last_t = t_begin;
+
+  os << '#' << t_begin << '\n'
+    << "$dumpvars\n";
+  reader.read(t_begin, t_end,
+      [&](uint64_t t, std::size_t sig, char const* value) {
+        if( num_initial < signals.size() ) {
+          write_value(os, signals[sig], sig, value);
+          if( ++num_initial == signals.size() )
+            os << "$end\n";
+          return;
+        }
+
+        if( t != last_t ) {
+          os << '#' << t << '\n';
+          last_t = t;
+        }
+        write_value(os, signals[sig], sig, value);
+      });
+
+  if( num_initial < signals.size() )
+    os << "$end\n";
+}
+
+
+int main(int argc, char* argv[]) {
+  using namespace std;
+
+  try {
+    po::options_description desc("Options");
+    desc.add_options()
+      ("help,h", "print usage info")
+      ("input,i", po::value<std::string>(),
+       "input waveform file")
+      ("output,o", po::value<std::string>(),
+       "output VCD file")
+      ("begin,b", po::value<uint64_t>()->default_value(0),
+       "first time to convert in ps")
+      ("end,e", po::value<uint64_t>()->default_value(std::numeric_limits<uint64_t>::max()),
+       "last time to convert in ps")
+      ("info", "print signals and blocks instead of converting")
+    ;
+    po::positional_options_description pos_opts;
+    pos_opts.add("input", 1);
+    pos_opts.add("output", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv)
+        .options(desc)
+        .positional(pos_opts)
+        .run(),
+        vm);
+    po::notify(vm);
+
+    if( vm.count("help")
+        || !vm.count("input")
+        || (!vm.count("output") && !vm.count("info")) ) {
+      cout << "Usage: " << argv[0]
+        << " [options] <waveform> <VCD file>\n\n"
+        << desc << endl;
+      return 0;
+    }
+
+    if( vm.count("info") ) {
+      wave::Reader reader(vm["input"].as<std::string>());
+      for(std::size_t i=0; i<reader.signals().size(); ++i)
+        cout << reader.path(i) << " ("
+          << reader.signals()[i].width << " bits)\n";
+      for(auto const& b : reader.blocks())
+        cout << "block @" << b.offset << ": "
+          << b.t_begin << " - " << b.t_end << " ps, "
+          << b.num_steps << " steps\n";
+      return 0;
+    }
+
+    convert(vm["input"].as<std::string>(),
+        vm["output"].as<std::string>(),
+        vm["begin"].as<uint64_t>(),
+        vm["end"].as<uint64_t>());
+
+  } catch( std::runtime_error const& err ) {
+    cerr << "Encountered runtime error: " << err.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* vim: set et ff=unix sts=2 sw=2 ts=2 : */
@@ -0,0 +1,80 @@
+#pragma once
+
+/** @file
+ * Binary waveform format written by wave::Writer.
+ *
+ * All integers are stored little endian. Times are given in picoseconds.
+ *
+ *   header        "CELLWAVE", u32 version, u32 reserved,
+ *                 u64 number of scopes, u64 number of signals
+ *   scopes        i64 parent scope (-1 for the root), string name
+ *   signals       u64 scope, u32 width in bits, u8 kind, string name
+ *   blocks        see below
+ *   index         per block: u64 file offset, u64 first time, u64 last time,
+ *                 u32 number of steps
+ *   trailer       u64 index offset, u64 number of blocks, "CELLWEND"
+ *
+ * Strings are stored as u32 length followed by the characters.
+ *
+ * A block holds a fixed maximum number of simulation steps. It is stored as
+ * u8 compression (0 raw, 1 LZ, see lz_compress()), u32 raw size, u32 stored
+ * size and the stored data. The raw block data is organized column wise:
+ *
+ *   u32 number of steps
+ *   times         varint per step, delta to the previous step; the first
+ *                 delta is relative to the first time in the index
+ *   values        value of every signal before the first step
+ *   columns       per signal: varint number of changes, followed by the
+ *                 changes as varint step delta and value
+ *
+ * Values occupy (width + 7) / 8 bytes, real values are stored as double.
+ * Because every block starts with the values of all signals, blocks can be
+ * decoded independently of each other. A file holds at least one block, if
+ * no step was written it has no steps and starts at time 0.
+ * */
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+
+namespace wave {
+
+  static char const file_magic[8] = {'C','E','L','L','W','A','V','E'};
+  static char const trailer_magic[8] = {'C','E','L','L','W','E','N','D'};
+  static uint32_t const format_version = 1;
+
+  enum Compression {
+    raw = 0,
+    lz = 1
+  };
+
+  struct Scope {
+    int64_t parent;
+    std::string name;
+  };
+
+  struct Signal {
+    enum Kind { integer = 0, real = 1 };
+
+    uint64_t scope;
+    uint32_t width;
+    Kind kind;
+    std::string name;
+
+    /** size of a value in bytes */
+    std::size_t size() const {
+      return kind == real ? sizeof(double) : (width + 7) / 8;
+    }
+  };
+
+  struct Block_info {
+    uint64_t offset;
+    uint64_t t_begin;
+    uint64_t t_end;
+    uint32_t num_steps;
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,308 @@
+#include "wave/wave_reader.h"
+#include "wave/encoding.h"
+#include "wave/lz.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace wave {
+
+  using namespace encoding;
+
+  static std::size_t const trailer_size = 8 + 8 + sizeof(trailer_magic);
+  static std::size_t const index_entry_size = 8 + 8 + 8 + 4;
+  static std::size_t const block_header_size = 1 + 4 + 4;
+
+
+  Reader::Reader(std::string const& filename)
+    : m_filename(filename) {
+    m_is.open(filename, std::ios::binary);
+    if( !m_is ) {
+      std::stringstream strm;
+      strm << "Could not open waveform file '"
+        << filename
+        << "' for reading";
+      throw std::runtime_error(strm.str());
+    }
+
+    read_index();
+    read_header();
+  }
+
+
+  std::string
+  Reader::path(std::size_t signal) const {
+    auto const& sig = m_signals.at(signal);
+    std::string rv = sig.name;
+
+    for(int64_t s = sig.scope; s >= 0; s = m_scopes[s].parent)
+      rv = m_scopes[s].name + '.' + rv;
+
+    return rv;
+  }
+
+
+  int64_t
+  Reader::find(std::string const& path) const {
+    for(std::size_t i=0; i<m_signals.size(); ++i) {
+      if( this->path(i) == path )
+        return i;
+    }
+
+    return -1;
+  }
+
+
+  uint64_t
+  Reader::begin_time() const {
+    return m_index.empty() ? 0 : m_index.front().t_begin;
+  }
+
+
+  uint64_t
+  Reader::end_time() const {
+    return m_index.empty() ? 0 : m_index.back().t_end;
+  }
+
+
+  void
+  Reader::read(uint64_t t_begin, uint64_t t_end, Value_callback const& fn) {
+    if( m_index.empty() )
+      return;
+
+    // last block starting at or before t_begin
+    auto it = std::upper_bound(m_index.begin(),
+        m_index.end(),
+        t_begin,
+        [](uint64_t t, Block_info const& b) { return t < b.t_begin; });
+    std::size_t b = (it == m_index.begin()) ? 0 : (it - m_index.begin()) - 1;
+
+    Block block;
+    load_block(b, block);
+
+    // state at t_begin
+    std::vector<char> state(block.start_values,
+        block.start_values + m_values_size);
+    std::size_t ci = 0;
+    for(; ci < block.changes.size(); ++ci) {
+      auto const& c = block.changes[ci];
+      if( block.times[c.step] > t_begin )
+        break;
+      std::memcpy(&state[m_offsets[c.signal]],
+          c.value,
+          m_signals[c.signal].size());
+    }
+
+    for(std::size_t i=0; i<m_signals.size(); ++i)
+      fn(t_begin, i, &state[m_offsets[i]]);
+
+    while( true ) {
+      for(; ci < block.changes.size(); ++ci) {
+        auto const& c = block.changes[ci];
+        auto t = block.times[c.step];
+        if( t > t_end )
+          return;
+        fn(t, c.signal, c.value);
+      }
+
+      if( (++b >= m_index.size()) || (m_index[b].t_begin > t_end) )
+        return;
+
+      load_block(b, block);
+      ci = 0;
+    }
+  }
+
+
+  std::vector<char>
+  Reader::value_at(std::size_t signal, uint64_t t) {
+    if( signal >= m_signals.size() )
+      throw std::runtime_error("Invalid signal index");
+
+    std::vector<char> rv;
+    read(t, t, [&](uint64_t, std::size_t sig, char const* value) {
+          if( sig == signal )
+            rv.assign(value, value + m_signals[sig].size());
+        });
+
+    return rv;
+  }
+
+
+  void
+  Reader::read_index() {
+    m_is.seekg(0, std::ios::end);
+    uint64_t file_size = m_is.tellg();
+    if( file_size < trailer_size )
+      throw std::runtime_error("Corrupt waveform: file too short");
+
+    auto trailer = read_bytes(file_size - trailer_size, trailer_size);
+    Cursor cur(trailer.data(), trailer.data() + trailer.size());
+    auto index_offset = cur.get<uint64_t>();
+    auto num_blocks = cur.get<uint64_t>();
+    if( std::memcmp(cur.get_bytes(sizeof(trailer_magic)),
+          trailer_magic,
+          sizeof(trailer_magic)) != 0 ) {
+      std::stringstream strm;
+      strm << "'" << m_filename << "' is not a complete waveform file";
+      throw std::runtime_error(strm.str());
+    }
+
+    if( index_offset + num_blocks * index_entry_size + trailer_size != file_size )
+      throw std::runtime_error("Corrupt waveform: invalid block index");
+
+    auto index = read_bytes(index_offset, num_blocks * index_entry_size);
+    Cursor icur(index.data(), index.data() + index.size());
+    for(uint64_t i=0; i<num_blocks; ++i) {
+      Block_info info;
+      info.offset = icur.get<uint64_t>();
+      info.t_begin = icur.get<uint64_t>();
+      info.t_end = icur.get<uint64_t>();
+      info.num_steps = icur.get<uint32_t>();
+      m_index.push_back(info);
+    }
+  }
+
+
+  void
+  Reader::read_header() {
+    // the header ends where the first block or the index begins
+    m_is.seekg(0, std::ios::end);
+    uint64_t end = m_is.tellg();
+    end -= trailer_size + m_index.size() * index_entry_size;
+    if( !m_index.empty() )
+      end = m_index.front().offset;
+
+    auto header = read_bytes(0, end);
+    Cursor cur(header.data(), header.data() + header.size());
+
+    if( std::memcmp(cur.get_bytes(sizeof(file_magic)),
+          file_magic,
+          sizeof(file_magic)) != 0 ) {
+      std::stringstream strm;
+      strm << "'" << m_filename << "' is not a waveform file";
+      throw std::runtime_error(strm.str());
+    }
+
+    auto version = cur.get<uint32_t>();
+    if( version != format_version ) {
+      std::stringstream strm;
+      strm << "Unsupported waveform format version "
+        << version
+        << " (expected "
+        << format_version
+        << ")";
+      throw std::runtime_error(strm.str());
+    }
+    cur.get<uint32_t>();
+
+    auto num_scopes = cur.get<uint64_t>();
+    auto num_signals = cur.get<uint64_t>();
+
+    for(uint64_t i=0; i<num_scopes; ++i) {
+      Scope scope;
+      scope.parent = cur.get<int64_t>();
+      scope.name = cur.get_string();
+      if( (scope.parent < -1) || (scope.parent >= static_cast<int64_t>(i)) )
+        throw std::runtime_error("Corrupt waveform: invalid parent scope");
+      m_scopes.push_back(scope);
+    }
+
+    for(uint64_t i=0; i<num_signals; ++i) {
+      Signal sig;
+      sig.scope = cur.get<uint64_t>();
+      sig.width = cur.get<uint32_t>();
+      sig.kind = static_cast<Signal::Kind>(cur.get<uint8_t>());
+      sig.name = cur.get_string();
+      if( sig.scope >= m_scopes.size() )
+        throw std::runtime_error("Corrupt waveform: invalid signal scope");
+
+      m_signals.push_back(sig);
+      m_offsets.push_back(m_values_size);
+      m_values_size += sig.size();
+    }
+  }
+
+
+  void
+  Reader::load_block(std::size_t i, Block& block) {
+    auto const& info = m_index[i];
+
+    auto header = read_bytes(info.offset, block_header_size);
+    Cursor hcur(header.data(), header.data() + header.size());
+    auto compression = hcur.get<uint8_t>();
+    auto raw_size = hcur.get<uint32_t>();
+    auto stored_size = hcur.get<uint32_t>();
+
+    auto stored = read_bytes(info.offset + block_header_size, stored_size);
+    block.data.clear();
+    if( compression == lz )
+      lz_decompress(stored.data(), stored.size(), raw_size, block.data);
+    else if( compression == raw )
+      block.data.swap(stored);
+    else
+      throw std::runtime_error("Corrupt waveform: unknown block compression");
+
+    Cursor cur(block.data.data(), block.data.data() + block.data.size());
+    auto num_steps = cur.get<uint32_t>();
+    if( num_steps != info.num_steps )
+      throw std::runtime_error("Corrupt waveform: block does not match index");
+
+    block.times.clear();
+    uint64_t t = info.t_begin;
+    for(uint32_t s=0; s<num_steps; ++s) {
+      t += cur.get_varint();
+      block.times.push_back(t);
+    }
+
+    block.start_values = cur.get_bytes(m_values_size);
+
+    block.changes.clear();
+    for(std::size_t sig=0; sig<m_signals.size(); ++sig) {
+      auto num_changes = cur.get_varint();
+      uint64_t step = 0;
+      for(uint64_t c=0; c<num_changes; ++c) {
+        step += cur.get_varint();
+        if( step >= num_steps )
+          throw std::runtime_error("Corrupt waveform: change out of block");
+
+        Block::Change change;
+        change.step = step;
+        change.signal = sig;
+        change.value = cur.get_bytes(m_signals[sig].size());
+        block.changes.push_back(change);
+      }
+    }
+
+    std::stable_sort(block.changes.begin(),
+        block.changes.end(),
+        [](Block::Change const& a, Block::Change const& b) {
+          return a.step < b.step;
+        });
+  }
+
+
+  std::vector<char>
+  Reader::read_bytes(uint64_t offset, std::size_t n) {
+    std::vector<char> rv(n);
+
+    m_is.clear();
+    m_is.seekg(offset);
+    m_is.read(rv.data(), n);
+    if( !m_is ) {
+      std::stringstream strm;
+      strm << "Failed to read from waveform file '"
+        << m_filename
+        << "'";
+      throw std::runtime_error(strm.str());
+    }
+
+    return rv;
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "wave/wave_format.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <fstream>
+
+
+namespace wave {
+
+  /** Read a binary waveform file, see wave_format.h
+   *
+   * Only the header and the block index are read when opening a file.
+   * Blocks are loaded on demand, so reading a time range only touches the
+   * blocks covering it.
+   * */
+  class Reader {
+    public:
+      /** Called with time, signal index and value */
+      typedef std::function<void(uint64_t, std::size_t, char const*)> Value_callback;
+
+
+      explicit Reader(std::string const& filename);
+
+      std::vector<Scope> const& scopes() const { return m_scopes; }
+      std::vector<Signal> const& signals() const { return m_signals; }
+      std::vector<Block_info> const& blocks() const { return m_index; }
+
+      /** Hierarchical name of a signal with scopes separated by '.' */
+      std::string path(std::size_t signal) const;
+
+      /** Find a signal by hierarchical name
+       *
+       * @return Index of the signal or -1 if not found
+       * */
+      int64_t find(std::string const& path) const;
+
+      /** Time of the first step */
+      uint64_t begin_time() const;
+
+      /** Time of the last step */
+      uint64_t end_time() const;
+
+      /** Read values within a time range
+       *
+       * Calls fn for every signal with its value at t_begin first, followed
+       * by all value changes in (t_begin, t_end] in order of time.
+       * */
+      void read(uint64_t t_begin, uint64_t t_end, Value_callback const& fn);
+
+      /** Value of a signal at time t */
+      std::vector<char> value_at(std::size_t signal, uint64_t t);
+
+
+    private:
+      /** Decoded block data */
+      struct Block {
+        struct Change {
+          uint32_t step;
+          std::size_t signal;
+          char const* value;
+        };
+
+        std::vector<char> data;
+        std::vector<uint64_t> times;
+        char const* start_values;
+        std::vector<Change> changes;  /**< ordered by step */
+      };
+
+      std::string m_filename;
+      std::ifstream m_is;
+      std::vector<Scope> m_scopes;
+      std::vector<Signal> m_signals;
+      std::vector<std::size_t> m_offsets;
+      std::size_t m_values_size = 0;
+      std::vector<Block_info> m_index;
+
+      void read_header();
+      void read_index();
+      void load_block(std::size_t i, Block& block);
+      std::vector<char> read_bytes(uint64_t offset, std::size_t n);
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,238 @@
+#include "wave/wave_writer.h"
+#include "wave/encoding.h"
+#include "wave/lz.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace wave {
+
+  using namespace encoding;
+
+
+  Writer::Writer(std::string const& filename, std::size_t block_steps)
+    : m_filename(filename),
+      m_block_steps(block_steps) {
+    if( m_block_steps == 0 )
+      throw std::runtime_error("Waveform blocks must hold at least one step");
+
+    m_os.open(filename, std::ios::binary);
+    if( !m_os ) {
+      std::stringstream strm;
+      strm << "Could not open waveform file '"
+        << filename
+        << "' for writing";
+      throw std::runtime_error(strm.str());
+    }
+  }
+
+
+  Writer::~Writer() {
+    try {
+      close();
+    } catch( std::exception const& ) {
+    }
+  }
+
+
+  std::size_t
+  Writer::add_scope(int64_t parent, std::string const& name) {
+    if( m_started )
+      throw std::runtime_error("Scopes must be added before Writer::initial()");
+    if( (parent >= static_cast<int64_t>(m_scopes.size())) || (parent < -1) )
+      throw std::runtime_error("Invalid parent scope");
+
+    m_scopes.push_back(Scope{parent, name});
+    return m_scopes.size() - 1;
+  }
+
+
+  std::size_t
+  Writer::add_signal(uint64_t scope,
+      std::string const& name,
+      uint32_t width,
+      Signal::Kind kind) {
+    if( m_started )
+      throw std::runtime_error("Signals must be added before Writer::initial()");
+    if( scope >= m_scopes.size() )
+      throw std::runtime_error("Invalid signal scope");
+
+    m_signals.push_back(Signal{scope, width, kind, name});
+    m_offsets.push_back(m_values_size);
+    m_values_size += m_signals.back().size();
+    return m_signals.size() - 1;
+  }
+
+
+  void
+  Writer::initial(char const* values) {
+    if( m_started )
+      throw std::runtime_error("Writer::initial() called twice");
+    m_started = true;
+
+    std::vector<char> header(file_magic, file_magic + sizeof(file_magic));
+    put<uint32_t>(header, format_version);
+    put<uint32_t>(header, 0);
+    put<uint64_t>(header, m_scopes.size());
+    put<uint64_t>(header, m_signals.size());
+
+    for(auto const& scope : m_scopes) {
+      put<int64_t>(header, scope.parent);
+      put_string(header, scope.name);
+    }
+
+    for(auto const& sig : m_signals) {
+      put<uint64_t>(header, sig.scope);
+      put<uint32_t>(header, sig.width);
+      put<uint8_t>(header, sig.kind);
+      put_string(header, sig.name);
+    }
+
+    write(header);
+
+    m_current.assign(values, values + m_values_size);
+    m_block_start = m_current;
+    m_columns.resize(m_signals.size());
+    m_num_changes.assign(m_signals.size(), 0);
+    m_last_step.assign(m_signals.size(), 0);
+  }
+
+
+  void
+  Writer::step(uint64_t t, char const* values) {
+    if( !m_started || m_closed )
+      throw std::runtime_error("Writer::step() called outside of "
+          "Writer::initial() and Writer::close()");
+
+    uint64_t last_t = 0;
+    if( !m_times.empty() )
+      last_t = m_times.back();
+    else if( !m_index.empty() )
+      last_t = m_index.back().t_end;
+
+    if( t < last_t )
+      throw std::runtime_error("Waveform times must not decrease");
+
+    uint32_t step_index = m_times.size();
+    m_times.push_back(t);
+
+    for(std::size_t i=0; i<m_signals.size(); ++i) {
+      auto ofs = m_offsets[i];
+      auto sz = m_signals[i].size();
+
+      if( std::memcmp(values + ofs, &m_current[ofs], sz) == 0 )
+        continue;
+
+      auto& col = m_columns[i];
+      put_varint(col, step_index - m_last_step[i]);
+      col.insert(col.end(), values + ofs, values + ofs + sz);
+      std::memcpy(&m_current[ofs], values + ofs, sz);
+      m_last_step[i] = step_index;
+      ++m_num_changes[i];
+    }
+
+    if( m_times.size() >= m_block_steps )
+      flush_block();
+  }
+
+
+  void
+  Writer::close() {
+    if( m_closed )
+      return;
+
+    if( !m_started )
+      initial(std::vector<char>(m_values_size, 0).data());
+
+    flush_block();
+    m_closed = true;
+
+    uint64_t index_offset = m_os.tellp();
+    std::vector<char> index;
+    for(auto const& b : m_index) {
+      put<uint64_t>(index, b.offset);
+      put<uint64_t>(index, b.t_begin);
+      put<uint64_t>(index, b.t_end);
+      put<uint32_t>(index, b.num_steps);
+    }
+    put<uint64_t>(index, index_offset);
+    put<uint64_t>(index, m_index.size());
+    index.insert(index.end(), trailer_magic, trailer_magic + sizeof(trailer_magic));
+
+    write(index);
+    m_os.close();
+  }
+
+
+  void
+  Writer::flush_block() {
+    // a file without steps still gets a block with the initial values
+    if( m_times.empty() && !m_index.empty() )
+      return;
+
+    uint64_t const t_begin = m_times.empty() ? 0 : m_times.front();
+    uint64_t const t_end = m_times.empty() ? 0 : m_times.back();
+
+    m_raw.clear();
+    put<uint32_t>(m_raw, m_times.size());
+
+    auto prev_t = t_begin;
+    for(auto t : m_times) {
+      put_varint(m_raw, t - prev_t);
+      prev_t = t;
+    }
+
+    m_raw.insert(m_raw.end(), m_block_start.begin(), m_block_start.end());
+
+    for(std::size_t i=0; i<m_signals.size(); ++i) {
+      put_varint(m_raw, m_num_changes[i]);
+      m_raw.insert(m_raw.end(), m_columns[i].begin(), m_columns[i].end());
+    }
+
+    m_compressed.clear();
+    lz_compress(m_raw.data(), m_raw.size(), m_compressed);
+
+    auto const& stored = m_compressed.size() < m_raw.size() ? m_compressed : m_raw;
+    std::vector<char> block_header;
+    put<uint8_t>(block_header, &stored == &m_compressed ? lz : raw);
+    put<uint32_t>(block_header, m_raw.size());
+    put<uint32_t>(block_header, stored.size());
+
+    Block_info info;
+    info.offset = m_os.tellp();
+    info.t_begin = t_begin;
+    info.t_end = t_end;
+    info.num_steps = m_times.size();
+    m_index.push_back(info);
+
+    write(block_header);
+    write(stored);
+
+    // next block starts with the current values
+    m_block_start = m_current;
+    m_times.clear();
+    for(auto& col : m_columns)
+      col.clear();
+    std::fill(m_num_changes.begin(), m_num_changes.end(), 0);
+    std::fill(m_last_step.begin(), m_last_step.end(), 0);
+  }
+
+
+  void
+  Writer::write(std::vector<char> const& data) {
+    m_os.write(data.data(), data.size());
+    if( !m_os ) {
+      std::stringstream strm;
+      strm << "Failed to write to waveform file '"
+        << m_filename
+        << "'";
+      throw std::runtime_error(strm.str());
+    }
+  }
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "wave/wave_format.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+
+namespace wave {
+
+  /** Write a binary waveform file, see wave_format.h
+   *
+   * Scopes and signals have to be added before initial() is called. Values
+   * are passed to initial() and step() as one buffer holding the values of
+   * all signals in the order they were added, see value_offset().
+   * */
+  class Writer {
+    public:
+      /**
+       * @param filename Name of the waveform file
+       * @param block_steps Maximum number of steps per block
+       * */
+      explicit Writer(std::string const& filename,
+          std::size_t block_steps = 4096);
+      ~Writer();
+
+      /** Add a scope
+       *
+       * @param parent Index of the parent scope or -1 for the root
+       * @return Index of the scope
+       * */
+      std::size_t add_scope(int64_t parent, std::string const& name);
+
+      /** Add a signal to a scope
+       *
+       * @return Index of the signal
+       * */
+      std::size_t add_signal(uint64_t scope,
+          std::string const& name,
+          uint32_t width,
+          Signal::Kind kind);
+
+      /** Offset of a signal's value in the value buffer */
+      std::size_t value_offset(std::size_t signal) const {
+        return m_offsets.at(signal);
+      }
+
+      /** Size of the value buffer */
+      std::size_t values_size() const { return m_values_size; }
+
+      /** Write the header and set the initial values */
+      void initial(char const* values);
+
+      /** Record values after a simulation step at time t in picoseconds */
+      void step(uint64_t t, char const* values);
+
+      /** Write pending data, the block index and the trailer */
+      void close();
+
+      std::size_t num_blocks() const { return m_index.size(); }
+
+
+    private:
+      std::string m_filename;
+      std::ofstream m_os;
+      std::size_t m_block_steps;
+      bool m_started = false;
+      bool m_closed = false;
+
+      std::vector<Scope> m_scopes;
+      std::vector<Signal> m_signals;
+      std::vector<std::size_t> m_offsets;
+      std::size_t m_values_size = 0;
+
+      std::vector<char> m_current;
+      std::vector<char> m_block_start;
+      std::vector<uint64_t> m_times;
+      std::vector<std::vector<char>> m_columns;
+      std::vector<uint64_t> m_num_changes;
+      std::vector<uint32_t> m_last_step;
+      std::vector<Block_info> m_index;
+      std::vector<char> m_raw;
+      std::vector<char> m_compressed;
+
+      void flush_block();
+      void write(std::vector<char> const& data);
+  };
+
+}
+
+/* vim: set et ff=unix sts=0 sw=2 ts=2 : */